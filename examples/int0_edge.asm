@@ -0,0 +1,49 @@
+;
+;	int0_edge.asm -- INT0 on falling edges (reference program for the simulator).
+;
+;	PD2 (the INT0 pin) is made an output and toggled by writing to PIND, ten times over, with INT0
+;	set to interrupt on falling edges only.  The handler counts them in r20, and the program stops
+;	at the break with:
+;
+;		r20 = 5, PD2 high
+;
+;	With PD2 an input instead, driving the pin low from outside interrupts the same way.
+;
+
+.mcu "atmega328p"
+
+.equ PIND	= 0x09		; I/O addresses, for in/out
+.equ DDRD	= 0x0a
+.equ PORTD	= 0x0b
+.equ EIMSK	= 0x1d
+.equ EICRA	= 0x69		; data address, for lds/sts
+
+.text
+.org 0
+	jmp	start
+.org 0x02			; INT0
+	jmp	int0_isr
+
+.org 0x34
+start:
+	clr	r20
+	ldi	r16, 0x02
+	sts	EICRA, r16	; ISC01: falling edge
+	ldi	r16, 0x01
+	out	EIMSK, r16	; INT0
+	ldi	r16, 0x04
+	out	PORTD, r16	; PD2 high
+	out	DDRD, r16	; and an output
+	sei
+	ldi	r17, 10
+toggle:
+	out	PIND, r16	; flips PD2
+	nop
+	dec	r17
+	brne	toggle
+	break
+
+int0_isr:
+	inc	r20
+	reti
+
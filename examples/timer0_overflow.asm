@@ -0,0 +1,46 @@
+;
+;	timer0_overflow.asm -- Timer0 overflow interrupt (reference program for the simulator).
+;
+;	Timer0 counts the 16 MHz clock divided by 8 and overflows every 256 * 8 = 2048 cycles.  The
+;	handler counts overflows in r20 while the main loop sleeps between them, and after 100 the
+;	program stops at the break with:
+;
+;		r20 = 100, cycles = 204827
+;
+;	The prescaler runs from reset, so counting starts at the first multiple of 8 after the out
+;	to TCCR0B (cycle 10): the 100th overflow is at cycle 8 + 100 * 2048 = 204808, and waking,
+;	the interrupt response, the handler and the loop back to the break take 19 more.
+;
+
+.mcu "atmega328p"
+
+.equ SMCR	= 0x33		; I/O addresses, for in/out
+.equ TCCR0B	= 0x25
+.equ TIMSK0	= 0x6e		; data address, for lds/sts
+
+.text
+.org 0
+	jmp	start
+.org 0x20			; TIMER0_OVF
+	jmp	timer0_ovf
+
+.org 0x34
+start:
+	ldi	r16, 0x01
+	out	SMCR, r16	; idle sleep enabled
+	clr	r20
+	ldi	r16, 0x01
+	sts	TIMSK0, r16	; TOIE0
+	ldi	r16, 0x02
+	out	TCCR0B, r16	; clk/8: counting from here
+	sei
+loop:
+	sleep
+	cpi	r20, 100
+	brne	loop
+	break
+
+timer0_ovf:
+	inc	r20
+	reti
+
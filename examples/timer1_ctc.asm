@@ -0,0 +1,52 @@
+;
+;	timer1_ctc.asm -- Timer1 clear-on-compare interrupt (reference program for the simulator).
+;
+;	Timer1 counts the 16 MHz clock and is cleared at OCR1A = 15999, so the compare interrupt comes
+;	every 16000 cycles (1 ms).  The main loop keeps reading TCNT1 (low byte first, as 16-bit reads
+;	must be) into r25:r24 until the handler has counted 10 interrupts in r20, then stops at the
+;	break with:
+;
+;		r20 = 10, r25:r24 < 16000, cycles = 160031
+;
+;	Counting starts with the sts to TCCR1B (cycle 14), so the 10th match is at cycle
+;	14 + 15999 + 9 * 16000 = 160013.
+;
+
+.mcu "atmega328p"
+
+.equ TIMSK1	= 0x6f		; data addresses, for lds/sts
+.equ TCCR1B	= 0x81
+.equ TCNT1L	= 0x84
+.equ TCNT1H	= 0x85
+.equ OCR1AL	= 0x88
+.equ OCR1AH	= 0x89
+
+.text
+.org 0
+	jmp	start
+.org 0x16			; TIMER1_COMPA
+	jmp	timer1_compa
+
+.org 0x34
+start:
+	clr	r20
+	ldi	r16, high(15999)
+	sts	OCR1AH, r16	; high byte first
+	ldi	r16, low(15999)
+	sts	OCR1AL, r16
+	ldi	r16, 0x02
+	sts	TIMSK1, r16	; OCIE1A
+	ldi	r16, 0x09
+	sts	TCCR1B, r16	; WGM12 (CTC, TOP = OCR1A), clk/1: counting from here
+	sei
+loop:
+	lds	r24, TCNT1L
+	lds	r25, TCNT1H
+	cpi	r20, 10
+	brne	loop
+	break
+
+timer1_compa:
+	inc	r20
+	reti
+
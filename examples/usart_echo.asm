@@ -0,0 +1,68 @@
+;
+;	usart_echo.asm -- USART0 transmit and receive (reference program for the simulator).
+;
+;	At 16 MHz with UBRR0 = 8 a frame (start, 8 data bits, stop) takes 9 * 16 * 10 = 1440 cycles,
+;	about 115200 baud.  The program sends "OK" and a newline, waiting for the data register to
+;	empty before each byte, then echoes what it receives from the receive interrupt.  Once it has
+;	echoed a '.' it waits for that to be sent and stops at the break.  Given "ab." from outside
+;	when it first sleeps (at cycle 4338), the output is "OK\nab." and:
+;
+;		r20 = 3 (bytes received), r18 = '.', cycles = 10117
+;
+
+.mcu "atmega328p"
+
+.equ UCSR0A	= 0xc0		; data addresses, for lds/sts
+.equ UCSR0B	= 0xc1
+.equ UBRR0L	= 0xc4
+.equ UDR0	= 0xc6
+
+.text
+.org 0
+	jmp	start
+.org 0x24			; USART_RX
+	jmp	usart_rx
+
+.org 0x34
+start:
+	clr	r20
+	ldi	r16, 8
+	sts	UBRR0L, r16
+	ldi	r16, 0x98
+	sts	UCSR0B, r16	; RXCIE0, RXEN0, TXEN0
+	ldi	r17, 'O'
+	rcall	send
+	ldi	r17, 'K'
+	rcall	send
+	ldi	r17, 10
+	rcall	send
+	sei
+loop:
+	sleep
+	cpi	r18, '.'
+	brne	loop
+drain:
+	lds	r16, UCSR0A
+	sbrs	r16, 5		; UDRE0: the '.' is being shifted out
+	rjmp	drain
+	ldi	r16, 0x40
+	sts	UCSR0A, r16	; clear TXC0 (set by an earlier byte) by writing a one
+sent:
+	lds	r16, UCSR0A
+	sbrs	r16, 6		; TXC0: the '.' has gone
+	rjmp	sent
+	break
+
+send:
+	lds	r16, UCSR0A
+	sbrs	r16, 5		; UDRE0
+	rjmp	send
+	sts	UDR0, r17
+	ret
+
+usart_rx:
+	lds	r18, UDR0
+	sts	UDR0, r18	; cannot overrun: bytes arrive no faster than they go
+	inc	r20
+	reti
+
@@ -1,5 +1,6 @@
 CONFIG       += static debug
 QMAKE_CXXFLAGS     += -std=c++11
+QT           += network
 
 greaterThan(QT_MAJOR_VERSION, 4) {
     QT += widgets \
@@ -15,7 +16,39 @@ HEADERS       = mainwindow.h \
     language.h \
     arduinoconfiguration.h \
     tooltipwidget.h \
-    avrasmfileparser.h
+    avrasmfileparser.h \
+    avrasmconstants.h \
+    avrdevice.h \
+    avrheximage.h \
+    avrdecoder.h \
+    avrasmprogram.h \
+    avrlisting.h \
+    avrworkpool.h \
+    avrbatchbuild.h \
+    avrcyclemargin.h \
+    avrasmflow.h \
+    avrisranalysis.h \
+    avrbackgroundanalysis.h \
+    avrstackanalysis.h \
+    avrmemoryusage.h \
+    avrpeephole.h \
+    avrpeepholedialog.h \
+    avrdelaygenerator.h \
+    avrdelaydialog.h \
+    avrcycleassertions.h \
+    avrreachability.h \
+    avrliveness.h \
+    avrinstructionmix.h \
+    avrsimulator.h \
+    avrsimulatorpanel.h \
+    avrprofiler.h \
+    avrhotspotpanel.h \
+    avrsimulatorthread.h \
+    avrtracerecorder.h \
+    avrtracereader.h \
+    avrperipherals.h \
+    avrgdbserver.h \
+    avrserialterminal.h
 
 SOURCES       = main.cpp \
                 mainwindow.cpp \
@@ -27,7 +60,39 @@ SOURCES       = main.cpp \
     arduinoconfiguration.cpp \
     language.cpp \
     tooltipwidget.cpp \
-    avrasmfileparser.cpp
+    avrasmfileparser.cpp \
+    avrasmconstants.cpp \
+    avrdevice.cpp \
+    avrheximage.cpp \
+    avrdecoder.cpp \
+    avrasmprogram.cpp \
+    avrlisting.cpp \
+    avrworkpool.cpp \
+    avrbatchbuild.cpp \
+    avrcyclemargin.cpp \
+    avrasmflow.cpp \
+    avrisranalysis.cpp \
+    avrbackgroundanalysis.cpp \
+    avrstackanalysis.cpp \
+    avrmemoryusage.cpp \
+    avrpeephole.cpp \
+    avrpeepholedialog.cpp \
+    avrdelaygenerator.cpp \
+    avrdelaydialog.cpp \
+    avrcycleassertions.cpp \
+    avrreachability.cpp \
+    avrliveness.cpp \
+    avrinstructionmix.cpp \
+    avrsimulator.cpp \
+    avrsimulatorpanel.cpp \
+    avrprofiler.cpp \
+    avrhotspotpanel.cpp \
+    avrsimulatorthread.cpp \
+    avrtracerecorder.cpp \
+    avrtracereader.cpp \
+    avrperipherals.cpp \
+    avrgdbserver.cpp \
+    avrserialterminal.cpp
 
 RESOURCES     = application.qrc
 
@@ -587,6 +587,15 @@ QString ArduinoConfiguration::avrdudePath (void)
 	return _avrdudePath;
 }
 /*}}}*/
+/*{{{  QString ArduinoConfiguration::targetDevice (void)*/
+/*
+ *	returns the configured target part (avrdude's -p setting).
+ */
+QString ArduinoConfiguration::targetDevice (void)
+{
+	return _opt_p.isEmpty () ? QString (DEFAULT_opt_p) : _opt_p;
+}
+/*}}}*/
 /*{{{  void ArduinoConfiguration::applyParams (void)*/
 /*
  *	called when the 'apply' button is clicked (via Parameters::applyClicked()).
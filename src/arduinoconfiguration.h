@@ -92,6 +92,7 @@ public:
 	QStringList *avrdudeProcessedParams (QString, QString);
 	QStringList avrdudeParams (void);
 	QString avrdudePath (void);
+	QString targetDevice (void);
 	void applyParams (void);
 	void cancelParams (void);
 
@@ -0,0 +1,798 @@
+/*
+ *	avrasmconstants.cpp -- constant (.equ/.set/.def) table and expression evaluator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "avrasmconstants.h"
+
+#include <QDebug>
+
+#include <limits>
+
+
+/*{{{  static helpers for character classes*/
+static inline bool isNameStart (QChar ch)
+{
+	return ch.isLetter () || (ch == '_') || (ch == '.');
+}
+
+static inline bool isNameChar (QChar ch)
+{
+	return ch.isLetterOrNumber () || (ch == '_') || (ch == '.');
+}
+
+static inline bool isRegisterName (const QString &name, qint64 *reg)
+{
+	bool ok;
+	int r;
+
+	if ((name.length () < 2) || (name.length () > 3) || ((name.at (0) != 'r') && (name.at (0) != 'R'))) {
+		return false;
+	}
+	r = name.mid (1).toInt (&ok, 10);
+	if (!ok || (r < 0) || (r > 31)) {
+		return false;
+	}
+	if (reg) {
+		*reg = r;
+	}
+	return true;
+}
+/*}}}*/
+
+/*{{{  class ExpressionParser*/
+/*
+ *	recursive-descent evaluator for assembler constant expressions.  Operators and precedence
+ *	follow C; the hi/lo/hi2/hi3 byte-selection functions are understood as in nocc.
+ */
+class ExpressionParser
+{
+public:
+	ExpressionParser (const QString &text, const AVRASMConstants *table, const QHash<QString, qint64> *extra)
+		: _text (text), _pos (0), _table (table), _extra (extra)
+	{
+	}
+
+	bool parse (qint64 *result, QString *error)
+	{
+		qint64 v = parseTernary ();
+
+		skipSpace ();
+		if (_error.isEmpty () && (_pos < _text.length ())) {
+			_error = QString ("unexpected '%1' in expression").arg (_text.mid (_pos));
+		}
+		if (!_error.isEmpty ()) {
+			if (error) {
+				*error = _error;
+			}
+			return false;
+		}
+		*result = v;
+		return true;
+	}
+
+private:
+	void skipSpace (void)
+	{
+		while ((_pos < _text.length ()) && _text.at (_pos).isSpace ()) {
+			_pos++;
+		}
+	}
+
+	bool accept (const char *op)
+	{
+		int len = qstrlen (op);
+
+		skipSpace ();
+		if (_text.midRef (_pos, len) != QLatin1String (op)) {
+			return false;
+		}
+		/* don't take '<' out of '<<', '|' out of '||', etc. */
+		if ((len == 1) && (_pos + 1 < _text.length ())) {
+			QChar nxt = _text.at (_pos + 1);
+
+			if (((op[0] == '<') || (op[0] == '>')) && ((nxt == op[0]) || (nxt == '='))) {
+				return false;
+			}
+			if (((op[0] == '&') || (op[0] == '|')) && (nxt == op[0])) {
+				return false;
+			}
+			if (((op[0] == '!') || (op[0] == '=')) && (nxt == '=')) {
+				return false;
+			}
+		}
+		_pos += len;
+		return true;
+	}
+
+	qint64 parseTernary (void)
+	{
+		qint64 cond = parseBinary (0);
+
+		if (accept ("?")) {
+			qint64 a = parseTernary ();
+
+			if (!accept (":")) {
+				fail ("expected ':' in conditional expression");
+				return 0;
+			}
+			qint64 b = parseTernary ();
+
+			return cond ? a : b;
+		}
+		return cond;
+	}
+
+	qint64 parseBinary (int level)
+	{
+		/* precedence levels, loosest first */
+		static const char *const levels[][5] = {
+			{ "||", 0 },
+			{ "&&", 0 },
+			{ "|", 0 },
+			{ "^", 0 },
+			{ "&", 0 },
+			{ "==", "!=", 0 },
+			{ "<=", ">=", "<", ">", 0 },
+			{ "<<", ">>", 0 },
+			{ "+", "-", 0 },
+			{ "*", "/", "%", 0 }
+		};
+		static const int nlevels = sizeof (levels) / sizeof (levels[0]);
+
+		if (level == nlevels) {
+			return parseUnary ();
+		}
+
+		qint64 lhs = parseBinary (level + 1);
+
+		while (_error.isEmpty ()) {
+			const char *op = 0;
+
+			for (int i=0; levels[level][i]; i++) {
+				if (accept (levels[level][i])) {
+					op = levels[level][i];
+					break;		/* for() */
+				}
+			}
+			if (!op) {
+				break;			/* while() */
+			}
+
+			qint64 rhs = parseBinary (level + 1);
+
+			lhs = apply (op, lhs, rhs);
+		}
+		return lhs;
+	}
+
+	qint64 apply (const char *op, qint64 a, qint64 b)
+	{
+		switch (op[0]) {
+		case '|':
+			return (op[1] == '|') ? (a || b) : (a | b);
+		case '&':
+			return (op[1] == '&') ? (a && b) : (a & b);
+		case '^':
+			return a ^ b;
+		case '=':
+			return a == b;
+		case '!':
+			return a != b;
+		case '<':
+		case '>':
+			if (op[1] == op[0]) {
+				if ((b < 0) || (b > 63)) {
+					fail ("shift count out of range");
+					return 0;
+				}
+				/* shifted unsigned, so that negative values shift left as the assembler does */
+				return (op[0] == '<') ? (qint64)((quint64)a << b) : (a >> b);
+			}
+			if (op[0] == '<') {
+				return (op[1] == '=') ? (a <= b) : (a < b);
+			}
+			return (op[1] == '=') ? (a >= b) : (a > b);
+		case '+':
+			/* wrapped in 64 bits as the assembler does, computed unsigned to stay defined */
+			return (qint64)((quint64)a + (quint64)b);
+		case '-':
+			return (qint64)((quint64)a - (quint64)b);
+		case '*':
+			return (qint64)((quint64)a * (quint64)b);
+		case '/':
+		case '%':
+			if (b == 0) {
+				fail ("division by zero");
+				return 0;
+			}
+			if ((b == -1) && (a == std::numeric_limits<qint64>::min ())) {
+				fail ("division overflows");
+				return 0;
+			}
+			return (op[0] == '/') ? (a / b) : (a % b);
+		}
+		return 0;
+	}
+
+	qint64 parseUnary (void)
+	{
+		if (accept ("-")) {
+			return (qint64)(0 - (quint64)parseUnary ());
+		} else if (accept ("+")) {
+			return parseUnary ();
+		} else if (accept ("~")) {
+			return ~parseUnary ();
+		} else if (accept ("!")) {
+			return !parseUnary ();
+		}
+		return parsePrimary ();
+	}
+
+	qint64 parsePrimary (void)
+	{
+		skipSpace ();
+		if (_pos >= _text.length ()) {
+			fail ("unexpected end of expression");
+			return 0;
+		}
+
+		QChar ch = _text.at (_pos);
+
+		if (ch == '(') {
+			_pos++;
+
+			qint64 v = parseTernary ();
+
+			if (!accept (")")) {
+				fail ("missing ')'");
+			}
+			return v;
+		} else if (ch == '\'') {
+			return parseCharacter ();
+		} else if (ch.isDigit () || (ch == '$')) {
+			return parseNumber ();
+		} else if (isNameStart (ch)) {
+			int start = _pos;
+
+			while ((_pos < _text.length ()) && isNameChar (_text.at (_pos))) {
+				_pos++;
+			}
+
+			QString name = _text.mid (start, _pos - start);
+
+			if (accept ("(")) {
+				qint64 arg = parseTernary ();
+
+				if (!accept (")")) {
+					fail ("missing ')'");
+					return 0;
+				}
+				return function (name, arg);
+			}
+			return lookup (name);
+		}
+		fail (QString ("unexpected '%1' in expression").arg (ch));
+		return 0;
+	}
+
+	qint64 parseNumber (void)
+	{
+		int base = 10;
+		int start;
+		bool ok;
+		qint64 v;
+
+		if (_text.at (_pos) == '$') {
+			base = 16;
+			_pos++;
+		} else if ((_text.at (_pos) == '0') && (_pos + 1 < _text.length ())) {
+			QChar nxt = _text.at (_pos + 1).toLower ();
+
+			if (nxt == 'x') {
+				base = 16;
+				_pos += 2;
+			} else if ((nxt == 'b') && (_pos + 2 < _text.length ()) && ((_text.at (_pos + 2) == '0') || (_text.at (_pos + 2) == '1'))) {
+				base = 2;
+				_pos += 2;
+			}
+		}
+		start = _pos;
+		while ((_pos < _text.length ()) && _text.at (_pos).isLetterOrNumber ()) {
+			_pos++;
+		}
+		v = _text.mid (start, _pos - start).toLongLong (&ok, base);
+		if (!ok) {
+			fail (QString ("bad number '%1'").arg (_text.mid (start, _pos - start)));
+			return 0;
+		}
+		return v;
+	}
+
+	qint64 parseCharacter (void)
+	{
+		qint64 v;
+
+		_pos++;
+		if (_pos >= _text.length ()) {
+			fail ("unterminated character constant");
+			return 0;
+		}
+		if ((_text.at (_pos) == '\\') && (_pos + 1 < _text.length ())) {
+			switch (_text.at (_pos + 1).toLatin1 ()) {
+			case 'n':	v = '\n'; break;
+			case 'r':	v = '\r'; break;
+			case 't':	v = '\t'; break;
+			case '0':	v = 0; break;
+			default:	v = _text.at (_pos + 1).unicode (); break;
+			}
+			_pos += 2;
+		} else {
+			v = _text.at (_pos).unicode ();
+			_pos++;
+		}
+		if ((_pos >= _text.length ()) || (_text.at (_pos) != '\'')) {
+			fail ("malformed character constant");
+			return 0;
+		}
+		_pos++;
+		return v;
+	}
+
+	qint64 function (const QString &name, qint64 arg)
+	{
+		QString lname = name.toLower ();
+
+		if ((lname == "lo") || (lname == "low")) {
+			return arg & 0xff;
+		} else if ((lname == "hi") || (lname == "high")) {
+			return (arg >> 8) & 0xff;
+		} else if (lname == "hi2") {
+			return (arg >> 16) & 0xff;
+		} else if (lname == "hi3") {
+			return (arg >> 24) & 0xff;
+		}
+		fail (QString ("unknown function '%1'").arg (name));
+		return 0;
+	}
+
+	qint64 lookup (const QString &name)
+	{
+		qint64 v;
+
+		if (_extra && _extra->contains (name)) {
+			return _extra->value (name);
+		}
+		if (_table && _table->contains (name)) {
+			if (_table->value (name, &v)) {
+				return v;
+			}
+			fail (QString ("'%1' has no value").arg (name));
+			return 0;
+		}
+		if (isRegisterName (name, &v)) {
+			return v;
+		}
+		fail (QString ("undefined name '%1'").arg (name));
+		return 0;
+	}
+
+	void fail (const QString &msg)
+	{
+		if (_error.isEmpty ()) {
+			_error = msg;
+		}
+	}
+
+	const QString &_text;
+	int _pos;
+	const AVRASMConstants *_table;
+	const QHash<QString, qint64> *_extra;
+	QString _error;
+};
+/*}}}*/
+
+
+/*{{{  AVRASMConstants::AVRASMConstants ()*/
+/*
+ *	constructor.
+ */
+AVRASMConstants::AVRASMConstants ()
+{
+}
+/*}}}*/
+/*{{{  void AVRASMConstants::clear (void)*/
+/*
+ *	forgets all definitions.
+ */
+void AVRASMConstants::clear (void)
+{
+	_constants.clear ();
+	_dependents.clear ();
+}
+/*}}}*/
+/*{{{  int AVRASMConstants::update (const QString &source)*/
+/*
+ *	brings the table up to date with a single piece of source text.
+ *	returns the number of constants that were re-evaluated.
+ */
+int AVRASMConstants::update (const QString &source)
+{
+	return update (QStringList (source), QStringList (QString ()));
+}
+/*}}}*/
+/*{{{  int AVRASMConstants::update (const QStringList &sources, const QStringList &files)*/
+/*
+ *	scans source texts (e.g. included files, then the file including them) for .equ/.set/.def
+ *	definitions and brings the table up to date, recording each definition's file (from 'files',
+ *	one per source) and line.  Only definitions whose text changed (or was added or removed), and
+ *	the constants downstream of those in the dependency graph, are re-evaluated.
+ *	returns the number of constants that were re-evaluated.
+ */
+int AVRASMConstants::update (const QStringList &sources, const QStringList &files)
+{
+	QHash<QString, Constant> fresh;
+	QSet<QString> seeds;
+	QStringList work;
+	int count = 0;
+
+	/*{{{  collect definitions from the sources*/
+	for (int f=0; f<sources.count (); f++) {
+		QStringList lines = sources.at (f).split ('\n');
+
+		for (int ln=0; ln<lines.count (); ln++) {
+			QString text = stripComment (lines.at (ln)).trimmed ();
+			int i;
+
+			/* skip over any leading label */
+			for (i=0; (i<text.length ()) && isNameChar (text.at (i)); i++);
+			if ((i > 0) && (i < text.length ()) && (text.at (i) == ':') && isNameStart (text.at (0))) {
+				text = text.mid (i + 1).trimmed ();
+			}
+			if (!text.startsWith ('.')) {
+				continue;
+			}
+			for (i=1; (i<text.length ()) && text.at (i).isLetter (); i++);
+
+			QString dir = text.mid (1, i - 1).toLower ();
+			Constant c;
+
+			if (dir == "equ") {
+				c.kind = EQU;
+			} else if (dir == "set") {
+				c.kind = SET;
+			} else if (dir == "def") {
+				c.kind = DEF;
+			} else {
+				continue;
+			}
+
+			QString rest = text.mid (i).trimmed ();
+
+			for (i=0; (i<rest.length ()) && isNameChar (rest.at (i)); i++);
+			if ((i == 0) || !isNameStart (rest.at (0))) {
+				continue;
+			}
+
+			QString name = rest.left (i);
+
+			rest = rest.mid (i).trimmed ();
+			if (!rest.startsWith ('=') && !rest.startsWith (',')) {
+				continue;
+			}
+			c.expression = rest.mid (1).trimmed ();
+			c.depends = namesIn (c.expression);
+			c.file = files.value (f);
+			c.line = ln;
+			c.value = 0;
+			c.valid = false;
+			c.dirty = true;
+			c.visiting = false;
+			fresh.insert (name, c);		/* later .set's replace earlier ones */
+		}
+	}
+	/*}}}*/
+	/*{{{  diff against the existing graph*/
+	for (QHash<QString, Constant>::Iterator it = _constants.begin (); it != _constants.end (); ) {
+		if (!fresh.contains (it.key ())) {
+			unlink (it.key (), it->depends);
+			seeds.insert (it.key ());
+			it = _constants.erase (it);
+		} else {
+			++it;
+		}
+	}
+	for (QHash<QString, Constant>::ConstIterator it = fresh.constBegin (); it != fresh.constEnd (); ++it) {
+		QHash<QString, Constant>::Iterator old = _constants.find (it.key ());
+
+		if (old == _constants.end ()) {
+			_constants.insert (it.key (), it.value ());
+			link (it.key (), it->depends);
+			seeds.insert (it.key ());
+		} else if ((old->kind != it->kind) || (old->expression != it->expression)) {
+			unlink (it.key (), old->depends);
+			*old = it.value ();
+			link (it.key (), old->depends);
+			seeds.insert (it.key ());
+		} else {
+			old->file = it->file;
+			old->line = it->line;
+		}
+	}
+	/*}}}*/
+	/*{{{  mark everything downstream of a changed definition as dirty*/
+	work = seeds.toList ();
+	while (!work.isEmpty ()) {
+		QString name = work.takeLast ();
+		QHash<QString, Constant>::Iterator it = _constants.find (name);
+
+		if (it != _constants.end ()) {
+			it->dirty = true;
+		}
+		for (const QString &dep : _dependents.value (name)) {
+			if (!seeds.contains (dep)) {
+				seeds.insert (dep);
+				work.append (dep);
+			}
+		}
+	}
+	/*}}}*/
+
+	for (const QString &name : seeds) {
+		if (_constants.contains (name)) {
+			evaluateNode (name);
+			count++;
+		}
+	}
+	return count;
+}
+/*}}}*/
+/*{{{  void AVRASMConstants::evaluateNode (const QString &name)*/
+/*
+ *	evaluates a single (dirty) constant, evaluating any dirty dependencies first.
+ */
+void AVRASMConstants::evaluateNode (const QString &name)
+{
+	QHash<QString, Constant>::Iterator it = _constants.find (name);
+
+	if ((it == _constants.end ()) || !it->dirty || it->visiting) {
+		return;
+	}
+	it->visiting = true;
+	for (const QString &dep : it->depends) {
+		evaluateNode (dep);
+	}
+
+	/* no insertions happen above, so the iterator is still good */
+	it->visiting = false;
+	it->dirty = false;
+	it->error.clear ();
+	for (const QString &dep : it->depends) {
+		QHash<QString, Constant>::ConstIterator d = _constants.constFind (dep);
+
+		if ((d != _constants.constEnd ()) && d->visiting) {
+			it->valid = false;
+			it->error = QString ("circular definition through '%1'").arg (dep);
+			return;
+		}
+	}
+	it->valid = evaluate (it->expression, &(it->value), &(it->error));
+}
+/*}}}*/
+/*{{{  void AVRASMConstants::link (const QString &name, const QStringList &depends)*/
+/*
+ *	adds reverse dependency edges for a constant.
+ */
+void AVRASMConstants::link (const QString &name, const QStringList &depends)
+{
+	for (const QString &dep : depends) {
+		_dependents[dep].insert (name);
+	}
+}
+/*}}}*/
+/*{{{  void AVRASMConstants::unlink (const QString &name, const QStringList &depends)*/
+/*
+ *	removes reverse dependency edges for a constant.
+ */
+void AVRASMConstants::unlink (const QString &name, const QStringList &depends)
+{
+	for (const QString &dep : depends) {
+		QHash<QString, QSet<QString> >::Iterator it = _dependents.find (dep);
+
+		if (it != _dependents.end ()) {
+			it->remove (name);
+			if (it->isEmpty ()) {
+				_dependents.erase (it);
+			}
+		}
+	}
+}
+/*}}}*/
+
+/*{{{  bool AVRASMConstants::contains (const QString &name) const*/
+/*
+ *	true if the given name is defined here.
+ */
+bool AVRASMConstants::contains (const QString &name) const
+{
+	return _constants.contains (name);
+}
+/*}}}*/
+/*{{{  bool AVRASMConstants::value (const QString &name, qint64 *result) const*/
+/*
+ *	gets the value of a constant (the register number for .def names).
+ *	returns true on success, false if undefined or it could not be evaluated.
+ */
+bool AVRASMConstants::value (const QString &name, qint64 *result) const
+{
+	QHash<QString, Constant>::ConstIterator it = _constants.constFind (name);
+
+	if ((it == _constants.constEnd ()) || !it->valid || it->dirty) {
+		return false;
+	}
+	*result = it->value;
+	return true;
+}
+/*}}}*/
+/*{{{  AVRASMConstants::ConstantKind AVRASMConstants::kind (const QString &name) const*/
+/*
+ *	returns how a constant was defined.
+ */
+AVRASMConstants::ConstantKind AVRASMConstants::kind (const QString &name) const
+{
+	return _constants.value (name).kind;
+}
+/*}}}*/
+/*{{{  QString AVRASMConstants::expression (const QString &name) const*/
+/*
+ *	returns the defining expression text for a constant.
+ */
+QString AVRASMConstants::expression (const QString &name) const
+{
+	return _constants.value (name).expression;
+}
+/*}}}*/
+/*{{{  QString AVRASMConstants::errorFor (const QString &name) const*/
+/*
+ *	returns the reason a constant could not be evaluated (empty if it was).
+ */
+QString AVRASMConstants::errorFor (const QString &name) const
+{
+	return _constants.value (name).error;
+}
+/*}}}*/
+/*{{{  int AVRASMConstants::lineFor (const QString &name) const*/
+/*
+ *	returns the (0-based) source line a constant was defined on, -1 if unknown.
+ */
+int AVRASMConstants::lineFor (const QString &name) const
+{
+	QHash<QString, Constant>::ConstIterator it = _constants.constFind (name);
+
+	return (it == _constants.constEnd ()) ? -1 : it->line;
+}
+/*}}}*/
+/*{{{  QString AVRASMConstants::fileFor (const QString &name) const*/
+/*
+ *	returns the file a constant was defined in (as given to update ()), empty if unknown.
+ */
+QString AVRASMConstants::fileFor (const QString &name) const
+{
+	QHash<QString, Constant>::ConstIterator it = _constants.constFind (name);
+
+	return (it == _constants.constEnd ()) ? QString () : it->file;
+}
+/*}}}*/
+/*{{{  QStringList AVRASMConstants::dependencies (const QString &name) const*/
+/*
+ *	returns the names used in a constant's definition.
+ */
+QStringList AVRASMConstants::dependencies (const QString &name) const
+{
+	return _constants.value (name).depends;
+}
+/*}}}*/
+/*{{{  QStringList AVRASMConstants::names (void) const*/
+/*
+ *	returns all defined names.
+ */
+QStringList AVRASMConstants::names (void) const
+{
+	return _constants.keys ();
+}
+/*}}}*/
+
+/*{{{  bool AVRASMConstants::evaluate (const QString &expr, qint64 *result, QString *error, const QHash<QString, qint64> *extra) const*/
+/*
+ *	evaluates an expression against the current table (and optionally some extra names, e.g. labels).
+ *	returns true on success, false otherwise (with a reason in 'error' if given).
+ */
+bool AVRASMConstants::evaluate (const QString &expr, qint64 *result, QString *error, const QHash<QString, qint64> *extra) const
+{
+	ExpressionParser parser (expr, this, extra);
+
+	return parser.parse (result, error);
+}
+/*}}}*/
+/*{{{  QString AVRASMConstants::stripComment (const QString &line)*/
+/*
+ *	removes a trailing ';' comment from a line, respecting quoted strings and characters.
+ */
+QString AVRASMConstants::stripComment (const QString &line)
+{
+	QChar quote;
+
+	for (int i=0; i<line.length (); i++) {
+		QChar ch = line.at (i);
+
+		if (!quote.isNull ()) {
+			if (ch == '\\') {
+				i++;
+			} else if (ch == quote) {
+				quote = QChar ();
+			}
+		} else if ((ch == '"') || (ch == '\'')) {
+			quote = ch;
+		} else if (ch == ';') {
+			return line.left (i);
+		}
+	}
+	return line;
+}
+/*}}}*/
+/*{{{  QStringList AVRASMConstants::namesIn (const QString &expr)*/
+/*
+ *	returns the names (not numbers, registers or function calls) referenced by an expression.
+ */
+QStringList AVRASMConstants::namesIn (const QString &expr)
+{
+	QStringList names;
+	int i = 0;
+
+	while (i < expr.length ()) {
+		QChar ch = expr.at (i);
+
+		if (ch == '\'') {
+			/* skip character constant */
+			for (i++; (i < expr.length ()) && (expr.at (i) != '\''); i++) {
+				if (expr.at (i) == '\\') {
+					i++;
+				}
+			}
+			i++;
+		} else if (ch.isDigit () || (ch == '$')) {
+			for (i++; (i < expr.length ()) && expr.at (i).isLetterOrNumber (); i++);
+		} else if (isNameStart (ch)) {
+			int start = i;
+			int j;
+
+			for (i++; (i < expr.length ()) && isNameChar (expr.at (i)); i++);
+			for (j=i; (j < expr.length ()) && expr.at (j).isSpace (); j++);
+
+			QString name = expr.mid (start, i - start);
+
+			if (((j >= expr.length ()) || (expr.at (j) != '(')) && !isRegisterName (name, 0) && !names.contains (name)) {
+				names << name;
+			}
+		} else {
+			i++;
+		}
+	}
+	return names;
+}
+/*}}}*/
+
@@ -0,0 +1,86 @@
+/*
+ *	avrasmconstants.h -- constant (.equ/.set/.def) table and expression evaluator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRASMCONSTANTS_H
+#define AVRASMCONSTANTS_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/*
+ *	Holds the constants defined by a piece of source.  Each definition is a node in a dependency
+ *	graph (edges from a constant to the constants named in its expression), so that after an edit
+ *	only the definitions that changed, and whatever depends on them, get re-evaluated.
+ */
+class AVRASMConstants
+{
+public:
+	typedef enum ConstantKind {
+		EQU = 0,
+		SET,
+		DEF
+	} ConstantKind;
+
+	AVRASMConstants ();
+
+	int update (const QString &source);
+	int update (const QStringList &sources, const QStringList &files);
+	void clear (void);
+
+	bool contains (const QString &name) const;
+	bool value (const QString &name, qint64 *result) const;
+	ConstantKind kind (const QString &name) const;
+	QString expression (const QString &name) const;
+	QString errorFor (const QString &name) const;
+	int lineFor (const QString &name) const;
+	QString fileFor (const QString &name) const;
+	QStringList dependencies (const QString &name) const;
+	QStringList names (void) const;
+
+	bool evaluate (const QString &expr, qint64 *result, QString *error = 0, const QHash<QString, qint64> *extra = 0) const;
+
+	static QString stripComment (const QString &line);
+	static QStringList namesIn (const QString &expr);
+
+private:
+	typedef struct Constant {
+		ConstantKind kind;
+		QString expression;
+		QStringList depends;
+		QString file;		/* where defined ('files' given to update ()) */
+		int line;
+		qint64 value;
+		bool valid;
+		bool dirty;
+		bool visiting;
+		QString error;
+	} Constant;
+
+	void evaluateNode (const QString &name);
+	void link (const QString &name, const QStringList &depends);
+	void unlink (const QString &name, const QStringList &depends);
+
+	QHash<QString, Constant> _constants;
+	QHash<QString, QSet<QString> > _dependents;	/* reverse edges: name -> constants whose expression uses it */
+};
+
+#endif	/* !AVRASMCONSTANTS_H */
+
@@ -0,0 +1,297 @@
+/*
+ *	avrasmflow.cpp -- control-flow graph over a laid-out assembler program.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include <QHash>
+#include <QSet>
+
+#include "avrasmflow.h"
+#include "avrasmprogram.h"
+#include "avrdevice.h"
+
+/*{{{  AVRASMFlow::NodeKind AVRASMFlow::nodeKind (const QString &mnemonic)*/
+/*
+ *	classifies an instruction by what it does to control flow.
+ */
+AVRASMFlow::NodeKind AVRASMFlow::nodeKind (const QString &mnemonic)
+{
+	static const QSet<QString> skips = {"cpse", "sbrc", "sbrs", "sbic", "sbis"};
+
+	if ((mnemonic == "rjmp") || (mnemonic == "jmp")) {
+		return AVRASMFlow::JUMP;
+	} else if ((mnemonic == "rcall") || (mnemonic == "call")) {
+		return AVRASMFlow::CALL;
+	} else if (mnemonic == "ret") {
+		return AVRASMFlow::RETURN;
+	} else if (mnemonic == "reti") {
+		return AVRASMFlow::RETI;
+	} else if ((mnemonic == "ijmp") || (mnemonic == "eijmp")) {
+		return AVRASMFlow::INDIRECT_JUMP;
+	} else if ((mnemonic == "icall") || (mnemonic == "eicall")) {
+		return AVRASMFlow::INDIRECT_CALL;
+	} else if (skips.contains (mnemonic)) {
+		return AVRASMFlow::SKIP;
+	} else if (mnemonic.startsWith ("br") && (mnemonic != "break")) {
+		return AVRASMFlow::BRANCH;
+	}
+	return AVRASMFlow::PLAIN;
+}
+/*}}}*/
+
+/*{{{  AVRASMFlow::AVRASMFlow (const AVRASMProgram &program, bool pc22)*/
+/*
+ *	constructor: builds the graph for a program (which must outlive this).
+ */
+AVRASMFlow::AVRASMFlow (const AVRASMProgram &program, bool pc22) : _program (program), _pc22 (pc22)
+{
+	build ();
+}
+/*}}}*/
+/*{{{  const AVRASMProgram &AVRASMFlow::program (void) const*/
+/*
+ *	returns the program the graph was built from.
+ */
+const AVRASMProgram &AVRASMFlow::program (void) const
+{
+	return _program;
+}
+/*}}}*/
+/*{{{  const QVector<AVRASMFlow::Node> &AVRASMFlow::nodes (void) const*/
+/*
+ *	returns the nodes, in address order.
+ */
+const QVector<AVRASMFlow::Node> &AVRASMFlow::nodes (void) const
+{
+	return _nodes;
+}
+/*}}}*/
+/*{{{  int AVRASMFlow::nodeAt (qint32 address) const*/
+/*
+ *	returns the node starting at the given (byte) address, or -1.
+ */
+int AVRASMFlow::nodeAt (qint32 address) const
+{
+	int idx = _program.indexForAddress (address);
+	int n = nodeForIndex (idx);
+
+	if ((n < 0) || (_nodes.at (n).address != address)) {
+		return -1;
+	}
+	return n;
+}
+/*}}}*/
+/*{{{  int AVRASMFlow::nodeForLabel (const QString &label) const*/
+/*
+ *	returns the node a text-section label refers to, or -1.
+ */
+int AVRASMFlow::nodeForLabel (const QString &label) const
+{
+	const QHash<QString, AVRASMProgram::Symbol> &syms = _program.symbols ();
+	QHash<QString, AVRASMProgram::Symbol>::const_iterator it = syms.find (label);
+
+	if ((it == syms.end ()) || (it->section != AVRASMProgram::TEXT)) {
+		return -1;
+	}
+	return nodeAt (it->address);
+}
+/*}}}*/
+/*{{{  int AVRASMFlow::nodeForIndex (int index) const*/
+/*
+ *	returns the node for a program line, or -1 if that line is not an instruction.
+ */
+int AVRASMFlow::nodeForIndex (int index) const
+{
+	if ((index < 0) || (index >= _nodeForIndex.count ())) {
+		return -1;
+	}
+	return _nodeForIndex.at (index);
+}
+/*}}}*/
+/*{{{  QVector<int> AVRASMFlow::vectorEntries (const AVRDeviceInfo &dev, QVector<int> *slots) const*/
+/*
+ *	finds the handler for each interrupt vector ([0] is reset): the target of the jump in the
+ *	vector's slot, or the slot itself if it holds a reti.  Unused vectors (nothing placed, or
+ *	something other than a jump) are -1.  If 'slots' is given, it gets the slot nodes.
+ */
+QVector<int> AVRASMFlow::vectorEntries (const AVRDeviceInfo &dev, QVector<int> *slots) const
+{
+	QVector<int> entries (dev.vectorCount, -1);
+
+	if (slots) {
+		slots->fill (-1, dev.vectorCount);
+	}
+	for (int v=0; v<dev.vectorCount; v++) {
+		int n = nodeAt (v * dev.vectorSize * 2);
+
+		if (n < 0) {
+			continue;
+		}
+		const Node &node = _nodes.at (n);
+
+		if ((node.kind == JUMP) && (node.target >= 0)) {
+			entries[v] = node.target;
+		} else if (node.kind == RETI) {
+			entries[v] = n;
+		} else {
+			continue;
+		}
+		if (slots) {
+			(*slots)[v] = n;
+		}
+	}
+	return entries;
+}
+/*}}}*/
+/*{{{  int AVRASMFlow::edgeCycles (int node, bool taken) const*/
+/*
+ *	returns the cycles a node costs when it leaves by its target ('taken') or falls through.
+ *	Skips cost one more cycle per word of the instruction they pass over.
+ */
+int AVRASMFlow::edgeCycles (int node, bool taken) const
+{
+	const Node &n = _nodes.at (node);
+
+	switch (n.kind) {
+	case BRANCH:
+		return taken ? n.maxCycles : n.minCycles;
+	case SKIP:
+		if (taken && (n.next >= 0)) {
+			return n.minCycles + (_nodes.at (n.next).size >> 1);
+		}
+		return n.minCycles;
+	default:
+		return n.maxCycles;
+	}
+}
+/*}}}*/
+
+/*{{{  void AVRASMFlow::build (void)*/
+/*
+ *	creates a node for each placed instruction in the text section, then links them up.
+ */
+void AVRASMFlow::build (void)
+{
+	const QVector<AVRASMProgram::Line> &lines = _program.lines ();
+
+	_nodes.clear ();
+	_nodeForIndex.fill (-1, lines.count ());
+
+	/*{{{  nodes, in address order*/
+	for (int i=0; i<lines.count (); i++) {
+		const AVRASMProgram::Line &l = lines.at (i);
+		Node node;
+
+		if ((l.section != AVRASMProgram::TEXT) || (l.size <= 0) || (l.address < 0) ||
+				((l.kind != AVRASMProgram::INSTRUCTION) && (l.kind != AVRASMProgram::MACRO_CALL))) {
+			continue;
+		}
+		node.index = i;
+		node.kind = (l.kind == AVRASMProgram::INSTRUCTION) ? nodeKind (l.stmt->mnemonic) : PLAIN;
+		node.mnemonic = l.stmt->mnemonic;
+		node.address = l.address;
+		node.size = l.size;
+		node.minCycles = l.minCycles;
+		node.maxCycles = l.maxCycles;
+		node.next = -1;
+		node.target = -1;
+		node.unresolved = false;
+
+		switch (node.kind) {
+		case CALL:
+		case INDIRECT_CALL:
+		case RETURN:
+		case RETI:
+			/* the range in the opcode table is 16-bit vs 22-bit PC */
+			node.minCycles = node.maxCycles = _pc22 ? l.maxCycles : l.minCycles;
+			break;
+		default:
+			break;
+		}
+		_nodes << node;
+	}
+	std::stable_sort (_nodes.begin (), _nodes.end (), [] (const Node &a, const Node &b) { return a.address < b.address; });
+	for (int n=0; n<_nodes.count (); n++) {
+		_nodeForIndex[_nodes.at (n).index] = n;
+	}
+	/*}}}*/
+	/*{{{  successors*/
+	for (int n=0; n<_nodes.count (); n++) {
+		Node &node = _nodes[n];
+		const QStringList &ops = lines.at (node.index).stmt->operands;
+
+		if ((node.kind != JUMP) && (node.kind != RETURN) && (node.kind != RETI) && (node.kind != INDIRECT_JUMP)) {
+			node.next = nodeAt (node.address + node.size);
+		}
+		switch (node.kind) {
+		case JUMP:
+		case CALL:
+			if (!ops.isEmpty ()) {
+				node.target = resolveTarget (node, ops.first ());
+			}
+			node.unresolved = (node.target < 0);
+			break;
+		case BRANCH:
+			if (!ops.isEmpty ()) {
+				node.target = resolveTarget (node, ops.last ());
+			}
+			node.unresolved = (node.target < 0);
+			break;
+		default:
+			break;
+		}
+	}
+	for (int n=0; n<_nodes.count (); n++) {
+		Node &node = _nodes[n];
+
+		if ((node.kind == SKIP) && (node.next >= 0)) {
+			node.target = _nodes.at (node.next).next;
+		}
+	}
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  int AVRASMFlow::resolveTarget (const Node &node, const QString &operand) const*/
+/*
+ *	finds the node a jump/branch/call operand refers to: a label, or an expression over labels
+ *	(as word addresses) and 'pc'.
+ *	returns the node, or -1 if it cannot be worked out.
+ */
+int AVRASMFlow::resolveTarget (const Node &node, const QString &operand) const
+{
+	QString op = operand.trimmed ();
+	int n = nodeForLabel (op);
+	QHash<QString, qint64> extra;
+	qint64 v;
+
+	if (n >= 0) {
+		return n;
+	}
+	for (const AVRASMProgram::Symbol &sym : _program.symbols ()) {
+		extra.insert (sym.name, (sym.section == AVRASMProgram::TEXT) ? (sym.address >> 1) : sym.address);
+	}
+	extra.insert ("pc", node.address >> 1);
+	extra.insert ("PC", node.address >> 1);
+	if (!_program.constants ().evaluate (op, &v, 0, &extra)) {
+		return -1;
+	}
+	return nodeAt ((qint32)(v << 1));
+}
+/*}}}*/
+
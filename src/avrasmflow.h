@@ -0,0 +1,87 @@
+/*
+ *	avrasmflow.h -- control-flow graph over a laid-out assembler program.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRASMFLOW_H
+#define AVRASMFLOW_H
+
+#include <QString>
+#include <QVector>
+
+class AVRASMProgram;
+struct AVRDeviceInfo;
+
+/*
+ *	One node per instruction (or macro invocation) in the text section.  Each node has at most two
+ *	successors: the fall-through ('next') and a 'target' (jump, branch, call, or the instruction
+ *	after the one a skip passes over).  Call and return timings are fixed for the size of the
+ *	program counter (16 or 22 bits) rather than left as a range.
+ */
+class AVRASMFlow
+{
+public:
+	typedef enum NodeKind {
+		PLAIN = 0,		/* falls through */
+		JUMP,			/* rjmp, jmp: target only */
+		BRANCH,			/* conditional branch: next or target */
+		SKIP,			/* cpse, sbrc, ...: next or the one after */
+		CALL,			/* rcall, call: target then next */
+		RETURN,			/* ret */
+		RETI,			/* reti */
+		INDIRECT_JUMP,		/* ijmp, eijmp */
+		INDIRECT_CALL		/* icall, eicall */
+	} NodeKind;
+
+	typedef struct Node {
+		int index;		/* into the program's lines () */
+		NodeKind kind;
+		QString mnemonic;
+		qint32 address;		/* bytes */
+		int size;		/* bytes */
+		int minCycles;
+		int maxCycles;
+		int next;		/* fall-through node, -1 if none */
+		int target;		/* other successor, -1 if none or not resolved */
+		bool unresolved;	/* has a target we could not find */
+	} Node;
+
+	AVRASMFlow (const AVRASMProgram &program, bool pc22 = false);
+
+	const AVRASMProgram &program (void) const;
+	const QVector<Node> &nodes (void) const;
+	int nodeAt (qint32 address) const;
+	int nodeForLabel (const QString &label) const;
+	int nodeForIndex (int index) const;
+	QVector<int> vectorEntries (const AVRDeviceInfo &dev, QVector<int> *slots = 0) const;
+
+	int edgeCycles (int node, bool taken) const;
+
+	static NodeKind nodeKind (const QString &mnemonic);
+
+private:
+	void build (void);
+	int resolveTarget (const Node &node, const QString &operand) const;
+
+	const AVRASMProgram &_program;
+	bool _pc22;			/* 22-bit program counter (calls and returns take longer) */
+	QVector<Node> _nodes;
+	QVector<int> _nodeForIndex;	/* program line index -> node, -1 if none */
+};
+
+#endif	/* !AVRASMFLOW_H */
+
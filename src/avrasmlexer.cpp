@@ -24,6 +24,7 @@
 #include <QProcess>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QTextStream>
 #include <QXmlStreamReader>
@@ -41,6 +42,8 @@
 	#include "avrasmtoken.h"
 #endif
 
+#include "avrasmprogram.h"
+#include "avrliveness.h"
 #include "language.h"
 #include "mainwindow.h"
 #include "parameters.h"
@@ -70,6 +73,9 @@ AVRASMLexer::AVRASMLexer (QObject *parent) : QsciLexerCustom (parent)
 	_tokenReader = NULL;
 #endif
 	_apisReady = false;
+	_constantsStale = true;
+	_fileName = QString ("untitled.asm");
+	_tooltipLine = -1;
 	_tooltipWidget = new TooltipWidget (scintillaEditor);
 	_tooltipWidget->setAutoFillBackground (true);
 	initStyles ();
@@ -78,6 +84,7 @@ AVRASMLexer::AVRASMLexer (QObject *parent) : QsciLexerCustom (parent)
 	}
 	// Install an event filter to catch tooltip events in order to display useful information
 	scintillaEditor->installEventFilter (this);
+	connect (scintillaEditor, SIGNAL (textChanged ()), SLOT (textChanged ()));
 	connect (Parameters::getInstance().editorConfig(), SIGNAL (updateStyle()), SLOT (updateStyle()));
 }
 /*}}}*/
@@ -485,6 +492,39 @@ fprintf (stderr, "AVRASMLexer::styleText(): start=%d, end=%d\n", start, end);
 #endif
 }
 /*}}}*/
+/*{{{  AVRASMConstants *AVRASMLexer::constants (void)*/
+/*
+ *	returns the constant table for the editor contents, brought up to date first.
+ */
+AVRASMConstants *AVRASMLexer::constants (void)
+{
+	updateConstants ();
+	return &_constants;
+}
+/*}}}*/
+/*{{{  void AVRASMLexer::setSourceFile (const QString &fileName, const QStringList &includePaths)*/
+/*
+ *	sets the file the editor holds and the include paths, for constants from included files.
+ */
+void AVRASMLexer::setSourceFile (const QString &fileName, const QStringList &includePaths)
+{
+	if ((fileName != _fileName) || (includePaths != _includePaths)) {
+		_fileName = fileName;
+		_includePaths = includePaths;
+		_constantsStale = true;
+	}
+}
+/*}}}*/
+/*{{{  void AVRASMLexer::setLiveRegisters (const QHash<int, quint32> &liveByLine)*/
+/*
+ *	sets the registers live before each editor line (from the background analysis), shown as
+ *	free and live registers in tool-tips.
+ */
+void AVRASMLexer::setLiveRegisters (const QHash<int, quint32> &liveByLine)
+{
+	_liveByLine = liveByLine;
+}
+/*}}}*/
 
 
 // Private functions
@@ -524,6 +564,15 @@ void AVRASMLexer::updateStyle (void)
 	((QsciScintilla *)parent())->setCaretWidth (Parameters::getInstance ().editorConfig ()->cursorSize ());
 }
 /*}}}*/
+/*{{{  void AVRASMLexer::textChanged (void)*/
+/*
+ *	called when the editor text changes: the constant table is brought up to date when next used.
+ */
+void AVRASMLexer::textChanged (void)
+{
+	_constantsStale = true;
+}
+/*}}}*/
 
 #ifdef USE_NOCC_LEXER
 /*{{{  int AVRASMLexer::styleForToken (const AVRASMToken &token) const*/
@@ -911,6 +960,36 @@ bool AVRASMLexer::eventFilter (QObject *qobj, QEvent *event)
 	return false;
 }
 /*}}}*/
+/*{{{  void AVRASMLexer::updateConstants (void)*/
+/*
+ *	brings the constant table up to date with the editor text and the files it includes, if it
+ *	has changed since the last time (only edited definitions, and their dependents, get
+ *	re-evaluated).
+ */
+void AVRASMLexer::updateConstants (void)
+{
+	if (_constantsStale) {
+		AVRASMParsedFile *main = new AVRASMParsedFile;
+		QVector<QSharedPointer<const AVRASMParsedFile> > parsed;
+		QStringList files (_fileName);
+		QStringList sources, names;
+
+		main->fileName = _fileName;
+		main->text = editor ()->text ().remove ('\r').split ('\n');
+		AVRASMProgram::parseStatements (main->text, &main->statements);
+		parsed << QSharedPointer<const AVRASMParsedFile> (main);
+		AVRASMProgram::findIncludes (&files, &parsed, _includePaths);
+
+		/* includes first, so the including file's definitions win */
+		for (int f=parsed.count () - 1; f>=0; f--) {
+			sources << parsed.at (f)->text.join ("\n");
+			names << files.at (f);
+		}
+		_constants.update (sources, names);
+		_constantsStale = false;
+	}
+}
+/*}}}*/
 /*{{{  void AVRASMLexer::updateTooltip (const QPoint &tooltipPosition)*/
 /*
  *	updates tool-tip based on what the word is, i.e. provides documentation for particular things.
@@ -919,12 +998,17 @@ void AVRASMLexer::updateTooltip (const QPoint &tooltipPosition)
 {
 	static QStringList (AVRASMLexer::*tooltipGenerators[]) (const QString &) const = {
 		&AVRASMLexer::tooltipForOpcode,
-		&AVRASMLexer::tooltipForDirective
+		&AVRASMLexer::tooltipForDirective,
+		&AVRASMLexer::tooltipForConstant,
+		&AVRASMLexer::tooltipForRegisters
 	};
 
 	QString wordUnderCursor = editor()->wordAtPoint (tooltipPosition);
 	QStringList tooltipContent;
 
+	_tooltipLine = editor()->lineAt (tooltipPosition);
+	updateConstants ();
+
 	for (auto tooltipGenerator:tooltipGenerators) {
 		tooltipContent = (this->*tooltipGenerator)(wordUnderCursor);
 
@@ -936,13 +1020,15 @@ void AVRASMLexer::updateTooltip (const QPoint &tooltipPosition)
 	if (tooltipContent.empty ()) {
 		_tooltipWidget->hide ();
 	} else {
-		if (wordUnderCursor != _lastTooltipContext) {
+		QString context = QString ("%1:%2").arg (_tooltipLine).arg (wordUnderCursor);
+
+		if (context != _lastTooltipContext) {
 			_tooltipWidget->setTooltips (tooltipContent);
 		}
 		_tooltipWidget->move (tooltipPosition + QPoint (10, 10));
 		_tooltipWidget->resize (_tooltipWidget->sizeHint ());
 		_tooltipWidget->show ();
-		_lastTooltipContext = wordUnderCursor;
+		_lastTooltipContext = context;
 	}
 }
 /*}}}*/
@@ -1023,4 +1109,79 @@ QStringList AVRASMLexer::tooltipForDirective (const QString &directive) const
 	return QStringList (tooltipContent);
 }
 /*}}}*/
+/*{{{  QStringList AVRASMLexer::tooltipForConstant (const QString &name) const*/
+/*
+ *	returns a string containing a tool-tip for a .equ/.set/.def name, showing its value.
+ */
+QStringList AVRASMLexer::tooltipForConstant (const QString &name) const
+{
+	// A few lambdas to format the tooltip with HTML
+	static auto wrapInTag =[](const QString & tag, const QString & text) {
+		return (QStringList () << "<" << tag << ">" << text << "</" << tag << ">").join ("");
+	};
+	static auto table = std::bind (wrapInTag, "table", std::placeholders::_1);
+	static auto tr = std::bind (wrapInTag, "tr", std::placeholders::_1);
+	static auto td = std::bind (wrapInTag, "td", std::placeholders::_1);
+	static auto b = std::bind (wrapInTag, "b", std::placeholders::_1);
+	static const char *kindNames[] = { ".equ", ".set", ".def" };
+
+	qint64 val;
+	QString valueText;
+
+	if (!_constants.contains (name)) {
+		return QStringList ();
+	}
+
+	AVRASMConstants::ConstantKind kind = _constants.kind (name);
+
+	if (!_constants.value (name, &val)) {
+		valueText = QString ("<i>%1</i>").arg (_constants.errorFor (name).toHtmlEscaped ());
+	} else if (kind == AVRASMConstants::DEF) {
+		valueText = QString ("r%1").arg (val);
+	} else {
+		valueText = QString ("%1 (0x%2)").arg (val).arg ((quint64)val, 0, 16);
+	}
+
+	QString tooltipContent = b (name)
+		+ ": " + kindNames[kind]
+		+ table ((QStringList ()
+			  << tr (td (b ("Definition:")) + td (_constants.expression (name).toHtmlEscaped ()))
+			  << tr (td (b (kind == AVRASMConstants::DEF ? "Register:" : "Value:")) + td (valueText))
+			  << ((_constants.fileFor (name) == _fileName) ? "" :
+				  tr (td (b ("From:")) + td (QString ("%1:%2").arg (QFileInfo (_constants.fileFor (name)).fileName ())
+						  .arg (_constants.lineFor (name) + 1).toHtmlEscaped ())))
+			  << (_constants.dependencies (name).isEmpty () ? "" :
+				  tr (td (b ("Uses:")) + td (_constants.dependencies (name).join (", "))))).join ("\n"));
+	return QStringList (tooltipContent);
+}
+/*}}}*/
+/*{{{  QStringList AVRASMLexer::tooltipForRegisters (const QString &word) const*/
+/*
+ *	returns a string containing a tool-tip for the line under the mouse, showing which registers
+ *	are free (not live) before its instruction, or the next instruction on a label or comment.
+ */
+QStringList AVRASMLexer::tooltipForRegisters (const QString &word) const
+{
+	// A few lambdas to format the tooltip with HTML
+	static auto wrapInTag =[](const QString & tag, const QString & text) {
+		return (QStringList () << "<" << tag << ">" << text << "</" << tag << ">").join ("");
+	};
+	static auto table = std::bind (wrapInTag, "table", std::placeholders::_1);
+	static auto tr = std::bind (wrapInTag, "tr", std::placeholders::_1);
+	static auto td = std::bind (wrapInTag, "td", std::placeholders::_1);
+	static auto b = std::bind (wrapInTag, "b", std::placeholders::_1);
+
+	Q_UNUSED (word);
+	if (!_liveByLine.contains (_tooltipLine)) {
+		return QStringList ();
+	}
+
+	quint32 live = _liveByLine.value (_tooltipLine);
+	QString tooltipContent = table ((QStringList ()
+			  << tr (td (b ("Free:")) + td (AVRLiveness::registerList (~live)))
+			  << tr (td (b ("Live:")) + td (AVRLiveness::registerList (live)))).join ("\n"));
+
+	return QStringList (tooltipContent);
+}
+/*}}}*/
 
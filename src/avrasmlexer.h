@@ -23,9 +23,11 @@
 #define AVRASMLEXER_H
 
 #include <Qsci/qscilexercustom.h>
+#include <QHash>
 #include <QProcess>
 
 #include "parameters.h"
+#include "avrasmconstants.h"
 
 /* Note: turning this on causes the styler to use nocc for lexing: this is *not* fast on Windows */
 #undef USE_NOCC_LEXER
@@ -54,8 +56,13 @@ public:
 	// Inherited from QsciLexerCustom
 	void styleText (int start, int end);
 
+	AVRASMConstants *constants (void);
+	void setLiveRegisters (const QHash<int, quint32> &liveByLine);
+	void setSourceFile (const QString &fileName, const QStringList &includePaths);
+
 private slots:
 	void updateStyle (void);
+	void textChanged (void);
 #ifdef USE_NOCC_LEXER
 	void noccRuntimeError (void);
 #endif
@@ -92,9 +99,12 @@ private:
 
 	bool eventFilter (QObject *object, QEvent *event);
 
+	void updateConstants (void);
 	void updateTooltip (const QPoint &tooltipPosition);
 	QStringList tooltipForOpcode (const QString &opcode) const;
 	QStringList tooltipForDirective (const QString &directive) const;
+	QStringList tooltipForConstant (const QString &name) const;
+	QStringList tooltipForRegisters (const QString &word) const;
 
 #ifdef USE_NOCC_LEXER
 	QString _noccPath;
@@ -106,6 +116,12 @@ private:
 	bool _apisReady;
 	TooltipWidget *_tooltipWidget;
 	QString _lastTooltipContext;
+	AVRASMConstants _constants;
+	bool _constantsStale;		/* editor text changed since _constants was updated */
+	QString _fileName;		/* the editor's file, for finding includes */
+	QStringList _includePaths;
+	QHash<int, quint32> _liveByLine;	/* editor line -> registers live there, from the last analysis */
+	int _tooltipLine;		/* editor line under the tool-tip, -1 if none */
 	Parameters *_params;
 };
 
@@ -0,0 +1,901 @@
+/*
+ *	avrasmprogram.cpp -- source-level model of an assembler program (statements, placement, symbols).
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include "avrasmprogram.h"
+#include "language.h"
+
+#define MAX_INCLUDE_DEPTH 16
+
+/*{{{  static helpers*/
+static inline bool isNameStart (QChar ch)
+{
+	return ch.isLetter () || (ch == '_');
+}
+
+static inline bool isNameChar (QChar ch)
+{
+	return ch.isLetterOrNumber () || (ch == '_');
+}
+
+/*
+ *	splits on commas that are not inside brackets or quotes.
+ */
+static QStringList splitOperands (const QString &args)
+{
+	QStringList ops;
+	QChar quote;
+	int depth = 0;
+	int start = 0;
+
+	if (args.isEmpty ()) {
+		return ops;
+	}
+	for (int i=0; i<args.length (); i++) {
+		QChar ch = args.at (i);
+
+		if (!quote.isNull ()) {
+			if (ch == '\\') {
+				i++;
+			} else if (ch == quote) {
+				quote = QChar ();
+			}
+		} else if ((ch == '"') || (ch == '\'')) {
+			quote = ch;
+		} else if ((ch == '(') || (ch == '[')) {
+			depth++;
+		} else if (((ch == ')') || (ch == ']')) && (depth > 0)) {
+			depth--;
+		} else if ((ch == ',') && !depth) {
+			ops << args.mid (start, i - start).trimmed ();
+			start = i + 1;
+		}
+	}
+	ops << args.mid (start).trimmed ();
+	return ops;
+}
+
+/*
+ *	returns the number of characters in a double-quoted string literal (escapes count as one).
+ */
+static int stringLength (const QString &lit)
+{
+	int n = 0;
+
+	for (int i=1; (i < lit.length ()) && (lit.at (i) != '"'); i++) {
+		if (lit.at (i) == '\\') {
+			i++;
+		}
+		n++;
+	}
+	return n;
+}
+
+/*
+ *	reads a text file into lines (any line-ending).
+ */
+static bool readLines (const QString &fileName, QStringList *lines, QString *error)
+{
+	QFile file (fileName);
+
+	if (!file.open (QIODevice::ReadOnly)) {
+		if (error) {
+			*error = QString ("%1: %2").arg (fileName).arg (file.errorString ());
+		}
+		return false;
+	}
+	QString text = QString::fromUtf8 (file.readAll ());
+
+	text.remove ('\r');
+	*lines = text.split ('\n');
+	return true;
+}
+/*}}}*/
+
+
+/*{{{  AVRASMIncludeCache &AVRASMIncludeCache::instance (void)*/
+/*
+ *	returns the (process-wide) include cache.
+ */
+AVRASMIncludeCache &AVRASMIncludeCache::instance (void)
+{
+	static AVRASMIncludeCache cache;
+
+	return cache;
+}
+/*}}}*/
+/*{{{  AVRASMIncludeCache::AVRASMIncludeCache ()*/
+/*
+ *	constructor.
+ */
+AVRASMIncludeCache::AVRASMIncludeCache ()
+{
+	_hits = 0;
+	_misses = 0;
+}
+/*}}}*/
+/*{{{  QSharedPointer<const AVRASMParsedFile> AVRASMIncludeCache::get (const QString &fileName, QString *error)*/
+/*
+ *	returns the parsed form of a file, parsing it if not cached or changed on disk since.  The lock
+ *	is not held while parsing, so two threads may occasionally parse the same file; the last one in wins.
+ *	returns a null pointer if the file cannot be read.
+ */
+QSharedPointer<const AVRASMParsedFile> AVRASMIncludeCache::get (const QString &fileName, QString *error)
+{
+	QFileInfo info (fileName);
+	QString path = info.canonicalFilePath ();
+
+	if (path.isEmpty ()) {
+		if (error) {
+			*error = QString ("%1: no such file").arg (fileName);
+		}
+		return QSharedPointer<const AVRASMParsedFile> ();
+	}
+
+	{
+		QMutexLocker locker (&_lock);
+		QSharedPointer<const AVRASMParsedFile> cached = _files.value (path);
+
+		if (cached && (cached->modified == info.lastModified ()) && (cached->size == info.size ())) {
+			_hits++;
+			return cached;
+		}
+		_misses++;
+	}
+
+	AVRASMParsedFile *parsed = new AVRASMParsedFile;
+
+	parsed->fileName = path;
+	parsed->modified = info.lastModified ();
+	parsed->size = info.size ();
+	if (!readLines (path, &parsed->text, error)) {
+		delete parsed;
+		return QSharedPointer<const AVRASMParsedFile> ();
+	}
+	AVRASMProgram::parseStatements (parsed->text, &parsed->statements);
+
+	QSharedPointer<const AVRASMParsedFile> result (parsed);
+	QMutexLocker locker (&_lock);
+
+	_files.insert (path, result);
+	return result;
+}
+/*}}}*/
+/*{{{  void AVRASMIncludeCache::clear (void)*/
+/*
+ *	drops everything cached (programs still holding a file keep their copy).
+ */
+void AVRASMIncludeCache::clear (void)
+{
+	QMutexLocker locker (&_lock);
+
+	_files.clear ();
+	_hits = 0;
+	_misses = 0;
+}
+/*}}}*/
+/*{{{  int AVRASMIncludeCache::hits (void) const*/
+/*
+ *	returns the number of lookups answered from the cache.
+ */
+int AVRASMIncludeCache::hits (void) const
+{
+	QMutexLocker locker (&_lock);
+
+	return _hits;
+}
+/*}}}*/
+/*{{{  int AVRASMIncludeCache::misses (void) const*/
+/*
+ *	returns the number of lookups that had to (re-)parse a file.
+ */
+int AVRASMIncludeCache::misses (void) const
+{
+	QMutexLocker locker (&_lock);
+
+	return _misses;
+}
+/*}}}*/
+
+
+/*{{{  AVRASMProgram::AVRASMProgram ()*/
+/*
+ *	constructor.
+ */
+AVRASMProgram::AVRASMProgram ()
+{
+	clear ();
+}
+/*}}}*/
+/*{{{  void AVRASMProgram::clear (void)*/
+/*
+ *	empties the program.
+ */
+void AVRASMProgram::clear (void)
+{
+	_files.clear ();
+	_parsed.clear ();
+	_lines.clear ();
+	_mainIndex.clear ();
+	_textByAddress.clear ();
+	_symbols.clear ();
+	_macros.clear ();
+	_constants.clear ();
+	_errors.clear ();
+	_section = TEXT;
+	for (int i=0; i<3; i++) {
+		_pc[i] = 0;
+		_extent[i] = 0;
+	}
+}
+/*}}}*/
+/*{{{  bool AVRASMProgram::load (const QString &fileName, const QStringList &includePaths, QString *error)*/
+/*
+ *	loads and lays out a program from disk (the main file goes through the include cache too).
+ *	returns true on success, false otherwise.
+ */
+bool AVRASMProgram::load (const QString &fileName, const QStringList &includePaths, QString *error)
+{
+	QSharedPointer<const AVRASMParsedFile> main = AVRASMIncludeCache::instance ().get (fileName, error);
+
+	clear ();
+	if (!main) {
+		return false;
+	}
+	_includePaths = includePaths;
+	_files << fileName;
+	_parsed << main;
+	place ();
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRASMProgram::parse (const QString &text, const QString &fileName, const QStringList &includePaths)*/
+/*
+ *	lays out a program from text (e.g. the editor buffer); 'fileName' is used to find includes.
+ */
+void AVRASMProgram::parse (const QString &text, const QString &fileName, const QStringList &includePaths)
+{
+	AVRASMParsedFile *main = new AVRASMParsedFile;
+
+	clear ();
+	main->fileName = fileName;
+	main->size = text.length ();
+	main->text = QString (text).remove ('\r').split ('\n');
+	parseStatements (main->text, &main->statements);
+
+	_includePaths = includePaths;
+	_files << fileName;
+	_parsed << QSharedPointer<const AVRASMParsedFile> (main);
+	place ();
+}
+/*}}}*/
+
+/*{{{  void AVRASMProgram::parseStatements (const QStringList &text, QVector<AVRASMStatement> *out)*/
+/*
+ *	splits source lines into statements, one per line (blank lines give an empty statement).
+ */
+void AVRASMProgram::parseStatements (const QStringList &text, QVector<AVRASMStatement> *out)
+{
+	out->resize (text.count ());
+	for (int ln=0; ln<text.count (); ln++) {
+		AVRASMStatement &stmt = (*out)[ln];
+		QString s = AVRASMConstants::stripComment (text.at (ln)).trimmed ();
+		int i;
+
+		stmt.line = ln;
+		if (s.isEmpty ()) {
+			continue;
+		}
+
+		/* leading label */
+		for (i=0; (i<s.length ()) && isNameChar (s.at (i)); i++);
+		if ((i > 0) && (i < s.length ()) && (s.at (i) == ':') && isNameStart (s.at (0))) {
+			stmt.label = s.left (i);
+			s = s.mid (i + 1).trimmed ();
+		}
+		if (s.isEmpty ()) {
+			continue;
+		}
+
+		/* mnemonic, directive or macro name */
+		i = (s.at (0) == '.') ? 1 : 0;
+		for (; (i<s.length ()) && isNameChar (s.at (i)); i++);
+		if (i == 0) {
+			/* something odd, keep it all as arguments */
+			stmt.args = s;
+			continue;
+		}
+		stmt.mnemonic = s.left (i).toLower ();
+		stmt.args = s.mid (i).trimmed ();
+		if (!stmt.args.isEmpty () && (stmt.args.at (0) == '(') && stmt.args.endsWith (')') && !stmt.mnemonic.startsWith ('.')) {
+			/* macro invocation with bracketed parameters */
+			stmt.operands = splitOperands (stmt.args.mid (1, stmt.args.length () - 2));
+		} else {
+			stmt.operands = splitOperands (stmt.args);
+		}
+	}
+}
+/*}}}*/
+/*{{{  int AVRASMProgram::instructionWords (const QString &mnemonic)*/
+/*
+ *	returns the size of an instruction in words (the only 32-bit ones take a full address).
+ */
+int AVRASMProgram::instructionWords (const QString &mnemonic)
+{
+	if ((mnemonic == "lds") || (mnemonic == "sts") || (mnemonic == "jmp") || (mnemonic == "call")) {
+		return 2;
+	}
+	return 1;
+}
+/*}}}*/
+/*{{{  bool AVRASMProgram::instructionCycles (const QString &mnemonic, int *minCycles, int *maxCycles)*/
+/*
+ *	finds the cycle range over all forms of an instruction, from OpcodesInfo.  Instructions with
+ *	no fixed timing (e.g. SPM) give 0 / 0.
+ *	returns true if 'mnemonic' is an instruction, false otherwise.
+ */
+bool AVRASMProgram::instructionCycles (const QString &mnemonic, int *minCycles, int *maxCycles)
+{
+	QList<OpcodeInfo> infos = OpcodesInfo.values (mnemonic.toUpper ());
+	bool any = false;
+
+	*minCycles = 0;
+	*maxCycles = 0;
+	if (infos.isEmpty ()) {
+		return false;
+	}
+	for (const OpcodeInfo &info : infos) {
+		int lo, hi;
+
+		if (!opcodeCycles (info.nClocks, &lo, &hi)) {
+			continue;
+		}
+		if (!any || (lo < *minCycles)) {
+			*minCycles = lo;
+		}
+		if (!any || (hi > *maxCycles)) {
+			*maxCycles = hi;
+		}
+		any = true;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  QString AVRASMProgram::sectionName (Section section)*/
+/*
+ *	returns the directive name of a section.
+ */
+QString AVRASMProgram::sectionName (Section section)
+{
+	switch (section) {
+	case TEXT:
+		return "text";
+	case DATA:
+		return "data";
+	case EEPROM:
+		return "eeprom";
+	}
+	return "";
+}
+/*}}}*/
+/*{{{  QStringList AVRASMProgram::includePaths (const QString &noccParams)*/
+/*
+ *	picks the include directories ("-I DIR" or "-IDIR") out of nocc's parameters, so that
+ *	analysis finds the same headers the build does.
+ */
+QStringList AVRASMProgram::includePaths (const QString &noccParams)
+{
+	QStringList params = noccParams.split (" ", QString::SkipEmptyParts);
+	QStringList dirs;
+
+	for (int i=0; i<params.count (); i++) {
+		const QString &p = params.at (i);
+
+		if ((p == "-I") && (i + 1 < params.count ())) {
+			dirs << params.at (++i);
+		} else if (p.startsWith ("-I") && (p.length () > 2)) {
+			dirs << p.mid (2);
+		}
+	}
+	return dirs;
+}
+/*}}}*/
+
+/*{{{  void AVRASMProgram::findIncludes (QStringList *files, QVector<QSharedPointer<const AVRASMParsedFile> > *parsed, const QStringList &includePaths, QStringList *errors)*/
+/*
+ *	adds everything the files so far include (directly or not) to 'files' and 'parsed', each file
+ *	once, through the include cache.  Problems (missing or unreadable includes) go in 'errors'.
+ */
+void AVRASMProgram::findIncludes (QStringList *files, QVector<QSharedPointer<const AVRASMParsedFile> > *parsed, const QStringList &includePaths,
+		QStringList *errors)
+{
+	for (int f=0; f<parsed->count (); f++) {
+		for (const AVRASMStatement &stmt : parsed->at (f)->statements) {
+			if ((stmt.mnemonic == ".include") && (parsed->count () < 256)) {
+				QString name = stmt.args;
+				QString path;
+
+				name.remove ('"');
+				path = findInclude (name.trimmed (), files->at (f), includePaths);
+				if (path.isEmpty ()) {
+					if (errors) {
+						*errors << QString ("%1:%2: cannot find include file \"%3\"").arg (files->at (f)).arg (stmt.line + 1).arg (name);
+					}
+					continue;
+				}
+				if (files->contains (path)) {
+					continue;
+				}
+
+				QString err;
+				QSharedPointer<const AVRASMParsedFile> inc = AVRASMIncludeCache::instance ().get (path, &err);
+
+				if (!inc) {
+					if (errors) {
+						*errors << err;
+					}
+					continue;
+				}
+				*files << path;
+				*parsed << inc;
+			}
+		}
+	}
+}
+/*}}}*/
+/*{{{  QString AVRASMProgram::findInclude (const QString &name, int fromFile) const*/
+/*
+ *	looks for an included file: relative to the including file first, then the include paths.
+ *	returns the path found, or an empty string.
+ */
+QString AVRASMProgram::findInclude (const QString &name, int fromFile) const
+{
+	return findInclude (name, _files.at (fromFile), _includePaths);
+}
+/*}}}*/
+/*{{{  QString AVRASMProgram::findInclude (const QString &name, const QString &fromFile, const QStringList &includePaths)*/
+/*
+ *	looks for a file included from 'fromFile': relative to that first, then the include paths.
+ *	returns the path found, or an empty string.
+ */
+QString AVRASMProgram::findInclude (const QString &name, const QString &fromFile, const QStringList &includePaths)
+{
+	QStringList dirs;
+
+	if (QFileInfo (name).isAbsolute ()) {
+		return QFileInfo (name).exists () ? name : QString ();
+	}
+	dirs << QFileInfo (fromFile).absolutePath ();
+	dirs << includePaths;
+	for (const QString &dir : dirs) {
+		QString path = QDir (dir).filePath (name);
+
+		if (QFileInfo (path).isFile ()) {
+			return path;
+		}
+	}
+	return QString ();
+}
+/*}}}*/
+/*{{{  int AVRASMProgram::dataSize (const AVRASMStatement &stmt, Section section) const*/
+/*
+ *	returns the number of bytes placed by a .const, .const16 or .space directive (text-section
+ *	output is padded to whole words).
+ */
+int AVRASMProgram::dataSize (const AVRASMStatement &stmt, Section section) const
+{
+	int size = 0;
+
+	if (stmt.mnemonic == ".const") {
+		for (const QString &op : stmt.operands) {
+			size += op.startsWith ('"') ? stringLength (op) : 1;
+		}
+	} else if (stmt.mnemonic == ".const16") {
+		size = 2 * stmt.operands.count ();
+	} else if (stmt.mnemonic == ".space") {
+		qint64 v;
+
+		if (_constants.evaluate (stmt.args, &v) && (v > 0)) {
+			size = (int)v;
+		}
+	}
+	if ((section == TEXT) && (size & 1)) {
+		size++;
+	}
+	return size;
+}
+/*}}}*/
+/*{{{  void AVRASMProgram::sizeMacro (Macro *macro, int depth) const*/
+/*
+ *	works out the size and cycle range of a macro body (nested invocations included).
+ */
+void AVRASMProgram::sizeMacro (Macro *macro, int depth) const
+{
+	macro->size = 0;
+	macro->minCycles = 0;
+	macro->maxCycles = 0;
+	for (const AVRASMStatement *stmt : macro->body) {
+		int lo, hi;
+
+		if (instructionCycles (stmt->mnemonic, &lo, &hi)) {
+			macro->size += 2 * instructionWords (stmt->mnemonic);
+			macro->minCycles += lo;
+			macro->maxCycles += hi;
+		} else if (stmt->mnemonic.startsWith (".const") || (stmt->mnemonic == ".space")) {
+			macro->size += dataSize (*stmt, TEXT);
+		} else if (_macros.contains (stmt->mnemonic) && (depth < MAX_INCLUDE_DEPTH)) {
+			Macro inner = _macros.value (stmt->mnemonic);
+
+			sizeMacro (&inner, depth + 1);
+			macro->size += inner.size;
+			macro->minCycles += inner.minCycles;
+			macro->maxCycles += inner.maxCycles;
+		}
+	}
+}
+/*}}}*/
+/*{{{  void AVRASMProgram::place (void)*/
+/*
+ *	lays out the main file (and its includes): assigns sections and addresses, collects labels.
+ */
+void AVRASMProgram::place (void)
+{
+	QStringList sources, files;
+
+	/* constants first, from every file that gets pulled in */
+	findIncludes (&_files, &_parsed, _includePaths, &_errors);
+	for (int f=_parsed.count () - 1; f>=0; f--) {
+		sources << _parsed.at (f)->text.join ("\n");
+		files << _files.at (f);
+	}
+	_constants.update (sources, files);
+
+	placeFile (0, _parsed.at (0)->statements, 0);
+
+	_mainIndex.fill (-1, _parsed.at (0)->statements.count ());
+	for (int i=0; i<_lines.count (); i++) {
+		const Line &l = _lines.at (i);
+
+		if (l.file == 0) {
+			_mainIndex[l.line] = i;
+		}
+		if ((l.section == TEXT) && (l.address >= 0) && (l.size > 0)) {
+			_textByAddress << i;
+		}
+	}
+	std::stable_sort (_textByAddress.begin (), _textByAddress.end (), [this] (int a, int b) {
+		return _lines.at (a).address < _lines.at (b).address;
+	});
+}
+/*}}}*/
+/*{{{  void AVRASMProgram::placeFile (int file, const QVector<AVRASMStatement> &stmts, int depth)*/
+/*
+ *	places the statements of one file, recursing into includes.
+ */
+void AVRASMProgram::placeFile (int file, const QVector<AVRASMStatement> &stmts, int depth)
+{
+	QHash<QString, qint64> labels;
+	QString inMacro;
+
+	for (const Symbol &sym : _symbols) {
+		labels.insert (sym.name, (sym.section == TEXT) ? (sym.address >> 1) : sym.address);
+	}
+
+	for (int s=0; s<stmts.count (); s++) {
+		const AVRASMStatement &stmt = stmts.at (s);
+		Line line;
+
+		line.file = file;
+		line.line = stmt.line;
+		line.kind = BLANK;
+		line.section = _section;
+		line.address = -1;
+		line.size = 0;
+		line.minCycles = 0;
+		line.maxCycles = 0;
+		line.stmt = &stmt;
+
+		/*{{{  inside a macro definition: just collect*/
+		if (!inMacro.isEmpty ()) {
+			if (stmt.mnemonic == ".endmacro") {
+				sizeMacro (&_macros[inMacro], 0);
+				inMacro.clear ();
+				line.kind = DIRECTIVE;
+			} else if (!stmt.mnemonic.isEmpty ()) {
+				_macros[inMacro].body << &stmt;
+			}
+			_lines << line;
+			continue;
+		}
+		/*}}}*/
+
+		if (!stmt.label.isEmpty ()) {
+			Symbol sym;
+
+			sym.name = stmt.label;
+			sym.section = _section;
+			sym.address = _pc[_section];
+			sym.index = _lines.count ();
+			_symbols.insert (sym.name, sym);
+			labels.insert (sym.name, (_section == TEXT) ? (sym.address >> 1) : sym.address);
+			line.address = _pc[_section];
+		}
+
+		const QString &mn = stmt.mnemonic;
+		int lo, hi;
+
+		if (mn.isEmpty ()) {
+			/* blank or label only */
+		} else if (instructionCycles (mn, &lo, &hi)) {
+			line.kind = INSTRUCTION;
+			line.address = _pc[_section];
+			line.size = 2 * instructionWords (mn);
+			line.minCycles = lo;
+			line.maxCycles = hi;
+		} else if ((mn == ".const") || (mn == ".const16") || (mn == ".space")) {
+			line.kind = DATA_BYTES;
+			line.address = _pc[_section];
+			line.size = dataSize (stmt, _section);
+		} else if (mn == ".text") {
+			line.kind = DIRECTIVE;
+			_section = TEXT;
+		} else if (mn == ".data") {
+			line.kind = DIRECTIVE;
+			_section = DATA;
+		} else if (mn == ".eeprom") {
+			line.kind = DIRECTIVE;
+			_section = EEPROM;
+		} else if (mn == ".org") {
+			qint64 v;
+			QString err;
+
+			line.kind = DIRECTIVE;
+			if (_constants.evaluate (stmt.args, &v, &err, &labels)) {
+				/* word address in the text section, as for the Atmel assembler */
+				_pc[_section] = (_section == TEXT) ? (qint32)(v << 1) : (qint32)v;
+				line.address = _pc[_section];
+			} else {
+				_errors << QString ("%1:%2: .org: %3").arg (_files.at (file)).arg (stmt.line + 1).arg (err);
+			}
+		} else if (mn == ".macro") {
+			QString name = stmt.args;
+			int i;
+
+			for (i=0; (i<name.length ()) && isNameChar (name.at (i)); i++);
+			inMacro = name.left (i).toLower ();
+			_macros.insert (inMacro, Macro ());
+			line.kind = DIRECTIVE;
+		} else if (mn == ".include") {
+			QString name = stmt.args;
+			int inc;
+
+			line.kind = DIRECTIVE;
+			name.remove ('"');
+			inc = _files.indexOf (findInclude (name.trimmed (), file));
+			_lines << line;
+			if ((inc > 0) && (depth < MAX_INCLUDE_DEPTH)) {
+				placeFile (inc, _parsed.at (inc)->statements, depth + 1);
+				for (const Symbol &sym : _symbols) {
+					labels.insert (sym.name, (sym.section == TEXT) ? (sym.address >> 1) : sym.address);
+				}
+			}
+			continue;
+		} else if (mn.startsWith ('.')) {
+			line.kind = DIRECTIVE;
+		} else if (_macros.contains (mn)) {
+			const Macro &macro = _macros[mn];
+
+			line.kind = MACRO_CALL;
+			line.address = _pc[_section];
+			line.size = macro.size;
+			line.minCycles = macro.minCycles;
+			line.maxCycles = macro.maxCycles;
+		} else {
+			line.kind = UNKNOWN;
+		}
+
+		if (line.size > 0) {
+			_pc[_section] += line.size;
+			if (_pc[_section] > _extent[_section]) {
+				_extent[_section] = _pc[_section];
+			}
+		}
+		_lines << line;
+	}
+}
+/*}}}*/
+
+/*{{{  QStringList AVRASMProgram::files (void) const*/
+/*
+ *	returns the files making up the program, the main file first.
+ */
+QStringList AVRASMProgram::files (void) const
+{
+	return _files;
+}
+/*}}}*/
+/*{{{  const QVector<AVRASMProgram::Line> &AVRASMProgram::lines (void) const*/
+/*
+ *	returns every line of the program in assembly order (included files' lines appear after the
+ *	.include that pulls them in).
+ */
+const QVector<AVRASMProgram::Line> &AVRASMProgram::lines (void) const
+{
+	return _lines;
+}
+/*}}}*/
+/*{{{  int AVRASMProgram::indexForLine (int line, int file) const*/
+/*
+ *	returns the index into lines () for a source line, or -1.
+ */
+int AVRASMProgram::indexForLine (int line, int file) const
+{
+	if (file == 0) {
+		return ((line >= 0) && (line < _mainIndex.count ())) ? _mainIndex.at (line) : -1;
+	}
+	for (int i=0; i<_lines.count (); i++) {
+		if ((_lines.at (i).file == file) && (_lines.at (i).line == line)) {
+			return i;
+		}
+	}
+	return -1;
+}
+/*}}}*/
+/*{{{  int AVRASMProgram::indexForAddress (qint32 address) const*/
+/*
+ *	returns the index into lines () of the text-section line placing the given (byte) address, or -1.
+ */
+int AVRASMProgram::indexForAddress (qint32 address) const
+{
+	int lo = 0, hi = _textByAddress.count () - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		const Line &l = _lines.at (_textByAddress.at (mid));
+
+		if (address < l.address) {
+			hi = mid - 1;
+		} else if (address >= l.address + l.size) {
+			lo = mid + 1;
+		} else {
+			return _textByAddress.at (mid);
+		}
+	}
+	return -1;
+}
+/*}}}*/
+/*{{{  QString AVRASMProgram::sourceText (int index) const*/
+/*
+ *	returns the original text of a line.
+ */
+QString AVRASMProgram::sourceText (int index) const
+{
+	const Line &l = _lines.at (index);
+	const QStringList &text = _parsed.at (l.file)->text;
+
+	return (l.line < text.count ()) ? text.at (l.line) : QString ();
+}
+/*}}}*/
+/*{{{  const QHash<QString, AVRASMProgram::Symbol> &AVRASMProgram::symbols (void) const*/
+/*
+ *	returns the labels defined by the program.
+ */
+const QHash<QString, AVRASMProgram::Symbol> &AVRASMProgram::symbols (void) const
+{
+	return _symbols;
+}
+/*}}}*/
+/*{{{  QList<AVRASMProgram::Symbol> AVRASMProgram::symbolsByAddress (void) const*/
+/*
+ *	returns the labels ordered by section then address.
+ */
+QList<AVRASMProgram::Symbol> AVRASMProgram::symbolsByAddress (void) const
+{
+	QList<Symbol> syms = _symbols.values ();
+
+	std::sort (syms.begin (), syms.end (), [] (const Symbol &a, const Symbol &b) {
+		if (a.section != b.section) {
+			return a.section < b.section;
+		}
+		return (a.address != b.address) ? (a.address < b.address) : (a.name < b.name);
+	});
+	return syms;
+}
+/*}}}*/
+/*{{{  const AVRASMConstants &AVRASMProgram::constants (void) const*/
+/*
+ *	returns the .equ/.set/.def constants (from every file).
+ */
+const AVRASMConstants &AVRASMProgram::constants (void) const
+{
+	return _constants;
+}
+/*}}}*/
+/*{{{  bool AVRASMProgram::macroBody (const QString &name, QVector<const AVRASMStatement *> *body) const*/
+/*
+ *	gets the statements of a macro (as written, parameters not substituted).
+ *	returns true if the macro is defined, false otherwise.
+ */
+bool AVRASMProgram::macroBody (const QString &name, QVector<const AVRASMStatement *> *body) const
+{
+	QHash<QString, Macro>::const_iterator it = _macros.find (name);
+
+	if (it == _macros.end ()) {
+		return false;
+	}
+	*body = it->body;
+	return true;
+}
+/*}}}*/
+/*{{{  QStringList AVRASMProgram::errors (void) const*/
+/*
+ *	returns any problems found laying out the program (missing includes, bad .org).
+ */
+QStringList AVRASMProgram::errors (void) const
+{
+	return _errors;
+}
+/*}}}*/
+/*{{{  int AVRASMProgram::sectionSize (Section section) const*/
+/*
+ *	returns the highest address used in a section (bytes).
+ */
+int AVRASMProgram::sectionSize (Section section) const
+{
+	return _extent[section];
+}
+/*}}}*/
+/*{{{  int AVRASMProgram::registerOperand (const QString &operand) const*/
+/*
+ *	works out which register an operand names: r0-r31, the XL..ZH pointer halves, or a .def name.
+ *	returns the register number, or -1 if not a register.
+ */
+int AVRASMProgram::registerOperand (const QString &operand) const
+{
+	static const char *pointers[6] = {"XL", "XH", "YL", "YH", "ZL", "ZH"};
+	QString op = operand.trimmed ();
+	QString upper = op.toUpper ();
+	qint64 v;
+	bool ok;
+
+	if (upper.startsWith ('R')) {
+		int r = upper.mid (1).toInt (&ok);
+
+		if (ok && (r >= 0) && (r < 32)) {
+			return r;
+		}
+	}
+	for (int i=0; i<6; i++) {
+		if (upper == pointers[i]) {
+			return 26 + i;
+		}
+	}
+	if (_constants.contains (op) && (_constants.kind (op) == AVRASMConstants::DEF) && _constants.value (op, &v) && (v >= 0) && (v < 32)) {
+		return (int)v;
+	}
+	return -1;
+}
+/*}}}*/
+
@@ -0,0 +1,180 @@
+/*
+ *	avrasmprogram.h -- source-level model of an assembler program (statements, placement, symbols).
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRASMPROGRAM_H
+#define AVRASMPROGRAM_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "avrasmconstants.h"
+
+/* one source line, split up but not yet placed */
+typedef struct AVRASMStatement
+{
+	int line;			/* 0-based line number in its file */
+	QString label;			/* label defined here (without the ':'), or empty */
+	QString mnemonic;		/* lower-case instruction, directive (with '.') or macro name */
+	QString args;			/* everything after the mnemonic */
+	QStringList operands;		/* 'args' split on top-level commas */
+} AVRASMStatement;
+
+/* a parsed file, as shared through AVRASMIncludeCache */
+typedef struct AVRASMParsedFile
+{
+	QString fileName;		/* canonical path */
+	QDateTime modified;
+	qint64 size;
+	QVector<AVRASMStatement> statements;
+	QStringList text;		/* the raw lines */
+} AVRASMParsedFile;
+
+/*
+ *	Included files are parsed once and shared (read-only) between every program that includes
+ *	them, across threads, until the file changes on disk.
+ */
+class AVRASMIncludeCache
+{
+public:
+	static AVRASMIncludeCache &instance (void);
+
+	QSharedPointer<const AVRASMParsedFile> get (const QString &fileName, QString *error = 0);
+	void clear (void);
+	int hits (void) const;
+	int misses (void) const;
+
+private:
+	AVRASMIncludeCache ();
+
+	mutable QMutex _lock;
+	QHash<QString, QSharedPointer<const AVRASMParsedFile> > _files;
+	int _hits;
+	int _misses;
+};
+
+/*
+ *	The program as the assembler will lay it out: every statement of the main file (and anything it
+ *	includes) with its section, address, size and cycle cost, plus the labels.  Addresses are in
+ *	bytes for all sections.
+ */
+class AVRASMProgram
+{
+public:
+	typedef enum Section {
+		TEXT = 0,
+		DATA,
+		EEPROM
+	} Section;
+
+	typedef enum LineKind {
+		BLANK = 0,		/* empty, comment or label only */
+		INSTRUCTION,
+		DATA_BYTES,		/* .const, .const16, .space */
+		DIRECTIVE,		/* anything else starting with '.' */
+		MACRO_CALL,
+		UNKNOWN			/* not something we know the size of */
+	} LineKind;
+
+	typedef struct Line {
+		int file;		/* index into files () */
+		int line;		/* 0-based line in that file */
+		LineKind kind;
+		Section section;
+		qint32 address;		/* where this line's output starts, -1 if nothing placed */
+		int size;		/* bytes placed */
+		int minCycles;
+		int maxCycles;
+		const AVRASMStatement *stmt;
+	} Line;
+
+	typedef struct Symbol {
+		QString name;
+		Section section;
+		qint32 address;
+		int index;		/* into lines () */
+	} Symbol;
+
+	AVRASMProgram ();
+
+	bool load (const QString &fileName, const QStringList &includePaths = QStringList (), QString *error = 0);
+	void parse (const QString &text, const QString &fileName, const QStringList &includePaths = QStringList ());
+	void clear (void);
+
+	QStringList files (void) const;
+	const QVector<Line> &lines (void) const;
+	int indexForLine (int line, int file = 0) const;
+	int indexForAddress (qint32 address) const;
+	QString sourceText (int index) const;
+
+	const QHash<QString, Symbol> &symbols (void) const;
+	QList<Symbol> symbolsByAddress (void) const;
+	const AVRASMConstants &constants (void) const;
+	bool macroBody (const QString &name, QVector<const AVRASMStatement *> *body) const;
+	QStringList errors (void) const;
+
+	int sectionSize (Section section) const;
+	int registerOperand (const QString &operand) const;
+
+	static void parseStatements (const QStringList &text, QVector<AVRASMStatement> *out);
+	static int instructionWords (const QString &mnemonic);
+	static bool instructionCycles (const QString &mnemonic, int *minCycles, int *maxCycles);
+	static QString sectionName (Section section);
+	static QStringList includePaths (const QString &noccParams);
+	static void findIncludes (QStringList *files, QVector<QSharedPointer<const AVRASMParsedFile> > *parsed, const QStringList &includePaths,
+			QStringList *errors = 0);
+
+private:
+	typedef struct Macro {
+		QVector<const AVRASMStatement *> body;
+		int size;
+		int minCycles;
+		int maxCycles;
+	} Macro;
+
+	void place (void);
+	void placeFile (int file, const QVector<AVRASMStatement> &stmts, int depth);
+	int dataSize (const AVRASMStatement &stmt, Section section) const;
+	void sizeMacro (Macro *macro, int depth) const;
+	QString findInclude (const QString &name, int fromFile) const;
+	static QString findInclude (const QString &name, const QString &fromFile, const QStringList &includePaths);
+
+	QStringList _files;
+	QVector<QSharedPointer<const AVRASMParsedFile> > _parsed;	/* per file, [0] is the main file */
+	QVector<Line> _lines;
+	QVector<int> _mainIndex;		/* main-file line -> index into _lines */
+	QVector<int> _textByAddress;		/* indices of placed TEXT lines, by address */
+	QHash<QString, Symbol> _symbols;
+	QHash<QString, Macro> _macros;
+	AVRASMConstants _constants;
+	QStringList _includePaths;
+	QStringList _errors;
+
+	/* placement state */
+	Section _section;
+	qint32 _pc[3];
+	qint32 _extent[3];
+};
+
+#endif	/* !AVRASMPROGRAM_H */
+
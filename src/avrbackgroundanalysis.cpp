@@ -0,0 +1,185 @@
+/*
+ *	avrbackgroundanalysis.cpp -- static analyses of the current file, run off the GUI thread.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include "avrbackgroundanalysis.h"
+#include "avrasmflow.h"
+#include "avrdevice.h"
+#include "avrliveness.h"
+
+/*{{{  AVRBackgroundAnalysis::AVRBackgroundAnalysis (QObject *parent)*/
+/*
+ *	constructor: the thread is started on the first request.
+ */
+AVRBackgroundAnalysis::AVRBackgroundAnalysis (QObject *parent) : QThread (parent)
+{
+	_pending = false;
+	_quit = false;
+	_result.deviceKnown = false;
+	_result.isrBudget = 0;
+	_result.msecs = 0;
+	_result.stack.bounded = false;
+	_result.stack.mainDepth = _result.stack.interruptDepth = _result.stack.depth = 0;
+	_result.stack.available = 0;
+	_result.stack.problemIndex = -1;
+}
+/*}}}*/
+/*{{{  AVRBackgroundAnalysis::~AVRBackgroundAnalysis ()*/
+/*
+ *	destructor: lets any run in progress finish, then stops the thread.
+ */
+AVRBackgroundAnalysis::~AVRBackgroundAnalysis ()
+{
+	_lock.lock ();
+	_quit = true;
+	_wake.wakeAll ();
+	_lock.unlock ();
+	wait ();
+}
+/*}}}*/
+/*{{{  void AVRBackgroundAnalysis::request (const QString &text, const QString &fileName, const QStringList &includePaths, const QString &device, int isrBudget)*/
+/*
+ *	asks for the given source to be analysed (with includes looked for as the build would),
+ *	replacing anything still waiting.
+ */
+void AVRBackgroundAnalysis::request (const QString &text, const QString &fileName, const QStringList &includePaths, const QString &device, int isrBudget)
+{
+	QMutexLocker locker (&_lock);
+
+	_job.text = text;
+	_job.fileName = fileName;
+	_job.includePaths = includePaths;
+	_job.device = device;
+	_job.isrBudget = isrBudget;
+	_pending = true;
+	if (!isRunning ()) {
+		start (QThread::LowPriority);
+	}
+	_wake.wakeAll ();
+}
+/*}}}*/
+/*{{{  AVRBackgroundAnalysis::Result AVRBackgroundAnalysis::result (void) const*/
+/*
+ *	returns the result of the last finished run.
+ */
+AVRBackgroundAnalysis::Result AVRBackgroundAnalysis::result (void) const
+{
+	QMutexLocker locker (&_lock);
+
+	return _result;
+}
+/*}}}*/
+/*{{{  QString AVRBackgroundAnalysis::location (const AVRASMProgram &program, int index)*/
+/*
+ *	formats a program line as "file:line" (the file name without its path).
+ */
+QString AVRBackgroundAnalysis::location (const AVRASMProgram &program, int index)
+{
+	if ((index < 0) || (index >= program.lines ().count ())) {
+		return QString ("?");
+	}
+	const AVRASMProgram::Line &l = program.lines ().at (index);
+
+	return QString ("%1:%2").arg (QFileInfo (program.files ().at (l.file)).fileName ()).arg (l.line + 1);
+}
+/*}}}*/
+
+/*{{{  void AVRBackgroundAnalysis::run (void)*/
+/*
+ *	thread body: waits for requests and handles the latest of them.
+ */
+void AVRBackgroundAnalysis::run (void)
+{
+	_lock.lock ();
+	while (!_quit) {
+		if (!_pending) {
+			_wake.wait (&_lock);
+			continue;
+		}
+
+		Job job = _job;
+
+		_pending = false;
+		_lock.unlock ();
+
+		Result r = analyse (job);
+
+		_lock.lock ();
+		_result = r;
+		_lock.unlock ();
+		emit analysed ();
+		_lock.lock ();
+	}
+	_lock.unlock ();
+}
+/*}}}*/
+/*{{{  AVRBackgroundAnalysis::Result AVRBackgroundAnalysis::analyse (const Job &job) const*/
+/*
+ *	lays out the source and runs the analyses over it.
+ */
+AVRBackgroundAnalysis::Result AVRBackgroundAnalysis::analyse (const Job &job) const
+{
+	QElapsedTimer timer;
+	Result r;
+	QSharedPointer<AVRASMProgram> program (new AVRASMProgram ());
+	const AVRDeviceInfo *dev = findAVRDevice (job.device);
+
+	timer.start ();
+	r.fileName = job.fileName;
+	r.device = job.device;
+	r.deviceKnown = (dev != 0);
+	r.isrBudget = job.isrBudget;
+	r.stack.bounded = false;
+	r.stack.mainDepth = r.stack.interruptDepth = r.stack.depth = 0;
+	r.stack.available = 0;
+	r.stack.problemIndex = -1;
+
+	program->parse (job.text, job.fileName, job.includePaths);
+	r.program = program;
+
+	AVRASMFlow flow (*program, dev && (dev->flashSize > 131072));
+	AVRCycleAssertions assertions (flow);
+
+	AVRReachability reach (flow, dev);
+	AVRLiveness live (flow, dev);
+
+	for (int n=0; n<flow.nodes ().count (); n++) {
+		r.liveIn.insert (flow.nodes ().at (n).index, live.liveIn (n));
+	}
+
+	r.assertions = assertions.assertions ();
+	r.unreachable = reach.unreachable ();
+	r.unusedTables = reach.unusedTables ();
+	r.reachabilityNotes = reach.notes ();
+	if (dev) {
+		AVRISRAnalysis isr (flow, *dev);
+		AVRStackAnalysis stack (flow, *dev);
+
+		r.handlers = isr.handlers ();
+		r.stack = stack.summary ();
+	}
+
+	r.msecs = timer.elapsed ();
+	return r;
+}
+/*}}}*/
+
@@ -0,0 +1,98 @@
+/*
+ *	avrbackgroundanalysis.h -- static analyses of the current file, run off the GUI thread.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRBACKGROUNDANALYSIS_H
+#define AVRBACKGROUNDANALYSIS_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "avrasmprogram.h"
+#include "avrcycleassertions.h"
+#include "avrisranalysis.h"
+#include "avrreachability.h"
+#include "avrstackanalysis.h"
+
+/*
+ *	One long-lived thread that lays out the given source and analyses it.  Requests made while it
+ *	is busy replace any that have not started yet, so only the latest text is ever looked at; each
+ *	finished run is signalled, and its result kept until the next.
+ */
+class AVRBackgroundAnalysis : public QThread
+{
+	Q_OBJECT
+
+public:
+	typedef struct Result {
+		QString fileName;
+		QString device;
+		bool deviceKnown;
+		QSharedPointer<const AVRASMProgram> program;
+		int isrBudget;				/* cycles */
+		QList<AVRISRAnalysis::Handler> handlers;
+		AVRStackAnalysis::Summary stack;
+		QList<AVRCycleAssertions::Assertion> assertions;
+		QList<AVRReachability::Block> unreachable;
+		QList<AVRReachability::Table> unusedTables;
+		QList<AVRReachability::Note> reachabilityNotes;
+		QHash<int, quint32> liveIn;		/* program line -> registers live before it */
+		qint64 msecs;
+	} Result;
+
+	explicit AVRBackgroundAnalysis (QObject *parent = 0);
+	~AVRBackgroundAnalysis ();
+
+	void request (const QString &text, const QString &fileName, const QStringList &includePaths, const QString &device, int isrBudget);
+	Result result (void) const;
+
+	static QString location (const AVRASMProgram &program, int index);
+
+signals:
+	void analysed (void);
+
+protected:
+	void run (void);
+
+private:
+	typedef struct Job {
+		QString text;
+		QString fileName;
+		QStringList includePaths;
+		QString device;
+		int isrBudget;
+	} Job;
+
+	Result analyse (const Job &job) const;
+
+	mutable QMutex _lock;
+	QWaitCondition _wake;
+	bool _pending;
+	bool _quit;
+	Job _job;
+	Result _result;
+};
+
+#endif	/* !AVRBACKGROUNDANALYSIS_H */
+
@@ -0,0 +1,416 @@
+/*
+ *	avrbatchbuild.cpp -- parallel batch assembly of many files / device variants.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include "avrbatchbuild.h"
+#include "avrasmprogram.h"
+#include "avrdevice.h"
+#include "avrheximage.h"
+#include "avrworkpool.h"
+
+/*{{{  AVRBatchBuild::AVRBatchBuild (QObject *parent)*/
+/*
+ *	constructor.
+ */
+AVRBatchBuild::AVRBatchBuild (QObject *parent) : QThread (parent)
+{
+	_threads = 0;
+	_timeout = 60000;
+	_msecs = 0;
+	_steals = 0;
+	_usedThreads = 0;
+}
+/*}}}*/
+/*{{{  void AVRBatchBuild::setNocc (const QString &path, const QString &specsPath, const QString &params)*/
+/*
+ *	sets the compiler and its parameters (as in the configuration: "%filename%" is replaced by the
+ *	file being built and "%device%" by the device variant).
+ */
+void AVRBatchBuild::setNocc (const QString &path, const QString &specsPath, const QString &params)
+{
+	_noccPath = path;
+	_noccSpecsPath = specsPath;
+	_noccParams = params;
+}
+/*}}}*/
+/*{{{  void AVRBatchBuild::setThreads (int threads)*/
+/*
+ *	sets the number of builds run at once (0 for one per core).
+ */
+void AVRBatchBuild::setThreads (int threads)
+{
+	_threads = threads;
+}
+/*}}}*/
+/*{{{  void AVRBatchBuild::setTimeout (int msecs)*/
+/*
+ *	sets how long a single nocc run may take.
+ */
+void AVRBatchBuild::setTimeout (int msecs)
+{
+	_timeout = msecs;
+}
+/*}}}*/
+/*{{{  void AVRBatchBuild::addFile (const QString &file, const QStringList &devices)*/
+/*
+ *	adds a file to build for each of the given devices.
+ */
+void AVRBatchBuild::addFile (const QString &file, const QStringList &devices)
+{
+	_jobs << qMakePair (file, devices);
+}
+/*}}}*/
+/*{{{  void AVRBatchBuild::addListFile (const QString &listFile, const QStringList &devices)*/
+/*
+ *	adds every file named in a list file (one per line, '#' comments, names relative to the list).
+ */
+void AVRBatchBuild::addListFile (const QString &listFile, const QStringList &devices)
+{
+	QFile file (listFile);
+	QFileInfo info (listFile);
+
+	if (!file.open (QIODevice::ReadOnly | QIODevice::Text)) {
+		return;
+	}
+	QTextStream in (&file);
+
+	while (!in.atEnd ()) {
+		QString line = in.readLine ().trimmed ();
+
+		if (line.isEmpty () || line.startsWith ('#')) {
+			continue;
+		}
+		addFile (QFileInfo (line).isAbsolute () ? line : info.dir ().filePath (line), devices);
+	}
+}
+/*}}}*/
+
+/*{{{  void AVRBatchBuild::run (void)*/
+/*
+ *	thread body: runs every job on a work-stealing pool and waits for them all.
+ */
+void AVRBatchBuild::run (void)
+{
+	QElapsedTimer timer;
+
+	timer.start ();
+	{
+		QMutexLocker locker (&_lock);
+
+		_results.clear ();
+	}
+	{
+		AVRWorkPool pool (_threads);
+
+		for (int i=0; i<_jobs.count (); i++) {
+			QString file = _jobs.at (i).first;
+			QStringList devices = _jobs.at (i).second;
+
+			pool.submit ([this, file, devices] () {
+				buildFile (file, devices);
+			});
+		}
+		pool.waitForDone ();
+		_steals = pool.steals ();
+		_usedThreads = pool.threadCount ();
+	}
+	_msecs = timer.elapsed ();
+
+	QMutexLocker locker (&_lock);
+
+	std::stable_sort (_results.begin (), _results.end (), [] (const Result &a, const Result &b) {
+		return (a.file != b.file) ? (a.file < b.file) : (a.device < b.device);
+	});
+}
+/*}}}*/
+/*{{{  void AVRBatchBuild::buildFile (const QString &file, const QStringList &devices)*/
+/*
+ *	one pool task: builds a file for each device in turn.  With more than one device, the outputs
+ *	are renamed for the device, and the parameters must pass %device% to nocc (otherwise the
+ *	source's .mcu decides, and every variant would be the same build).
+ */
+void AVRBatchBuild::buildFile (const QString &file, const QStringList &devices)
+{
+	bool variants = (devices.count () > 1);
+
+	for (const QString &device : devices) {
+		Result r;
+
+		if (variants && !_noccParams.contains ("%device%")) {
+			const AVRDeviceInfo *dev = findAVRDevice (device);
+
+			r.file = file;
+			r.device = dev ? dev->name : device;
+			r.ok = false;
+			r.exitCode = -1;
+			r.flashUsed = r.dataUsed = r.eepromUsed = 0;
+			r.flashSize = dev ? dev->flashSize : 0;
+			r.sramSize = dev ? dev->sramSize : 0;
+			r.eepromSize = dev ? dev->eepromSize : 0;
+			r.msecs = 0;
+			r.problems << QString ("not built: several devices given, but the nocc parameters have no %device%");
+		} else {
+			r = buildOne (file, device, variants);
+		}
+
+		{
+			QMutexLocker locker (&_lock);
+
+			_results << r;
+		}
+		emit jobFinished (file, device, r.ok);
+	}
+}
+/*}}}*/
+/*{{{  AVRBatchBuild::Result AVRBatchBuild::buildOne (const QString &file, const QString &device, bool suffix)*/
+/*
+ *	runs nocc for one file and device, then checks what it produced.  If 'suffix' is set, the
+ *	images are renamed FILE.DEVICE.flash.hex (and .eeprom.hex), so other variants keep theirs.
+ */
+AVRBatchBuild::Result AVRBatchBuild::buildOne (const QString &file, const QString &device, bool suffix)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (device);
+	QElapsedTimer timer;
+	QProcess proc;
+	QStringList params = _noccParams.split (" ", QString::SkipEmptyParts);
+	QStringList env = QProcess::systemEnvironment ();
+	Result r;
+
+	timer.start ();
+	r.file = file;
+	r.device = dev ? dev->name : device;
+	r.ok = false;
+	r.exitCode = -1;
+	r.flashUsed = r.dataUsed = r.eepromUsed = 0;
+	r.flashSize = dev ? dev->flashSize : 0;
+	r.sramSize = dev ? dev->sramSize : 0;
+	r.eepromSize = dev ? dev->eepromSize : 0;
+
+	params.replaceInStrings ("%filename%", file);
+	params.replaceInStrings ("%device%", r.device.toLower ());
+	params.insert (0, "--specs-file");
+	params.insert (1, _noccSpecsPath);
+
+	env << "CYGWIN=nodosfilewarning";
+	proc.setEnvironment (env);
+	proc.setProcessChannelMode (QProcess::MergedChannels);
+	proc.start (_noccPath, params);
+	if (!proc.waitForStarted ()) {
+		r.problems << QString ("failed to start nocc: %1").arg (proc.errorString ());
+		r.msecs = timer.elapsed ();
+		return r;
+	}
+	if (!proc.waitForFinished (_timeout)) {
+		proc.kill ();
+		proc.waitForFinished ();
+		r.problems << QString ("nocc timed out after %1 ms").arg (_timeout);
+	}
+	r.output = QString::fromLocal8Bit (proc.readAll ()).trimmed ();
+	r.exitCode = proc.exitCode ();
+	r.ok = r.problems.isEmpty () && (proc.exitStatus () == QProcess::NormalExit) && (r.exitCode == 0);
+
+	if (r.ok) {
+		QString base = file;
+		QString err;
+		AVRASMProgram program;
+
+		base.replace (QString (".asm"), QString (""));
+		if (suffix) {
+			QString named = base + "." + r.device.toLower ();
+
+			for (const char *ext : {".flash.hex", ".eeprom.hex"}) {
+				if (QFileInfo (base + ext).exists ()) {
+					QFile::remove (named + ext);
+					if (!QFile::rename (base + ext, named + ext)) {
+						r.problems << QString ("cannot rename %1 to %2").arg (base + ext).arg (named + ext);
+					}
+				}
+			}
+			base = named;
+		}
+		if (!dev) {
+			r.problems << QString ("unknown device \"%1\", output not checked").arg (device);
+		} else {
+			AVRHexImage flash (dev->flashSize, dev->flashPageSize);
+			AVRHexImage eeprom (dev->eepromSize, dev->eepromPageSize);
+
+			if (!flash.load (base + ".flash.hex", &err)) {
+				r.problems << err;
+			}
+			r.flashUsed = flash.extent ();
+			if (QFileInfo (base + ".eeprom.hex").exists ()) {
+				if (!eeprom.load (base + ".eeprom.hex", &err)) {
+					r.problems << err;
+				}
+				r.eepromUsed = eeprom.extent ();
+			}
+		}
+		if (program.load (file, AVRASMProgram::includePaths (_noccParams), &err)) {
+			/* the image is clipped to the device, so an overflow only shows in the layout */
+			r.flashUsed = qMax (r.flashUsed, program.sectionSize (AVRASMProgram::TEXT));
+			r.dataUsed = program.sectionSize (AVRASMProgram::DATA);
+			r.problems << program.errors ();
+		} else {
+			r.problems << err;
+		}
+		if (dev && (r.flashUsed > r.flashSize)) {
+			r.problems << QString ("flash overflow: %1 of %2 bytes").arg (r.flashUsed).arg (r.flashSize);
+			r.ok = false;
+		}
+		if (dev && (r.dataUsed > r.sramSize)) {
+			r.problems << QString ("SRAM overflow: %1 of %2 bytes").arg (r.dataUsed).arg (r.sramSize);
+			r.ok = false;
+		}
+	}
+	r.msecs = timer.elapsed ();
+	return r;
+}
+/*}}}*/
+
+/*{{{  QList<AVRBatchBuild::Result> AVRBatchBuild::results (void) const*/
+/*
+ *	returns the results (sorted by file then device once the run has finished).
+ */
+QList<AVRBatchBuild::Result> AVRBatchBuild::results (void) const
+{
+	QMutexLocker locker (&_lock);
+
+	return _results;
+}
+/*}}}*/
+/*{{{  int AVRBatchBuild::failures (void) const*/
+/*
+ *	returns the number of builds that failed.
+ */
+int AVRBatchBuild::failures (void) const
+{
+	QMutexLocker locker (&_lock);
+	int n = 0;
+
+	for (const Result &r : _results) {
+		if (!r.ok) {
+			n++;
+		}
+	}
+	return n;
+}
+/*}}}*/
+/*{{{  QString AVRBatchBuild::report (void) const*/
+/*
+ *	produces the plain-text report: a summary line, then one line per build (with nocc's output
+ *	and any problems indented underneath).
+ */
+QString AVRBatchBuild::report (void) const
+{
+	QList<Result> results = this->results ();
+	AVRASMIncludeCache &cache = AVRASMIncludeCache::instance ();
+	QString out;
+	QTextStream s (&out);
+
+	s << QString ("batch build: %1 build(s), %2 failed, %3 thread(s), %4 s (%5 steal(s); include cache %6 hit(s), %7 miss(es))\n\n")
+		.arg (results.count ()).arg (failures ()).arg (_usedThreads).arg (_msecs / 1000.0, 0, 'f', 2)
+		.arg (_steals).arg (cache.hits ()).arg (cache.misses ());
+
+	for (const Result &r : results) {
+		s << QString ("%1 %2 %3  flash %4/%5  sram %6/%7  eeprom %8/%9  %10 s\n")
+			.arg (r.ok ? "ok  " : "FAIL").arg (r.device, -11).arg (r.file)
+			.arg (r.flashUsed).arg (r.flashSize).arg (r.dataUsed).arg (r.sramSize)
+			.arg (r.eepromUsed).arg (r.eepromSize).arg (r.msecs / 1000.0, 0, 'f', 2);
+		if (!r.ok && !r.output.isEmpty ()) {
+			for (const QString &line : r.output.split ('\n')) {
+				s << "\t" << line << "\n";
+			}
+		}
+		for (const QString &p : r.problems) {
+			s << "\t" << p << "\n";
+		}
+	}
+	s.flush ();
+	return out;
+}
+/*}}}*/
+/*{{{  QString AVRBatchBuild::jsonReport (void) const*/
+/*
+ *	produces the report as JSON, for scripts.
+ */
+QString AVRBatchBuild::jsonReport (void) const
+{
+	QList<Result> results = this->results ();
+	QJsonArray builds;
+	QJsonObject top;
+
+	for (const Result &r : results) {
+		QJsonObject b;
+
+		b["file"] = r.file;
+		b["device"] = r.device;
+		b["ok"] = r.ok;
+		b["exitCode"] = r.exitCode;
+		b["output"] = r.output;
+		b["problems"] = QJsonArray::fromStringList (r.problems);
+		b["flashUsed"] = r.flashUsed;
+		b["flashSize"] = r.flashSize;
+		b["sramUsed"] = r.dataUsed;
+		b["sramSize"] = r.sramSize;
+		b["eepromUsed"] = r.eepromUsed;
+		b["eepromSize"] = r.eepromSize;
+		b["seconds"] = r.msecs / 1000.0;
+		builds.append (b);
+	}
+	top["builds"] = builds;
+	top["failed"] = failures ();
+	top["threads"] = _usedThreads;
+	top["seconds"] = _msecs / 1000.0;
+	top["steals"] = _steals;
+	return QString::fromUtf8 (QJsonDocument (top).toJson ());
+}
+/*}}}*/
+/*{{{  bool AVRBatchBuild::saveReport (const QString &fileName, QString *error) const*/
+/*
+ *	writes the report to a file, as JSON if the name ends ".json".
+ *	returns true on success, false otherwise.
+ */
+bool AVRBatchBuild::saveReport (const QString &fileName, QString *error) const
+{
+	QSaveFile file (fileName);
+	QByteArray data = (fileName.endsWith (".json") ? jsonReport () : report ()).toUtf8 ();
+
+	if (!file.open (QIODevice::WriteOnly) || (file.write (data) != data.size ()) || !file.commit ()) {
+		if (error) {
+			*error = QString ("%1: %2").arg (fileName).arg (file.errorString ());
+		}
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+
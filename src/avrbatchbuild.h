@@ -0,0 +1,98 @@
+/*
+ *	avrbatchbuild.h -- parallel batch assembly of many files / device variants.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRBATCHBUILD_H
+#define AVRBATCHBUILD_H
+
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+/*
+ *	Runs nocc over a list of files on a work-stealing pool (one task per file; device variants of
+ *	the same file run one after another inside the file's task, each renaming its images for the
+ *	device before the next starts).
+ *	After each build the output is checked against the device and the source laid out, which pulls
+ *	included headers through the shared include cache.  Runs on its own thread; the results are
+ *	gathered into a single report.
+ */
+class AVRBatchBuild : public QThread
+{
+	Q_OBJECT
+
+public:
+	typedef struct Result {
+		QString file;
+		QString device;
+		bool ok;
+		int exitCode;
+		QString output;			/* nocc's stdout and stderr */
+		QStringList problems;		/* our own checks */
+		int flashUsed;
+		int flashSize;
+		int dataUsed;
+		int sramSize;
+		int eepromUsed;
+		int eepromSize;
+		qint64 msecs;
+	} Result;
+
+	explicit AVRBatchBuild (QObject *parent = 0);
+
+	void setNocc (const QString &path, const QString &specsPath, const QString &params);
+	void setThreads (int threads);
+	void setTimeout (int msecs);
+	void addFile (const QString &file, const QStringList &devices);
+	void addListFile (const QString &listFile, const QStringList &devices);
+
+	QList<Result> results (void) const;
+	int failures (void) const;
+	QString report (void) const;
+	QString jsonReport (void) const;
+	bool saveReport (const QString &fileName, QString *error = 0) const;
+
+signals:
+	void jobFinished (const QString &file, const QString &device, bool ok);
+
+protected:
+	void run (void);
+
+private:
+	void buildFile (const QString &file, const QStringList &devices);
+	Result buildOne (const QString &file, const QString &device, bool suffix);
+
+	QString _noccPath;
+	QString _noccSpecsPath;
+	QString _noccParams;
+	int _threads;
+	int _timeout;
+	QList<QPair<QString, QStringList> > _jobs;
+
+	mutable QMutex _lock;
+	QList<Result> _results;
+	qint64 _msecs;
+	int _steals;
+	int _usedThreads;
+};
+
+#endif	/* !AVRBATCHBUILD_H */
+
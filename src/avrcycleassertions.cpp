@@ -0,0 +1,376 @@
+/*
+ *	avrcycleassertions.cpp -- checks "; @cycles" budgets written in source comments.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QHash>
+#include <QPair>
+#include <QRegExp>
+
+#include "avrcycleassertions.h"
+#include "avrasmflow.h"
+#include "avrasmprogram.h"
+
+/* comparisons, longest first so "<=" is not taken as "<" */
+static const struct {
+	const char *text;
+	AVRCycleAssertions::Compare compare;
+} compareOps[] = {
+	{"<=", AVRCycleAssertions::CMP_LE},
+	{">=", AVRCycleAssertions::CMP_GE},
+	{"==", AVRCycleAssertions::CMP_EQ},
+	{"<", AVRCycleAssertions::CMP_LT},
+	{">", AVRCycleAssertions::CMP_GT}
+};
+
+/*{{{  AVRCycleAssertions::AVRCycleAssertions (const AVRASMFlow &flow)*/
+/*
+ *	constructor: finds and checks every assertion in the graph's program (which must outlive this).
+ */
+AVRCycleAssertions::AVRCycleAssertions (const AVRASMFlow &flow) : _flow (flow)
+{
+	int n = _flow.nodes ().count ();
+
+	_subroutines.first = _subroutines.last = -1;
+	_subroutines.state.fill (UNSEEN, n);
+	_subroutines.minCycles.fill (0, n);
+	_subroutines.maxCycles.fill (0, n);
+	_subroutines.cause.fill (-1, n);
+	_problem.resize (n);
+	find ();
+}
+/*}}}*/
+/*{{{  const QList<AVRCycleAssertions::Assertion> &AVRCycleAssertions::assertions (void) const*/
+/*
+ *	returns the assertions, in program order (stray "@end"s included, as failures).
+ */
+const QList<AVRCycleAssertions::Assertion> &AVRCycleAssertions::assertions (void) const
+{
+	return _assertions;
+}
+/*}}}*/
+/*{{{  int AVRCycleAssertions::failures (void) const*/
+/*
+ *	returns the number of assertions that do not hold (or cannot be checked).
+ */
+int AVRCycleAssertions::failures (void) const
+{
+	int count = 0;
+
+	for (const Assertion &a : _assertions) {
+		if (!a.ok) {
+			count++;
+		}
+	}
+	return count;
+}
+/*}}}*/
+
+/*{{{  void AVRCycleAssertions::find (void)*/
+/*
+ *	pairs up the "@cycles" and "@end" comments (separately in each file), then checks each region.
+ */
+void AVRCycleAssertions::find (void)
+{
+	const AVRASMProgram &program = _flow.program ();
+	const QVector<AVRASMProgram::Line> &lines = program.lines ();
+	QRegExp pragmaRE ("^;+\\s*@(cycles|end)\\b\\s*(.*)$");
+	QHash<int, QList<int> > open;		/* file -> assertions not yet ended */
+
+	for (int i=0; i<lines.count (); i++) {
+		QString text = program.sourceText (i);
+		QString comment = text.mid (AVRASMConstants::stripComment (text).length ()).trimmed ();
+		Assertion a;
+
+		if (!comment.startsWith (';') || !pragmaRE.exactMatch (comment)) {
+			continue;
+		}
+		if (pragmaRE.cap (1) == "end") {
+			if (!open[lines.at (i).file].isEmpty ()) {
+				_assertions[open[lines.at (i).file].takeLast ()].endIndex = i;
+				continue;
+			}
+			a.problem = QString ("@end without @cycles");
+		}
+
+		a.index = i;
+		a.endIndex = -1;
+		a.compare = CMP_LE;
+		a.limit = 0;
+		a.text = pragmaRE.cap (2).trimmed ();
+		a.bounded = false;
+		a.minCycles = a.maxCycles = 0;
+		a.ok = false;
+		a.problemIndex = i;
+
+		if (a.problem.isEmpty ()) {
+			/*{{{  condition*/
+			QString cond = a.text;
+			QString err;
+			unsigned int k;
+
+			for (k=0; k<sizeof (compareOps) / sizeof (compareOps[0]); k++) {
+				if (cond.startsWith (compareOps[k].text)) {
+					break;
+				}
+			}
+			if (k == sizeof (compareOps) / sizeof (compareOps[0])) {
+				a.problem = QString ("expected <=, <, >=, > or == after @cycles");
+			} else {
+				a.compare = compareOps[k].compare;
+				if (!program.constants ().evaluate (cond.mid (QString (compareOps[k].text).length ()).trimmed (), &a.limit, &err)) {
+					a.problem = QString ("bad @cycles limit: %1").arg (err);
+				}
+			}
+			/*}}}*/
+			open[lines.at (i).file] << _assertions.count ();
+		}
+		_assertions << a;
+	}
+
+	for (int i=0; i<_assertions.count (); i++) {
+		Assertion &a = _assertions[i];
+
+		if (!a.problem.isEmpty ()) {
+			continue;
+		}
+		if (a.endIndex < 0) {
+			a.problem = QString ("@cycles without @end");
+			continue;
+		}
+		check (a);
+	}
+}
+/*}}}*/
+/*{{{  void AVRCycleAssertions::check (Assertion &a)*/
+/*
+ *	times a region and compares it with the limit.
+ */
+void AVRCycleAssertions::check (Assertion &a)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	int n = nodes.count ();
+	int entry = -1;
+	Scope scope;
+
+	for (int i=a.index; (i<=a.endIndex) && (entry < 0); i++) {
+		entry = _flow.nodeForIndex (i);
+	}
+	a.bounded = true;
+	if (entry >= 0) {
+		scope.first = a.index;
+		scope.last = a.endIndex;
+		scope.state.fill (UNSEEN, n);
+		scope.minCycles.fill (0, n);
+		scope.maxCycles.fill (0, n);
+		scope.cause.fill (-1, n);
+		evaluate (scope, entry);
+
+		if (scope.maxCycles.at (entry) < 0) {
+			a.bounded = false;
+			a.problemIndex = nodes.at (scope.cause.at (entry)).index;
+			a.problem = QString ("cannot time region: %1").arg (_problem.at (scope.cause.at (entry)));
+			return;
+		}
+		a.minCycles = scope.minCycles.at (entry);
+		a.maxCycles = scope.maxCycles.at (entry);
+	}
+
+	switch (a.compare) {
+	case CMP_LE:
+		a.ok = (a.maxCycles <= a.limit);
+		break;
+	case CMP_LT:
+		a.ok = (a.maxCycles < a.limit);
+		break;
+	case CMP_GE:
+		a.ok = (a.minCycles >= a.limit);
+		break;
+	case CMP_GT:
+		a.ok = (a.minCycles > a.limit);
+		break;
+	case CMP_EQ:
+		a.ok = (a.minCycles == a.limit) && (a.maxCycles == a.limit);
+		break;
+	}
+	if (!a.ok) {
+		a.problem = QString ("region takes %1 cycles, not %2").arg ((a.minCycles == a.maxCycles) ? QString::number (a.maxCycles) :
+				QString ("%1-%2").arg (a.minCycles).arg (a.maxCycles)).arg (a.text);
+		a.problemIndex = a.index;
+	}
+}
+/*}}}*/
+/*{{{  bool AVRCycleAssertions::inside (const Scope &scope, int node) const*/
+/*
+ *	returns true if a node is part of a scope (subroutines include everything).
+ */
+bool AVRCycleAssertions::inside (const Scope &scope, int node) const
+{
+	int index = _flow.nodes ().at (node).index;
+
+	return (scope.first < 0) || ((index >= scope.first) && (index <= scope.last));
+}
+/*}}}*/
+/*{{{  void AVRCycleAssertions::evaluate (Scope &scope, int root)*/
+/*
+ *	depth-first search from a node, working out the shortest and longest times to leaving the scope
+ *	after those of its successors (as in AVRISRAnalysis::evaluate).  Within a subroutine a call's
+ *	target is just another successor; within a region, called subroutines are timed separately.
+ */
+void AVRCycleAssertions::evaluate (Scope &scope, int root)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	const AVRASMProgram &program = _flow.program ();
+	bool region = (scope.first >= 0);
+	QVector<QPair<int, bool> > stack;
+
+	stack << qMakePair (root, false);
+	while (!stack.isEmpty ()) {
+		QPair<int, bool> top = stack.takeLast ();
+		int n = top.first;
+		const AVRASMFlow::Node &node = nodes.at (n);
+		int succ[2] = {node.next, node.target};
+		qint64 calleeMin = 0, calleeMax = 0;
+
+		if (node.kind == AVRASMFlow::JUMP) {
+			succ[0] = -1;
+		}
+		if (region && (node.kind == AVRASMFlow::CALL)) {
+			succ[1] = -1;
+		}
+
+		if (!top.second) {
+			/*{{{  first visit: come back after the successors in scope*/
+			if (scope.state.at (n) != UNSEEN) {
+				continue;
+			}
+			scope.state[n] = ACTIVE;
+			stack << qMakePair (n, true);
+			for (int i=0; i<2; i++) {
+				if ((succ[i] >= 0) && inside (scope, succ[i]) && (scope.state.at (succ[i]) == UNSEEN)) {
+					stack << qMakePair (succ[i], false);
+				}
+			}
+			continue;
+			/*}}}*/
+		}
+
+		scope.state[n] = DONE;
+
+		/*{{{  things we cannot follow*/
+		switch (node.kind) {
+		case AVRASMFlow::RETURN:
+		case AVRASMFlow::RETI:
+			scope.minCycles[n] = scope.maxCycles[n] = node.maxCycles;
+			continue;
+		case AVRASMFlow::INDIRECT_JUMP:
+		case AVRASMFlow::INDIRECT_CALL:
+			setProblem (scope, n, n, QString ("indirect %1 (target not known)").arg (node.mnemonic));
+			continue;
+		default:
+			break;
+		}
+		if (node.unresolved) {
+			setProblem (scope, n, n, QString ("target of %1 not found").arg (node.mnemonic));
+			continue;
+		}
+		if ((node.kind != AVRASMFlow::JUMP) && ((succ[0] < 0) || ((node.kind == AVRASMFlow::SKIP) && (succ[1] < 0)))) {
+			setProblem (scope, n, n, QString ("runs off the end of the code"));
+			continue;
+		}
+		/*}}}*/
+		/*{{{  loops and unbounded successors*/
+		bool bad = false;
+
+		for (int i=0; (i<2) && !bad; i++) {
+			int s = succ[i];
+
+			if ((s < 0) || !inside (scope, s)) {
+				continue;
+			}
+			if (scope.state.at (s) == ACTIVE) {
+				const AVRASMProgram::Line &l = program.lines ().at (nodes.at (s).index);
+
+				setProblem (scope, n, n, QString ("loop or recursion back to %1:%2").arg (program.files ().at (l.file)).arg (l.line + 1));
+				bad = true;
+			} else if (scope.maxCycles.at (s) < 0) {
+				setProblem (scope, n, scope.cause.at (s), QString ());
+				bad = true;
+			}
+		}
+		if (!bad && region && (node.kind == AVRASMFlow::CALL)) {
+			if (_subroutines.state.at (node.target) != DONE) {
+				evaluate (_subroutines, node.target);
+			}
+			if (_subroutines.maxCycles.at (node.target) < 0) {
+				setProblem (scope, n, _subroutines.cause.at (node.target), QString ());
+				bad = true;
+			}
+			calleeMin = _subroutines.minCycles.at (node.target);
+			calleeMax = _subroutines.maxCycles.at (node.target);
+		}
+		if (bad) {
+			continue;
+		}
+		/*}}}*/
+
+		/* time from each successor to leaving the scope (none if it is outside) */
+		qint64 nextMin = ((succ[0] >= 0) && inside (scope, succ[0])) ? scope.minCycles.at (succ[0]) : 0;
+		qint64 nextMax = ((succ[0] >= 0) && inside (scope, succ[0])) ? scope.maxCycles.at (succ[0]) : 0;
+		qint64 targetMin = ((succ[1] >= 0) && inside (scope, succ[1])) ? scope.minCycles.at (succ[1]) : 0;
+		qint64 targetMax = ((succ[1] >= 0) && inside (scope, succ[1])) ? scope.maxCycles.at (succ[1]) : 0;
+
+		switch (node.kind) {
+		case AVRASMFlow::JUMP:
+			scope.minCycles[n] = _flow.edgeCycles (n, true) + targetMin;
+			scope.maxCycles[n] = _flow.edgeCycles (n, true) + targetMax;
+			break;
+		case AVRASMFlow::CALL:
+			if (!region) {
+				calleeMin = targetMin;
+				calleeMax = targetMax;
+			}
+			scope.minCycles[n] = _flow.edgeCycles (n, true) + calleeMin + nextMin;
+			scope.maxCycles[n] = _flow.edgeCycles (n, true) + calleeMax + nextMax;
+			break;
+		case AVRASMFlow::BRANCH:
+		case AVRASMFlow::SKIP:
+			scope.minCycles[n] = qMin (_flow.edgeCycles (n, false) + nextMin, _flow.edgeCycles (n, true) + targetMin);
+			scope.maxCycles[n] = qMax (_flow.edgeCycles (n, false) + nextMax, _flow.edgeCycles (n, true) + targetMax);
+			break;
+		default:
+			scope.minCycles[n] = node.minCycles + nextMin;
+			scope.maxCycles[n] = _flow.edgeCycles (n, false) + nextMax;
+			break;
+		}
+	}
+}
+/*}}}*/
+/*{{{  void AVRCycleAssertions::setProblem (Scope &scope, int node, int cause, const QString &problem)*/
+/*
+ *	marks a node untimeable because of 'cause' (which gets the problem text, if given).
+ */
+void AVRCycleAssertions::setProblem (Scope &scope, int node, int cause, const QString &problem)
+{
+	scope.minCycles[node] = scope.maxCycles[node] = -1;
+	scope.cause[node] = cause;
+	if (!problem.isEmpty ()) {
+		_problem[cause] = problem;
+	}
+}
+/*}}}*/
+
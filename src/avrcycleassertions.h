@@ -0,0 +1,96 @@
+/*
+ *	avrcycleassertions.h -- checks "; @cycles" budgets written in source comments.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRCYCLEASSERTIONS_H
+#define AVRCYCLEASSERTIONS_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class AVRASMFlow;
+
+/*
+ *	A region is opened by a comment of the form "; @cycles <= N" (or <, >=, >, ==, with N any
+ *	constant expression) and closed by "; @end"; regions nest, and both lines are part of the
+ *	region.  Every path from the region's first instruction to where it leaves the region (a jump
+ *	or fall-through out, or a ret/reti) is timed, calls included, and the shortest and longest
+ *	checked against the limit.  Loops (inside the region or anything it calls) and indirect jumps
+ *	cannot be timed, so a region containing one fails with the line responsible.
+ */
+class AVRCycleAssertions
+{
+public:
+	typedef enum Compare {
+		CMP_LE = 0,
+		CMP_LT,
+		CMP_GE,
+		CMP_GT,
+		CMP_EQ
+	} Compare;
+
+	typedef struct Assertion {
+		int index;		/* program line of the "@cycles" */
+		int endIndex;		/* and of its "@end", -1 if missing */
+		Compare compare;
+		qint64 limit;
+		QString text;		/* the condition as written, e.g. "<= 20" */
+		bool bounded;
+		qint64 minCycles;
+		qint64 maxCycles;
+		bool ok;
+		QString problem;	/* why not ok */
+		int problemIndex;	/* program line responsible */
+	} Assertion;
+
+	AVRCycleAssertions (const AVRASMFlow &flow);
+
+	const QList<Assertion> &assertions (void) const;
+	int failures (void) const;
+
+private:
+	typedef enum State {
+		UNSEEN = 0,
+		ACTIVE,
+		DONE
+	} State;
+
+	/* one set of search results: within a region, or to the return of a subroutine */
+	typedef struct Scope {
+		int first, last;		/* program lines in the region, -1 for a subroutine */
+		QVector<char> state;
+		QVector<qint64> minCycles;	/* to leaving the scope, -1 if unbounded */
+		QVector<qint64> maxCycles;
+		QVector<int> cause;		/* node responsible when unbounded */
+	} Scope;
+
+	void find (void);
+	void check (Assertion &a);
+	bool inside (const Scope &scope, int node) const;
+	void evaluate (Scope &scope, int root);
+	void setProblem (Scope &scope, int node, int cause, const QString &problem);
+
+	const AVRASMFlow &_flow;
+	QList<Assertion> _assertions;
+	Scope _subroutines;
+	QVector<QString> _problem;	/* per node, why it cannot be timed */
+};
+
+#endif	/* !AVRCYCLEASSERTIONS_H */
+
@@ -0,0 +1,366 @@
+/*
+ *	avrcyclemargin.cpp -- editor margin showing per-line cycle costs and basic-block totals.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include <QSet>
+#include <Qsci/qsciscintilla.h>
+
+#include "avrcyclemargin.h"
+#include "avrasmprogram.h"
+
+/*{{{  AVRCycleMargin::AVRCycleMargin (QsciScintilla *editor, int margin)*/
+/*
+ *	constructor: attaches to an editor, using the given margin number (made a text margin, and
+ *	the only one: margin texts are per line, not per margin).
+ */
+AVRCycleMargin::AVRCycleMargin (QsciScintilla *editor, int margin) : QObject (editor), _editor (editor), _margin (margin)
+{
+	_enabled = false;
+	_pc22 = false;
+	_addresses = false;
+	_dirtyFirst = -1;
+	_dirtyLast = -1;
+	_lines.resize (qMax (1, _editor->lines ()));
+	markDirty (0, _lines.count () - 1);
+
+	_editor->setMarginType (_margin, QsciScintilla::TextMargin);
+	_editor->setMarginWidth (_margin, 0);
+
+	_timer.setSingleShot (true);
+	_timer.setInterval (100);
+	connect (&_timer, SIGNAL (timeout ()), this, SLOT (refresh ()));
+	connect (_editor, SIGNAL (SCN_MODIFIED (int, int, const char *, int, int, int, int, int, int, int)),
+			this, SLOT (modified (int, int, const char *, int, int, int, int, int, int, int)));
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::setEnabled (bool enabled)*/
+/*
+ *	shows or hides the margin.
+ */
+void AVRCycleMargin::setEnabled (bool enabled)
+{
+	_enabled = enabled;
+	if (enabled) {
+		markDirty (0, _lines.count () - 1);
+		refresh ();
+	}
+	showAll ();
+}
+/*}}}*/
+/*{{{  bool AVRCycleMargin::isEnabled (void) const*/
+/*
+ *	returns true if the margin is showing.
+ */
+bool AVRCycleMargin::isEnabled (void) const
+{
+	return _enabled;
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::setPC22 (bool pc22)*/
+/*
+ *	sets whether the target has a 22-bit program counter, which fixes what calls and returns cost.
+ */
+void AVRCycleMargin::setPC22 (bool pc22)
+{
+	if (pc22 == _pc22) {
+		return;
+	}
+	_pc22 = pc22;
+	markDirty (0, _lines.count () - 1);
+	if (_enabled) {
+		refresh ();
+	}
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::setAddresses (const QVector<qint32> &addresses)*/
+/*
+ *	sets the flash address shown for each line (-1 for none), from a build's listing; an empty
+ *	vector stops showing addresses.
+ */
+void AVRCycleMargin::setAddresses (const QVector<qint32> &addresses)
+{
+	for (int l=0; l<_lines.count (); l++) {
+		_lines[l].address = (l < addresses.count ()) ? addresses.at (l) : -1;
+	}
+	_addresses = !addresses.isEmpty ();
+	showAll ();
+}
+/*}}}*/
+/*{{{  bool AVRCycleMargin::lineCycles (int line, int *minCycles, int *maxCycles) const*/
+/*
+ *	gets the cost of a line.
+ *	returns true if the line holds an instruction, false otherwise.
+ */
+bool AVRCycleMargin::lineCycles (int line, int *minCycles, int *maxCycles) const
+{
+	if ((line < 0) || (line >= _lines.count ()) || !_lines.at (line).instruction) {
+		return false;
+	}
+	*minCycles = _lines.at (line).minCycles;
+	*maxCycles = _lines.at (line).maxCycles;
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRCycleMargin::runningCycles (int line, int *minCycles, int *maxCycles) const*/
+/*
+ *	gets the running total from the start of the line's basic block up to and including the line.
+ *	returns true on success, false if out of range.
+ */
+bool AVRCycleMargin::runningCycles (int line, int *minCycles, int *maxCycles) const
+{
+	if ((line < 0) || (line >= _lines.count ())) {
+		return false;
+	}
+	*minCycles = _lines.at (line).runMin;
+	*maxCycles = _lines.at (line).runMax;
+	return true;
+}
+/*}}}*/
+/*{{{  int AVRCycleMargin::blockStart (int line) const*/
+/*
+ *	returns the first line of the basic block holding 'line'.
+ */
+int AVRCycleMargin::blockStart (int line) const
+{
+	if (line >= _lines.count ()) {
+		line = _lines.count () - 1;
+	}
+	while ((line > 0) && !_lines.at (line).label && !_lines.at (line - 1).ends) {
+		line--;
+	}
+	return qMax (line, 0);
+}
+/*}}}*/
+/*{{{  bool AVRCycleMargin::endsBlock (const QString &mnemonic)*/
+/*
+ *	returns true if an instruction can transfer control somewhere other than the next instruction
+ *	(calls return, so they do not end a block).
+ */
+bool AVRCycleMargin::endsBlock (const QString &mnemonic)
+{
+	static const QSet<QString> enders = {
+		"rjmp", "jmp", "ijmp", "eijmp", "ret", "reti",
+		"cpse", "sbrc", "sbrs", "sbic", "sbis"
+	};
+
+	if (mnemonic.startsWith ("br") && (mnemonic != "break")) {
+		return true;
+	}
+	return enders.contains (mnemonic);
+}
+/*}}}*/
+
+/*{{{  void AVRCycleMargin::modified (int position, int modificationType, const char *text, int length, int linesAdded, int line, int foldNow, int foldPrev, int token, int annotationLinesAdded)*/
+/*
+ *	SCN_MODIFIED: keeps the per-line records lined up with the text and notes which lines changed.
+ */
+void AVRCycleMargin::modified (int position, int modificationType, const char *text, int length, int linesAdded,
+		int line, int foldNow, int foldPrev, int token, int annotationLinesAdded)
+{
+	Q_UNUSED (text);
+	Q_UNUSED (length);
+	Q_UNUSED (line);
+	Q_UNUSED (foldNow);
+	Q_UNUSED (foldPrev);
+	Q_UNUSED (token);
+	Q_UNUSED (annotationLinesAdded);
+
+	if (!(modificationType & (QsciScintillaBase::SC_MOD_INSERTTEXT | QsciScintillaBase::SC_MOD_DELETETEXT))) {
+		return;
+	}
+
+	int first = (int)_editor->SendScintilla (QsciScintillaBase::SCI_LINEFROMPOSITION, (unsigned long)position);
+	LineCost blank;
+
+	memset (&blank, 0, sizeof (blank));
+	blank.address = -1;
+	first = qBound (0, first, _lines.count () - 1);
+	if (linesAdded > 0) {
+		_lines.insert (first + 1, linesAdded, blank);
+	} else if (linesAdded < 0) {
+		_lines.remove (first + 1, qMin (-linesAdded, _lines.count () - first - 1));
+	}
+	if (_dirtyFirst > first) {
+		/* pending range below the change moves with the text */
+		_dirtyFirst = qMax (first, _dirtyFirst + linesAdded);
+	}
+	if (_dirtyLast > first) {
+		_dirtyLast = qMax (first, _dirtyLast + linesAdded);
+	}
+	markDirty (first, first + qMax (linesAdded, 0));
+	_timer.start ();
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::markDirty (int first, int last)*/
+/*
+ *	adds a line range to what needs re-reading.
+ */
+void AVRCycleMargin::markDirty (int first, int last)
+{
+	if (_dirtyFirst < 0) {
+		_dirtyFirst = first;
+		_dirtyLast = last;
+		return;
+	}
+	if (first < _dirtyFirst) {
+		_dirtyFirst = first;
+	}
+	if (last > _dirtyLast) {
+		_dirtyLast = last;
+	}
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::parseLine (int line)*/
+/*
+ *	re-reads the cost and block boundaries of one line.
+ */
+void AVRCycleMargin::parseLine (int line)
+{
+	QVector<AVRASMStatement> stmts;
+	LineCost &c = _lines[line];
+	int lo, hi;
+
+	AVRASMProgram::parseStatements (QStringList () << _editor->text (line), &stmts);
+
+	const AVRASMStatement &stmt = stmts.at (0);
+
+	c.label = !stmt.label.isEmpty ();
+	c.instruction = AVRASMProgram::instructionCycles (stmt.mnemonic, &lo, &hi);
+	if (c.instruction && ((stmt.mnemonic == "call") || (stmt.mnemonic == "rcall") || (stmt.mnemonic == "icall") ||
+			(stmt.mnemonic == "eicall") || (stmt.mnemonic == "ret") || (stmt.mnemonic == "reti"))) {
+		/* the range in the opcode table is 16-bit vs 22-bit PC */
+		lo = hi = _pc22 ? hi : lo;
+	}
+	c.minCycles = c.instruction ? lo : 0;
+	c.maxCycles = c.instruction ? hi : 0;
+	c.ends = c.instruction && endsBlock (stmt.mnemonic);
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::refresh (void)*/
+/*
+ *	re-reads the changed lines, then redoes the running totals of the blocks they are in (blocks
+ *	after the last changed one are untouched).
+ */
+void AVRCycleMargin::refresh (void)
+{
+	int first, last, start, l;
+	qint32 runMin = 0, runMax = 0;
+
+	if (_dirtyFirst < 0) {
+		return;
+	}
+	first = qBound (0, _dirtyFirst, _lines.count () - 1);
+	last = qBound (0, _dirtyLast, _lines.count () - 1);
+	_dirtyFirst = -1;
+	_dirtyLast = -1;
+
+	for (l=first; l<=last; l++) {
+		parseLine (l);
+	}
+
+	start = blockStart (first);
+	for (l=start; l<_lines.count (); l++) {
+		LineCost &c = _lines[l];
+
+		if ((l > start) && (c.label || _lines.at (l - 1).ends)) {
+			if (l > last) {
+				break;
+			}
+			runMin = 0;
+			runMax = 0;
+		}
+		if (c.instruction) {
+			runMin += c.minCycles;
+			runMax += c.maxCycles;
+		}
+		c.runMin = runMin;
+		c.runMax = runMax;
+
+		if (_enabled) {
+			showLine (l);
+		}
+	}
+	emit updated (start, l - 1);
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::showLine (int line)*/
+/*
+ *	sets the margin text of one line.
+ */
+void AVRCycleMargin::showLine (int line)
+{
+	QString text = marginText (_lines.at (line));
+
+	if (text.trimmed ().isEmpty ()) {
+		_editor->clearMarginText (line);
+	} else {
+		_editor->setMarginText (line, text, QsciScintillaBase::STYLE_LINENUMBER);
+	}
+}
+/*}}}*/
+/*{{{  void AVRCycleMargin::showAll (void)*/
+/*
+ *	sizes the margin for what it now shows (hidden if nothing), and redoes every line's text.
+ */
+void AVRCycleMargin::showAll (void)
+{
+	LineCost widest;
+
+	memset (&widest, 0, sizeof (widest));
+	widest.address = _addresses ? 0xfffff : -1;
+	widest.instruction = true;
+	widest.minCycles = 10;
+	widest.maxCycles = 99;
+	widest.runMin = 1000;
+	widest.runMax = 9999;
+
+	_editor->clearMarginText ();
+	if (!_enabled && !_addresses) {
+		_editor->setMarginWidth (_margin, 0);
+		return;
+	}
+	_editor->setMarginWidth (_margin, marginText (widest) + "0");
+	for (int l=0; l<_lines.count (); l++) {
+		showLine (l);
+	}
+}
+/*}}}*/
+/*{{{  QString AVRCycleMargin::marginText (const LineCost &c) const*/
+/*
+ *	formats a line's address (if showing) and its cost and running block total (if enabled), e.g.
+ *	"001a4  1-2   S7-9".
+ */
+QString AVRCycleMargin::marginText (const LineCost &c) const
+{
+	QString text;
+
+	if (_addresses) {
+		text = (c.address >= 0) ? QString ("%1  ").arg (c.address, 5, 16, QChar ('0')) : QString (7, ' ');
+	}
+	if (_enabled && c.instruction) {
+		QString cost = (c.minCycles == c.maxCycles) ? QString::number (c.minCycles) : QString ("%1-%2").arg (c.minCycles).arg (c.maxCycles);
+		QString run = (c.runMin == c.runMax) ? QString::number (c.runMin) : QString ("%1-%2").arg (c.runMin).arg (c.runMax);
+
+		text += QString ("%1 %2%3").arg (cost, -5).arg (QChar (0x03a3)).arg (run);
+	}
+	return text;
+}
+/*}}}*/
+
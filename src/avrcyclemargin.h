@@ -0,0 +1,96 @@
+/*
+ *	avrcyclemargin.h -- editor margin showing per-line cycle costs and basic-block totals.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRCYCLEMARGIN_H
+#define AVRCYCLEMARGIN_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class QsciScintilla;
+
+/*
+ *	Keeps one cost record per editor line, following inserts and deletes as they happen, and only
+ *	re-reads the lines that changed.  A basic block starts at a label or after anything that can
+ *	transfer control (jumps, branches, returns, skips); each instruction line shows its own cost
+ *	and the running total from the start of its block, as min-max where the cost varies.
+ *
+ *	Scintilla keeps one margin text per line for all text margins, so the flash addresses from the
+ *	last build's listing are shown here too, in front of the cycles (and move with the lines).
+ */
+class AVRCycleMargin : public QObject
+{
+	Q_OBJECT
+
+public:
+	AVRCycleMargin (QsciScintilla *editor, int margin);
+
+	bool isEnabled (void) const;
+	void setPC22 (bool pc22);
+	void setAddresses (const QVector<qint32> &addresses);
+
+	bool lineCycles (int line, int *minCycles, int *maxCycles) const;
+	bool runningCycles (int line, int *minCycles, int *maxCycles) const;
+	int blockStart (int line) const;
+
+	static bool endsBlock (const QString &mnemonic);
+
+public slots:
+	void setEnabled (bool enabled);
+
+signals:
+	void updated (int firstLine, int lastLine);
+
+private slots:
+	void modified (int position, int modificationType, const char *text, int length, int linesAdded,
+			int line, int foldNow, int foldPrev, int token, int annotationLinesAdded);
+	void refresh (void);
+
+private:
+	typedef struct LineCost {
+		qint16 minCycles;
+		qint16 maxCycles;
+		qint32 runMin;		/* running totals from the start of the block */
+		qint32 runMax;
+		qint32 address;		/* from the last build's listing, -1 if none */
+		bool instruction;
+		bool label;		/* a block starts here */
+		bool ends;		/* a block ends after this line */
+	} LineCost;
+
+	void markDirty (int first, int last);
+	void parseLine (int line);
+	void showLine (int line);
+	void showAll (void);
+	QString marginText (const LineCost &c) const;
+
+	QsciScintilla *_editor;
+	int _margin;
+	bool _enabled;
+	bool _pc22;			/* 22-bit program counter (calls and returns take longer) */
+	bool _addresses;		/* showing addresses */
+	QVector<LineCost> _lines;
+	int _dirtyFirst;		/* -1 if nothing to do */
+	int _dirtyLast;
+	QTimer _timer;
+};
+
+#endif	/* !AVRCYCLEMARGIN_H */
+
@@ -0,0 +1,583 @@
+/*
+ *	avrdecoder.cpp -- table-driven AVR instruction decoder.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include <QStringList>
+#include <QtAlgorithms>
+
+#include "avrdecoder.h"
+#include "avrheximage.h"
+#include "language.h"
+
+
+/*{{{  operand formats and the opcode description table*/
+typedef enum OperandFormat {
+	F_NONE = 0,
+	F_RDRR,		/* d: 5 bits, r: 5 bits */
+	F_RD,		/* d: 5 bits */
+	F_RDK,		/* d: r16-r31, k: 8-bit immediate */
+	F_MOVW,		/* d, r: even registers */
+	F_MULS,		/* d, r: r16-r31 */
+	F_FMUL,		/* d, r: r16-r23 */
+	F_LDDQ,		/* d: 5 bits, k: 6-bit displacement */
+	F_LDS,		/* d: 5 bits, k: 16-bit data address (second word) */
+	F_ADIW,		/* d: r24/26/28/30, k: 6-bit immediate */
+	F_IOBIT,	/* k: 5-bit I/O address, b: bit */
+	F_IO,		/* d: 5 bits, k: 6-bit I/O address */
+	F_REL12,	/* k: signed 12-bit word offset */
+	F_BRANCH,	/* b: SREG bit, k: signed 7-bit word offset */
+	F_REGBIT,	/* d: 5 bits, b: bit */
+	F_SREG,		/* b: SREG bit */
+	F_JMP,		/* k: 22-bit word address (second word) */
+	F_DES		/* k: 4-bit round */
+} OperandFormat;
+
+typedef struct OpcodeDesc {
+	AVRDecoder::Opcode op;
+	const char *name;		/* mnemonic */
+	const char *syntax;		/* operand template, see AVRDecoder::format() */
+	const char *infoParams;		/* which OpcodesInfo variant describes this, NULL if only one */
+	quint16 mask;
+	quint16 match;
+	quint8 format;
+	quint8 words;
+} OpcodeDesc;
+
+static const OpcodeDesc opcodeDescs[] = {
+	// Opcode             ; Name     ; Syntax      ; OpcodesInfo variant ; Mask  ; Match ; Format ; Words
+	{AVRDecoder::OP_NOP, "nop", "", 0, 0xffff, 0x0000, F_NONE, 1},
+	{AVRDecoder::OP_MOVW, "movw", "%d, %r", 0, 0xff00, 0x0100, F_MOVW, 1},
+	{AVRDecoder::OP_MULS, "muls", "%d, %r", 0, 0xff00, 0x0200, F_MULS, 1},
+	{AVRDecoder::OP_MULSU, "mulsu", "%d, %r", 0, 0xff88, 0x0300, F_FMUL, 1},
+	{AVRDecoder::OP_FMUL, "fmul", "%d, %r", 0, 0xff88, 0x0308, F_FMUL, 1},
+	{AVRDecoder::OP_FMULS, "fmuls", "%d, %r", 0, 0xff88, 0x0380, F_FMUL, 1},
+	{AVRDecoder::OP_FMULSU, "fmulsu", "%d, %r", 0, 0xff88, 0x0388, F_FMUL, 1},
+	{AVRDecoder::OP_CPC, "cpc", "%d, %r", 0, 0xfc00, 0x0400, F_RDRR, 1},
+	{AVRDecoder::OP_SBC, "sbc", "%d, %r", 0, 0xfc00, 0x0800, F_RDRR, 1},
+	{AVRDecoder::OP_ADD, "add", "%d, %r", 0, 0xfc00, 0x0c00, F_RDRR, 1},
+	{AVRDecoder::OP_CPSE, "cpse", "%d, %r", 0, 0xfc00, 0x1000, F_RDRR, 1},
+	{AVRDecoder::OP_CP, "cp", "%d, %r", 0, 0xfc00, 0x1400, F_RDRR, 1},
+	{AVRDecoder::OP_SUB, "sub", "%d, %r", 0, 0xfc00, 0x1800, F_RDRR, 1},
+	{AVRDecoder::OP_ADC, "adc", "%d, %r", 0, 0xfc00, 0x1c00, F_RDRR, 1},
+	{AVRDecoder::OP_AND, "and", "%d, %r", 0, 0xfc00, 0x2000, F_RDRR, 1},
+	{AVRDecoder::OP_EOR, "eor", "%d, %r", 0, 0xfc00, 0x2400, F_RDRR, 1},
+	{AVRDecoder::OP_OR, "or", "%d, %r", 0, 0xfc00, 0x2800, F_RDRR, 1},
+	{AVRDecoder::OP_MOV, "mov", "%d, %r", 0, 0xfc00, 0x2c00, F_RDRR, 1},
+	{AVRDecoder::OP_CPI, "cpi", "%d, %K", 0, 0xf000, 0x3000, F_RDK, 1},
+	{AVRDecoder::OP_SBCI, "sbci", "%d, %K", 0, 0xf000, 0x4000, F_RDK, 1},
+	{AVRDecoder::OP_SUBI, "subi", "%d, %K", 0, 0xf000, 0x5000, F_RDK, 1},
+	{AVRDecoder::OP_ORI, "ori", "%d, %K", 0, 0xf000, 0x6000, F_RDK, 1},
+	{AVRDecoder::OP_ANDI, "andi", "%d, %K", 0, 0xf000, 0x7000, F_RDK, 1},
+	{AVRDecoder::OP_LDD_Z, "ldd", "%d, Z+%q", "Rd, Z+q", 0xd208, 0x8000, F_LDDQ, 1},
+	{AVRDecoder::OP_LDD_Y, "ldd", "%d, Y+%q", "Rd, Y+q", 0xd208, 0x8008, F_LDDQ, 1},
+	{AVRDecoder::OP_STD_Z, "std", "Z+%q, %d", "Z+q, Rr", 0xd208, 0x8200, F_LDDQ, 1},
+	{AVRDecoder::OP_STD_Y, "std", "Y+%q, %d", "Y+q, Rr", 0xd208, 0x8208, F_LDDQ, 1},
+	{AVRDecoder::OP_LDS, "lds", "%d, %m", 0, 0xfe0f, 0x9000, F_LDS, 2},
+	{AVRDecoder::OP_LD_ZINC, "ld", "%d, Z+", "Rd, Z+", 0xfe0f, 0x9001, F_RD, 1},
+	{AVRDecoder::OP_LD_ZDEC, "ld", "%d, -Z", "Rd, -Z", 0xfe0f, 0x9002, F_RD, 1},
+	{AVRDecoder::OP_LPM_Z, "lpm", "%d, Z", "Rd, Z", 0xfe0f, 0x9004, F_RD, 1},
+	{AVRDecoder::OP_LPM_ZINC, "lpm", "%d, Z+", "Rd, Z+", 0xfe0f, 0x9005, F_RD, 1},
+	{AVRDecoder::OP_ELPM_Z, "elpm", "%d, Z", "Rd, Z", 0xfe0f, 0x9006, F_RD, 1},
+	{AVRDecoder::OP_ELPM_ZINC, "elpm", "%d, Z+", "Rd, Z+", 0xfe0f, 0x9007, F_RD, 1},
+	{AVRDecoder::OP_LD_YINC, "ld", "%d, Y+", "Rd, Y+", 0xfe0f, 0x9009, F_RD, 1},
+	{AVRDecoder::OP_LD_YDEC, "ld", "%d, -Y", "Rd, -Y", 0xfe0f, 0x900a, F_RD, 1},
+	{AVRDecoder::OP_LD_X, "ld", "%d, X", "Rd, X", 0xfe0f, 0x900c, F_RD, 1},
+	{AVRDecoder::OP_LD_XINC, "ld", "%d, X+", "Rd, X+", 0xfe0f, 0x900d, F_RD, 1},
+	{AVRDecoder::OP_LD_XDEC, "ld", "%d, -X", "Rd, -X", 0xfe0f, 0x900e, F_RD, 1},
+	{AVRDecoder::OP_POP, "pop", "%d", 0, 0xfe0f, 0x900f, F_RD, 1},
+	{AVRDecoder::OP_STS, "sts", "%m, %d", 0, 0xfe0f, 0x9200, F_LDS, 2},
+	{AVRDecoder::OP_ST_ZINC, "st", "Z+, %d", "Z+, Rr", 0xfe0f, 0x9201, F_RD, 1},
+	{AVRDecoder::OP_ST_ZDEC, "st", "-Z, %d", "-Z, Rr", 0xfe0f, 0x9202, F_RD, 1},
+	{AVRDecoder::OP_XCH, "xch", "Z, %d", 0, 0xfe0f, 0x9204, F_RD, 1},
+	{AVRDecoder::OP_LAS, "las", "Z, %d", 0, 0xfe0f, 0x9205, F_RD, 1},
+	{AVRDecoder::OP_LAC, "lac", "Z, %d", 0, 0xfe0f, 0x9206, F_RD, 1},
+	{AVRDecoder::OP_LAT, "lat", "Z, %d", 0, 0xfe0f, 0x9207, F_RD, 1},
+	{AVRDecoder::OP_ST_YINC, "st", "Y+, %d", "Y+, Rr", 0xfe0f, 0x9209, F_RD, 1},
+	{AVRDecoder::OP_ST_YDEC, "st", "-Y, %d", "-Y, Rr", 0xfe0f, 0x920a, F_RD, 1},
+	{AVRDecoder::OP_ST_X, "st", "X, %d", "X, Rr", 0xfe0f, 0x920c, F_RD, 1},
+	{AVRDecoder::OP_ST_XINC, "st", "X+, %d", "X+, Rr", 0xfe0f, 0x920d, F_RD, 1},
+	{AVRDecoder::OP_ST_XDEC, "st", "-X, %d", "-X, Rr", 0xfe0f, 0x920e, F_RD, 1},
+	{AVRDecoder::OP_PUSH, "push", "%d", 0, 0xfe0f, 0x920f, F_RD, 1},
+	{AVRDecoder::OP_COM, "com", "%d", 0, 0xfe0f, 0x9400, F_RD, 1},
+	{AVRDecoder::OP_NEG, "neg", "%d", 0, 0xfe0f, 0x9401, F_RD, 1},
+	{AVRDecoder::OP_SWAP, "swap", "%d", 0, 0xfe0f, 0x9402, F_RD, 1},
+	{AVRDecoder::OP_INC, "inc", "%d", 0, 0xfe0f, 0x9403, F_RD, 1},
+	{AVRDecoder::OP_ASR, "asr", "%d", 0, 0xfe0f, 0x9405, F_RD, 1},
+	{AVRDecoder::OP_LSR, "lsr", "%d", 0, 0xfe0f, 0x9406, F_RD, 1},
+	{AVRDecoder::OP_ROR, "ror", "%d", 0, 0xfe0f, 0x9407, F_RD, 1},
+	{AVRDecoder::OP_DEC, "dec", "%d", 0, 0xfe0f, 0x940a, F_RD, 1},
+	{AVRDecoder::OP_BSET, "bset", "%s", 0, 0xff8f, 0x9408, F_SREG, 1},
+	{AVRDecoder::OP_BCLR, "bclr", "%s", 0, 0xff8f, 0x9488, F_SREG, 1},
+	{AVRDecoder::OP_IJMP, "ijmp", "", 0, 0xffff, 0x9409, F_NONE, 1},
+	{AVRDecoder::OP_EIJMP, "eijmp", "", 0, 0xffff, 0x9419, F_NONE, 1},
+	{AVRDecoder::OP_RET, "ret", "", 0, 0xffff, 0x9508, F_NONE, 1},
+	{AVRDecoder::OP_ICALL, "icall", "", 0, 0xffff, 0x9509, F_NONE, 1},
+	{AVRDecoder::OP_EICALL, "eicall", "", 0, 0xffff, 0x9519, F_NONE, 1},
+	{AVRDecoder::OP_RETI, "reti", "", 0, 0xffff, 0x9518, F_NONE, 1},
+	{AVRDecoder::OP_SLEEP, "sleep", "", 0, 0xffff, 0x9588, F_NONE, 1},
+	{AVRDecoder::OP_BREAK, "break", "", 0, 0xffff, 0x9598, F_NONE, 1},
+	{AVRDecoder::OP_WDR, "wdr", "", 0, 0xffff, 0x95a8, F_NONE, 1},
+	{AVRDecoder::OP_LPM, "lpm", "", "", 0xffff, 0x95c8, F_NONE, 1},
+	{AVRDecoder::OP_ELPM, "elpm", "", "", 0xffff, 0x95d8, F_NONE, 1},
+	{AVRDecoder::OP_SPM, "spm", "", "", 0xffff, 0x95e8, F_NONE, 1},
+	{AVRDecoder::OP_SPM_ZINC, "spm", "Z+", "Z+", 0xffff, 0x95f8, F_NONE, 1},
+	{AVRDecoder::OP_DES, "des", "%K", 0, 0xff0f, 0x940b, F_DES, 1},
+	{AVRDecoder::OP_JMP, "jmp", "%j", 0, 0xfe0e, 0x940c, F_JMP, 2},
+	{AVRDecoder::OP_CALL, "call", "%j", 0, 0xfe0e, 0x940e, F_JMP, 2},
+	{AVRDecoder::OP_ADIW, "adiw", "%d, %K", 0, 0xff00, 0x9600, F_ADIW, 1},
+	{AVRDecoder::OP_SBIW, "sbiw", "%d, %K", 0, 0xff00, 0x9700, F_ADIW, 1},
+	{AVRDecoder::OP_CBI, "cbi", "%A, %b", 0, 0xff00, 0x9800, F_IOBIT, 1},
+	{AVRDecoder::OP_SBIC, "sbic", "%A, %b", 0, 0xff00, 0x9900, F_IOBIT, 1},
+	{AVRDecoder::OP_SBI, "sbi", "%A, %b", 0, 0xff00, 0x9a00, F_IOBIT, 1},
+	{AVRDecoder::OP_SBIS, "sbis", "%A, %b", 0, 0xff00, 0x9b00, F_IOBIT, 1},
+	{AVRDecoder::OP_MUL, "mul", "%d, %r", 0, 0xfc00, 0x9c00, F_RDRR, 1},
+	{AVRDecoder::OP_IN, "in", "%d, %A", 0, 0xf800, 0xb000, F_IO, 1},
+	{AVRDecoder::OP_OUT, "out", "%A, %d", 0, 0xf800, 0xb800, F_IO, 1},
+	{AVRDecoder::OP_RJMP, "rjmp", "%o", 0, 0xf000, 0xc000, F_REL12, 1},
+	{AVRDecoder::OP_RCALL, "rcall", "%o", 0, 0xf000, 0xd000, F_REL12, 1},
+	{AVRDecoder::OP_LDI, "ldi", "%d, %K", 0, 0xf000, 0xe000, F_RDK, 1},
+	{AVRDecoder::OP_BRBS, "brbs", "%s, %o", 0, 0xfc00, 0xf000, F_BRANCH, 1},
+	{AVRDecoder::OP_BRBC, "brbc", "%s, %o", 0, 0xfc00, 0xf400, F_BRANCH, 1},
+	{AVRDecoder::OP_BLD, "bld", "%d, %b", 0, 0xfe08, 0xf800, F_REGBIT, 1},
+	{AVRDecoder::OP_BST, "bst", "%d, %b", 0, 0xfe08, 0xfa00, F_REGBIT, 1},
+	{AVRDecoder::OP_SBRC, "sbrc", "%d, %b", 0, 0xfe08, 0xfc00, F_REGBIT, 1},
+	{AVRDecoder::OP_SBRS, "sbrs", "%d, %b", 0, 0xfe08, 0xfe00, F_REGBIT, 1},
+};
+
+static const int nOpcodeDescs = sizeof (opcodeDescs) / sizeof (opcodeDescs[0]);
+
+/* indexed by opcode, filled in by the AVRDecoder constructor */
+static const OpcodeDesc *descForOpcode[AVRDecoder::OP_COUNT];
+
+static const OpcodeDesc unknownDesc = {AVRDecoder::OP_UNKNOWN, ".word", "%k", 0, 0, 0, F_NONE, 1};
+
+/* conditional branch and SREG set/clear aliases, by SREG bit */
+static const char *const brbsNames[8] = { "brcs", "breq", "brmi", "brvs", "brlt", "brhs", "brts", "brie" };
+static const char *const brbcNames[8] = { "brcc", "brne", "brpl", "brvc", "brge", "brhc", "brtc", "brid" };
+static const char *const bsetNames[8] = { "sec", "sez", "sen", "sev", "ses", "seh", "set", "sei" };
+static const char *const bclrNames[8] = { "clc", "clz", "cln", "clv", "cls", "clh", "clt", "cli" };
+/*}}}*/
+
+
+/*{{{  const AVRDecoder &AVRDecoder::instance (void)*/
+/*
+ *	returns the (single, lazily built) decoder.
+ */
+const AVRDecoder &AVRDecoder::instance (void)
+{
+	/* built on first use; a local static, so threads racing to it wait for one construction */
+	static const AVRDecoder decoder;
+
+	return decoder;
+}
+/*}}}*/
+/*{{{  AVRDecoder::AVRDecoder ()*/
+/*
+ *	constructor: generates the 64K decode table from the opcode patterns, least specific pattern
+ *	first so that more specific ones overwrite, and picks up cycle counts from OpcodesInfo.
+ */
+AVRDecoder::AVRDecoder ()
+{
+	QVector<int> order;
+
+	memset (_table, OP_UNKNOWN, sizeof (_table));
+	memset (descForOpcode, 0, sizeof (descForOpcode));
+	descForOpcode[OP_UNKNOWN] = &unknownDesc;
+
+	for (int i=0; i<nOpcodeDescs; i++) {
+		order.append (i);
+	}
+	std::stable_sort (order.begin (), order.end (), [] (int a, int b) {
+		return qPopulationCount (opcodeDescs[a].mask) < qPopulationCount (opcodeDescs[b].mask);
+	});
+
+	for (int i : order) {
+		const OpcodeDesc *desc = &opcodeDescs[i];
+		quint16 freeBits = ~desc->mask;
+		quint16 x = 0;
+
+		/* enumerate every word matching the pattern (all subsets of the don't-care bits) */
+		do {
+			_table[desc->match | x] = desc->op;
+			x = (x - freeBits) & freeBits;
+		} while (x);
+
+		descForOpcode[desc->op] = desc;
+	}
+
+	for (int op=0; op<OP_COUNT; op++) {
+		const OpcodeDesc *desc = descForOpcode[op];
+		const OpcodeInfo *info = 0;
+		int cmin = 1, cmax = 1;
+
+		if (desc && (op != OP_UNKNOWN)) {
+			info = findOpcodeInfo (desc->name, desc->infoParams ? QString (desc->infoParams) : QString ());
+		}
+		if (!info || !opcodeCycles (info->nClocks, &cmin, &cmax)) {
+			cmin = cmax = 1;
+		}
+		_minCycles[op] = cmin;
+		_maxCycles[op] = cmax;
+	}
+}
+/*}}}*/
+
+/*{{{  AVRInstruction AVRDecoder::decode (quint16 w, quint16 next) const*/
+/*
+ *	decodes an instruction; 'next' is the following word (used only by 2-word instructions).
+ */
+AVRInstruction AVRDecoder::decode (quint16 w, quint16 next) const
+{
+	AVRInstruction insn;
+	const OpcodeDesc *desc;
+
+	insn.op = _table[w];
+	desc = descForOpcode[insn.op];
+	insn.words = desc->words;
+	insn.d = 0;
+	insn.r = 0;
+	insn.b = 0;
+	insn.k = 0;
+
+	switch (desc->format) {
+	case F_NONE:
+		if (insn.op == OP_UNKNOWN) {
+			insn.k = w;
+		}
+		break;
+	case F_RDRR:
+		insn.d = (w >> 4) & 0x1f;
+		insn.r = (w & 0x0f) | ((w >> 5) & 0x10);
+		break;
+	case F_RD:
+		insn.d = (w >> 4) & 0x1f;
+		break;
+	case F_RDK:
+		insn.d = 16 + ((w >> 4) & 0x0f);
+		insn.k = (w & 0x0f) | ((w >> 4) & 0xf0);
+		break;
+	case F_MOVW:
+		insn.d = ((w >> 4) & 0x0f) << 1;
+		insn.r = (w & 0x0f) << 1;
+		break;
+	case F_MULS:
+		insn.d = 16 + ((w >> 4) & 0x0f);
+		insn.r = 16 + (w & 0x0f);
+		break;
+	case F_FMUL:
+		insn.d = 16 + ((w >> 4) & 0x07);
+		insn.r = 16 + (w & 0x07);
+		break;
+	case F_LDDQ:
+		insn.d = (w >> 4) & 0x1f;
+		insn.k = (w & 0x07) | ((w >> 7) & 0x18) | ((w >> 8) & 0x20);
+		break;
+	case F_LDS:
+		insn.d = (w >> 4) & 0x1f;
+		insn.k = next;
+		break;
+	case F_ADIW:
+		insn.d = 24 + (((w >> 4) & 0x03) << 1);
+		insn.k = (w & 0x0f) | ((w >> 2) & 0x30);
+		break;
+	case F_IOBIT:
+		insn.k = (w >> 3) & 0x1f;
+		insn.b = w & 0x07;
+		break;
+	case F_IO:
+		insn.d = (w >> 4) & 0x1f;
+		insn.k = (w & 0x0f) | ((w >> 5) & 0x30);
+		break;
+	case F_REL12:
+		insn.k = w & 0x0fff;
+		if (insn.k & 0x0800) {
+			insn.k -= 0x1000;
+		}
+		break;
+	case F_BRANCH:
+		insn.b = w & 0x07;
+		insn.k = (w >> 3) & 0x7f;
+		if (insn.k & 0x40) {
+			insn.k -= 0x80;
+		}
+		break;
+	case F_REGBIT:
+		insn.d = (w >> 4) & 0x1f;
+		insn.b = w & 0x07;
+		break;
+	case F_SREG:
+		insn.b = (w >> 4) & 0x07;
+		break;
+	case F_JMP:
+		insn.k = ((((w >> 3) & 0x3e) | (w & 0x01)) << 16) | next;
+		break;
+	case F_DES:
+		insn.k = (w >> 4) & 0x0f;
+		break;
+	}
+	return insn;
+}
+/*}}}*/
+/*{{{  int AVRDecoder::length (quint16 word) const*/
+/*
+ *	returns the length (in words) of the instruction starting with 'word'.
+ */
+int AVRDecoder::length (quint16 word) const
+{
+	return descForOpcode[_table[word]]->words;
+}
+/*}}}*/
+/*{{{  QString AVRDecoder::mnemonic (Opcode op) const*/
+/*
+ *	returns the base mnemonic for an opcode.
+ */
+QString AVRDecoder::mnemonic (Opcode op) const
+{
+	return QString (descForOpcode[op]->name);
+}
+/*}}}*/
+/*{{{  int AVRDecoder::minCycles (Opcode op) const*/
+/*
+ *	returns the minimum cycle count for an opcode (from OpcodesInfo).
+ */
+int AVRDecoder::minCycles (Opcode op) const
+{
+	return _minCycles[op];
+}
+/*}}}*/
+/*{{{  int AVRDecoder::maxCycles (Opcode op) const*/
+/*
+ *	returns the maximum cycle count for an opcode (from OpcodesInfo).
+ */
+int AVRDecoder::maxCycles (Opcode op) const
+{
+	return _maxCycles[op];
+}
+/*}}}*/
+/*{{{  QString AVRDecoder::format (const AVRInstruction &insn, quint32 address) const*/
+/*
+ *	formats a decoded instruction as assembler text.  'address' is the instruction's word address,
+ *	used for relative targets; addresses are shown as byte addresses.
+ *	Template escapes: %d %r registers, %K immediate, %A I/O address, %b bit, %s SREG bit,
+ *	%q displacement, %m data address, %j absolute target, %o relative target, %k raw word.
+ */
+QString AVRDecoder::format (const AVRInstruction &insn, quint32 address) const
+{
+	const OpcodeDesc *desc = descForOpcode[insn.op];
+	const char *name = desc->name;
+	const char *syntax = desc->syntax;
+	QString out;
+
+	/*{{{  aliases*/
+	switch (insn.op) {
+	case OP_BRBS:
+		name = brbsNames[insn.b];
+		syntax = "%o";
+		break;
+	case OP_BRBC:
+		name = brbcNames[insn.b];
+		syntax = "%o";
+		break;
+	case OP_BSET:
+		name = bsetNames[insn.b];
+		syntax = "";
+		break;
+	case OP_BCLR:
+		name = bclrNames[insn.b];
+		syntax = "";
+		break;
+	case OP_EOR:
+	case OP_AND:
+	case OP_ADD:
+	case OP_ADC:
+		if (insn.d == insn.r) {
+			name = (insn.op == OP_EOR) ? "clr" : (insn.op == OP_AND) ? "tst" : (insn.op == OP_ADD) ? "lsl" : "rol";
+			syntax = "%d";
+		}
+		break;
+	case OP_LDD_Y:
+	case OP_LDD_Z:
+	case OP_STD_Y:
+	case OP_STD_Z:
+		if (insn.k == 0) {
+			static const char *const plain[4] = { "%d, Z", "%d, Y", "Z, %d", "Y, %d" };
+
+			name = ((insn.op == OP_LDD_Y) || (insn.op == OP_LDD_Z)) ? "ld" : "st";
+			syntax = plain[insn.op - OP_LDD_Z];
+		}
+		break;
+	default:
+		break;
+	}
+	/*}}}*/
+
+	out = QString (name).leftJustified (7, ' ');
+	for (const char *p = syntax; *p; p++) {
+		if ((*p != '%') || !p[1]) {
+			out.append (QChar (*p));
+			continue;
+		}
+		p++;
+		switch (*p) {
+		case 'd':
+			out.append (QString ("r%1").arg (insn.d));
+			break;
+		case 'r':
+			out.append (QString ("r%1").arg (insn.r));
+			break;
+		case 'K':
+		case 'A':
+			out.append (QString ("0x%1").arg (insn.k, 2, 16, QChar ('0')));
+			break;
+		case 'b':
+		case 's':
+			out.append (QString::number (insn.b));
+			break;
+		case 'q':
+			out.append (QString::number (insn.k));
+			break;
+		case 'm':
+			out.append (QString ("0x%1").arg (insn.k, 4, 16, QChar ('0')));
+			break;
+		case 'j':
+			out.append (QString ("0x%1").arg ((quint32)insn.k << 1, 4, 16, QChar ('0')));
+			break;
+		case 'o':
+			out.append (QString ("0x%1").arg (((address + 1 + insn.k) << 1) & 0x7fffff, 4, 16, QChar ('0')));
+			break;
+		case 'k':
+			out.append (QString ("0x%1").arg (insn.k, 4, 16, QChar ('0')));
+			break;
+		default:
+			out.append (QChar (*p));
+			break;
+		}
+	}
+	return out.trimmed ();
+}
+/*}}}*/
+
+/*{{{  int AVRDecoder::disassemble (const quint16 *words, int count, quint32 base, QVector<AVRDisassembledInstruction> *out) const*/
+/*
+ *	decodes a run of flash words starting at word address 'base', appending to 'out'.
+ *	Erased words (0xffff) are skipped.
+ *	returns the number of instructions decoded.
+ */
+int AVRDecoder::disassemble (const quint16 *words, int count, quint32 base, QVector<AVRDisassembledInstruction> *out) const
+{
+	int n = 0;
+	int i = 0;
+
+	while (i < count) {
+		AVRDisassembledInstruction d;
+		quint16 w = words[i];
+		quint16 next = (i + 1 < count) ? words[i + 1] : 0xffff;
+
+		if (w == 0xffff) {
+			i++;
+			continue;
+		}
+		d.address = base + i;
+		d.insn = decode (w, next);
+		d.opcode[0] = w;
+		d.opcode[1] = (d.insn.words == 2) ? next : 0;
+		out->append (d);
+		i += d.insn.words;
+		n++;
+	}
+	return n;
+}
+/*}}}*/
+/*{{{  int AVRDecoder::disassemble (const AVRHexImage &image, QVector<AVRDisassembledInstruction> *out) const*/
+/*
+ *	decodes the used parts of a flash image, treating runs of consecutive used pages as one block
+ *	(so that 2-word instructions spanning a page boundary come out right).
+ *	returns the number of instructions decoded.
+ */
+int AVRDecoder::disassemble (const AVRHexImage &image, QVector<AVRDisassembledInstruction> *out) const
+{
+	const quint8 *data = image.data ();
+	QVector<quint16> words;
+	int n = 0;
+	int pg = 0;
+
+	out->reserve (out->size () + (image.extent () / 2));
+	while (pg < image.pageCount ()) {
+		int first, last;
+
+		if (!image.pageUsed (pg)) {
+			pg++;
+			continue;
+		}
+		for (first = pg; (pg < image.pageCount ()) && image.pageUsed (pg); pg++);
+		last = pg;
+
+		/* flash is little-endian words */
+		int start = (first * image.pageSize ()) / 2;
+		int count = ((last - first) * image.pageSize ()) / 2;
+
+		words.resize (count);
+		for (int i=0; i<count; i++) {
+			words[i] = data[(start + i) * 2] | (data[((start + i) * 2) + 1] << 8);
+		}
+		n += disassemble (words.constData (), count, start, out);
+	}
+	return n;
+}
+/*}}}*/
+/*{{{  QString AVRDecoder::listing (const QVector<AVRDisassembledInstruction> &insns) const*/
+/*
+ *	produces a text listing: byte address, instruction words, assembler text and cycle count.
+ */
+QString AVRDecoder::listing (const QVector<AVRDisassembledInstruction> &insns) const
+{
+	QStringList lines;
+	quint32 expect = 0;
+
+	for (int i=0; i<insns.size (); i++) {
+		const AVRDisassembledInstruction &d = insns.at (i);
+		Opcode op = (Opcode)d.insn.op;
+		QString words = QString ("%1").arg (d.opcode[0], 4, 16, QChar ('0'));
+		QString cycles;
+
+		if ((i > 0) && (d.address != expect)) {
+			lines << "          ...";
+		}
+		expect = d.address + d.insn.words;
+
+		if (d.insn.words == 2) {
+			words.append (QString (" %1").arg (d.opcode[1], 4, 16, QChar ('0')));
+		}
+		if (minCycles (op) == maxCycles (op)) {
+			cycles = QString::number (minCycles (op));
+		} else {
+			cycles = QString ("%1-%2").arg (minCycles (op)).arg (maxCycles (op));
+		}
+		lines << QString ("%1:  %2  %3 ; %4")
+			.arg (d.address << 1, 5, 16, QChar ('0'))
+			.arg (words, -9)
+			.arg (format (d.insn, d.address), -24)
+			.arg (cycles);
+	}
+	return lines.join ("\n");
+}
+/*}}}*/
+
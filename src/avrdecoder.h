@@ -0,0 +1,97 @@
+/*
+ *	avrdecoder.h -- table-driven AVR instruction decoder.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRDECODER_H
+#define AVRDECODER_H
+
+#include <QString>
+#include <QVector>
+
+class AVRHexImage;
+
+/* a decoded instruction; which fields mean what depends on the opcode's operand format */
+typedef struct AVRInstruction
+{
+	quint8 op;		/* AVRDecoder::Opcode */
+	quint8 words;		/* 1 or 2 */
+	quint8 d;		/* destination (or only) register */
+	quint8 r;		/* source register */
+	quint8 b;		/* bit number, SREG bit */
+	qint32 k;		/* immediate, I/O or data address, displacement, jump target/offset (words) */
+} AVRInstruction;
+
+/* an instruction placed in flash (for listings) */
+typedef struct AVRDisassembledInstruction
+{
+	quint32 address;	/* word address */
+	quint16 opcode[2];
+	AVRInstruction insn;
+} AVRDisassembledInstruction;
+
+class AVRDecoder
+{
+public:
+	typedef enum Opcode {
+		OP_UNKNOWN = 0,
+		OP_NOP, OP_MOVW, OP_MULS, OP_MULSU, OP_FMUL, OP_FMULS, OP_FMULSU,
+		OP_CPC, OP_SBC, OP_ADD, OP_CPSE, OP_CP, OP_SUB, OP_ADC, OP_AND, OP_EOR, OP_OR, OP_MOV,
+		OP_CPI, OP_SBCI, OP_SUBI, OP_ORI, OP_ANDI,
+		OP_LDD_Z, OP_LDD_Y, OP_STD_Z, OP_STD_Y,
+		OP_LDS, OP_LD_ZINC, OP_LD_ZDEC, OP_LPM_Z, OP_LPM_ZINC, OP_ELPM_Z, OP_ELPM_ZINC,
+		OP_LD_YINC, OP_LD_YDEC, OP_LD_X, OP_LD_XINC, OP_LD_XDEC, OP_POP,
+		OP_STS, OP_ST_ZINC, OP_ST_ZDEC, OP_XCH, OP_LAS, OP_LAC, OP_LAT,
+		OP_ST_YINC, OP_ST_YDEC, OP_ST_X, OP_ST_XINC, OP_ST_XDEC, OP_PUSH,
+		OP_COM, OP_NEG, OP_SWAP, OP_INC, OP_ASR, OP_LSR, OP_ROR, OP_DEC,
+		OP_BSET, OP_BCLR, OP_IJMP, OP_EIJMP, OP_RET, OP_ICALL, OP_EICALL, OP_RETI,
+		OP_SLEEP, OP_BREAK, OP_WDR, OP_LPM, OP_ELPM, OP_SPM, OP_SPM_ZINC, OP_DES,
+		OP_JMP, OP_CALL, OP_ADIW, OP_SBIW, OP_CBI, OP_SBIC, OP_SBI, OP_SBIS, OP_MUL,
+		OP_IN, OP_OUT, OP_RJMP, OP_RCALL, OP_LDI, OP_BRBS, OP_BRBC, OP_BLD, OP_BST, OP_SBRC, OP_SBRS,
+		OP_COUNT
+	} Opcode;
+
+	static const AVRDecoder &instance (void);
+
+	/* the 64K-entry lookup: opcode for any first instruction word */
+	inline Opcode opcode (quint16 word) const
+	{
+		return (Opcode)_table[word];
+	}
+
+	AVRInstruction decode (quint16 word, quint16 next) const;
+	int length (quint16 word) const;
+
+	QString mnemonic (Opcode op) const;
+	int minCycles (Opcode op) const;
+	int maxCycles (Opcode op) const;
+	QString format (const AVRInstruction &insn, quint32 address) const;
+
+	int disassemble (const quint16 *words, int count, quint32 base, QVector<AVRDisassembledInstruction> *out) const;
+	int disassemble (const AVRHexImage &image, QVector<AVRDisassembledInstruction> *out) const;
+	QString listing (const QVector<AVRDisassembledInstruction> &insns) const;
+
+private:
+	AVRDecoder ();
+
+	quint8 _table[65536];
+	quint8 _minCycles[OP_COUNT];
+	quint8 _maxCycles[OP_COUNT];
+};
+
+#endif	/* !AVRDECODER_H */
+
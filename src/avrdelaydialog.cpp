@@ -0,0 +1,190 @@
+/*
+ *	avrdelaydialog.cpp -- asks for a clock rate and delay, and shows the generated loop.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
+#include <QFormLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QRegExp>
+#include <QSet>
+#include <QSettings>
+
+#include "avrdelaydialog.h"
+
+/* units offered, and nanoseconds in each (0 for cycles) */
+static const struct {
+	const char *name;
+	qint64 ns;
+} delayUnits[] = {
+	{"us", 1000LL},
+	{"ns", 1LL},
+	{"ms", 1000000LL},
+	{"cycles", 0LL}
+};
+
+/*{{{  AVRDelayDialog::AVRDelayDialog (const QString &label, QWidget *parent)*/
+/*
+ *	constructor: 'label' is a loop label not already in use.
+ */
+AVRDelayDialog::AVRDelayDialog (const QString &label, QWidget *parent) : QDialog (parent)
+{
+	QSettings settings ("unikent", "avr-asm-ide");
+	QFormLayout *form = new QFormLayout (this);
+	QFont fixed ("Courier 10 Pitch", 10);
+
+	setWindowTitle (tr ("Insert delay loop"));
+
+	_clock = new QLineEdit (settings.value ("delayClock", "16000000").toString ());
+	_delay = new QDoubleSpinBox ();
+	_delay->setDecimals (3);
+	_delay->setRange (0.0, 1e9);
+	_delay->setValue (settings.value ("delayValue", 100.0).toDouble ());
+	_unit = new QComboBox ();
+	for (unsigned int i=0; i<sizeof (delayUnits) / sizeof (delayUnits[0]); i++) {
+		_unit->addItem (delayUnits[i].name);
+	}
+	_unit->setCurrentIndex (settings.value ("delayUnit", 0).toInt ());
+	_registers = new QLineEdit (settings.value ("delayRegisters", "r18, r19, r20").toString ());
+	_label = new QLineEdit (label);
+	_preview = new QPlainTextEdit ();
+	_preview->setReadOnly (true);
+	_preview->setFont (fixed);
+	_summary = new QLabel ();
+	_buttons = new QDialogButtonBox (QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+	_buttons->button (QDialogButtonBox::Ok)->setText (tr ("&Insert"));
+
+	form->addRow (tr ("Clock (Hz):"), _clock);
+	form->addRow (tr ("Delay:"), _delay);
+	form->addRow (tr ("Unit:"), _unit);
+	form->addRow (tr ("Registers (r16-r31):"), _registers);
+	form->addRow (tr ("Loop label:"), _label);
+	form->addRow (_preview);
+	form->addRow (_summary);
+	form->addRow (_buttons);
+
+	connect (_clock, SIGNAL (textChanged (QString)), this, SLOT (regenerate ()));
+	connect (_delay, SIGNAL (valueChanged (double)), this, SLOT (regenerate ()));
+	connect (_unit, SIGNAL (currentIndexChanged (int)), this, SLOT (regenerate ()));
+	connect (_registers, SIGNAL (textChanged (QString)), this, SLOT (regenerate ()));
+	connect (_label, SIGNAL (textChanged (QString)), this, SLOT (regenerate ()));
+	connect (_buttons, SIGNAL (accepted ()), this, SLOT (accept ()));
+	connect (_buttons, SIGNAL (rejected ()), this, SLOT (reject ()));
+	regenerate ();
+}
+/*}}}*/
+/*{{{  QStringList AVRDelayDialog::code (void) const*/
+/*
+ *	returns the generated lines (comment first).
+ */
+QStringList AVRDelayDialog::code (void) const
+{
+	return _code;
+}
+/*}}}*/
+/*{{{  void AVRDelayDialog::accept (void)*/
+/*
+ *	remembers the settings for next time.
+ */
+void AVRDelayDialog::accept (void)
+{
+	QSettings settings ("unikent", "avr-asm-ide");
+
+	settings.setValue ("delayClock", _clock->text ().trimmed ());
+	settings.setValue ("delayValue", _delay->value ());
+	settings.setValue ("delayUnit", _unit->currentIndex ());
+	settings.setValue ("delayRegisters", _registers->text ());
+	QDialog::accept ();
+}
+/*}}}*/
+
+/*{{{  void AVRDelayDialog::regenerate (void)*/
+/*
+ *	works out the cycle count and generates the loop for it.
+ */
+void AVRDelayDialog::regenerate (void)
+{
+	QRegExp regRE ("[rR](1[6-9]|2[0-9]|3[01])");
+	QRegExp labelRE ("[A-Za-z_][A-Za-z0-9_]*");
+	QSet<int> used;
+	QStringList regs = _registers->text ().split (',', QString::SkipEmptyParts);
+	qint64 unitNs = delayUnits[qMax (0, _unit->currentIndex ())].ns;
+	bool ok;
+	qint64 hz = _clock->text ().trimmed ().toLongLong (&ok);
+	qint64 cycles, ns;
+	QString err, label = _label->text ().trimmed ();
+	QStringList out;
+
+	_code.clear ();
+	_buttons->button (QDialogButtonBox::Ok)->setEnabled (false);
+	for (int i=0; i<regs.count (); i++) {
+		regs[i] = regs.at (i).trimmed ();
+		if (!regRE.exactMatch (regs.at (i))) {
+			_preview->clear ();
+			_summary->setText (tr ("\"%1\" is not one of r16-r31").arg (regs.at (i)));
+			return;
+		}
+		if (used.contains (regRE.cap (1).toInt ())) {
+			_preview->clear ();
+			_summary->setText (tr ("%1 is given more than once: each loop level needs its own register").arg (regs.at (i)));
+			return;
+		}
+		used.insert (regRE.cap (1).toInt ());
+	}
+	if (!labelRE.exactMatch (label)) {
+		_preview->clear ();
+		_summary->setText (label.isEmpty () ? tr ("the loop needs a label") : tr ("\"%1\" is not a valid label").arg (label));
+		return;
+	}
+	if (!ok || (hz <= 0)) {
+		_preview->clear ();
+		_summary->setText (tr ("clock rate must be a whole number of Hz"));
+		return;
+	}
+	if (unitNs) {
+		ns = (qint64)(_delay->value () * unitNs + 0.5);
+		cycles = AVRDelayGenerator::cyclesForTime (hz, ns);
+	} else {
+		cycles = (qint64)_delay->value ();
+		ns = (cycles * 1000000000LL) / hz;
+	}
+	if (!_generator.generate (cycles, regs, label, &out, &err)) {
+		_preview->clear ();
+		_summary->setText (err);
+		return;
+	}
+
+	double actual = (cycles * 1e9) / hz;
+	int levels = out.filter (QRegExp ("^\\tldi\\t")).count ();
+	int instrs = out.filter (QRegExp ("^\\t")).count ();
+
+	_code << QString ("\t; delay %1 cycles (%2 ns at %3 Hz)").arg (cycles).arg (actual, 0, 'f', 1).arg (hz);
+	if (levels > 0) {
+		_code.last () += QString (", clobbers %1").arg (QStringList (regs.mid (0, levels)).join (", "));
+	}
+	_code << out;
+	_preview->setPlainText (_code.join ("\n"));
+	_summary->setText (tr ("%1 cycles in %2 instruction(s), %3 ns from the delay asked for").arg (cycles).arg (instrs).arg (actual - ns, 0, 'f', 1));
+	_buttons->button (QDialogButtonBox::Ok)->setEnabled (true);
+}
+/*}}}*/
+
@@ -0,0 +1,68 @@
+/*
+ *	avrdelaydialog.h -- asks for a clock rate and delay, and shows the generated loop.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRDELAYDIALOG_H
+#define AVRDELAYDIALOG_H
+
+#include <QDialog>
+#include <QStringList>
+
+#include "avrdelaygenerator.h"
+
+class QComboBox;
+class QDialogButtonBox;
+class QDoubleSpinBox;
+class QLabel;
+class QLineEdit;
+class QPlainTextEdit;
+
+/*
+ *	The clock rate, registers and label are remembered between uses (QSettings); the code is
+ *	regenerated as the fields change, with the cycle count and any rounding shown underneath.
+ */
+class AVRDelayDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	AVRDelayDialog (const QString &label, QWidget *parent = 0);
+
+	QStringList code (void) const;
+
+public slots:
+	void accept (void);
+
+private slots:
+	void regenerate (void);
+
+private:
+	AVRDelayGenerator _generator;
+	QLineEdit *_clock;
+	QDoubleSpinBox *_delay;
+	QComboBox *_unit;
+	QLineEdit *_registers;
+	QLineEdit *_label;
+	QPlainTextEdit *_preview;
+	QLabel *_summary;
+	QDialogButtonBox *_buttons;
+	QStringList _code;
+};
+
+#endif	/* !AVRDELAYDIALOG_H */
+
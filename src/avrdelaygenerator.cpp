@@ -0,0 +1,205 @@
+/*
+ *	avrdelaygenerator.cpp -- cycle-exact busy-wait loop generator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "avrdelaygenerator.h"
+#include "avrasmprogram.h"
+
+#define MAX_LEVELS 4
+
+/*{{{  AVRDelayGenerator::AVRDelayGenerator ()*/
+/*
+ *	constructor: picks up the costs of the instructions used.
+ */
+AVRDelayGenerator::AVRDelayGenerator ()
+{
+	int lo, hi;
+
+	_ldi = AVRASMProgram::instructionCycles ("ldi", &lo, &hi) ? hi : 1;
+	_dec = AVRASMProgram::instructionCycles ("dec", &lo, &hi) ? hi : 1;
+	_nop = AVRASMProgram::instructionCycles ("nop", &lo, &hi) ? hi : 1;
+	_rjmp = AVRASMProgram::instructionCycles ("rjmp", &lo, &hi) ? hi : 2;
+	if (AVRASMProgram::instructionCycles ("brne", &lo, &hi)) {
+		_notTaken = lo;
+		_taken = hi;
+	} else {
+		_notTaken = 1;
+		_taken = 2;
+	}
+}
+/*}}}*/
+/*{{{  bool AVRDelayGenerator::generate (qint64 cycles, const QStringList &registers, const QString &label, QStringList *out, QString *error) const*/
+/*
+ *	produces the code (one line per entry, tab-indented) for an exact delay, using the given
+ *	registers (r16-r31, outermost first, as many as needed) and label.
+ *	returns true on success, false otherwise (with the reason in 'error').
+ */
+bool AVRDelayGenerator::generate (qint64 cycles, const QStringList &registers, const QString &label, QStringList *out, QString *error) const
+{
+	QVector<int> best;
+	qint64 bestSize = -1;
+	int levels;
+
+	if (cycles < 0) {
+		if (error) {
+			*error = QString ("negative delay");
+		}
+		return false;
+	}
+
+	/*{{{  fewest instructions: padding alone, or 1..n levels and padding*/
+	for (levels=0; (levels<=MAX_LEVELS) && (levels<=registers.count ()); levels++) {
+		QVector<int> counts;
+		qint64 size;
+
+		if (levels == 0) {
+			size = padSize (cycles);
+		} else if (!solve (cycles, levels, &counts)) {
+			continue;
+		} else {
+			size = 3 * levels + padSize (cycles - loopCycles (counts));
+		}
+		if ((bestSize < 0) || (size < bestSize)) {
+			bestSize = size;
+			best = counts;
+		}
+	}
+	if ((bestSize < 0) || (bestSize > 64)) {
+		if (error) {
+			*error = QString ("%1 cycles needs more than %2 loop levels (have %3 register(s))").arg (cycles)
+					.arg (qMin (MAX_LEVELS, registers.count ())).arg (registers.count ());
+		}
+		return false;
+	}
+	/*}}}*/
+
+	levels = best.count ();
+	for (int k=0; k<levels; k++) {
+		*out << QString ("\tldi\t%1, %2").arg (registers.at (k)).arg (best.at (k) & 0xff);
+	}
+	for (int k=levels-1; k>=0; k--) {
+		if (k == levels - 1) {
+			*out << QString ("%1:").arg (label);
+		}
+		*out << QString ("\tdec\t%1").arg (registers.at (k));
+		*out << QString ("\tbrne\t%1").arg (label);
+	}
+	qint64 pad = cycles - loopCycles (best);
+
+	for (; pad >= _rjmp; pad -= _rjmp) {
+		*out << QString ("\trjmp\tpc+1");
+	}
+	for (; pad > 0; pad -= _nop) {
+		*out << QString ("\tnop");
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  qint64 AVRDelayGenerator::loopCycles (const QVector<int> &counts) const*/
+/*
+ *	returns the cycles taken by the ldis and loop for the given counts (1-256, outermost first).
+ */
+qint64 AVRDelayGenerator::loopCycles (const QVector<int> &counts) const
+{
+	if (counts.isEmpty ()) {
+		return 0;
+	}
+	return (qint64)counts.count () * _ldi + levelCycles (counts, 0);
+}
+/*}}}*/
+/*{{{  qint64 AVRDelayGenerator::maxCycles (int levels) const*/
+/*
+ *	returns the longest delay a number of levels can make (all counts 256).
+ */
+qint64 AVRDelayGenerator::maxCycles (int levels) const
+{
+	return loopCycles (QVector<int> (levels, 256));
+}
+/*}}}*/
+/*{{{  qint64 AVRDelayGenerator::padSize (qint64 cycles) const*/
+/*
+ *	returns the instructions needed to pad out a number of cycles: rjmp pc+1 for each pair, and a
+ *	nop for any left over.
+ */
+qint64 AVRDelayGenerator::padSize (qint64 cycles) const
+{
+	return (cycles / _rjmp) + ((cycles % _rjmp) / _nop);
+}
+/*}}}*/
+/*{{{  qint64 AVRDelayGenerator::cyclesForTime (qint64 hz, qint64 ns)*/
+/*
+ *	converts a time to the nearest whole number of cycles at a clock rate.  Whole seconds and the
+ *	nanoseconds left over are scaled separately, since hz * ns overflows past ten minutes or so.
+ */
+qint64 AVRDelayGenerator::cyclesForTime (qint64 hz, qint64 ns)
+{
+	return hz * (ns / 1000000000LL) + (hz * (ns % 1000000000LL) + 500000000LL) / 1000000000LL;
+}
+/*}}}*/
+
+/*{{{  bool AVRDelayGenerator::solve (qint64 cycles, int levels, QVector<int> *counts) const*/
+/*
+ *	finds the counts for a number of levels that come closest to 'cycles' without going over,
+ *	largest outermost count first (adding one to a count is worth more than any lower counts can
+ *	make up, so this is the best).
+ *	returns true if the loop fits at all (the rest is padded), false otherwise.
+ */
+bool AVRDelayGenerator::solve (qint64 cycles, int levels, QVector<int> *counts) const
+{
+	counts->fill (1, levels);
+	if (loopCycles (*counts) > cycles) {
+		return false;
+	}
+	for (int k=0; k<levels; k++) {
+		int lo = 1, hi = 256;
+
+		/* largest count at this level that still fits, lower levels at 1 */
+		while (lo < hi) {
+			int mid = (lo + hi + 1) / 2;
+
+			(*counts)[k] = mid;
+			if (loopCycles (*counts) <= cycles) {
+				lo = mid;
+			} else {
+				hi = mid - 1;
+			}
+		}
+		(*counts)[k] = lo;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  qint64 AVRDelayGenerator::levelCycles (const QVector<int> &counts, int level) const*/
+/*
+ *	returns the cycles from the loop label until the brne of 'level' falls through, starting with
+ *	the given counts: the levels inside run down from their counts first, then go round a full
+ *	256 each time this level's count is not yet done.
+ */
+qint64 AVRDelayGenerator::levelCycles (const QVector<int> &counts, int level) const
+{
+	qint64 inner = 0, full = 0;
+	qint64 x = counts.at (level);
+
+	if (level + 1 < counts.count ()) {
+		inner = levelCycles (counts, level + 1);
+		full = levelCycles (QVector<int> (counts.count (), 256), level + 1);
+	}
+	return inner + x * _dec + (x - 1) * (_taken + full) + _notTaken;
+}
+/*}}}*/
+
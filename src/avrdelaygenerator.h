@@ -0,0 +1,68 @@
+/*
+ *	avrdelaygenerator.h -- cycle-exact busy-wait loop generator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRDELAYGENERATOR_H
+#define AVRDELAYGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+ *	Generates the usual nested countdown:
+ *
+ *		ldi	r18, c1		; one ldi per level, outermost first
+ *		ldi	r19, c2
+ *	label:	dec	r19		; innermost
+ *		brne	label
+ *		dec	r18
+ *		brne	label
+ *
+ *	followed by rjmp pc+1 (two cycles in one word) and nop to make up the exact count.  When an
+ *	inner register runs out the outer one is decremented and the inner goes round a full 256 more
+ *	times, so the total is a mixed-radix number in the counts; the largest that fits is found one
+ *	level at a time, using the fewest instructions (levels and padding) that reach the target.
+ *	Costs come from the instruction timing table.
+ */
+class AVRDelayGenerator
+{
+public:
+	AVRDelayGenerator ();
+
+	bool generate (qint64 cycles, const QStringList &registers, const QString &label, QStringList *out, QString *error = 0) const;
+	qint64 loopCycles (const QVector<int> &counts) const;
+	qint64 maxCycles (int levels) const;
+
+	static qint64 cyclesForTime (qint64 hz, qint64 ns);
+
+private:
+	bool solve (qint64 cycles, int levels, QVector<int> *counts) const;
+	qint64 levelCycles (const QVector<int> &counts, int level) const;
+	qint64 padSize (qint64 cycles) const;
+
+	int _ldi;
+	int _dec;
+	int _taken;		/* brne back to the label */
+	int _notTaken;
+	int _nop;
+	int _rjmp;		/* rjmp .+0, for padding */
+};
+
+#endif	/* !AVRDELAYGENERATOR_H */
+
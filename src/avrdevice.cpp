@@ -0,0 +1,53 @@
+/*
+ *	avrdevice.cpp -- memory layout of the AVR parts we know about.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "avrdevice.h"
+
+const QList<AVRDeviceInfo> AVRDevices = {
+	//  Name          ; Aliases                                   ; Flash  ; Page ; SRAM start ; SRAM ; EEPROM ; EPage ; Vectors ; VSize ; JMP  ; MUL  ; MOVW
+	{"ATMEGA328P", {"atmega328p", "atmega328", "m328p", "m328"}, 32768, 128, 0x100, 2048, 1024, 4, 26, 2, true, true, true},
+	{"ATMEGA168", {"atmega168", "atmega168p", "m168", "m168p"}, 16384, 128, 0x100, 1024, 512, 4, 26, 2, true, true, true},
+	{"ATMEGA88", {"atmega88", "atmega88p", "m88", "m88p"}, 8192, 64, 0x100, 1024, 512, 4, 26, 1, false, true, true},
+	{"ATMEGA8", {"atmega8", "m8"}, 8192, 64, 0x60, 1024, 512, 4, 19, 1, false, true, true},
+	{"ATMEGA32U4", {"atmega32u4", "m32u4"}, 32768, 128, 0x100, 2560, 1024, 4, 43, 2, true, true, true},
+	{"ATMEGA1280", {"atmega1280", "m1280"}, 131072, 256, 0x200, 8192, 4096, 8, 57, 2, true, true, true},
+	{"ATMEGA2560", {"atmega2560", "m2560"}, 262144, 256, 0x200, 8192, 4096, 8, 57, 2, true, true, true},
+	{"ATTINY85", {"attiny85", "t85"}, 8192, 64, 0x60, 512, 512, 4, 15, 1, false, false, true},
+};
+
+/*{{{  const AVRDeviceInfo *findAVRDevice (const QString &name)*/
+/*
+ *	finds a device by (case-insensitive) name or alias.
+ *	returns a pointer into AVRDevices, or NULL if not known.
+ */
+const AVRDeviceInfo *findAVRDevice (const QString &name)
+{
+	QString lname = name.trimmed ().toLower ();
+
+	for (int i=0; i<AVRDevices.count (); i++) {
+		const AVRDeviceInfo &dev = AVRDevices.at (i);
+
+		if ((dev.name.toLower () == lname) || dev.aliases.contains (lname)) {
+			return &dev;
+		}
+	}
+	return 0;
+}
+/*}}}*/
+
@@ -0,0 +1,49 @@
+/*
+ *	avrdevice.h -- memory layout of the AVR parts we know about.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRDEVICE_H
+#define AVRDEVICE_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+typedef struct AVRDeviceInfo
+{
+	QString name;			/* as given to avrdude's -p, upper-case */
+	QStringList aliases;		/* other names (nocc .mcu strings, avrdude short names) */
+	int flashSize;			/* bytes */
+	int flashPageSize;		/* bytes */
+	int sramStart;			/* data-space address of first SRAM byte */
+	int sramSize;			/* bytes */
+	int eepromSize;			/* bytes */
+	int eepromPageSize;		/* bytes */
+	int vectorCount;		/* interrupt vectors, including reset */
+	int vectorSize;			/* words per vector slot */
+	bool hasJmp;			/* JMP/CALL available */
+	bool hasMul;			/* MUL family available */
+	bool hasMovw;			/* MOVW available */
+} AVRDeviceInfo;
+
+extern const QList<AVRDeviceInfo> AVRDevices;
+
+const AVRDeviceInfo *findAVRDevice (const QString &name);
+
+#endif	/* !AVRDEVICE_H */
+
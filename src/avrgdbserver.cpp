@@ -0,0 +1,623 @@
+/*
+ *	avrgdbserver.cpp -- GDB remote serial protocol stub for the simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "avrgdbserver.h"
+
+/* where avr-gdb puts the data space and EEPROM in its one address space (flash is at 0) */
+#define GDB_DATA_BASE		0x800000
+#define GDB_EEPROM_BASE		0x810000
+
+/* signals in stop replies */
+#define GDB_SIGINT		2
+#define GDB_SIGILL		4
+#define GDB_SIGTRAP		5
+
+/* registers: r0-r31, SREG, SP (2 bytes), PC (4 bytes, byte address) */
+#define GDB_REG_SREG		32
+#define GDB_REG_SP		33
+#define GDB_REG_PC		34
+#define GDB_REG_BYTES		39
+
+/* cycles run between returns to the event loop while continuing */
+#define GDB_SLICE_CYCLES	1000000
+
+/*{{{  static bool parseHex (const QByteArray &text, quint32 *value)*/
+/*
+ *	parses a hex number.
+ *	returns true on success, false otherwise.
+ */
+static bool parseHex (const QByteArray &text, quint32 *value)
+{
+	bool ok;
+
+	*value = text.toUInt (&ok, 16);
+	return ok && !text.isEmpty ();
+}
+/*}}}*/
+/*{{{  static bool parseRange (const QByteArray &text, quint32 *addr, quint32 *len)*/
+/*
+ *	parses the "ADDR,LEN" that memory and breakpoint packets start with.
+ *	returns true on success, false otherwise.
+ */
+static bool parseRange (const QByteArray &text, quint32 *addr, quint32 *len)
+{
+	int comma = text.indexOf (',');
+
+	return (comma > 0) && parseHex (text.left (comma), addr) && parseHex (text.mid (comma + 1), len);
+}
+/*}}}*/
+/*{{{  static int stopSignal (AVRSimulator::StopReason reason)*/
+/*
+ *	returns the signal gdb is told the core stopped with.
+ */
+static int stopSignal (AVRSimulator::StopReason reason)
+{
+	return (reason == AVRSimulator::STOP_INVALID) ? GDB_SIGILL : GDB_SIGTRAP;
+}
+/*}}}*/
+
+/*{{{  AVRGdbServer::AVRGdbServer (AVRSimulator *sim, QObject *parent)*/
+/*
+ *	constructor: takes the simulator over; nothing happens until listen().
+ */
+AVRGdbServer::AVRGdbServer (AVRSimulator *sim, QObject *parent) : QObject (parent)
+{
+	_sim = sim;
+	_server = new QTcpServer (this);
+	_slice = new QTimer (this);
+	_slice->setSingleShot (true);
+	_client = 0;
+	_lastStop = "S05";
+	_noAck = false;
+	_running = false;
+	connect (_server, SIGNAL (newConnection ()), this, SLOT (newConnection ()));
+	connect (_slice, SIGNAL (timeout ()), this, SLOT (runSlice ()));
+}
+/*}}}*/
+/*{{{  AVRGdbServer::~AVRGdbServer ()*/
+/*
+ *	destructor: drops any client and the simulator.
+ */
+AVRGdbServer::~AVRGdbServer ()
+{
+	if (_client) {
+		_client->disconnect (this);
+		_client->abort ();
+	}
+	delete _sim;
+}
+/*}}}*/
+/*{{{  bool AVRGdbServer::listen (quint16 port, QString *error)*/
+/*
+ *	starts listening for gdb on a loopback port (0 for any free one).
+ *	returns true on success, false otherwise (with the reason in 'error').
+ */
+bool AVRGdbServer::listen (quint16 port, QString *error)
+{
+	if (!_server->listen (QHostAddress::LocalHost, port)) {
+		if (error) {
+			*error = QString ("cannot listen on port %1: %2").arg (port).arg (_server->errorString ());
+		}
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  quint16 AVRGdbServer::port (void) const*/
+/*
+ *	returns the port listened on.
+ */
+quint16 AVRGdbServer::port (void) const
+{
+	return _server->serverPort ();
+}
+/*}}}*/
+/*{{{  bool AVRGdbServer::isConnected (void) const*/
+/*
+ *	returns true if gdb is attached.
+ */
+bool AVRGdbServer::isConnected (void) const
+{
+	return (_client != 0);
+}
+/*}}}*/
+/*{{{  AVRSimulator *AVRGdbServer::simulator (void) const*/
+/*
+ *	returns the simulator being debugged.
+ */
+AVRSimulator *AVRGdbServer::simulator (void) const
+{
+	return _sim;
+}
+/*}}}*/
+
+/*{{{  void AVRGdbServer::newConnection (void)*/
+/*
+ *	called when gdb connects: a second client while one is attached is turned away.
+ */
+void AVRGdbServer::newConnection (void)
+{
+	while (_server->hasPendingConnections ()) {
+		QTcpSocket *s = _server->nextPendingConnection ();
+
+		if (_client) {
+			s->close ();
+			s->deleteLater ();
+			continue;
+		}
+		_client = s;
+		_in.clear ();
+		_lastPacket.clear ();
+		_noAck = false;
+		connect (_client, SIGNAL (readyRead ()), this, SLOT (readClient ()));
+		connect (_client, SIGNAL (disconnected ()), this, SLOT (clientGone ()));
+		emit message (QString ("gdb attached on port %1").arg (port ()));
+	}
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::readClient (void)*/
+/*
+ *	called when data arrives: acknowledges and handles each complete packet, and stops a continue
+ *	on ^C.
+ */
+void AVRGdbServer::readClient (void)
+{
+	_in.append (_client->readAll ());
+	while (_client && !_in.isEmpty ()) {
+		char ch = _in.at (0);
+		int hash;
+		quint8 sum = 0;
+		quint32 check;
+		QByteArray body;
+
+		if (ch != '$') {
+			_in.remove (0, 1);
+			if ((ch == 0x03) && _running) {
+				_running = false;
+				_slice->stop ();
+				stopped (GDB_SIGINT);
+			} else if ((ch == '-') && !_lastPacket.isEmpty ()) {
+				_client->write (_lastPacket);
+			}
+			continue;
+		}
+		hash = _in.indexOf ('#');
+		if ((hash < 0) || (_in.count () < hash + 3)) {
+			/* rest of the packet still to come */
+			break;
+		}
+		body = _in.mid (1, hash - 1);
+		for (int i=0; i<body.count (); i++) {
+			sum += (quint8)body.at (i);
+		}
+		if (!parseHex (_in.mid (hash + 1, 2), &check) || (check != sum)) {
+			_in.remove (0, hash + 3);
+			if (!_noAck) {
+				_client->write ("-");
+			}
+			continue;
+		}
+		_in.remove (0, hash + 3);
+		if (!_noAck) {
+			_client->write ("+");
+		}
+		handle (body);
+	}
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::clientGone (void)*/
+/*
+ *	called when gdb goes away: anything it left set is cleared, and the core left where it is.
+ */
+void AVRGdbServer::clientGone (void)
+{
+	_client->deleteLater ();
+	_client = 0;
+	_running = false;
+	_slice->stop ();
+	_sim->clearBreakpoints ();
+	_sim->clearWatchpoints ();
+	emit message (QString ("gdb detached"));
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::runSlice (void)*/
+/*
+ *	runs a slice of a continue, queueing the next one unless the core stopped.
+ */
+void AVRGdbServer::runSlice (void)
+{
+	AVRSimulator::StopReason r;
+
+	if (!_running) {
+		return;
+	}
+	r = _sim->run (GDB_SLICE_CYCLES);
+	if (r == AVRSimulator::STOP_LIMIT) {
+		_slice->start (0);
+		return;
+	}
+	_running = false;
+	if (r == AVRSimulator::STOP_SLEEP) {
+		emit message (QString ("simulator %1 at cycle %2").arg (AVRSimulator::stopReasonName (r)).arg (_sim->cycles ()));
+	}
+	stopped (stopSignal (r));
+}
+/*}}}*/
+
+/*{{{  void AVRGdbServer::handle (const QByteArray &cmd)*/
+/*
+ *	handles a packet (without its framing), replying unless it resumes the core.  Anything not
+ *	supported gets the empty reply.
+ */
+void AVRGdbServer::handle (const QByteArray &cmd)
+{
+	quint32 addr, len, n;
+	int colon = cmd.indexOf (':');
+	int sep;
+	QByteArray data;
+
+	if (cmd.isEmpty ()) {
+		send ("");
+		return;
+	}
+	switch (cmd.at (0)) {
+	case '?':
+		send (_lastStop);
+		break;
+	case 'g':
+		send (registers ().toHex ());
+		break;
+	case 'G':
+		data = QByteArray::fromHex (cmd.mid (1));
+		if (data.count () < GDB_REG_BYTES) {
+			send ("E01");
+			break;
+		}
+		for (int r=0; r<=GDB_REG_PC; r++) {
+			int at = (r <= GDB_REG_SP) ? r : (GDB_REG_SP + 2);
+
+			setRegister (r, data.mid (at, (r < GDB_REG_SP) ? 1 : (r == GDB_REG_SP) ? 2 : 4));
+		}
+		send ("OK");
+		break;
+	case 'p':
+		if (!parseHex (cmd.mid (1), &n) || (n > GDB_REG_PC)) {
+			send ("E01");
+		} else if (n < GDB_REG_SP) {
+			send (registers ().mid (n, 1).toHex ());
+		} else {
+			send (registers ().mid ((n == GDB_REG_SP) ? n : (n + 1), (n == GDB_REG_SP) ? 2 : 4).toHex ());
+		}
+		break;
+	case 'P':
+		sep = cmd.indexOf ('=');
+		if ((sep < 0) || !parseHex (cmd.mid (1, sep - 1), &n) || !setRegister (n, QByteArray::fromHex (cmd.mid (sep + 1)))) {
+			send ("E01");
+		} else {
+			send ("OK");
+		}
+		break;
+	case 'm':
+		if (!parseRange (cmd.mid (1), &addr, &len) || (data = readMemory (addr, len)).isEmpty ()) {
+			send ("E01");
+		} else {
+			send (data.toHex ());
+		}
+		break;
+	case 'M':
+	case 'X':
+		if ((colon < 0) || !parseRange (cmd.mid (1, colon - 1), &addr, &len)) {
+			send ("E01");
+			break;
+		}
+		if (cmd.at (0) == 'M') {
+			data = QByteArray::fromHex (cmd.mid (colon + 1));
+		} else {
+			/* binary, with '#', '$', '}' and '*' escaped as '}' then the byte xor 0x20 */
+			for (int i=colon+1; i<cmd.count (); i++) {
+				if ((cmd.at (i) == '}') && (i + 1 < cmd.count ())) {
+					data.append ((char)(cmd.at (++i) ^ 0x20));
+				} else {
+					data.append (cmd.at (i));
+				}
+			}
+		}
+		if (((quint32)data.count () != len) || !writeMemory (addr, data)) {
+			send ("E01");
+		} else {
+			send ("OK");
+		}
+		break;
+	case 'c':
+	case 's':
+		if ((cmd.count () > 1) && parseHex (cmd.mid (1), &addr)) {
+			_sim->setPC (addr >> 1);
+		}
+		resume (cmd.at (0) == 's');
+		break;
+	case 'C':
+	case 'S':
+		/* the signal is ignored: there is nothing to deliver it to */
+		sep = cmd.indexOf (';');
+		if ((sep > 0) && parseHex (cmd.mid (sep + 1), &addr)) {
+			_sim->setPC (addr >> 1);
+		}
+		resume (cmd.at (0) == 'S');
+		break;
+	case 'Z':
+	case 'z':
+		data = cmd.mid (1);
+		if ((data.count () < 3) || (data.at (1) != ',') || (data.at (0) < '0') || (data.at (0) > '4')) {
+			send ("");
+		} else if (!parseRange (data.mid (2), &addr, &len) || !setPoint (data.at (0) - '0', addr, len, cmd.at (0) == 'Z')) {
+			send ("E01");
+		} else {
+			send ("OK");
+		}
+		break;
+	case 'H':
+	case 'T':
+		/* one thread */
+		send ("OK");
+		break;
+	case 'k':
+		/* no reply: gdb is about to drop the connection */
+		_running = false;
+		_sim->reset ();
+		break;
+	case 'D':
+		_running = false;
+		send ("OK");
+		_client->disconnectFromHost ();
+		break;
+	case 'q':
+	case 'Q':
+	case 'v':
+		query (cmd);
+		break;
+	default:
+		send ("");
+		break;
+	}
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::query (const QByteArray &cmd)*/
+/*
+ *	handles the general query and set packets (q, Q) and the v packets gdb uses here.
+ */
+void AVRGdbServer::query (const QByteArray &cmd)
+{
+	if (cmd.startsWith ("qSupported")) {
+		send ("PacketSize=4000;QStartNoAckMode+");
+	} else if (cmd == "QStartNoAckMode") {
+		send ("OK");
+		_noAck = true;
+	} else if (cmd == "qAttached") {
+		send ("1");
+	} else if (cmd == "qfThreadInfo") {
+		send ("m1");
+	} else if (cmd == "qsThreadInfo") {
+		send ("l");
+	} else if (cmd == "qC") {
+		send ("QC1");
+	} else if (cmd == "qSymbol::") {
+		send ("OK");
+	} else if (cmd.startsWith ("qRcmd,")) {
+		/* "monitor ..." */
+		QByteArray line = QByteArray::fromHex (cmd.mid (6)).trimmed ();
+		QByteArray text;
+
+		if (line == "reset") {
+			_sim->reset ();
+			_lastStop = "S05";
+		} else if (line == "cycles") {
+			text = QString ("%1 cycles, %2 instructions\n").arg (_sim->cycles ()).arg (_sim->instructions ()).toLatin1 ();
+		} else {
+			text = "monitor commands: reset, cycles\n";
+		}
+		if (!text.isEmpty ()) {
+			send ("O" + text.toHex ());
+		}
+		send ("OK");
+	} else if (cmd == "vCont?") {
+		send ("vCont;c;C;s;S");
+	} else if (cmd.startsWith ("vCont;")) {
+		char action = (cmd.count () > 6) ? cmd.at (6) : 'c';
+
+		resume ((action == 's') || (action == 'S'));
+	} else {
+		send ("");
+	}
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::send (const QByteArray &body)*/
+/*
+ *	sends a packet, keeping it in case gdb asks for it again.
+ */
+void AVRGdbServer::send (const QByteArray &body)
+{
+	quint8 sum = 0;
+
+	for (int i=0; i<body.count (); i++) {
+		sum += (quint8)body.at (i);
+	}
+	_lastPacket = "$" + body + "#" + QByteArray::number (sum, 16).rightJustified (2, '0');
+	if (_client) {
+		_client->write (_lastPacket);
+	}
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::stopped (int signal)*/
+/*
+ *	tells gdb the core has stopped (with the address for a watchpoint).
+ */
+void AVRGdbServer::stopped (int signal)
+{
+	if ((signal == GDB_SIGTRAP) && (_sim->stopReason () == AVRSimulator::STOP_WATCHPOINT)) {
+		_lastStop = QString ("T%1%2:%3;").arg (signal, 2, 16, QChar ('0'))
+				.arg ((_sim->watchKind () == AVRSimulator::WATCH_READ) ? "rwatch" : "watch")
+				.arg (GDB_DATA_BASE + _sim->watchAddress (), 0, 16).toLatin1 ();
+	} else {
+		_lastStop = QString ("S%1").arg (signal, 2, 16, QChar ('0')).toLatin1 ();
+	}
+	send (_lastStop);
+}
+/*}}}*/
+/*{{{  void AVRGdbServer::resume (bool step)*/
+/*
+ *	single-steps (replying at once), or starts a continue that replies when the core stops.
+ */
+void AVRGdbServer::resume (bool step)
+{
+	if (step) {
+		stopped (stopSignal (_sim->step ()));
+		return;
+	}
+	_running = true;
+	_slice->start (0);
+}
+/*}}}*/
+/*{{{  QByteArray AVRGdbServer::registers (void) const*/
+/*
+ *	returns the registers as the 'g' packet lays them out (multi-byte ones little-endian).
+ */
+QByteArray AVRGdbServer::registers (void) const
+{
+	QByteArray r;
+	quint32 pc = _sim->pc () * 2;
+
+	for (int i=0; i<32; i++) {
+		r.append ((char)_sim->reg (i));
+	}
+	r.append ((char)_sim->sreg ());
+	r.append ((char)(_sim->sp () & 0xff));
+	r.append ((char)(_sim->sp () >> 8));
+	for (int i=0; i<4; i++) {
+		r.append ((char)(pc >> (8 * i)));
+	}
+	return r;
+}
+/*}}}*/
+/*{{{  bool AVRGdbServer::setRegister (int n, const QByteArray &bytes)*/
+/*
+ *	sets a register in gdb's numbering from its little-endian bytes.
+ *	returns true on success, false otherwise.
+ */
+bool AVRGdbServer::setRegister (int n, const QByteArray &bytes)
+{
+	quint32 v = 0;
+
+	if ((n < 0) || (n > GDB_REG_PC) || bytes.isEmpty () || (bytes.count () > 4)) {
+		return false;
+	}
+	for (int i=bytes.count ()-1; i>=0; i--) {
+		v = (v << 8) | (quint8)bytes.at (i);
+	}
+	if (n < GDB_REG_SREG) {
+		_sim->setReg (n, v);
+	} else if (n == GDB_REG_SREG) {
+		_sim->setDataAt (AVRSimulator::IO_SREG, v);
+	} else if (n == GDB_REG_SP) {
+		_sim->setDataAt (AVRSimulator::IO_SPL, v & 0xff);
+		_sim->setDataAt (AVRSimulator::IO_SPH, (v >> 8) & 0xff);
+	} else {
+		_sim->setPC (v >> 1);
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  QByteArray AVRGdbServer::readMemory (quint32 addr, int len) const*/
+/*
+ *	reads from gdb's address space, stopping at the end of the memory the address is in.
+ *	returns the bytes read, none if the address is not in any.
+ */
+QByteArray AVRGdbServer::readMemory (quint32 addr, int len) const
+{
+	QByteArray r;
+	quint32 flashBytes = _sim->device ().flashSize;
+	quint32 dataBytes = _sim->dataSize ();
+	quint32 eepromBytes = _sim->device ().eepromSize;
+
+	for (int i=0; i<len; i++, addr++) {
+		if (addr < flashBytes) {
+			quint16 w = _sim->flashWord (addr >> 1);
+
+			r.append ((char)((addr & 1) ? (w >> 8) : (w & 0xff)));
+		} else if ((addr >= GDB_DATA_BASE) && (addr - GDB_DATA_BASE < dataBytes)) {
+			r.append ((char)_sim->dataAt (addr - GDB_DATA_BASE));
+		} else if ((addr >= GDB_EEPROM_BASE) && (addr - GDB_EEPROM_BASE < eepromBytes)) {
+			r.append ((char)_sim->eepromAt (addr - GDB_EEPROM_BASE));
+		} else {
+			break;
+		}
+	}
+	return r;
+}
+/*}}}*/
+/*{{{  bool AVRGdbServer::writeMemory (quint32 addr, const QByteArray &bytes)*/
+/*
+ *	writes to gdb's address space: flash (as "load" does), the data space (without I/O side
+ *	effects) or EEPROM.
+ *	returns true on success, false if the range is not all in one of them.
+ */
+bool AVRGdbServer::writeMemory (quint32 addr, const QByteArray &bytes)
+{
+	quint32 len = bytes.count ();
+
+	if ((addr + len) <= (quint32)_sim->device ().flashSize) {
+		_sim->writeFlash (addr, bytes);
+	} else if ((addr >= GDB_DATA_BASE) && (addr + len <= GDB_DATA_BASE + _sim->dataSize ())) {
+		for (quint32 i=0; i<len; i++) {
+			_sim->setDataAt (addr - GDB_DATA_BASE + i, bytes.at (i));
+		}
+	} else if ((addr >= GDB_EEPROM_BASE) && (addr + len <= GDB_EEPROM_BASE + _sim->device ().eepromSize)) {
+		for (quint32 i=0; i<len; i++) {
+			_sim->setEepromAt (addr - GDB_EEPROM_BASE + i, bytes.at (i));
+		}
+	} else {
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRGdbServer::setPoint (int type, quint32 addr, int len, bool on)*/
+/*
+ *	sets or clears a Z packet's breakpoint (0 software, 1 hardware: the same here, at a flash
+ *	byte address) or watchpoint (2 write, 3 read, 4 access, at a data-space address).
+ *	returns true on success, false otherwise.
+ */
+bool AVRGdbServer::setPoint (int type, quint32 addr, int len, bool on)
+{
+	static const int kinds[] = {AVRSimulator::WATCH_WRITE, AVRSimulator::WATCH_READ, AVRSimulator::WATCH_READ | AVRSimulator::WATCH_WRITE};
+
+	if (type < 2) {
+		return (addr < GDB_DATA_BASE) && _sim->setBreakpoint (addr >> 1, on);
+	}
+	if ((addr < GDB_DATA_BASE) || (addr >= GDB_EEPROM_BASE)) {
+		return false;
+	}
+	return _sim->setWatchpoint (addr - GDB_DATA_BASE, len, kinds[type - 2], on);
+}
+/*}}}*/
+
@@ -0,0 +1,89 @@
+/*
+ *	avrgdbserver.h -- GDB remote serial protocol stub for the simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRGDBSERVER_H
+#define AVRGDBSERVER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include "avrsimulator.h"
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+/*
+ *	Lets avr-gdb ("target remote localhost:PORT") drive a simulator of its own: registers as
+ *	avr-gdb numbers them (r0-r31, SREG, SP, PC as a byte address), memory in its address spaces
+ *	(flash from 0, the data space from 0x800000, EEPROM from 0x810000), software breakpoints and
+ *	write/read/access watchpoints (Z0-Z4), single step and continue.  One client at a time, on the
+ *	loopback interface only.
+ *
+ *	A continue runs in slices from the event loop, so the GUI stays live and a ^C from gdb stops
+ *	the core between slices.
+ */
+class AVRGdbServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit AVRGdbServer (AVRSimulator *sim, QObject *parent = 0);
+	~AVRGdbServer ();
+
+	bool listen (quint16 port, QString *error = 0);
+	quint16 port (void) const;
+	bool isConnected (void) const;
+	AVRSimulator *simulator (void) const;
+
+signals:
+	void message (QString);
+
+private slots:
+	void newConnection (void);
+	void readClient (void);
+	void clientGone (void);
+	void runSlice (void);
+
+private:
+	void handle (const QByteArray &cmd);
+	void query (const QByteArray &cmd);
+	void send (const QByteArray &body);
+	void stopped (int signal);
+	void resume (bool step);
+	QByteArray registers (void) const;
+	bool setRegister (int n, const QByteArray &bytes);
+	QByteArray readMemory (quint32 addr, int len) const;
+	bool writeMemory (quint32 addr, const QByteArray &bytes);
+	bool setPoint (int type, quint32 addr, int len, bool on);
+
+	AVRSimulator *_sim;		/* owned */
+	QTcpServer *_server;
+	QTcpSocket *_client;		/* 0 when no one is attached */
+	QTimer *_slice;			/* fires runSlice() while continuing */
+	QByteArray _in;			/* received, not yet handled */
+	QByteArray _lastPacket;		/* for a resend */
+	QByteArray _lastStop;		/* answer to '?' */
+	bool _noAck;
+	bool _running;			/* continuing */
+};
+
+#endif	/* !AVRGDBSERVER_H */
+
@@ -0,0 +1,563 @@
+/*
+ *	avrheximage.cpp -- Intel HEX reader/writer for flash and EEPROM images.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include <QFile>
+#include <QIODevice>
+
+#include "avrheximage.h"
+
+/* size of the fixed read buffer used when the input can't be memory-mapped */
+#define HEX_READ_CHUNK 65536
+
+/* longest possible record: ':' + 2*(1+2+1+255+1) hex digits, plus slack for line endings */
+#define HEX_MAX_RECORD 528
+
+
+/*{{{  static hex-digit lookup*/
+static signed char hexDigitTable[256];
+
+static struct HexDigitTableInit {
+	HexDigitTableInit ()
+	{
+		memset (hexDigitTable, -1, sizeof (hexDigitTable));
+		for (int i=0; i<10; i++) {
+			hexDigitTable['0' + i] = i;
+		}
+		for (int i=0; i<6; i++) {
+			hexDigitTable['a' + i] = 10 + i;
+			hexDigitTable['A' + i] = 10 + i;
+		}
+	}
+} hexDigitTableInit;
+
+static inline int hexByte (const char *p)
+{
+	int hi = hexDigitTable[(unsigned char)p[0]];
+	int lo = hexDigitTable[(unsigned char)p[1]];
+
+	if ((hi | lo) < 0) {
+		return -1;
+	}
+	return (hi << 4) | lo;
+}
+
+static const char hexDigits[] = "0123456789ABCDEF";
+/*}}}*/
+
+
+/*{{{  AVRHexImage::AVRHexImage (int size, int pageSize, quint8 fill)*/
+/*
+ *	constructor: image of 'size' bytes (rounded up to whole pages).
+ */
+AVRHexImage::AVRHexImage (int size, int pageSize, quint8 fill)
+{
+	reset (size, pageSize, fill);
+}
+/*}}}*/
+/*{{{  void AVRHexImage::reset (int size, int pageSize, quint8 fill)*/
+/*
+ *	re-sizes the image and clears it.
+ */
+void AVRHexImage::reset (int size, int pageSize, quint8 fill)
+{
+	if (pageSize <= 0) {
+		pageSize = 128;
+	}
+	_pageSize = pageSize;
+	_fill = fill;
+	_data.resize (((size + pageSize - 1) / pageSize) * pageSize);
+	_used.resize (_data.size () / pageSize);
+	clear ();
+}
+/*}}}*/
+/*{{{  void AVRHexImage::clear (void)*/
+/*
+ *	fills the image with the fill byte and marks all pages unused.
+ */
+void AVRHexImage::clear (void)
+{
+	_data.fill ((char)_fill);
+	_used.fill (0);
+	_extent = 0;
+	_base = 0;
+	_lineNo = 0;
+	_seenEnd = false;
+}
+/*}}}*/
+
+/*{{{  bool AVRHexImage::load (const QString &fileName, QString *error)*/
+/*
+ *	loads an Intel HEX file into the image (cleared first).  The file is memory-mapped if possible.
+ *	returns true on success, false otherwise.
+ */
+bool AVRHexImage::load (const QString &fileName, QString *error)
+{
+	QFile file (fileName);
+
+	if (!file.open (QIODevice::ReadOnly)) {
+		if (error) {
+			*error = QString ("cannot open %1: %2").arg (fileName).arg (file.errorString ());
+		}
+		return false;
+	}
+	if (file.size () > 0) {
+		uchar *map = file.map (0, file.size ());
+
+		if (map) {
+			bool r;
+
+			clear ();
+			r = parse ((const char *)map, file.size (), error);
+			file.unmap (map);
+			return r;
+		}
+	}
+	return read (&file, error);
+}
+/*}}}*/
+/*{{{  bool AVRHexImage::read (QIODevice *dev, QString *error)*/
+/*
+ *	reads Intel HEX from a device into the image (cleared first), through a fixed-size buffer.
+ *	returns true on success, false otherwise.
+ */
+bool AVRHexImage::read (QIODevice *dev, QString *error)
+{
+	QByteArray chunk (HEX_READ_CHUNK + HEX_MAX_RECORD, 0);
+	char *buffer = chunk.data ();
+	qint64 carry = 0;
+
+	clear ();
+	for (;;) {
+		qint64 got = dev->read (buffer + carry, HEX_READ_CHUNK);
+		qint64 avail, done;
+
+		if (got < 0) {
+			if (error) {
+				*error = dev->errorString ();
+			}
+			return false;
+		}
+		avail = carry + got;
+		if (got == 0) {
+			/* end of input: whatever is left is the last line */
+			return parse (buffer, avail, error);
+		}
+
+		/* parse up to the last complete line, keep the rest for next time */
+		for (done = avail; (done > 0) && (buffer[done - 1] != '\n'); done--);
+		if (done == 0) {
+			if (avail >= HEX_MAX_RECORD) {
+				if (error) {
+					*error = QString ("line %1: record too long").arg (_lineNo + 1);
+				}
+				return false;
+			}
+			carry = avail;
+			continue;
+		}
+		if (!parse (buffer, done, error)) {
+			return false;
+		}
+		carry = avail - done;
+		if (carry >= HEX_MAX_RECORD) {
+			if (error) {
+				*error = QString ("line %1: record too long").arg (_lineNo + 1);
+			}
+			return false;
+		}
+		memmove (buffer, buffer + done, carry);
+	}
+}
+/*}}}*/
+/*{{{  bool AVRHexImage::parse (const char *text, qint64 length, QString *error)*/
+/*
+ *	parses a block of Intel HEX text into the image.  May be called repeatedly on consecutive
+ *	blocks as long as each one ends on a line boundary (state is kept between calls).
+ *	returns true on success, false otherwise.
+ */
+bool AVRHexImage::parse (const char *text, qint64 length, QString *error)
+{
+	const char *p = text;
+	const char *end = text + length;
+
+	while (p < end) {
+		const char *eol = (const char *)memchr (p, '\n', end - p);
+		const char *lend;
+
+		if (!eol) {
+			eol = end;
+		}
+		_lineNo++;
+		for (lend = eol; (lend > p) && ((lend[-1] == '\r') || (lend[-1] == ' ') || (lend[-1] == '\t')); lend--);
+		if (lend > p) {
+			if (_seenEnd) {
+				/* avrdude and friends ignore anything after the end record, so do we */
+				return true;
+			}
+			if (!parseRecord (p, lend - p, error)) {
+				return false;
+			}
+		}
+		p = eol + 1;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRHexImage::parseRecord (const char *rec, int len, QString *error)*/
+/*
+ *	parses a single record (without line ending).
+ *	returns true on success, false otherwise.
+ */
+bool AVRHexImage::parseRecord (const char *rec, int len, QString *error)
+{
+	int count, addr, type, sum, i;
+	quint8 bytes[255];
+
+	if ((rec[0] != ':') || (len < 11)) {
+		if (error) {
+			*error = QString ("line %1: not an Intel HEX record").arg (_lineNo);
+		}
+		return false;
+	}
+	count = hexByte (rec + 1);
+	if ((count < 0) || (len < 11 + (count * 2))) {
+		if (error) {
+			*error = QString ("line %1: truncated record").arg (_lineNo);
+		}
+		return false;
+	}
+
+	/* checksum covers count, address, type, data and the checksum byte itself */
+	sum = 0;
+	for (i=0; i<count+5; i++) {
+		int b = hexByte (rec + 1 + (i * 2));
+
+		if (b < 0) {
+			if (error) {
+				*error = QString ("line %1: bad hex digit").arg (_lineNo);
+			}
+			return false;
+		}
+		if ((i >= 4) && (i < count + 4)) {
+			bytes[i - 4] = (quint8)b;
+		}
+		sum += b;
+	}
+	if (sum & 0xff) {
+		if (error) {
+			*error = QString ("line %1: checksum mismatch").arg (_lineNo);
+		}
+		return false;
+	}
+
+	addr = (hexByte (rec + 3) << 8) | hexByte (rec + 5);
+	type = hexByte (rec + 7);
+
+	switch (type) {
+	case 0x00:		/* data */
+		{
+			quint32 abs = _base + addr;
+
+			if (abs + count > (quint32)_data.size ()) {
+				if (error) {
+					*error = QString ("line %1: data at 0x%2 beyond end of %3 byte image").arg (_lineNo)
+						.arg (abs, 0, 16).arg (_data.size ());
+				}
+				return false;
+			}
+			memcpy (_data.data () + abs, bytes, count);
+			markUsed (abs, count);
+		}
+		break;
+	case 0x01:		/* end of file */
+		_seenEnd = true;
+		break;
+	case 0x02:		/* extended segment address */
+		if (count != 2) {
+			break;
+		}
+		_base = ((bytes[0] << 8) | bytes[1]) << 4;
+		break;
+	case 0x04:		/* extended linear address */
+		if (count != 2) {
+			break;
+		}
+		_base = ((bytes[0] << 8) | bytes[1]) << 16;
+		break;
+	case 0x03:		/* start segment address */
+	case 0x05:		/* start linear address */
+		/* meaningless for AVR, ignore */
+		break;
+	default:
+		if (error) {
+			*error = QString ("line %1: unknown record type %2").arg (_lineNo).arg (type);
+		}
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRHexImage::markUsed (int addr, int count)*/
+/*
+ *	marks the pages covering [addr, addr+count) as used.
+ */
+void AVRHexImage::markUsed (int addr, int count)
+{
+	if (count <= 0) {
+		return;
+	}
+	for (int pg = addr / _pageSize; pg <= (addr + count - 1) / _pageSize; pg++) {
+		_used[pg] = 1;
+	}
+	if (addr + count > _extent) {
+		_extent = addr + count;
+	}
+}
+/*}}}*/
+
+/*{{{  bool AVRHexImage::save (const QString &fileName, QString *error) const*/
+/*
+ *	writes the image out to an Intel HEX file.
+ *	returns true on success, false otherwise.
+ */
+bool AVRHexImage::save (const QString &fileName, QString *error) const
+{
+	QFile file (fileName);
+
+	if (!file.open (QIODevice::WriteOnly | QIODevice::Truncate)) {
+		if (error) {
+			*error = QString ("cannot write %1: %2").arg (fileName).arg (file.errorString ());
+		}
+		return false;
+	}
+	if (!write (&file)) {
+		if (error) {
+			*error = file.errorString ();
+		}
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRHexImage::write (QIODevice *dev) const*/
+/*
+ *	writes the used pages of the image as Intel HEX (16 bytes per record, rows that are
+ *	entirely fill skipped), with extended linear address records above 64K.
+ *	returns true on success, false otherwise.
+ */
+bool AVRHexImage::write (QIODevice *dev) const
+{
+	QByteArray out;
+	quint32 upper = 0;
+	const quint8 *data = (const quint8 *)_data.constData ();
+
+	out.reserve (usedPages () * (_pageSize / 16) * 44 + 16);
+
+	for (int pg=0; pg<_used.size (); pg++) {
+		if (!_used.at (pg)) {
+			continue;
+		}
+		for (int row = pg * _pageSize; row < (pg + 1) * _pageSize; row += 16) {
+			int n = qMin (16, (pg + 1) * _pageSize - row);
+			char rec[HEX_MAX_RECORD];
+			int len = 0;
+			int sum;
+			int i;
+
+			for (i=0; (i<n) && (data[row + i] == _fill); i++);
+			if (i == n) {
+				continue;
+			}
+			if (((quint32)row >> 16) != upper) {
+				/* extended linear address record */
+				upper = (quint32)row >> 16;
+				sum = 0x02 + 0x04 + ((upper >> 8) & 0xff) + (upper & 0xff);
+				out.append (QString (":02000004%1%2\n").arg (upper, 4, 16, QChar ('0')).arg ((-sum) & 0xff, 2, 16, QChar ('0'))
+						.toUpper ().toLatin1 ());
+			}
+
+			sum = n + ((row >> 8) & 0xff) + (row & 0xff);
+			rec[len++] = ':';
+			rec[len++] = hexDigits[n >> 4];
+			rec[len++] = hexDigits[n & 0xf];
+			rec[len++] = hexDigits[(row >> 12) & 0xf];
+			rec[len++] = hexDigits[(row >> 8) & 0xf];
+			rec[len++] = hexDigits[(row >> 4) & 0xf];
+			rec[len++] = hexDigits[row & 0xf];
+			rec[len++] = '0';
+			rec[len++] = '0';
+			for (i=0; i<n; i++) {
+				quint8 b = data[row + i];
+
+				rec[len++] = hexDigits[b >> 4];
+				rec[len++] = hexDigits[b & 0xf];
+				sum += b;
+			}
+			sum = (-sum) & 0xff;
+			rec[len++] = hexDigits[sum >> 4];
+			rec[len++] = hexDigits[sum & 0xf];
+			rec[len++] = '\n';
+			out.append (rec, len);
+		}
+	}
+	out.append (":00000001FF\n");
+
+	return dev->write (out) == out.size ();
+}
+/*}}}*/
+
+/*{{{  int AVRHexImage::size (void) const*/
+/*
+ *	returns the image size in bytes (a whole number of pages).
+ */
+int AVRHexImage::size (void) const
+{
+	return _data.size ();
+}
+/*}}}*/
+/*{{{  int AVRHexImage::pageSize (void) const*/
+/*
+ *	returns the page size in bytes.
+ */
+int AVRHexImage::pageSize (void) const
+{
+	return _pageSize;
+}
+/*}}}*/
+/*{{{  int AVRHexImage::pageCount (void) const*/
+/*
+ *	returns the number of pages in the image.
+ */
+int AVRHexImage::pageCount (void) const
+{
+	return _used.size ();
+}
+/*}}}*/
+/*{{{  bool AVRHexImage::pageUsed (int page) const*/
+/*
+ *	true if any data was loaded into the given page.
+ */
+bool AVRHexImage::pageUsed (int page) const
+{
+	return (page >= 0) && (page < _used.size ()) && _used.at (page);
+}
+/*}}}*/
+/*{{{  int AVRHexImage::usedPages (void) const*/
+/*
+ *	returns the number of pages that hold data.
+ */
+int AVRHexImage::usedPages (void) const
+{
+	return _used.count ((char)1);
+}
+/*}}}*/
+/*{{{  int AVRHexImage::extent (void) const*/
+/*
+ *	returns one past the highest address holding data (0 if empty).
+ */
+int AVRHexImage::extent (void) const
+{
+	return _extent;
+}
+/*}}}*/
+/*{{{  bool AVRHexImage::isEmpty (void) const*/
+/*
+ *	true if nothing has been loaded.
+ */
+bool AVRHexImage::isEmpty (void) const
+{
+	return _extent == 0;
+}
+/*}}}*/
+/*{{{  const quint8 *AVRHexImage::data (void) const*/
+/*
+ *	returns the raw image bytes.
+ */
+const quint8 *AVRHexImage::data (void) const
+{
+	return (const quint8 *)_data.constData ();
+}
+/*}}}*/
+/*{{{  quint8 AVRHexImage::byteAt (int addr) const*/
+/*
+ *	returns a single byte (fill value if out of range).
+ */
+quint8 AVRHexImage::byteAt (int addr) const
+{
+	if ((addr < 0) || (addr >= _data.size ())) {
+		return _fill;
+	}
+	return (quint8)_data.at (addr);
+}
+/*}}}*/
+/*{{{  quint16 AVRHexImage::wordAt (int wordAddr) const*/
+/*
+ *	returns a little-endian 16-bit word at a word address (as for flash).
+ */
+quint16 AVRHexImage::wordAt (int wordAddr) const
+{
+	return byteAt (wordAddr * 2) | (byteAt ((wordAddr * 2) + 1) << 8);
+}
+/*}}}*/
+/*{{{  void AVRHexImage::setBytes (int addr, const quint8 *bytes, int count)*/
+/*
+ *	stores bytes into the image (clipped to its size), marking pages used.
+ */
+void AVRHexImage::setBytes (int addr, const quint8 *bytes, int count)
+{
+	if ((addr < 0) || (addr >= _data.size ())) {
+		return;
+	}
+	count = qMin (count, _data.size () - addr);
+	memcpy (_data.data () + addr, bytes, count);
+	markUsed (addr, count);
+}
+/*}}}*/
+/*{{{  int AVRHexImage::diff (const AVRHexImage &other, QVector<int> *pages) const*/
+/*
+ *	compares two images of the same geometry page-by-page (only pages used in either).
+ *	returns the number of pages that differ (filling in their numbers if 'pages' is given),
+ *	or -1 if the images aren't comparable.
+ */
+int AVRHexImage::diff (const AVRHexImage &other, QVector<int> *pages) const
+{
+	const char *a = _data.constData ();
+	const char *b = other._data.constData ();
+	int count = 0;
+
+	if ((other._pageSize != _pageSize) || (other._data.size () != _data.size ())) {
+		return -1;
+	}
+	for (int pg=0; pg<_used.size (); pg++) {
+		if (!_used.at (pg) && !other._used.at (pg)) {
+			continue;
+		}
+		if (memcmp (a + (pg * _pageSize), b + (pg * _pageSize), _pageSize)) {
+			count++;
+			if (pages) {
+				pages->append (pg);
+			}
+		}
+	}
+	return count;
+}
+/*}}}*/
+
@@ -0,0 +1,80 @@
+/*
+ *	avrheximage.h -- Intel HEX reader/writer for flash and EEPROM images.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRHEXIMAGE_H
+#define AVRHEXIMAGE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+/*
+ *	A memory image (flash or EEPROM) held in one buffer, allocated up-front and rounded up to a
+ *	whole number of pages, with a per-page "used" flag.  Parsing works in place on the input text
+ *	(memory-mapped file or fixed-size read buffer), so there are no per-record allocations.
+ */
+class AVRHexImage
+{
+public:
+	explicit AVRHexImage (int size = 0, int pageSize = 128, quint8 fill = 0xff);
+
+	void reset (int size, int pageSize, quint8 fill = 0xff);
+	void clear (void);
+
+	bool load (const QString &fileName, QString *error = 0);
+	bool read (QIODevice *dev, QString *error = 0);
+	bool parse (const char *text, qint64 length, QString *error = 0);
+	bool save (const QString &fileName, QString *error = 0) const;
+	bool write (QIODevice *dev) const;
+
+	int size (void) const;
+	int pageSize (void) const;
+	int pageCount (void) const;
+	bool pageUsed (int page) const;
+	int usedPages (void) const;
+	int extent (void) const;
+	bool isEmpty (void) const;
+
+	const quint8 *data (void) const;
+	quint8 byteAt (int addr) const;
+	quint16 wordAt (int wordAddr) const;
+	void setBytes (int addr, const quint8 *bytes, int count);
+
+	int diff (const AVRHexImage &other, QVector<int> *pages = 0) const;
+
+private:
+	bool parseRecord (const char *rec, int len, QString *error);
+	void markUsed (int addr, int count);
+
+	QByteArray _data;
+	QByteArray _used;		/* one flag per page */
+	int _pageSize;
+	quint8 _fill;
+	int _extent;			/* one past the highest byte written */
+
+	/* parse state */
+	quint32 _base;
+	int _lineNo;
+	bool _seenEnd;
+};
+
+#endif	/* !AVRHEXIMAGE_H */
+
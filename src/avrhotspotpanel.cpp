@@ -0,0 +1,133 @@
+/*
+ *	avrhotspotpanel.cpp -- sortable table of the lines a simulation spent its cycles on.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QHeaderView>
+#include <QLabel>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+#include "avrhotspotpanel.h"
+#include "avrprofiler.h"
+
+/* rows shown at most (the rest are cold anyway) */
+#define MAX_ROWS	500
+
+enum {
+	COL_CYCLES = 0,
+	COL_SHARE,
+	COL_EXECUTIONS,
+	COL_LINE,
+	COL_ADDRESS,
+	COL_SOURCE,
+	COL_COUNT
+};
+
+/*{{{  AVRHotSpotPanel::AVRHotSpotPanel (QWidget *parent)*/
+/*
+ *	constructor: empty until a profile is set.
+ */
+AVRHotSpotPanel::AVRHotSpotPanel (QWidget *parent) : QWidget (parent)
+{
+	QVBoxLayout *vbox = new QVBoxLayout (this);
+
+	_summary = new QLabel (tr ("Turn on profiling and run the simulator to see where the cycles go."));
+	_summary->setWordWrap (true);
+	_table = new QTableWidget (0, COL_COUNT);
+	_table->setHorizontalHeaderLabels (QStringList () << tr ("Cycles") << tr ("%") << tr ("Executions")
+			<< tr ("Line") << tr ("Address") << tr ("Source"));
+	_table->setEditTriggers (QAbstractItemView::NoEditTriggers);
+	_table->setSelectionBehavior (QAbstractItemView::SelectRows);
+	_table->verticalHeader ()->hide ();
+	_table->horizontalHeader ()->setStretchLastSection (true);
+
+	vbox->addWidget (_summary);
+	vbox->addWidget (_table);
+
+	connect (_table, SIGNAL (cellDoubleClicked (int, int)), this, SLOT (cellActivated (int, int)));
+}
+/*}}}*/
+/*{{{  void AVRHotSpotPanel::setProfile (const AVRProfiler &profile, const QStringList &source)*/
+/*
+ *	fills the table from a profile; 'source' is the main file's text, one entry per line.
+ */
+void AVRHotSpotPanel::setProfile (const AVRProfiler &profile, const QStringList &source)
+{
+	const QVector<AVRProfiler::Line> &lines = profile.lines ();
+	int rows = qMin (lines.count (), MAX_ROWS);
+	double total = qMax ((quint64)1, profile.totalCycles ());
+
+	_table->setSortingEnabled (false);
+	_table->setRowCount (rows);
+	for (int i=0; i<rows; i++) {
+		const AVRProfiler::Line &l = lines.at (i);
+		QTableWidgetItem *item;
+
+		item = new QTableWidgetItem ();
+		item->setData (Qt::DisplayRole, (qulonglong)l.cycles);
+		_table->setItem (i, COL_CYCLES, item);
+		item = new QTableWidgetItem ();
+		item->setData (Qt::DisplayRole, QString::number (100.0 * l.cycles / total, 'f', 1).toDouble ());
+		_table->setItem (i, COL_SHARE, item);
+		item = new QTableWidgetItem ();
+		item->setData (Qt::DisplayRole, (qulonglong)l.executions);
+		_table->setItem (i, COL_EXECUTIONS, item);
+		item = new QTableWidgetItem ();
+		if (l.line >= 0) {
+			item->setData (Qt::DisplayRole, l.line + 1);
+		}
+		item->setData (Qt::UserRole, l.line);
+		_table->setItem (i, COL_LINE, item);
+		_table->setItem (i, COL_ADDRESS, new QTableWidgetItem (QString ("0x%1").arg (l.address, 5, 16, QChar ('0'))));
+		_table->setItem (i, COL_SOURCE, new QTableWidgetItem (((l.line >= 0) && (l.line < source.count ()))
+				? source.at (l.line).trimmed () : QString ("(no source line)")));
+	}
+	_table->setSortingEnabled (true);
+	_table->sortByColumn (COL_CYCLES, Qt::DescendingOrder);
+	_table->resizeColumnsToContents ();
+
+	_summary->setText (tr ("%1 cycles over %2 line(s)%3").arg (profile.totalCycles ()).arg (lines.count ())
+			.arg ((lines.count () > rows) ? tr (", hottest %1 shown").arg (rows) : QString ()));
+}
+/*}}}*/
+/*{{{  void AVRHotSpotPanel::clear (void)*/
+/*
+ *	empties the table.
+ */
+void AVRHotSpotPanel::clear (void)
+{
+	_table->setRowCount (0);
+	_summary->setText (tr ("No profile."));
+}
+/*}}}*/
+
+/*{{{  void AVRHotSpotPanel::cellActivated (int row, int column)*/
+/*
+ *	double-click: asks for the row's line to be shown.
+ */
+void AVRHotSpotPanel::cellActivated (int row, int column)
+{
+	QTableWidgetItem *item = _table->item (row, COL_LINE);
+
+	Q_UNUSED (column);
+	if (item && (item->data (Qt::UserRole).toInt () >= 0)) {
+		emit lineActivated (item->data (Qt::UserRole).toInt ());
+	}
+}
+/*}}}*/
+
@@ -0,0 +1,56 @@
+/*
+ *	avrhotspotpanel.h -- sortable table of the lines a simulation spent its cycles on.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRHOTSPOTPANEL_H
+#define AVRHOTSPOTPANEL_H
+
+#include <QStringList>
+#include <QWidget>
+
+class AVRProfiler;
+class QLabel;
+class QTableWidget;
+
+/*
+ *	One row per line that ran: cycles, share of the total, executions, line, address and source.
+ *	Clicking a column header sorts by it; double-clicking a row asks for the line to be shown.
+ */
+class AVRHotSpotPanel : public QWidget
+{
+	Q_OBJECT
+
+public:
+	AVRHotSpotPanel (QWidget *parent = 0);
+
+	void setProfile (const AVRProfiler &profile, const QStringList &source);
+	void clear (void);
+
+signals:
+	void lineActivated (int);
+
+private slots:
+	void cellActivated (int row, int column);
+
+private:
+	QTableWidget *_table;
+	QLabel *_summary;
+};
+
+#endif	/* !AVRHOTSPOTPANEL_H */
+
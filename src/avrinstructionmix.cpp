@@ -0,0 +1,370 @@
+/*
+ *	avrinstructionmix.cpp -- instruction class mix and most-used opcodes.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSaveFile>
+#include <QSet>
+#include <QStringList>
+
+#include "avrinstructionmix.h"
+#include "avrasmflow.h"
+#include "avrasmprogram.h"
+#include "avrdevice.h"
+
+/* names for the classes, as used in the reports */
+static const char *classNames[AVRInstructionMix::CLASS_COUNT] = {"alu", "branch", "load_store", "io", "other"};
+
+/*{{{  AVRInstructionMix::AVRInstructionMix (const AVRASMFlow &flow, const AVRDeviceInfo *device)*/
+/*
+ *	constructor: counts everything in the graph's program ('device', if known, gives the vectors).
+ */
+AVRInstructionMix::AVRInstructionMix (const AVRASMFlow &flow, const AVRDeviceInfo *device)
+{
+	const AVRASMProgram &program = flow.program ();
+	const QVector<AVRASMFlow::Node> &nodes = flow.nodes ();
+	const QVector<AVRASMProgram::Line> &lines = program.lines ();
+	QHash<qint32, QString> labels;
+	QMap<qint32, int> entries;		/* function start address -> index into _functions */
+	QSet<int> starts;
+
+	clearMix (_total, "total");
+	for (const QString &f : program.files ()) {
+		Mix m;
+
+		clearMix (m, QFileInfo (f).fileName ());
+		_files << m;
+	}
+
+	/*{{{  functions: reset, handlers and call targets*/
+	for (const AVRASMProgram::Symbol &sym : program.symbols ()) {
+		if (sym.section == AVRASMProgram::TEXT) {
+			labels.insert (sym.address, sym.name);
+		}
+	}
+	if (device) {
+		for (int n : flow.vectorEntries (*device)) {
+			if (n >= 0) {
+				starts << n;
+			}
+		}
+	}
+	if (flow.nodeAt (0) >= 0) {
+		starts << flow.nodeAt (0);
+	}
+	for (const AVRASMFlow::Node &node : nodes) {
+		if ((node.kind == AVRASMFlow::CALL) && (node.target >= 0)) {
+			starts << node.target;
+		}
+	}
+	for (int n : starts) {
+		qint32 addr = nodes.at (n).address;
+
+		entries.insert (addr, 0);
+	}
+	for (QMap<qint32, int>::iterator it = entries.begin (); it != entries.end (); ++it) {
+		Mix m;
+
+		clearMix (m, labels.value (it.key (), QString ("0x%1").arg (it.key (), 4, 16, QChar ('0'))));
+		it.value () = _functions.count ();
+		_functions << m;
+	}
+	/*}}}*/
+	/*{{{  count*/
+	for (const AVRASMFlow::Node &node : nodes) {
+		const AVRASMProgram::Line &l = lines.at (node.index);
+		QMap<qint32, int>::const_iterator it = entries.upperBound (node.address);
+
+		if (l.kind != AVRASMProgram::INSTRUCTION) {
+			continue;
+		}
+		addInstruction (_total, node.mnemonic, node.size, node.minCycles, node.maxCycles);
+		addInstruction (_files[l.file], node.mnemonic, node.size, node.minCycles, node.maxCycles);
+		if (it != entries.constBegin ()) {
+			--it;
+			addInstruction (_functions[it.value ()], node.mnemonic, node.size, node.minCycles, node.maxCycles);
+		}
+	}
+	/*}}}*/
+
+	/* only keep files and functions with instructions in */
+	for (int i=_files.count () - 1; i>=0; i--) {
+		if (!_files.at (i).instructions) {
+			_files.removeAt (i);
+		}
+	}
+	for (int i=_functions.count () - 1; i>=0; i--) {
+		if (!_functions.at (i).instructions) {
+			_functions.removeAt (i);
+		}
+	}
+}
+/*}}}*/
+/*{{{  const QList<AVRInstructionMix::Mix> &AVRInstructionMix::files (void) const*/
+/*
+ *	returns the mix for each source file (with instructions in), in include order.
+ */
+const QList<AVRInstructionMix::Mix> &AVRInstructionMix::files (void) const
+{
+	return _files;
+}
+/*}}}*/
+/*{{{  const QList<AVRInstructionMix::Mix> &AVRInstructionMix::functions (void) const*/
+/*
+ *	returns the mix for each function, in address order.
+ */
+const QList<AVRInstructionMix::Mix> &AVRInstructionMix::functions (void) const
+{
+	return _functions;
+}
+/*}}}*/
+/*{{{  const AVRInstructionMix::Mix &AVRInstructionMix::total (void) const*/
+/*
+ *	returns the mix for the whole program.
+ */
+const AVRInstructionMix::Mix &AVRInstructionMix::total (void) const
+{
+	return _total;
+}
+/*}}}*/
+/*{{{  QString AVRInstructionMix::report (int top) const*/
+/*
+ *	produces a readable summary: the whole program with its 'top' most-used opcodes, then a line for
+ *	each file and function.
+ */
+QString AVRInstructionMix::report (int top) const
+{
+	QString str;
+	auto line = [] (const Mix &m) -> QString {
+		QString s = QString ("%1 instruction(s), %2 bytes, %3-%4 cycles each on average;").arg (m.instructions).arg (m.bytes)
+				.arg (m.instructions ? ((double)m.minCycles / m.instructions) : 0.0, 0, 'f', 2)
+				.arg (m.instructions ? ((double)m.maxCycles / m.instructions) : 0.0, 0, 'f', 2);
+
+		for (int c=0; c<CLASS_COUNT; c++) {
+			s += QString (" %1 %2%").arg (className ((InstructionClass)c)).arg (m.instructions ? ((100.0 * m.classes[c]) / m.instructions) : 0.0, 0, 'f', 1);
+		}
+		return s;
+	};
+	QStringList tops;
+
+	for (const QPair<QString, int> &op : topOpcodes (_total, top)) {
+		tops << QString ("%1 (%2)").arg (op.first).arg (op.second);
+	}
+	str += QString ("instruction mix: %1\n").arg (line (_total));
+	str += QString ("  most used: %1\n").arg (tops.isEmpty () ? QString ("none") : tops.join (", "));
+	for (const Mix &m : _files) {
+		str += QString ("  file %1: %2\n").arg (m.name).arg (line (m));
+	}
+	for (const Mix &m : _functions) {
+		str += QString ("  function %1: %2\n").arg (m.name).arg (line (m));
+	}
+	return str;
+}
+/*}}}*/
+/*{{{  QString AVRInstructionMix::csvReport (void) const*/
+/*
+ *	produces one CSV row for the whole program, each file and each function (with its five most
+ *	used opcodes), for spreadsheets.
+ */
+QString AVRInstructionMix::csvReport (void) const
+{
+	QString str ("scope,name,instructions,bytes,avg_min_cycles,avg_max_cycles");
+	auto row = [] (const QString &scope, const Mix &m) -> QString {
+		QString name = m.name;
+		QStringList tops;
+		QString s;
+
+		name.replace ("\"", "\"\"");
+		s = QString ("%1,\"%2\",%3,%4,%5,%6").arg (scope).arg (name).arg (m.instructions).arg (m.bytes)
+				.arg (m.instructions ? ((double)m.minCycles / m.instructions) : 0.0, 0, 'f', 3)
+				.arg (m.instructions ? ((double)m.maxCycles / m.instructions) : 0.0, 0, 'f', 3);
+		for (int c=0; c<CLASS_COUNT; c++) {
+			s += QString (",%1").arg (m.classes[c]);
+		}
+		for (const QPair<QString, int> &op : topOpcodes (m, 5)) {
+			tops << QString ("%1 %2").arg (op.first).arg (op.second);
+		}
+		return s + QString (",%1\n").arg (tops.join (";"));
+	};
+
+	for (int c=0; c<CLASS_COUNT; c++) {
+		str += QString (",%1").arg (className ((InstructionClass)c));
+	}
+	str += ",top_opcodes\n";
+	str += row ("total", _total);
+	for (const Mix &m : _files) {
+		str += row ("file", m);
+	}
+	for (const Mix &m : _functions) {
+		str += row ("function", m);
+	}
+	return str;
+}
+/*}}}*/
+/*{{{  QString AVRInstructionMix::jsonReport (void) const*/
+/*
+ *	produces the full counts (every opcode) as JSON, for scripts.
+ */
+QString AVRInstructionMix::jsonReport (void) const
+{
+	QJsonObject top;
+	QJsonArray files, functions;
+	auto object = [] (const Mix &m) -> QJsonObject {
+		QJsonObject o, classes, opcodes;
+
+		o["name"] = m.name;
+		o["instructions"] = m.instructions;
+		o["bytes"] = m.bytes;
+		o["minCycles"] = (double)m.minCycles;
+		o["maxCycles"] = (double)m.maxCycles;
+		for (int c=0; c<CLASS_COUNT; c++) {
+			classes[className ((InstructionClass)c)] = m.classes[c];
+		}
+		o["classes"] = classes;
+		for (QHash<QString, int>::const_iterator it = m.opcodes.constBegin (); it != m.opcodes.constEnd (); ++it) {
+			opcodes[it.key ()] = it.value ();
+		}
+		o["opcodes"] = opcodes;
+		return o;
+	};
+
+	for (const Mix &m : _files) {
+		files.append (object (m));
+	}
+	for (const Mix &m : _functions) {
+		functions.append (object (m));
+	}
+	top["total"] = object (_total);
+	top["files"] = files;
+	top["functions"] = functions;
+	return QString::fromUtf8 (QJsonDocument (top).toJson ());
+}
+/*}}}*/
+/*{{{  bool AVRInstructionMix::saveReport (const QString &fileName, QString *error) const*/
+/*
+ *	writes the statistics to a file, as JSON if the name ends ".json", otherwise CSV.
+ *	returns true on success, false otherwise.
+ */
+bool AVRInstructionMix::saveReport (const QString &fileName, QString *error) const
+{
+	QSaveFile file (fileName);
+	QByteArray data = (fileName.endsWith (".json") ? jsonReport () : csvReport ()).toUtf8 ();
+
+	if (!file.open (QIODevice::WriteOnly) || (file.write (data) != data.size ()) || !file.commit ()) {
+		if (error) {
+			*error = QString ("%1: %2").arg (fileName).arg (file.errorString ());
+		}
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  AVRInstructionMix::InstructionClass AVRInstructionMix::instructionClass (const QString &mnemonic)*/
+/*
+ *	classifies an instruction (lower-case mnemonic), following the groups of the instruction set
+ *	summary; anything not listed is arithmetic/logic.
+ */
+AVRInstructionMix::InstructionClass AVRInstructionMix::instructionClass (const QString &mnemonic)
+{
+	static const QSet<QString> branches = {
+		"rjmp", "jmp", "ijmp", "eijmp", "rcall", "call", "icall", "eicall", "ret", "reti",
+		"cpse", "sbrc", "sbrs"
+	};
+	static const QSet<QString> loadStore = {
+		"mov", "movw", "ldi", "ld", "ldd", "lds", "st", "std", "sts", "lpm", "elpm", "spm",
+		"push", "pop", "xch", "las", "lac", "lat"
+	};
+	static const QSet<QString> io = {"in", "out", "sbi", "cbi", "sbic", "sbis"};
+	static const QSet<QString> other = {"nop", "sleep", "wdr", "break", "des"};
+
+	if (branches.contains (mnemonic) || (mnemonic.startsWith ("br") && (mnemonic != "break"))) {
+		return CLASS_BRANCH;
+	} else if (loadStore.contains (mnemonic)) {
+		return CLASS_LOAD_STORE;
+	} else if (io.contains (mnemonic)) {
+		return CLASS_IO;
+	} else if (other.contains (mnemonic)) {
+		return CLASS_OTHER;
+	}
+	return CLASS_ALU;
+}
+/*}}}*/
+/*{{{  QString AVRInstructionMix::className (InstructionClass c)*/
+/*
+ *	returns the short name of a class, as used in the reports.
+ */
+QString AVRInstructionMix::className (InstructionClass c)
+{
+	return QString (classNames[c]);
+}
+/*}}}*/
+/*{{{  QList<QPair<QString, int> > AVRInstructionMix::topOpcodes (const Mix &mix, int count)*/
+/*
+ *	returns up to 'count' of the most used opcodes, most used first (ties alphabetically).
+ */
+QList<QPair<QString, int> > AVRInstructionMix::topOpcodes (const Mix &mix, int count)
+{
+	QList<QPair<QString, int> > list;
+
+	for (QHash<QString, int>::const_iterator it = mix.opcodes.constBegin (); it != mix.opcodes.constEnd (); ++it) {
+		list << qMakePair (it.key (), it.value ());
+	}
+	std::sort (list.begin (), list.end (), [] (const QPair<QString, int> &a, const QPair<QString, int> &b) {
+		return (a.second != b.second) ? (a.second > b.second) : (a.first < b.first);
+	});
+	return list.mid (0, count);
+}
+/*}}}*/
+
+/*{{{  void AVRInstructionMix::clearMix (Mix &mix, const QString &name)*/
+/*
+ *	empties a set of counts.
+ */
+void AVRInstructionMix::clearMix (Mix &mix, const QString &name)
+{
+	mix.name = name;
+	mix.instructions = 0;
+	mix.bytes = 0;
+	mix.minCycles = mix.maxCycles = 0;
+	for (int c=0; c<CLASS_COUNT; c++) {
+		mix.classes[c] = 0;
+	}
+	mix.opcodes.clear ();
+}
+/*}}}*/
+/*{{{  void AVRInstructionMix::addInstruction (Mix &mix, const QString &mnemonic, int bytes, int minCycles, int maxCycles)*/
+/*
+ *	counts one instruction.
+ */
+void AVRInstructionMix::addInstruction (Mix &mix, const QString &mnemonic, int bytes, int minCycles, int maxCycles)
+{
+	mix.instructions++;
+	mix.bytes += bytes;
+	mix.minCycles += minCycles;
+	mix.maxCycles += maxCycles;
+	mix.classes[instructionClass (mnemonic)]++;
+	mix.opcodes[mnemonic]++;
+}
+/*}}}*/
+
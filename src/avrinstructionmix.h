@@ -0,0 +1,84 @@
+/*
+ *	avrinstructionmix.h -- instruction class mix and most-used opcodes.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRINSTRUCTIONMIX_H
+#define AVRINSTRUCTIONMIX_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+class AVRASMFlow;
+struct AVRDeviceInfo;
+
+/*
+ *	Counts the placed instructions (not data, not macro invocations) by class, with their size and
+ *	cycle costs from the opcode table, for each source file and each function.  A function starts
+ *	at the reset or an interrupt handler or anything called, and runs up to the next one by
+ *	address, which is how hand-written code is usually laid out.
+ */
+class AVRInstructionMix
+{
+public:
+	typedef enum InstructionClass {
+		CLASS_ALU = 0,		/* arithmetic, logic, shifts, bit and flag operations */
+		CLASS_BRANCH,		/* jumps, calls, returns, branches, skips */
+		CLASS_LOAD_STORE,	/* register moves, loads, stores, push/pop, lpm/spm */
+		CLASS_IO,		/* in/out, sbi/cbi, sbic/sbis */
+		CLASS_OTHER,		/* nop, sleep, wdr, break */
+		CLASS_COUNT
+	} InstructionClass;
+
+	typedef struct Mix {
+		QString name;		/* file or function */
+		int instructions;
+		int bytes;
+		qint64 minCycles;	/* sums, for the averages */
+		qint64 maxCycles;
+		int classes[CLASS_COUNT];
+		QHash<QString, int> opcodes;
+	} Mix;
+
+	AVRInstructionMix (const AVRASMFlow &flow, const AVRDeviceInfo *device);
+
+	const QList<Mix> &files (void) const;
+	const QList<Mix> &functions (void) const;
+	const Mix &total (void) const;
+
+	QString report (int top) const;
+	QString csvReport (void) const;
+	QString jsonReport (void) const;
+	bool saveReport (const QString &fileName, QString *error = 0) const;
+
+	static InstructionClass instructionClass (const QString &mnemonic);
+	static QString className (InstructionClass c);
+	static QList<QPair<QString, int> > topOpcodes (const Mix &mix, int count);
+
+private:
+	static void clearMix (Mix &mix, const QString &name);
+	static void addInstruction (Mix &mix, const QString &mnemonic, int bytes, int minCycles, int maxCycles);
+
+	QList<Mix> _files;
+	QList<Mix> _functions;
+	Mix _total;
+};
+
+#endif	/* !AVRINSTRUCTIONMIX_H */
+
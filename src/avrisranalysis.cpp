@@ -0,0 +1,285 @@
+/*
+ *	avrisranalysis.cpp -- worst-case interrupt handler cycle counts and latencies.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QPair>
+
+#include "avrisranalysis.h"
+#include "avrasmflow.h"
+#include "avrasmprogram.h"
+
+/* vector names for the ATmega48/88/168/328 family */
+static const char *megaX8Vectors[] = {
+	"RESET", "INT0", "INT1", "PCINT0", "PCINT1", "PCINT2", "WDT",
+	"TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF",
+	"TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF",
+	"TIMER0_COMPA", "TIMER0_COMPB", "TIMER0_OVF",
+	"SPI_STC", "USART_RX", "USART_UDRE", "USART_TX",
+	"ADC", "EE_READY", "ANALOG_COMP", "TWI", "SPM_READY"
+};
+
+/*{{{  AVRISRAnalysis::AVRISRAnalysis (const AVRASMFlow &flow, const AVRDeviceInfo &device)*/
+/*
+ *	constructor: analyses every handler in the graph (which must outlive this).
+ */
+AVRISRAnalysis::AVRISRAnalysis (const AVRASMFlow &flow, const AVRDeviceInfo &device) : _flow (flow), _device (device)
+{
+	int n = _flow.nodes ().count ();
+
+	_state.fill (UNSEEN, n);
+	_cycles.fill (0, n);
+	_cause.fill (-1, n);
+	_problem.resize (n);
+	analyse ();
+}
+/*}}}*/
+/*{{{  const QList<AVRISRAnalysis::Handler> &AVRISRAnalysis::handlers (void) const*/
+/*
+ *	returns the handlers found, in vector order (reset is not included).
+ */
+const QList<AVRISRAnalysis::Handler> &AVRISRAnalysis::handlers (void) const
+{
+	return _handlers;
+}
+/*}}}*/
+/*{{{  bool AVRISRAnalysis::worstCase (int node, qint64 *cycles, QString *problem, int *problemIndex)*/
+/*
+ *	gets the longest path from a node to the ret/reti that ends it (subroutines called on the way
+ *	included).  Results are kept, so asking about many nodes costs no more than asking about all.
+ *	returns true if bounded, false otherwise (with the reason and responsible line if asked for).
+ */
+bool AVRISRAnalysis::worstCase (int node, qint64 *cycles, QString *problem, int *problemIndex)
+{
+	if (_state.at (node) != DONE) {
+		evaluate (node);
+	}
+	*cycles = _cycles.at (node);
+	if (_cycles.at (node) >= 0) {
+		return true;
+	}
+	if (problem) {
+		*problem = _problem.at (_cause.at (node));
+	}
+	if (problemIndex) {
+		*problemIndex = _flow.nodes ().at (_cause.at (node)).index;
+	}
+	return false;
+}
+/*}}}*/
+/*{{{  QString AVRISRAnalysis::vectorName (const AVRDeviceInfo &device, int vector)*/
+/*
+ *	returns the datasheet name of a vector where known, otherwise "VECTOR_<n>".
+ */
+QString AVRISRAnalysis::vectorName (const AVRDeviceInfo &device, int vector)
+{
+	bool megaX8 = (device.name == "ATMEGA328P") || (device.name == "ATMEGA168") || (device.name == "ATMEGA88");
+
+	if (megaX8 && (vector >= 0) && (vector < (int)(sizeof (megaX8Vectors) / sizeof (megaX8Vectors[0])))) {
+		return QString (megaX8Vectors[vector]);
+	}
+	return QString ("VECTOR_%1").arg (vector);
+}
+/*}}}*/
+/*{{{  int AVRISRAnalysis::responseCycles (const AVRDeviceInfo &device)*/
+/*
+ *	returns the cycles from an interrupt being taken to the vector slot executing (return address
+ *	pushed, I flag cleared): 4, or 5 with a 22-bit program counter.
+ */
+int AVRISRAnalysis::responseCycles (const AVRDeviceInfo &device)
+{
+	return (device.flashSize > 131072) ? 5 : 4;
+}
+/*}}}*/
+
+/*{{{  void AVRISRAnalysis::analyse (void)*/
+/*
+ *	finds the handlers and works out their costs, then the latencies (which depend on the others).
+ */
+void AVRISRAnalysis::analyse (void)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	QVector<int> slots;
+	QVector<int> entries = _flow.vectorEntries (_device, &slots);
+	int longest = 0;
+
+	for (int v=1; v<entries.count (); v++) {
+		Handler h;
+
+		if (entries.at (v) < 0) {
+			continue;
+		}
+		h.vector = v;
+		h.name = vectorName (_device, v);
+		h.entry = entries.at (v);
+		h.entryIndex = nodes.at (h.entry).index;
+		h.overhead = responseCycles (_device);
+		h.problemIndex = -1;
+		h.latency = 0;
+		if (slots.at (v) != h.entry) {
+			/* the jump in the slot; a bare reti in the slot is the handler */
+			h.overhead += _flow.edgeCycles (slots.at (v), true);
+		}
+		h.bounded = worstCase (h.entry, &h.bodyCycles, &h.problem, &h.problemIndex);
+		h.cycles = h.bounded ? (h.overhead + h.bodyCycles) : -1;
+		_handlers << h;
+	}
+
+	/*{{{  latencies: the longest thing that can be running when the interrupt arrives*/
+	for (int n=0; n<nodes.count (); n++) {
+		longest = qMax (longest, qMax (_flow.edgeCycles (n, false), _flow.edgeCycles (n, true)));
+	}
+	for (int i=0; i<_handlers.count (); i++) {
+		Handler &h = _handlers[i];
+		qint64 blocking = longest - 1;
+
+		for (int j=0; j<_handlers.count (); j++) {
+			if (j == i) {
+				continue;
+			}
+			if (!_handlers.at (j).bounded) {
+				blocking = -1;
+				break;
+			}
+			blocking = qMax (blocking, _handlers.at (j).cycles);
+		}
+		h.latency = (blocking < 0) ? -1 : (blocking + h.overhead);
+	}
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  void AVRISRAnalysis::evaluate (int root)*/
+/*
+ *	depth-first search from a node, working out the worst case of each node after its successors
+ *	(with an explicit stack, as straight-line code makes for very deep paths).  A successor still on
+ *	the stack means a loop.
+ */
+void AVRISRAnalysis::evaluate (int root)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	const QVector<AVRASMProgram::Line> &lines = _flow.program ().lines ();
+	QVector<QPair<int, bool> > stack;
+
+	stack << qMakePair (root, false);
+	while (!stack.isEmpty ()) {
+		QPair<int, bool> top = stack.takeLast ();
+		int n = top.first;
+		const AVRASMFlow::Node &node = nodes.at (n);
+		int succ[2] = {node.next, node.target};
+
+		if (node.kind == AVRASMFlow::JUMP) {
+			succ[0] = -1;
+		}
+
+		if (!top.second) {
+			/*{{{  first visit: come back after the successors*/
+			if (_state.at (n) != UNSEEN) {
+				continue;
+			}
+			_state[n] = ACTIVE;
+			stack << qMakePair (n, true);
+			for (int i=0; i<2; i++) {
+				if ((succ[i] >= 0) && (_state.at (succ[i]) == UNSEEN)) {
+					stack << qMakePair (succ[i], false);
+				}
+			}
+			continue;
+			/*}}}*/
+		}
+
+		_state[n] = DONE;
+		_cycles[n] = 0;
+
+		/*{{{  things we cannot follow*/
+		switch (node.kind) {
+		case AVRASMFlow::RETURN:
+		case AVRASMFlow::RETI:
+			_cycles[n] = node.maxCycles;
+			continue;
+		case AVRASMFlow::INDIRECT_JUMP:
+		case AVRASMFlow::INDIRECT_CALL:
+			setProblem (n, n, QString ("indirect %1 (target not known)").arg (node.mnemonic));
+			continue;
+		default:
+			break;
+		}
+		if (node.unresolved) {
+			setProblem (n, n, QString ("target of %1 not found").arg (node.mnemonic));
+			continue;
+		}
+		if ((node.kind != AVRASMFlow::JUMP) && ((succ[0] < 0) || ((node.kind == AVRASMFlow::SKIP) && (succ[1] < 0)))) {
+			setProblem (n, n, QString ("runs off the end of the code"));
+			continue;
+		}
+		/*}}}*/
+		/*{{{  loops and unbounded successors*/
+		bool bad = false;
+
+		for (int i=0; (i<2) && !bad; i++) {
+			int s = succ[i];
+
+			if (s < 0) {
+				continue;
+			}
+			if (_state.at (s) == ACTIVE) {
+				const AVRASMProgram::Line &l = lines.at (nodes.at (s).index);
+
+				setProblem (n, n, QString ("loop or recursion back to %1:%2").arg (_flow.program ().files ().at (l.file)).arg (l.line + 1));
+				bad = true;
+			} else if (_cycles.at (s) < 0) {
+				setProblem (n, _cause.at (s), QString ());
+				bad = true;
+			}
+		}
+		if (bad) {
+			continue;
+		}
+		/*}}}*/
+
+		switch (node.kind) {
+		case AVRASMFlow::JUMP:
+			_cycles[n] = _flow.edgeCycles (n, true) + _cycles.at (succ[1]);
+			break;
+		case AVRASMFlow::CALL:
+			/* into the subroutine, back, then on to our own return */
+			_cycles[n] = _flow.edgeCycles (n, true) + _cycles.at (succ[1]) + _cycles.at (succ[0]);
+			break;
+		case AVRASMFlow::BRANCH:
+		case AVRASMFlow::SKIP:
+			_cycles[n] = qMax (_flow.edgeCycles (n, false) + _cycles.at (succ[0]), _flow.edgeCycles (n, true) + _cycles.at (succ[1]));
+			break;
+		default:
+			_cycles[n] = _flow.edgeCycles (n, false) + _cycles.at (succ[0]);
+			break;
+		}
+	}
+}
+/*}}}*/
+/*{{{  void AVRISRAnalysis::setProblem (int node, int cause, const QString &problem)*/
+/*
+ *	marks a node unbounded because of 'cause' (which gets the problem text, if given).
+ */
+void AVRISRAnalysis::setProblem (int node, int cause, const QString &problem)
+{
+	_cycles[node] = -1;
+	_cause[node] = cause;
+	if (!problem.isEmpty ()) {
+		_problem[cause] = problem;
+	}
+}
+/*}}}*/
+
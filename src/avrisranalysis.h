@@ -0,0 +1,87 @@
+/*
+ *	avrisranalysis.h -- worst-case interrupt handler cycle counts and latencies.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRISRANALYSIS_H
+#define AVRISRANALYSIS_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "avrdevice.h"
+
+class AVRASMFlow;
+
+/*
+ *	For each interrupt vector with a handler, the longest path (in cycles) from the handler's first
+ *	instruction to its reti, following calls into subroutines, plus the cost of getting there: the
+ *	interrupt response and the jump in the vector slot.  Loops, recursion and indirect jumps make a
+ *	handler unbounded; the line responsible is reported.  The latency of a vector is how long it can
+ *	wait before its first instruction runs: the longest instruction (or other handler) that has to
+ *	finish first, plus the response and vector jump.
+ */
+class AVRISRAnalysis
+{
+public:
+	typedef struct Handler {
+		int vector;
+		QString name;		/* e.g. "TIMER0_OVF" */
+		int entry;		/* flow node of the first instruction */
+		int entryIndex;		/* and its program line */
+		bool bounded;
+		qint64 bodyCycles;	/* first instruction to reti inclusive */
+		int overhead;		/* response + vector jump */
+		qint64 cycles;		/* overhead + bodyCycles */
+		qint64 latency;		/* worst wait before the first instruction runs */
+		QString problem;	/* why not bounded */
+		int problemIndex;	/* program line responsible, -1 if none */
+	} Handler;
+
+	AVRISRAnalysis (const AVRASMFlow &flow, const AVRDeviceInfo &device);
+
+	const QList<Handler> &handlers (void) const;
+	bool worstCase (int node, qint64 *cycles, QString *problem = 0, int *problemIndex = 0);
+
+	static QString vectorName (const AVRDeviceInfo &device, int vector);
+	static int responseCycles (const AVRDeviceInfo &device);
+
+private:
+	typedef enum State {
+		UNSEEN = 0,
+		ACTIVE,			/* on the search stack */
+		DONE
+	} State;
+
+	void analyse (void);
+	void evaluate (int root);
+	void setProblem (int node, int cause, const QString &problem);
+
+	const AVRASMFlow &_flow;
+	AVRDeviceInfo _device;
+	QList<Handler> _handlers;
+
+	/* per flow node, filled in as needed */
+	QVector<char> _state;
+	QVector<qint64> _cycles;	/* -1 if unbounded */
+	QVector<int> _cause;		/* node responsible when unbounded */
+	QVector<QString> _problem;
+};
+
+#endif	/* !AVRISRANALYSIS_H */
+
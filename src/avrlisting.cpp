@@ -0,0 +1,445 @@
+/*
+ *	avrlisting.cpp -- listing/map file generation and the memory-mapped listing index.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "avrlisting.h"
+#include "avrasmprogram.h"
+#include "avrheximage.h"
+
+/*{{{  static helpers*/
+/*
+ *	writes 'data' to a file, replacing it atomically (so a reader that has the old one mapped is
+ *	never looking at a half-written file).
+ */
+static bool saveFile (const QString &fileName, const QByteArray &data, QString *error)
+{
+	QSaveFile file (fileName);
+
+	if (!file.open (QIODevice::WriteOnly) || (file.write (data) != data.size ()) || !file.commit ()) {
+		if (error) {
+			*error = QString ("%1: %2").arg (fileName).arg (file.errorString ());
+		}
+		return false;
+	}
+	return true;
+}
+
+static QString cyclesText (int lo, int hi)
+{
+	if (!hi) {
+		return "";
+	}
+	return (lo == hi) ? QString::number (lo) : QString ("%1-%2").arg (lo).arg (hi);
+}
+/*}}}*/
+
+
+/*{{{  bool AVRListing::write (const AVRASMProgram &program, const AVRHexImage &flash, const QString &baseName, QString *error)*/
+/*
+ *	writes <baseName>.lst (listing), <baseName>.map (symbols) and <baseName>.lstx (index).
+ *	returns true on success, false otherwise.
+ */
+bool AVRListing::write (const AVRASMProgram &program, const AVRHexImage &flash, const QString &baseName, QString *error)
+{
+	if (!saveFile (baseName + ".lst", listingText (program, flash).toUtf8 (), error)) {
+		return false;
+	}
+	if (!saveFile (baseName + ".map", mapText (program).toUtf8 (), error)) {
+		return false;
+	}
+	return saveFile (baseName + ".lstx", indexData (program, flash), error);
+}
+/*}}}*/
+/*{{{  QString AVRListing::listingText (const AVRASMProgram &program, const AVRHexImage &flash)*/
+/*
+ *	produces the listing: section, address, encoded words, cycles, line number and source text.
+ *	Lines of included files are only listed where they place something.
+ */
+QString AVRListing::listingText (const AVRASMProgram &program, const AVRHexImage &flash)
+{
+	const QVector<AVRASMProgram::Line> &lines = program.lines ();
+	QStringList files = program.files ();
+	QString out;
+	QTextStream s (&out);
+	int lastFile = 0;
+
+	s << "; listing of " << QFileInfo (files.value (0)).fileName () << "\n";
+	s << ";\n; sec  addr    words          cyc   line  source\n";
+	for (int i=0; i<lines.count (); i++) {
+		const AVRASMProgram::Line &l = lines.at (i);
+		QString words;
+
+		if ((l.file != 0) && (l.size == 0)) {
+			continue;
+		}
+		if (l.file != lastFile) {
+			s << "\n; " << QFileInfo (files.value (l.file)).fileName () << "\n";
+			lastFile = l.file;
+		}
+		if ((l.section == AVRASMProgram::TEXT) && (l.size > 0)) {
+			int wa = l.address >> 1;
+
+			for (int w=0; (w < (l.size >> 1)) && (w < 3); w++) {
+				words.append (QString ("%1 ").arg (flash.wordAt (wa + w), 4, 16, QChar ('0')));
+			}
+			if ((l.size >> 1) > 3) {
+				words.append ("...");
+			}
+		}
+		s << QString ("%1 %2 %3 %4 %5  ")
+			.arg ((l.address >= 0) ? AVRASMProgram::sectionName (l.section).left (4) : QString (""), -4)
+			.arg ((l.address >= 0) ? QString ("%1").arg (l.address, 6, 16, QChar ('0')) : QString (""), -6)
+			.arg (words, -15)
+			.arg (cyclesText (l.minCycles, l.maxCycles), -5)
+			.arg (l.line + 1, 5);
+		s << program.sourceText (i) << "\n";
+	}
+	s.flush ();
+	return out;
+}
+/*}}}*/
+/*{{{  QString AVRListing::mapText (const AVRASMProgram &program)*/
+/*
+ *	produces the symbol map: section sizes, then every label by address.
+ */
+QString AVRListing::mapText (const AVRASMProgram &program)
+{
+	QStringList files = program.files ();
+	QString out;
+	QTextStream s (&out);
+
+	s << "; symbol map of " << QFileInfo (files.value (0)).fileName () << "\n;\n";
+	for (int sec=AVRASMProgram::TEXT; sec<=AVRASMProgram::EEPROM; sec++) {
+		s << QString ("; %1 %2 bytes\n").arg (AVRASMProgram::sectionName ((AVRASMProgram::Section)sec), -7)
+				.arg (program.sectionSize ((AVRASMProgram::Section)sec));
+	}
+	s << "\n";
+	for (const AVRASMProgram::Symbol &sym : program.symbolsByAddress ()) {
+		const AVRASMProgram::Line &l = program.lines ().at (sym.index);
+
+		s << QString ("%1 %2  %3  %4:%5\n")
+			.arg (sym.name, -24)
+			.arg (AVRASMProgram::sectionName (sym.section), -6)
+			.arg (sym.address, 6, 16, QChar ('0'))
+			.arg (QFileInfo (files.value (l.file)).fileName ())
+			.arg (l.line + 1);
+	}
+	s.flush ();
+	return out;
+}
+/*}}}*/
+/*{{{  QByteArray AVRListing::indexData (const AVRASMProgram &program, const AVRHexImage &flash)*/
+/*
+ *	builds the binary listing index (see avrlisting.h for the layout).
+ */
+QByteArray AVRListing::indexData (const AVRASMProgram &program, const AVRHexImage &flash)
+{
+	const QVector<AVRASMProgram::Line> &lines = program.lines ();
+	QList<AVRASMProgram::Symbol> syms = program.symbolsByAddress ();
+	QVector<AVRListingLine> lrecs;
+	QVector<AVRListingAddress> arecs;
+	QVector<AVRListingSymbol> srecs;
+	QByteArray strings;
+	AVRListingHeader hdr;
+	QByteArray data;
+	int nlines = 0;
+
+	for (const AVRASMProgram::Line &l : lines) {
+		if ((l.file == 0) && (l.line >= nlines)) {
+			nlines = l.line + 1;
+		}
+	}
+
+	/*{{{  line records*/
+	lrecs.resize (nlines);
+	for (int i=0; i<nlines; i++) {
+		AVRListingLine &rec = lrecs[i];
+
+		memset (&rec, 0, sizeof (rec));
+		rec.address = -1;
+	}
+	for (const AVRASMProgram::Line &l : lines) {
+		if (l.file != 0) {
+			/* line numbers in an included file, not this one */
+			continue;
+		}
+
+		AVRListingLine &rec = lrecs[l.line];
+
+		rec.address = l.address;
+		rec.size = (quint16)qMin (l.size, 0xffff);
+		rec.minCycles = (quint8)qMin (l.minCycles, 0xff);
+		rec.maxCycles = (quint8)qMin (l.maxCycles, 0xff);
+		rec.section = l.section;
+		rec.kind = l.kind;
+		if ((l.section == AVRASMProgram::TEXT) && (l.size > 0)) {
+			rec.opcode[0] = flash.wordAt (l.address >> 1);
+			rec.opcode[1] = (l.size > 2) ? flash.wordAt ((l.address >> 1) + 1) : 0;
+			arecs.append ({ (quint32)l.address, (quint32)l.line });
+		}
+	}
+	std::stable_sort (arecs.begin (), arecs.end (), [] (const AVRListingAddress &a, const AVRListingAddress &b) {
+		return a.address < b.address;
+	});
+	/*}}}*/
+	/*{{{  symbols*/
+	for (const AVRASMProgram::Symbol &sym : syms) {
+		const AVRASMProgram::Line &l = lines.at (sym.index);
+		AVRListingSymbol rec;
+
+		rec.name = strings.size ();
+		rec.address = sym.address;
+		rec.line = (l.file == 0) ? (quint32)l.line : 0xffffffff;
+		rec.section = sym.section;
+		strings.append (sym.name.toUtf8 ());
+		strings.append ('\0');
+		srecs.append (rec);
+	}
+	/*}}}*/
+
+	memset (&hdr, 0, sizeof (hdr));
+	strncpy (hdr.magic, AVRLISTING_MAGIC, sizeof (hdr.magic));
+	hdr.version = AVRLISTING_VERSION;
+	hdr.lineCount = lrecs.count ();
+	hdr.lineOffset = sizeof (hdr);
+	hdr.addressCount = arecs.count ();
+	hdr.addressOffset = hdr.lineOffset + (hdr.lineCount * sizeof (AVRListingLine));
+	hdr.symbolCount = srecs.count ();
+	hdr.symbolOffset = hdr.addressOffset + (hdr.addressCount * sizeof (AVRListingAddress));
+	hdr.stringOffset = hdr.symbolOffset + (hdr.symbolCount * sizeof (AVRListingSymbol));
+	hdr.stringSize = strings.size ();
+	hdr.textSize = program.sectionSize (AVRASMProgram::TEXT);
+	hdr.dataSize = program.sectionSize (AVRASMProgram::DATA);
+	hdr.eepromSize = program.sectionSize (AVRASMProgram::EEPROM);
+
+	data.reserve (hdr.stringOffset + hdr.stringSize);
+	data.append ((const char *)&hdr, sizeof (hdr));
+	data.append ((const char *)lrecs.constData (), lrecs.count () * sizeof (AVRListingLine));
+	data.append ((const char *)arecs.constData (), arecs.count () * sizeof (AVRListingAddress));
+	data.append ((const char *)srecs.constData (), srecs.count () * sizeof (AVRListingSymbol));
+	data.append (strings);
+
+	return data;
+}
+/*}}}*/
+
+
+/*{{{  AVRListingIndex::AVRListingIndex ()*/
+/*
+ *	constructor.
+ */
+AVRListingIndex::AVRListingIndex ()
+{
+	_map = 0;
+	_size = 0;
+	_header = 0;
+}
+/*}}}*/
+/*{{{  AVRListingIndex::~AVRListingIndex ()*/
+/*
+ *	destructor.
+ */
+AVRListingIndex::~AVRListingIndex ()
+{
+	close ();
+}
+/*}}}*/
+/*{{{  bool AVRListingIndex::open (const QString &fileName, QString *error)*/
+/*
+ *	maps a listing index, checking the header and that every table fits in the file.
+ *	returns true on success, false otherwise.
+ */
+bool AVRListingIndex::open (const QString &fileName, QString *error)
+{
+	const AVRListingHeader *hdr;
+
+	close ();
+	_file.setFileName (fileName);
+	if (!_file.open (QIODevice::ReadOnly)) {
+		if (error) {
+			*error = QString ("%1: %2").arg (fileName).arg (_file.errorString ());
+		}
+		return false;
+	}
+	_size = _file.size ();
+	_map = (_size >= (qint64)sizeof (AVRListingHeader)) ? _file.map (0, _size) : 0;
+	hdr = (const AVRListingHeader *)_map;
+
+	if (!hdr || strncmp (hdr->magic, AVRLISTING_MAGIC, sizeof (hdr->magic)) || (hdr->version != AVRLISTING_VERSION) ||
+			((qint64)hdr->lineOffset + ((qint64)hdr->lineCount * sizeof (AVRListingLine)) > _size) ||
+			((qint64)hdr->addressOffset + ((qint64)hdr->addressCount * sizeof (AVRListingAddress)) > _size) ||
+			((qint64)hdr->symbolOffset + ((qint64)hdr->symbolCount * sizeof (AVRListingSymbol)) > _size) ||
+			((qint64)hdr->stringOffset + hdr->stringSize > _size)) {
+		if (error) {
+			*error = QString ("%1: not a listing index").arg (fileName);
+		}
+		close ();
+		return false;
+	}
+	_header = hdr;
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRListingIndex::close (void)*/
+/*
+ *	unmaps and closes the index.
+ */
+void AVRListingIndex::close (void)
+{
+	if (_map) {
+		_file.unmap ((uchar *)_map);
+	}
+	if (_file.isOpen ()) {
+		_file.close ();
+	}
+	_map = 0;
+	_size = 0;
+	_header = 0;
+}
+/*}}}*/
+/*{{{  bool AVRListingIndex::isOpen (void) const*/
+/*
+ *	returns true if an index is mapped.
+ */
+bool AVRListingIndex::isOpen (void) const
+{
+	return (_header != 0);
+}
+/*}}}*/
+/*{{{  QString AVRListingIndex::fileName (void) const*/
+/*
+ *	returns the name of the mapped file.
+ */
+QString AVRListingIndex::fileName (void) const
+{
+	return _file.fileName ();
+}
+/*}}}*/
+/*{{{  int AVRListingIndex::lineCount (void) const*/
+/*
+ *	returns the number of source lines described.
+ */
+int AVRListingIndex::lineCount (void) const
+{
+	return _header ? (int)_header->lineCount : 0;
+}
+/*}}}*/
+/*{{{  const AVRListingLine *AVRListingIndex::line (int line) const*/
+/*
+ *	returns the record for a (0-based) source line, or NULL if out of range.
+ */
+const AVRListingLine *AVRListingIndex::line (int line) const
+{
+	if (!_header || (line < 0) || (line >= (int)_header->lineCount)) {
+		return 0;
+	}
+	return ((const AVRListingLine *)(_map + _header->lineOffset)) + line;
+}
+/*}}}*/
+/*{{{  int AVRListingIndex::lineForAddress (quint32 address) const*/
+/*
+ *	finds the main-file line that placed the instruction at a (byte) flash address.
+ *	returns the 0-based line, or -1 if none.
+ */
+int AVRListingIndex::lineForAddress (quint32 address) const
+{
+	const AVRListingAddress *tab;
+	int lo, hi;
+
+	if (!_header || !_header->addressCount) {
+		return -1;
+	}
+	tab = (const AVRListingAddress *)(_map + _header->addressOffset);
+
+	/* last entry with address <= the one wanted */
+	lo = 0;
+	hi = _header->addressCount - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+
+		if (tab[mid].address <= address) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	if (tab[lo].address > address) {
+		return -1;
+	}
+
+	const AVRListingLine *rec = line (tab[lo].line);
+
+	if (!rec || (address >= (quint32)rec->address + rec->size)) {
+		return -1;
+	}
+	return tab[lo].line;
+}
+/*}}}*/
+/*{{{  int AVRListingIndex::symbolCount (void) const*/
+/*
+ *	returns the number of symbols.
+ */
+int AVRListingIndex::symbolCount (void) const
+{
+	return _header ? (int)_header->symbolCount : 0;
+}
+/*}}}*/
+/*{{{  const AVRListingSymbol *AVRListingIndex::symbol (int index) const*/
+/*
+ *	returns a symbol record, or NULL if out of range.
+ */
+const AVRListingSymbol *AVRListingIndex::symbol (int index) const
+{
+	if (!_header || (index < 0) || (index >= (int)_header->symbolCount)) {
+		return 0;
+	}
+	return ((const AVRListingSymbol *)(_map + _header->symbolOffset)) + index;
+}
+/*}}}*/
+/*{{{  const char *AVRListingIndex::symbolName (int index) const*/
+/*
+ *	returns the name of a symbol (pointing into the mapping), or NULL.
+ */
+const char *AVRListingIndex::symbolName (int index) const
+{
+	const AVRListingSymbol *sym = symbol (index);
+
+	if (!sym || (sym->name >= _header->stringSize)) {
+		return 0;
+	}
+	return (const char *)(_map + _header->stringOffset + sym->name);
+}
+/*}}}*/
+/*{{{  const AVRListingHeader *AVRListingIndex::header (void) const*/
+/*
+ *	returns the header of the mapped index, or NULL.
+ */
+const AVRListingHeader *AVRListingIndex::header (void) const
+{
+	return _header;
+}
+/*}}}*/
+
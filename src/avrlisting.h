@@ -0,0 +1,123 @@
+/*
+ *	avrlisting.h -- listing/map file generation and the memory-mapped listing index.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRLISTING_H
+#define AVRLISTING_H
+
+#include <QFile>
+#include <QString>
+
+class AVRASMProgram;
+class AVRHexImage;
+
+/*
+ *	The indexed listing (".lstx") is a flat file of fixed-size records, in host byte order, laid out
+ *	so that it can be used straight from a memory mapping:
+ *		header
+ *		one AVRListingLine per line of the main source file (indexed by line number)
+ *		AVRListingAddress table for the text section, sorted by address
+ *		AVRListingSymbol table, sorted by section then address
+ *		string table (NUL-terminated symbol names)
+ */
+#define AVRLISTING_MAGIC "AVRLSTX"
+#define AVRLISTING_VERSION 1
+
+typedef struct AVRListingHeader
+{
+	char magic[8];
+	quint32 version;
+	quint32 lineCount;
+	quint32 lineOffset;
+	quint32 addressCount;
+	quint32 addressOffset;
+	quint32 symbolCount;
+	quint32 symbolOffset;
+	quint32 stringOffset;
+	quint32 stringSize;
+	quint32 textSize;		/* bytes used in each section */
+	quint32 dataSize;
+	quint32 eepromSize;
+} AVRListingHeader;
+
+typedef struct AVRListingLine
+{
+	qint32 address;			/* byte address, -1 if the line places nothing */
+	quint16 size;			/* bytes placed */
+	quint8 minCycles;
+	quint8 maxCycles;
+	quint8 section;			/* AVRASMProgram::Section */
+	quint8 kind;			/* AVRASMProgram::LineKind */
+	quint16 opcode[2];		/* first words of the encoding, from the flash image */
+	quint16 reserved;
+} AVRListingLine;
+
+typedef struct AVRListingAddress
+{
+	quint32 address;
+	quint32 line;
+} AVRListingAddress;
+
+typedef struct AVRListingSymbol
+{
+	quint32 name;			/* offset into the string table */
+	qint32 address;
+	quint32 line;			/* main-file line, or 0xffffffff if in an included file */
+	quint32 section;
+} AVRListingSymbol;
+
+class AVRListing
+{
+public:
+	static bool write (const AVRASMProgram &program, const AVRHexImage &flash, const QString &baseName, QString *error = 0);
+
+	static QString listingText (const AVRASMProgram &program, const AVRHexImage &flash);
+	static QString mapText (const AVRASMProgram &program);
+	static QByteArray indexData (const AVRASMProgram &program, const AVRHexImage &flash);
+};
+
+class AVRListingIndex
+{
+public:
+	AVRListingIndex ();
+	~AVRListingIndex ();
+
+	bool open (const QString &fileName, QString *error = 0);
+	void close (void);
+	bool isOpen (void) const;
+	QString fileName (void) const;
+
+	int lineCount (void) const;
+	const AVRListingLine *line (int line) const;
+	int lineForAddress (quint32 address) const;
+
+	int symbolCount (void) const;
+	const AVRListingSymbol *symbol (int index) const;
+	const char *symbolName (int index) const;
+
+	const AVRListingHeader *header (void) const;
+
+private:
+	QFile _file;
+	const uchar *_map;
+	qint64 _size;
+	const AVRListingHeader *_header;
+};
+
+#endif	/* !AVRLISTING_H */
+
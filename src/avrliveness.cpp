@@ -0,0 +1,467 @@
+/*
+ *	avrliveness.cpp -- register liveness over the control-flow graph.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QSet>
+
+#include "avrliveness.h"
+#include "avrasmflow.h"
+#include "avrasmprogram.h"
+#include "avrdevice.h"
+
+/* what an instruction does with its operands, and implicitly */
+#define USE_0		0x0001		/* reads operand 0 */
+#define DEF_0		0x0002		/* writes operand 0 */
+#define USE_1		0x0004		/* reads operand 1 */
+#define DEF_1		0x0008
+#define PAIR		0x0010		/* register operands are the low half of a pair */
+#define PTR_0		0x0020		/* operand 0 is X, Y+q, -Z, ... */
+#define PTR_1		0x0040
+#define MUL_R1R0	0x0080		/* writes r1:r0 */
+#define USE_R1R0	0x0100		/* reads r1:r0 */
+#define USE_Z		0x0200
+#define LPM_R0		0x0400		/* without operands: r0 <- (Z) */
+#define SAME_DEF	0x0800		/* with both operands the same, only writes (eor r,r) */
+
+#define REG(n)		(((quint32)1) << (n))
+#define REG_PAIR(n)	(REG(n) | REG((n) + 1))
+
+static const struct {
+	const char *mnemonic;
+	int flags;
+} registerAccess[] = {
+	{"add", USE_0 | DEF_0 | USE_1}, {"adc", USE_0 | DEF_0 | USE_1},
+	{"sub", USE_0 | DEF_0 | USE_1 | SAME_DEF}, {"sbc", USE_0 | DEF_0 | USE_1},
+	{"and", USE_0 | DEF_0 | USE_1}, {"or", USE_0 | DEF_0 | USE_1},
+	{"eor", USE_0 | DEF_0 | USE_1 | SAME_DEF},
+	{"cp", USE_0 | USE_1}, {"cpc", USE_0 | USE_1}, {"cpse", USE_0 | USE_1},
+	{"mov", DEF_0 | USE_1}, {"movw", DEF_0 | USE_1 | PAIR},
+	{"mul", USE_0 | USE_1 | MUL_R1R0}, {"muls", USE_0 | USE_1 | MUL_R1R0}, {"mulsu", USE_0 | USE_1 | MUL_R1R0},
+	{"fmul", USE_0 | USE_1 | MUL_R1R0}, {"fmuls", USE_0 | USE_1 | MUL_R1R0}, {"fmulsu", USE_0 | USE_1 | MUL_R1R0},
+	{"com", USE_0 | DEF_0}, {"neg", USE_0 | DEF_0}, {"inc", USE_0 | DEF_0}, {"dec", USE_0 | DEF_0},
+	{"lsl", USE_0 | DEF_0}, {"lsr", USE_0 | DEF_0}, {"rol", USE_0 | DEF_0}, {"ror", USE_0 | DEF_0},
+	{"asr", USE_0 | DEF_0}, {"swap", USE_0 | DEF_0},
+	{"tst", USE_0}, {"clr", DEF_0}, {"ser", DEF_0},
+	{"ldi", DEF_0}, {"lds", DEF_0}, {"in", DEF_0}, {"pop", DEF_0},
+	{"subi", USE_0 | DEF_0}, {"sbci", USE_0 | DEF_0}, {"andi", USE_0 | DEF_0}, {"ori", USE_0 | DEF_0},
+	{"sbr", USE_0 | DEF_0}, {"cbr", USE_0 | DEF_0}, {"cpi", USE_0},
+	{"adiw", USE_0 | DEF_0 | PAIR}, {"sbiw", USE_0 | DEF_0 | PAIR},
+	{"out", USE_1}, {"sts", USE_1}, {"push", USE_0},
+	{"sbrc", USE_0}, {"sbrs", USE_0}, {"bst", USE_0}, {"bld", USE_0 | DEF_0},
+	{"ld", DEF_0 | PTR_1}, {"ldd", DEF_0 | PTR_1}, {"st", PTR_0 | USE_1}, {"std", PTR_0 | USE_1},
+	{"lpm", DEF_0 | PTR_1 | LPM_R0}, {"elpm", DEF_0 | PTR_1 | LPM_R0},
+	{"spm", USE_R1R0 | USE_Z},
+	{"xch", PTR_0 | USE_1 | DEF_1}, {"las", PTR_0 | USE_1 | DEF_1}, {"lac", PTR_0 | USE_1 | DEF_1}, {"lat", PTR_0 | USE_1 | DEF_1},
+	{"ijmp", USE_Z}, {"icall", USE_Z}, {"eijmp", USE_Z}, {"eicall", USE_Z}
+};
+
+const quint32 AVRLiveness::ALL_REGISTERS;
+
+/*{{{  static int pointerBase (const QString &operand, bool *updates)*/
+/*
+ *	decodes a pointer operand (X, X+, -X, Y+q, ...): sets 'updates' if it is incremented or
+ *	decremented.
+ *	returns the low register of the pair, or -1 if not a pointer.
+ */
+static int pointerBase (const QString &operand, bool *updates)
+{
+	QString op = operand.trimmed ().toUpper ();
+
+	*updates = op.startsWith ('-') || op.endsWith ('+');
+	if (op.startsWith ('-')) {
+		op = op.mid (1).trimmed ();
+	}
+	if (op.isEmpty ()) {
+		return -1;
+	}
+	switch (op.at (0).toLatin1 ()) {
+	case 'X':
+		return 26;
+	case 'Y':
+		return 28;
+	case 'Z':
+		return 30;
+	default:
+		return -1;
+	}
+}
+/*}}}*/
+
+/*{{{  AVRLiveness::AVRLiveness (const AVRASMFlow &flow, const AVRDeviceInfo *device)*/
+/*
+ *	constructor: works out liveness for the whole graph (which must outlive this), with the
+ *	interrupt handlers found from the device's vector table if given.
+ */
+AVRLiveness::AVRLiveness (const AVRASMFlow &flow, const AVRDeviceInfo *device) : _flow (flow), _handlerRegisters (0)
+{
+	int n = _flow.nodes ().count ();
+
+	_use.fill (0, n);
+	_def.fill (0, n);
+	_in.fill (0, n);
+	_out.fill (0, n);
+	_succ.resize (n);
+	_opaque.fill (false, n);
+	_inHandler.fill (false, n);
+	for (int i=0; i<n; i++) {
+		accesses (i, &_use[i], &_def[i]);
+	}
+	findReturnSites ();
+	if (device) {
+		findHandlerRegisters (*device);
+	}
+	solve ();
+}
+/*}}}*/
+/*{{{  quint32 AVRLiveness::liveIn (int node) const*/
+/*
+ *	returns the registers live just before a node.
+ */
+quint32 AVRLiveness::liveIn (int node) const
+{
+	return _in.at (node);
+}
+/*}}}*/
+/*{{{  quint32 AVRLiveness::liveOut (int node) const*/
+/*
+ *	returns the registers live just after a node.
+ */
+quint32 AVRLiveness::liveOut (int node) const
+{
+	return _out.at (node);
+}
+/*}}}*/
+/*{{{  quint32 AVRLiveness::uses (int node) const*/
+/*
+ *	returns the registers a node reads.
+ */
+quint32 AVRLiveness::uses (int node) const
+{
+	return _use.at (node);
+}
+/*}}}*/
+/*{{{  quint32 AVRLiveness::defines (int node) const*/
+/*
+ *	returns the registers a node writes.
+ */
+quint32 AVRLiveness::defines (int node) const
+{
+	return _def.at (node);
+}
+/*}}}*/
+/*{{{  QString AVRLiveness::registerList (quint32 mask)*/
+/*
+ *	formats a register mask with runs collapsed, e.g. "r2-r7, r16, r18-r21" ("none" if empty).
+ */
+QString AVRLiveness::registerList (quint32 mask)
+{
+	QStringList parts;
+
+	for (int r=0; r<32; r++) {
+		int last;
+
+		if (!(mask & REG (r))) {
+			continue;
+		}
+		for (last=r; (last < 31) && (mask & REG (last + 1)); last++);
+		if (last == r) {
+			parts << QString ("r%1").arg (r);
+		} else {
+			parts << QString ("r%1-r%2").arg (r).arg (last);
+		}
+		r = last;
+	}
+	return parts.isEmpty () ? QString ("none") : parts.join (", ");
+}
+/*}}}*/
+
+/*{{{  void AVRLiveness::accesses (int node, quint32 *use, quint32 *def) const*/
+/*
+ *	works out the registers a node reads and writes from its mnemonic and operands.
+ */
+void AVRLiveness::accesses (int node, quint32 *use, quint32 *def) const
+{
+	const AVRASMFlow::Node &n = _flow.nodes ().at (node);
+	const AVRASMProgram &program = _flow.program ();
+	const AVRASMProgram::Line &l = program.lines ().at (n.index);
+	const QStringList &ops = l.stmt->operands;
+	int regs[2] = {-1, -1};
+	int flags = -1;
+
+	*use = *def = 0;
+	if (l.kind == AVRASMProgram::MACRO_CALL) {
+		/* could do anything */
+		*use = ALL_REGISTERS;
+		return;
+	}
+	for (unsigned int i=0; i<sizeof (registerAccess) / sizeof (registerAccess[0]); i++) {
+		if (n.mnemonic == registerAccess[i].mnemonic) {
+			flags = registerAccess[i].flags;
+			break;
+		}
+	}
+	if (flags < 0) {
+		/* jumps, branches, nop, sei and the like touch no registers */
+		return;
+	}
+	for (int i=0; (i<2) && (i<ops.count ()); i++) {
+		QString op = ops.at (i);
+
+		if (op.contains (':')) {
+			/* "r25:r24" names a pair by its halves */
+			op = op.section (':', 1);
+		}
+		regs[i] = program.registerOperand (op);
+	}
+
+	/*{{{  explicit operands*/
+	for (int i=0; i<2; i++) {
+		quint32 mask;
+
+		if (regs[i] < 0) {
+			continue;
+		}
+		mask = ((flags & PAIR) && (regs[i] < 31)) ? REG_PAIR (regs[i]) : REG (regs[i]);
+		if (flags & (i ? USE_1 : USE_0)) {
+			*use |= mask;
+		}
+		if (flags & (i ? DEF_1 : DEF_0)) {
+			*def |= mask;
+		}
+	}
+	if ((flags & SAME_DEF) && (regs[0] >= 0) && (regs[0] == regs[1])) {
+		*use &= ~REG (regs[0]);
+	}
+	/*}}}*/
+	/*{{{  pointers*/
+	for (int i=0; i<2; i++) {
+		bool updates;
+		int base;
+
+		if (!(flags & (i ? PTR_1 : PTR_0)) || (i >= ops.count ())) {
+			continue;
+		}
+		base = pointerBase (ops.at (i), &updates);
+		if (base < 0) {
+			continue;
+		}
+		*use |= REG_PAIR (base);
+		if (updates) {
+			*def |= REG_PAIR (base);
+		}
+	}
+	/*}}}*/
+	/*{{{  implicit registers*/
+	if (flags & MUL_R1R0) {
+		*def |= REG_PAIR (0);
+	}
+	if (flags & USE_R1R0) {
+		*use |= REG_PAIR (0);
+	}
+	if (flags & USE_Z) {
+		*use |= REG_PAIR (30);
+		if (!ops.isEmpty () && ops.first ().trimmed ().endsWith ('+')) {
+			*def |= REG_PAIR (30);
+		}
+	}
+	if ((flags & LPM_R0) && ops.isEmpty ()) {
+		*use |= REG_PAIR (30);
+		*def |= REG (0);
+	}
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  void AVRLiveness::findReturnSites (void)*/
+/*
+ *	sets up the successors: a call goes into its subroutine, and each ret goes back to after every
+ *	call of the subroutine(s) it ends (found by walking each subroutine without entering calls).
+ */
+void AVRLiveness::findReturnSites (void)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	QHash<int, QList<int> > sites;		/* subroutine entry -> nodes after its calls */
+	QSet<int> returnsSeen;
+
+	for (int n=0; n<nodes.count (); n++) {
+		const AVRASMFlow::Node &node = nodes.at (n);
+
+		switch (node.kind) {
+		case AVRASMFlow::PLAIN:
+			if (node.next >= 0) {
+				_succ[n] << node.next;
+			}
+			break;
+		case AVRASMFlow::JUMP:
+			if (node.target >= 0) {
+				_succ[n] << node.target;
+			}
+			break;
+		case AVRASMFlow::BRANCH:
+		case AVRASMFlow::SKIP:
+			if (node.next >= 0) {
+				_succ[n] << node.next;
+			}
+			if (node.target >= 0) {
+				_succ[n] << node.target;
+			}
+			break;
+		case AVRASMFlow::CALL:
+			if (node.target >= 0) {
+				_succ[n] << node.target;
+				if (node.next >= 0) {
+					sites[node.target] << node.next;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+		if (node.unresolved || (node.kind == AVRASMFlow::RETI) || (node.kind == AVRASMFlow::INDIRECT_JUMP) ||
+				(node.kind == AVRASMFlow::INDIRECT_CALL)) {
+			_opaque[n] = true;
+		}
+	}
+
+	/*{{{  rets back to the callers of whichever subroutines they end*/
+	for (QHash<int, QList<int> >::const_iterator it = sites.constBegin (); it != sites.constEnd (); ++it) {
+		QVector<bool> seen (nodes.count (), false);
+		QList<int> work;
+
+		work << it.key ();
+		while (!work.isEmpty ()) {
+			int n = work.takeLast ();
+			const AVRASMFlow::Node &node = nodes.at (n);
+
+			if (seen.at (n)) {
+				continue;
+			}
+			seen[n] = true;
+			if (node.kind == AVRASMFlow::RETURN) {
+				_succ[n] << it.value ();
+				returnsSeen << n;
+				continue;
+			}
+			if ((node.kind != AVRASMFlow::JUMP) && (node.next >= 0)) {
+				work << node.next;
+			}
+			if ((node.kind != AVRASMFlow::CALL) && (node.target >= 0)) {
+				work << node.target;
+			}
+		}
+	}
+	for (int n=0; n<nodes.count (); n++) {
+		if ((nodes.at (n).kind == AVRASMFlow::RETURN) && !returnsSeen.contains (n)) {
+			/* nobody calls this: could return anywhere */
+			_opaque[n] = true;
+		}
+	}
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  void AVRLiveness::findHandlerRegisters (const AVRDeviceInfo &device)*/
+/*
+ *	marks the nodes reachable from the interrupt vectors (bar reset), subroutines they call
+ *	included, and collects the registers those nodes read or write that no push there saves.
+ */
+void AVRLiveness::findHandlerRegisters (const AVRDeviceInfo &device)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	QVector<int> entries = _flow.vectorEntries (device);
+	quint32 touched = 0, saved = 0;
+	QList<int> work;
+
+	for (int v=1; v<entries.count (); v++) {
+		if (entries.at (v) >= 0) {
+			work << entries.at (v);
+		}
+	}
+	while (!work.isEmpty ()) {
+		int n = work.takeLast ();
+		const AVRASMFlow::Node &node = nodes.at (n);
+
+		if (_inHandler.at (n)) {
+			continue;
+		}
+		_inHandler[n] = true;
+		if (node.mnemonic == "push") {
+			saved |= _use.at (n);
+		} else {
+			touched |= _use.at (n) | _def.at (n);
+		}
+		if (node.next >= 0) {
+			work << node.next;
+		}
+		if (node.target >= 0) {
+			work << node.target;
+		}
+	}
+	_handlerRegisters = touched & ~saved;
+}
+/*}}}*/
+/*{{{  void AVRLiveness::solve (void)*/
+/*
+ *	the usual backward dataflow: live-in is what a node reads plus what is live after it and not
+ *	written by it, iterated from a worklist until nothing changes.  Outside the interrupt
+ *	handlers, the registers they keep their own values in are live throughout.
+ */
+void AVRLiveness::solve (void)
+{
+	int count = _flow.nodes ().count ();
+	QVector<QList<int> > preds (count);
+	QVector<bool> queued (count, true);
+	QList<int> work;
+
+	for (int n=0; n<count; n++) {
+		for (int s : _succ.at (n)) {
+			preds[s] << n;
+		}
+	}
+	for (int n=count-1; n>=0; n--) {
+		work << n;
+	}
+	while (!work.isEmpty ()) {
+		int n = work.takeFirst ();
+		quint32 out = _opaque.at (n) ? ALL_REGISTERS : 0;
+		quint32 in;
+
+		queued[n] = false;
+		for (int s : _succ.at (n)) {
+			out |= _in.at (s);
+		}
+		if (!_inHandler.at (n)) {
+			out |= _handlerRegisters;
+		}
+		in = _use.at (n) | (out & ~_def.at (n));
+		if (!_inHandler.at (n)) {
+			in |= _handlerRegisters;
+		}
+		_out[n] = out;
+		if (in == _in.at (n)) {
+			continue;
+		}
+		_in[n] = in;
+		for (int p : preds.at (n)) {
+			if (!queued.at (p)) {
+				queued[p] = true;
+				work << p;
+			}
+		}
+	}
+}
+/*}}}*/
+
@@ -0,0 +1,75 @@
+/*
+ *	avrliveness.h -- register liveness over the control-flow graph.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRLIVENESS_H
+#define AVRLIVENESS_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class AVRASMFlow;
+struct AVRDeviceInfo;
+
+/*
+ *	A register is live before an instruction if some path from there reads it before writing it.
+ *	Each instruction's reads and writes include the implicit ones: r1:r0 for the multiplies, lpm
+ *	and spm, X/Y/Z for indirect loads and stores (and their updates with +/-), Z for ijmp/icall.
+ *	A call flows into its subroutine, and a ret back to the instructions after every call of the
+ *	subroutine it ends, so registers a subroutine overwrites are free before the call.  Anything
+ *	the analysis cannot see past (reti, indirect jumps, unknown targets, macros) counts as reading
+ *	every register.  Masks have bit n set for register rn.  Calls and returns tie subroutines
+ *	together, so each run covers the whole program rather than one function.  Given the device,
+ *	registers the interrupt handlers touch without pushing them first (global state kept in a
+ *	register) are live everywhere outside the handlers, as an interrupt could come at any point.
+ */
+class AVRLiveness
+{
+public:
+	static const quint32 ALL_REGISTERS = 0xffffffff;
+
+	AVRLiveness (const AVRASMFlow &flow, const AVRDeviceInfo *device = 0);
+
+	quint32 liveIn (int node) const;
+	quint32 liveOut (int node) const;
+	quint32 uses (int node) const;
+	quint32 defines (int node) const;
+
+	static QString registerList (quint32 mask);
+
+private:
+	void accesses (int node, quint32 *use, quint32 *def) const;
+	void findReturnSites (void);
+	void findHandlerRegisters (const AVRDeviceInfo &device);
+	void solve (void);
+
+	const AVRASMFlow &_flow;
+	QVector<quint32> _use;			/* per flow node */
+	QVector<quint32> _def;
+	QVector<quint32> _in;
+	QVector<quint32> _out;
+	QVector<QList<int> > _succ;		/* successors for liveness (calls into, returns back) */
+	QVector<bool> _opaque;			/* cannot see past: everything live after */
+	QVector<bool> _inHandler;		/* reached from an interrupt vector */
+	quint32 _handlerRegisters;		/* touched, unsaved, by the interrupt handlers */
+};
+
+#endif	/* !AVRLIVENESS_H */
+
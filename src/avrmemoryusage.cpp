@@ -0,0 +1,185 @@
+/*
+ *	avrmemoryusage.cpp -- flash/SRAM/EEPROM usage of a built program, against budgets.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include "avrmemoryusage.h"
+#include "avrheximage.h"
+
+/*{{{  AVRMemoryUsage::AVRMemoryUsage (const AVRASMProgram &program, const AVRDeviceInfo &device, const AVRHexImage *flash, const AVRHexImage *eeprom)*/
+/*
+ *	constructor: works out the usage (budgets start at the whole device).
+ */
+AVRMemoryUsage::AVRMemoryUsage (const AVRASMProgram &program, const AVRDeviceInfo &device, const AVRHexImage *flash, const AVRHexImage *eeprom)
+{
+	const QVector<AVRASMProgram::Line> &lines = program.lines ();
+	int current[3] = {-1, -1, -1};		/* consumer being charged, per section */
+
+	_regions[AVRASMProgram::TEXT].name = "flash";
+	_regions[AVRASMProgram::TEXT].size = device.flashSize;
+	_regions[AVRASMProgram::DATA].name = "sram";
+	_regions[AVRASMProgram::DATA].size = device.sramSize;
+	_regions[AVRASMProgram::EEPROM].name = "eeprom";
+	_regions[AVRASMProgram::EEPROM].size = device.eepromSize;
+	for (int s=0; s<3; s++) {
+		_regions[s].section = (AVRASMProgram::Section)s;
+		_regions[s].used = program.sectionSize ((AVRASMProgram::Section)s);
+		_regions[s].budget = _regions[s].size;
+	}
+	/* the images are clipped to the device, the layout is not: take whichever is bigger */
+	if (flash) {
+		_regions[AVRASMProgram::TEXT].used = qMax (_regions[AVRASMProgram::TEXT].used, flash->extent ());
+	}
+	if (eeprom) {
+		_regions[AVRASMProgram::EEPROM].used = qMax (_regions[AVRASMProgram::EEPROM].used, eeprom->extent ());
+	}
+
+	/*{{{  charge placed bytes to the label before them*/
+	for (int i=0; i<lines.count (); i++) {
+		const AVRASMProgram::Line &l = lines.at (i);
+		int s = (int)l.section;
+
+		if (l.stmt && !l.stmt->label.isEmpty () && (l.address >= 0)) {
+			Consumer c;
+
+			c.label = l.stmt->label;
+			c.section = l.section;
+			c.address = l.address;
+			c.size = 0;
+			_consumers << c;
+			current[s] = _consumers.count () - 1;
+		}
+		if (l.size <= 0) {
+			continue;
+		}
+		if (current[s] < 0) {
+			Consumer c;
+
+			c.label = "(start)";
+			c.section = l.section;
+			c.address = l.address;
+			c.size = 0;
+			_consumers << c;
+			current[s] = _consumers.count () - 1;
+		}
+		_consumers[current[s]].size += l.size;
+	}
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  void AVRMemoryUsage::setBudget (AVRASMProgram::Section section, int percent)*/
+/*
+ *	sets the budget for a memory, as a percentage of the device's size.
+ */
+void AVRMemoryUsage::setBudget (AVRASMProgram::Section section, int percent)
+{
+	_regions[section].budget = (int)(((qint64)_regions[section].size * qBound (0, percent, 100)) / 100);
+}
+/*}}}*/
+/*{{{  const AVRMemoryUsage::Region &AVRMemoryUsage::region (AVRASMProgram::Section section) const*/
+/*
+ *	returns the usage of one memory.
+ */
+const AVRMemoryUsage::Region &AVRMemoryUsage::region (AVRASMProgram::Section section) const
+{
+	return _regions[section];
+}
+/*}}}*/
+/*{{{  QList<AVRMemoryUsage::Consumer> AVRMemoryUsage::consumers (AVRASMProgram::Section section) const*/
+/*
+ *	returns the labels in a section that have bytes after them, biggest first.
+ */
+QList<AVRMemoryUsage::Consumer> AVRMemoryUsage::consumers (AVRASMProgram::Section section) const
+{
+	QList<Consumer> list;
+
+	for (const Consumer &c : _consumers) {
+		if ((c.section == section) && (c.size > 0)) {
+			list << c;
+		}
+	}
+	std::stable_sort (list.begin (), list.end (), [] (const Consumer &a, const Consumer &b) { return a.size > b.size; });
+	return list;
+}
+/*}}}*/
+/*{{{  QList<AVRMemoryUsage::Consumer> AVRMemoryUsage::biggest (int count) const*/
+/*
+ *	returns the biggest consumers in any section (at most 'count').
+ */
+QList<AVRMemoryUsage::Consumer> AVRMemoryUsage::biggest (int count) const
+{
+	QList<Consumer> list;
+
+	for (const Consumer &c : _consumers) {
+		if (c.size > 0) {
+			list << c;
+		}
+	}
+	std::stable_sort (list.begin (), list.end (), [] (const Consumer &a, const Consumer &b) { return a.size > b.size; });
+	return list.mid (0, count);
+}
+/*}}}*/
+/*{{{  bool AVRMemoryUsage::overBudget (QStringList *problems) const*/
+/*
+ *	checks each memory against its budget, describing any that are over in 'problems'.
+ *	returns true if any is over, false otherwise.
+ */
+bool AVRMemoryUsage::overBudget (QStringList *problems) const
+{
+	bool over = false;
+
+	for (int s=0; s<3; s++) {
+		const Region &r = _regions[s];
+
+		if (r.used <= r.budget) {
+			continue;
+		}
+		over = true;
+		if (problems) {
+			*problems << QString ("%1: %2 bytes used, budget is %3 of %4 bytes").arg (r.name).arg (r.used).arg (r.budget).arg (r.size);
+		}
+	}
+	return over;
+}
+/*}}}*/
+/*{{{  QString AVRMemoryUsage::report (int top) const*/
+/*
+ *	formats the usage of each memory and the biggest consumers of each.
+ */
+QString AVRMemoryUsage::report (int top) const
+{
+	QString str;
+
+	for (int s=0; s<3; s++) {
+		const Region &r = _regions[s];
+		QList<Consumer> list = consumers ((AVRASMProgram::Section)s);
+
+		str += QString ("%1: %2 of %3 bytes (%4%), %5 free, budget %6\n").arg (r.name, -6).arg (r.used).arg (r.size)
+				.arg (r.size ? ((100.0 * r.used) / r.size) : 0.0, 0, 'f', 1).arg (qMax (0, r.size - r.used)).arg (r.budget);
+		for (int i=0; (i<list.count ()) && (i<top); i++) {
+			const Consumer &c = list.at (i);
+
+			str += QString ("    %1  %2 bytes at 0x%3\n").arg (c.label, -24).arg (c.size, 6)
+					.arg ((s == AVRASMProgram::TEXT) ? (c.address >> 1) : c.address, 4, 16, QChar ('0'));
+		}
+	}
+	return str;
+}
+/*}}}*/
+
@@ -0,0 +1,72 @@
+/*
+ *	avrmemoryusage.h -- flash/SRAM/EEPROM usage of a built program, against budgets.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRMEMORYUSAGE_H
+#define AVRMEMORYUSAGE_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "avrasmprogram.h"
+#include "avrdevice.h"
+
+class AVRHexImage;
+
+/*
+ *	How much of each memory a program uses: flash and EEPROM from the built images where given
+ *	(else the source layout), SRAM from the .data section.  Bytes are also charged to the label
+ *	they follow, so the biggest consumers can be listed.  Each memory has a budget, as a
+ *	percentage of the device's size.
+ */
+class AVRMemoryUsage
+{
+public:
+	typedef struct Region {
+		AVRASMProgram::Section section;
+		QString name;		/* "flash", "sram", "eeprom" */
+		int used;		/* bytes */
+		int size;		/* bytes on the device */
+		int budget;		/* bytes allowed */
+	} Region;
+
+	typedef struct Consumer {
+		QString label;		/* "(start)" for bytes before the first label */
+		AVRASMProgram::Section section;
+		qint32 address;
+		int size;
+	} Consumer;
+
+	AVRMemoryUsage (const AVRASMProgram &program, const AVRDeviceInfo &device, const AVRHexImage *flash = 0, const AVRHexImage *eeprom = 0);
+
+	void setBudget (AVRASMProgram::Section section, int percent);
+
+	const Region &region (AVRASMProgram::Section section) const;
+	QList<Consumer> consumers (AVRASMProgram::Section section) const;
+	QList<Consumer> biggest (int count) const;
+	bool overBudget (QStringList *problems = 0) const;
+	QString report (int top = 10) const;
+
+private:
+	Region _regions[3];
+	QList<Consumer> _consumers;	/* in program order */
+};
+
+#endif	/* !AVRMEMORYUSAGE_H */
+
@@ -0,0 +1,492 @@
+/*
+ *	avrpeephole.cpp -- peephole optimisation advisor over the laid-out source.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QSet>
+
+#include "avrpeephole.h"
+#include "avrasmprogram.h"
+
+/*{{{  AVRPeephole::AVRPeephole (const AVRASMProgram &program, bool pc22, bool hasMovw, qint32 vectorBytes)*/
+/*
+ *	constructor: finds the suggestions for a program (which must outlive this), on a target with a
+ *	16 or 22-bit PC, with or without MOVW, and with an interrupt vector table of 'vectorBytes'.
+ */
+AVRPeephole::AVRPeephole (const AVRASMProgram &program, bool pc22, bool hasMovw, qint32 vectorBytes) : _program (program), _flow (program, pc22),
+	_hasMovw (hasMovw), _vectorBytes (vectorBytes)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+
+	for (const AVRASMProgram::Symbol &sym : program.symbols ()) {
+		if (sym.section == AVRASMProgram::TEXT) {
+			_labelled.insert (sym.address);
+		}
+	}
+	_prev.fill (-1, nodes.count ());
+	for (int n=0; n<nodes.count (); n++) {
+		if (nodes.at (n).next >= 0) {
+			_prev[nodes.at (n).next] = n;
+		}
+	}
+	scan ();
+}
+/*}}}*/
+/*{{{  const QList<AVRPeephole::Suggestion> &AVRPeephole::suggestions (void) const*/
+/*
+ *	returns the suggestions, in line order.
+ */
+const QList<AVRPeephole::Suggestion> &AVRPeephole::suggestions (void) const
+{
+	return _suggestions;
+}
+/*}}}*/
+/*{{{  QString AVRPeephole::ruleName (Rule rule)*/
+/*
+ *	returns a short name for a rule.
+ */
+QString AVRPeephole::ruleName (Rule rule)
+{
+	switch (rule) {
+	case SHORT_CALL:
+		return "call to rcall";
+	case SHORT_JUMP:
+		return "jmp to rjmp";
+	case REDUNDANT_CLR:
+		return "redundant clr";
+	case POST_INCREMENT:
+		return "post-increment";
+	case MOVW:
+		return "movw";
+	}
+	return "";
+}
+/*}}}*/
+
+/*{{{  void AVRPeephole::scan (void)*/
+/*
+ *	tries each rule at each instruction; a pair, once rewritten, is not looked at again.
+ */
+void AVRPeephole::scan (void)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+
+	for (int n=0; n<nodes.count (); n++) {
+		if (mainLine (n) < 0) {
+			continue;
+		}
+		if (shortBranch (n)) {
+			continue;
+		}
+		if (redundantClr (n) || postIncrement (n) || movw (n)) {
+			n++;
+		}
+	}
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::shortBranch (int n)*/
+/*
+ *	call/jmp whose target is within reach of rcall/rjmp (2K words either way).  Shortening code
+ *	only brings targets closer, so this holds whatever else gets applied.  Not where the next slot
+ *	must not move: interrupt vectors, before a .org, or in a table of jumps.
+ */
+bool AVRPeephole::shortBranch (int n)
+{
+	const AVRASMFlow::Node &node = _flow.nodes ().at (n);
+	bool call = (node.mnemonic == "call");
+	QHash<int, QString> lines;
+	qint32 offset;
+
+	if ((!call && (node.mnemonic != "jmp")) || (node.target < 0) || fixedSlot (n)) {
+		return false;
+	}
+	offset = (_flow.nodes ().at (node.target).address >> 1) - ((node.address >> 1) + 1);
+	if ((offset < -2048) || (offset > 2047)) {
+		return false;
+	}
+
+	QString text = instructionText (n);
+	QString mn = text.left (node.mnemonic.length ());
+
+	lines.insert (mainLine (n), rewrite (n, ((mn == mn.toUpper ()) ? QString ("R") : QString ("r")) + text));
+	add (call ? SHORT_CALL : SHORT_JUMP, mainLine (n), mainLine (n), lines,
+			QString ("%1 is in range of %2").arg (node.mnemonic).arg (call ? "rcall" : "rjmp"), 1, 1);
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::redundantClr (int n)*/
+/*
+ *	clr rN straight before ldi rN, K: the clr does nothing the ldi does not undo (bar flags).
+ */
+bool AVRPeephole::redundantClr (int n)
+{
+	const AVRASMFlow::Node &node = _flow.nodes ().at (n);
+	QHash<int, QString> lines;
+
+	if ((node.mnemonic != "clr") || !pairable (node.next)) {
+		return false;
+	}
+
+	const AVRASMFlow::Node &next = _flow.nodes ().at (node.next);
+	const QStringList &a = _program.lines ().at (node.index).stmt->operands;
+	const QStringList &b = _program.lines ().at (next.index).stmt->operands;
+
+	if ((next.mnemonic != "ldi") || (a.count () != 1) || (b.count () != 2) ||
+			(_program.registerOperand (a.at (0)) < 0) || (_program.registerOperand (a.at (0)) != _program.registerOperand (b.at (0))) ||
+			flagsLive (next.next, SREG_S | SREG_V | SREG_N | SREG_Z)) {
+		return false;
+	}
+	lines.insert (mainLine (n), rewrite (n, QString ()));
+	add (REDUNDANT_CLR, mainLine (n), mainLine (node.next), lines,
+			QString ("clr %1 is overwritten by the ldi after it").arg (a.at (0).trimmed ()), 1, 1);
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::postIncrement (int n)*/
+/*
+ *	ld/st through X, Y or Z followed by adiw of that pointer by 1: use the post-increment form.
+ */
+bool AVRPeephole::postIncrement (int n)
+{
+	const AVRASMFlow::Node &node = _flow.nodes ().at (n);
+	QHash<int, QString> lines;
+	int ptr, reg;
+	qint64 k;
+
+	if (((node.mnemonic != "ld") && (node.mnemonic != "st")) || !pairable (node.next)) {
+		return false;
+	}
+
+	const AVRASMFlow::Node &next = _flow.nodes ().at (node.next);
+	const QStringList &a = _program.lines ().at (node.index).stmt->operands;
+	const QStringList &b = _program.lines ().at (next.index).stmt->operands;
+
+	if ((next.mnemonic != "adiw") || (a.count () != 2) || (b.count () != 2)) {
+		return false;
+	}
+	QString p = a.at ((node.mnemonic == "ld") ? 1 : 0).trimmed ().toUpper ();
+
+	if (p == "X") {
+		ptr = 26;
+	} else if (p == "Y") {
+		ptr = 28;
+	} else if (p == "Z") {
+		ptr = 30;
+	} else {
+		return false;
+	}
+	reg = _program.registerOperand (a.at ((node.mnemonic == "ld") ? 0 : 1));
+	if ((reg < 0) || (reg == ptr) || (reg == ptr + 1)) {
+		/* post-increment with the pointer's own register is undefined */
+		return false;
+	}
+	if ((_program.registerOperand (b.at (0)) != ptr) || !_program.constants ().evaluate (b.at (1), &k) || (k != 1) ||
+			flagsLive (next.next, SREG_S | SREG_V | SREG_N | SREG_Z | SREG_C)) {
+		return false;
+	}
+
+	QString text = instructionText (n);
+
+	if (node.mnemonic == "ld") {
+		text += "+";
+	} else {
+		QString left = text.left (text.indexOf (',')).trimmed ();
+
+		text = left + "+" + text.mid (text.indexOf (','));
+	}
+	lines.insert (mainLine (n), rewrite (n, text));
+	lines.insert (mainLine (node.next), rewrite (node.next, QString ()));
+	add (POST_INCREMENT, mainLine (n), mainLine (node.next), lines,
+			QString ("%1 then adiw %2: use %3+").arg (node.mnemonic).arg (b.at (0).trimmed ()).arg (p), 1, 2);
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::movw (int n)*/
+/*
+ *	mov of both halves of an (even-aligned) register pair: one movw.
+ */
+bool AVRPeephole::movw (int n)
+{
+	const AVRASMFlow::Node &node = _flow.nodes ().at (n);
+	QHash<int, QString> lines;
+
+	if (!_hasMovw || (node.mnemonic != "mov") || !pairable (node.next) || (_flow.nodes ().at (node.next).mnemonic != "mov")) {
+		return false;
+	}
+
+	const QStringList &a = _program.lines ().at (node.index).stmt->operands;
+	const QStringList &b = _program.lines ().at (_flow.nodes ().at (node.next).index).stmt->operands;
+
+	if ((a.count () != 2) || (b.count () != 2)) {
+		return false;
+	}
+
+	int ad = _program.registerOperand (a.at (0)), as = _program.registerOperand (a.at (1));
+	int bd = _program.registerOperand (b.at (0)), bs = _program.registerOperand (b.at (1));
+	const QStringList *low;
+
+	if ((ad < 0) || (as < 0) || (bd < 0) || (bs < 0)) {
+		return false;
+	}
+	if (!(ad & 1) && !(as & 1) && (bd == ad + 1) && (bs == as + 1)) {
+		low = &a;
+	} else if (!(bd & 1) && !(bs & 1) && (ad == bd + 1) && (as == bs + 1)) {
+		low = &b;
+	} else {
+		return false;
+	}
+	if ((ad == as) || (ad == bs) || (bd == as)) {
+		/* pairs overlap: the two movs are not one copy */
+		return false;
+	}
+
+	QString mn = instructionText (n).left (3);
+
+	lines.insert (mainLine (n), rewrite (n, QString ("%1%2 %3, %4").arg (mn).arg ((mn == mn.toUpper ()) ? "W" : "w")
+			.arg (low->at (0).trimmed ()).arg (low->at (1).trimmed ())));
+	lines.insert (mainLine (node.next), rewrite (node.next, QString ()));
+	add (MOVW, mainLine (n), mainLine (node.next), lines,
+			QString ("two movs copy the pair %1:%2").arg (low->at (1).trimmed ()).arg (low->at (0).trimmed ()), 1, 1);
+	return true;
+}
+/*}}}*/
+
+/*{{{  bool AVRPeephole::fixedSlot (int n) const*/
+/*
+ *	true if shortening node n would move code that must stay where it is: n is in the interrupt
+ *	vector table, a .org comes before anything else is placed after it, or it is in a run of
+ *	jmp/rjmp with a label on it (a table reached by ijmp/icall, with entries a fixed size apart).
+ */
+bool AVRPeephole::fixedSlot (int n) const
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	const QVector<AVRASMProgram::Line> &lines = _program.lines ();
+	bool labelled = false;
+
+	if (nodes.at (n).address < _vectorBytes) {
+		return true;
+	}
+	for (int idx = nodes.at (n).index + 1; idx < lines.count (); idx++) {
+		const AVRASMProgram::Line &l = lines.at (idx);
+
+		if ((l.kind == AVRASMProgram::DIRECTIVE) && l.stmt && (l.stmt->mnemonic == ".org")) {
+			return true;
+		}
+		if ((l.kind != AVRASMProgram::BLANK) && (l.kind != AVRASMProgram::DIRECTIVE)) {
+			break;
+		}
+	}
+
+	/* the run of jumps n is in (nodes are in source order, so neighbours in flash are adjacent) */
+	int first = n, last = n;
+
+	while ((first > 0) && isJump (first - 1) && (nodes.at (first - 1).address + nodes.at (first - 1).size == nodes.at (first).address)) {
+		first--;
+	}
+	while ((last + 1 < nodes.count ()) && isJump (last + 1) && (nodes.at (last).address + nodes.at (last).size == nodes.at (last + 1).address)) {
+		last++;
+	}
+	for (int m = first; m <= last; m++) {
+		labelled = labelled || _labelled.contains (nodes.at (m).address);
+	}
+	return (last > first) && labelled;
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::isJump (int n) const*/
+/*
+ *	true if node n is a jmp or rjmp (the entries of a jump table).
+ */
+bool AVRPeephole::isJump (int n) const
+{
+	const QString &mn = _flow.nodes ().at (n).mnemonic;
+
+	return (mn == "jmp") || (mn == "rjmp");
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::pairable (int n) const*/
+/*
+ *	checks that a node can be merged with the one before it: both in the main file, in order, no
+ *	label at it (so only reached by falling through), and the one before is not skipped by a skip
+ *	instruction.
+ */
+bool AVRPeephole::pairable (int n) const
+{
+	if ((n < 0) || (mainLine (n) < 0) || (_prev.at (n) < 0) || (mainLine (_prev.at (n)) < 0) || (mainLine (n) <= mainLine (_prev.at (n)))) {
+		return false;
+	}
+	const AVRASMFlow::Node &node = _flow.nodes ().at (n);
+	int before = _prev.at (_prev.at (n));
+
+	if (_labelled.contains (node.address)) {
+		return false;
+	}
+	if ((before >= 0) && (_flow.nodes ().at (before).kind == AVRASMFlow::SKIP)) {
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRPeephole::flagsLive (int n, int flags) const*/
+/*
+ *	follows the code from node 'n' until each of the given SREG flags (SREG_ bits) has been set
+ *	again, to see whether any is read first.  Branches, jumps, calls, skips, returns, and running
+ *	off the end of the code (or into data) all count as reads, since the flags may be tested
+ *	wherever control goes next.
+ *	returns true if the flags may be read, false if they are all overwritten first.
+ */
+bool AVRPeephole::flagsLive (int n, int flags) const
+{
+	static const int arith = SREG_H | SREG_S | SREG_V | SREG_N | SREG_Z | SREG_C;
+	static const int logic = SREG_S | SREG_V | SREG_N | SREG_Z;
+	static const int shift = SREG_S | SREG_V | SREG_N | SREG_Z | SREG_C;
+	static const QHash<QString, int> writes = {
+		{"add", arith}, {"adc", arith}, {"sub", arith}, {"subi", arith}, {"sbc", arith}, {"sbci", arith},
+		{"cp", arith}, {"cpc", arith}, {"cpi", arith}, {"neg", arith},
+		{"adiw", shift}, {"sbiw", shift}, {"com", shift}, {"lsl", arith}, {"rol", arith},
+		{"lsr", shift}, {"ror", shift}, {"asr", shift},
+		{"and", logic}, {"andi", logic}, {"or", logic}, {"ori", logic}, {"eor", logic}, {"clr", logic},
+		{"tst", logic}, {"cbr", logic}, {"sbr", logic}, {"inc", logic}, {"dec", logic},
+		{"mul", SREG_Z | SREG_C}, {"muls", SREG_Z | SREG_C}, {"mulsu", SREG_Z | SREG_C},
+		{"fmul", SREG_Z | SREG_C}, {"fmuls", SREG_Z | SREG_C}, {"fmulsu", SREG_Z | SREG_C},
+		{"sec", SREG_C}, {"clc", SREG_C}, {"sez", SREG_Z}, {"clz", SREG_Z}, {"sen", SREG_N}, {"cln", SREG_N},
+		{"sev", SREG_V}, {"clv", SREG_V}, {"ses", SREG_S}, {"cls", SREG_S}, {"seh", SREG_H}, {"clh", SREG_H}
+	};
+	static const QHash<QString, int> reads = {
+		{"adc", SREG_C}, {"rol", SREG_C}, {"ror", SREG_C},
+		{"sbc", SREG_C | SREG_Z}, {"sbci", SREG_C | SREG_Z}, {"cpc", SREG_C | SREG_Z}
+	};
+	int guard = _flow.nodes ().count ();
+
+	while (flags && (guard-- > 0)) {
+		if (n < 0) {
+			return true;
+		}
+		const AVRASMFlow::Node &node = _flow.nodes ().at (n);
+		const AVRASMProgram::Line &l = _program.lines ().at (node.index);
+
+		if ((l.kind != AVRASMProgram::INSTRUCTION) || (node.kind != AVRASMFlow::PLAIN) || (reads.value (node.mnemonic) & flags)) {
+			return true;
+		}
+		if ((node.mnemonic == "in") || (node.mnemonic == "out")) {
+			const QStringList &ops = l.stmt->operands;
+			bool sreg = (ops.count () == 2) && (ops.at ((node.mnemonic == "in") ? 1 : 0).trimmed ().toUpper () == "SREG");
+
+			if (sreg && (node.mnemonic == "in")) {
+				return true;
+			} else if (sreg) {
+				flags = 0;
+			}
+		}
+		flags &= ~writes.value (node.mnemonic);
+		n = node.next;
+	}
+	return (flags != 0);
+}
+/*}}}*/
+/*{{{  int AVRPeephole::mainLine (int n) const*/
+/*
+ *	returns the editor line of a node, or -1 if it is in an included file.
+ */
+int AVRPeephole::mainLine (int n) const
+{
+	const AVRASMProgram::Line &l = _program.lines ().at (_flow.nodes ().at (n).index);
+
+	return (l.file == 0) ? l.line : -1;
+}
+/*}}}*/
+/*{{{  QString AVRPeephole::instructionText (int n) const*/
+/*
+ *	returns the instruction as written (no label or comment).
+ */
+QString AVRPeephole::instructionText (int n) const
+{
+	const AVRASMProgram::Line &l = _program.lines ().at (_flow.nodes ().at (n).index);
+	QString code = AVRASMConstants::stripComment (_program.sourceText (_flow.nodes ().at (n).index));
+
+	if (!l.stmt->label.isEmpty ()) {
+		code = code.mid (code.indexOf (':') + 1);
+	}
+	return code.trimmed ();
+}
+/*}}}*/
+/*{{{  QString AVRPeephole::rewrite (int n, const QString &instruction) const*/
+/*
+ *	returns a node's line with its instruction replaced, keeping label, indentation and comment.
+ *	An empty 'instruction' removes it; if nothing is left the result is empty (line goes).
+ */
+QString AVRPeephole::rewrite (int n, const QString &instruction) const
+{
+	const AVRASMProgram::Line &l = _program.lines ().at (_flow.nodes ().at (n).index);
+	QString text = _program.sourceText (_flow.nodes ().at (n).index);
+	QString code = AVRASMConstants::stripComment (text);
+	QString comment = text.mid (code.length ());
+	int start = l.stmt->label.isEmpty () ? 0 : (code.indexOf (':') + 1);
+	int end = code.length ();
+
+	if (instruction.isEmpty ()) {
+		if (!l.stmt->label.isEmpty ()) {
+			return code.left (start) + (comment.isEmpty () ? QString ("") : QString ("\t") + comment);
+		}
+		if (!comment.isEmpty ()) {
+			int indent = 0;
+
+			while ((indent < code.length ()) && code.at (indent).isSpace ()) {
+				indent++;
+			}
+			return code.left (indent) + comment;
+		}
+		return QString ();
+	}
+
+	while ((start < code.length ()) && code.at (start).isSpace ()) {
+		start++;
+	}
+	while ((end > start) && code.at (end - 1).isSpace ()) {
+		end--;
+	}
+	if (!comment.isEmpty () && (end == code.length ())) {
+		comment.prepend (' ');
+	}
+	return code.left (start) + instruction + code.mid (end) + comment;
+}
+/*}}}*/
+/*{{{  void AVRPeephole::add (Rule rule, int first, int last, const QHash<int, QString> &lines, const QString &description, int words, int cycles)*/
+/*
+ *	records a suggestion replacing lines first..last: those in 'lines' get the new text (or go,
+ *	if empty), the rest are kept as they are.
+ */
+void AVRPeephole::add (Rule rule, int first, int last, const QHash<int, QString> &lines, const QString &description, int words, int cycles)
+{
+	Suggestion s;
+
+	s.rule = rule;
+	s.firstLine = first;
+	s.lastLine = last;
+	s.description = description;
+	s.words = words;
+	s.cycles = cycles;
+	for (int ln=first; ln<=last; ln++) {
+		if (!lines.contains (ln)) {
+			s.replacement << _program.sourceText (_program.indexForLine (ln, 0));
+		} else if (!lines.value (ln).isEmpty ()) {
+			s.replacement << lines.value (ln);
+		}
+	}
+	_suggestions << s;
+}
+/*}}}*/
+
@@ -0,0 +1,99 @@
+/*
+ *	avrpeephole.h -- peephole optimisation advisor over the laid-out source.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRPEEPHOLE_H
+#define AVRPEEPHOLE_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "avrasmflow.h"
+
+class AVRASMProgram;
+
+/*
+ *	Looks at each instruction (and pairs of adjacent ones) in the main file for shorter or faster
+ *	equivalents.  Pairs are only merged when nothing can jump between them (no label on the
+ *	second, not the target of a skip) and, where an instruction that goes away set flags, nothing
+ *	reads them before they are all set again.  Each suggestion replaces a run of editor lines,
+ *	keeping labels, comments and indentation.
+ */
+class AVRPeephole
+{
+public:
+	typedef enum Rule {
+		SHORT_CALL = 0,		/* call -> rcall (not in vectors or jump tables) */
+		SHORT_JUMP,		/* jmp -> rjmp (likewise) */
+		REDUNDANT_CLR,		/* clr rN; ldi rN, K */
+		POST_INCREMENT,		/* ld/st via X/Y/Z; adiw by 1 */
+		MOVW			/* two movs of a register pair (if the target has movw) */
+	} Rule;
+
+	typedef struct Suggestion {
+		Rule rule;
+		int firstLine;		/* editor (main file) lines replaced, 0-based, inclusive */
+		int lastLine;
+		QStringList replacement;	/* new text for those lines */
+		QString description;
+		int words;		/* flash words saved */
+		int cycles;		/* cycles saved each time it runs */
+	} Suggestion;
+
+	AVRPeephole (const AVRASMProgram &program, bool pc22 = false, bool hasMovw = false, qint32 vectorBytes = 0);
+
+	const QList<Suggestion> &suggestions (void) const;
+
+	static QString ruleName (Rule rule);
+
+private:
+	/* SREG bits */
+	enum {
+		SREG_C = 0x01, SREG_Z = 0x02, SREG_N = 0x04, SREG_V = 0x08,
+		SREG_S = 0x10, SREG_H = 0x20
+	};
+
+	void scan (void);
+	bool shortBranch (int n);
+	bool redundantClr (int n);
+	bool postIncrement (int n);
+	bool movw (int n);
+
+	bool fixedSlot (int n) const;
+	bool isJump (int n) const;
+	bool pairable (int n) const;
+	bool flagsLive (int n, int flags) const;
+	int mainLine (int n) const;
+	QString instructionText (int n) const;
+	QString rewrite (int n, const QString &instruction) const;
+	void add (Rule rule, int first, int last, const QHash<int, QString> &lines, const QString &description, int words, int cycles);
+
+	const AVRASMProgram &_program;
+	AVRASMFlow _flow;
+	QSet<qint32> _labelled;		/* text addresses with a label */
+	QVector<int> _prev;		/* fall-through predecessor of each node, -1 if none */
+	QList<Suggestion> _suggestions;
+	bool _hasMovw;			/* the target has MOVW */
+	qint32 _vectorBytes;		/* size of the interrupt vector table */
+};
+
+#endif	/* !AVRPEEPHOLE_H */
+
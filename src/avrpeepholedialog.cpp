@@ -0,0 +1,156 @@
+/*
+ *	avrpeepholedialog.cpp -- lists peephole suggestions and applies the chosen ones.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <Qsci/qsciscintilla.h>
+
+#include "avrpeepholedialog.h"
+
+/*{{{  AVRPeepholeDialog::AVRPeepholeDialog (QsciScintilla *editor, const QList<AVRPeephole::Suggestion> &suggestions, QWidget *parent)*/
+/*
+ *	constructor: fills in the list.
+ */
+AVRPeepholeDialog::AVRPeepholeDialog (QsciScintilla *editor, const QList<AVRPeephole::Suggestion> &suggestions, QWidget *parent)
+	: QDialog (parent), _editor (editor), _suggestions (suggestions), _applied (0)
+{
+	QVBoxLayout *layout = new QVBoxLayout (this);
+	QDialogButtonBox *buttons = new QDialogButtonBox (QDialogButtonBox::Close);
+	QPushButton *applyButton = buttons->addButton (tr ("&Apply ticked"), QDialogButtonBox::ApplyRole);
+
+	setWindowTitle (tr ("Peephole suggestions"));
+	resize (640, 360);
+
+	_tree = new QTreeWidget ();
+	_tree->setRootIsDecorated (false);
+	_tree->setHeaderLabels (QStringList () << tr ("Line") << tr ("Change") << tr ("Words") << tr ("Cycles") << tr ("Why"));
+	for (int i=0; i<_suggestions.count (); i++) {
+		const AVRPeephole::Suggestion &s = _suggestions.at (i);
+		QTreeWidgetItem *item = new QTreeWidgetItem ();
+
+		item->setText (0, QString::number (s.firstLine + 1));
+		item->setText (1, AVRPeephole::ruleName (s.rule));
+		item->setText (2, QString ("-%1").arg (s.words));
+		item->setText (3, QString ("-%1").arg (s.cycles));
+		item->setText (4, s.description);
+		item->setToolTip (4, s.replacement.join ("\n"));
+		item->setData (0, Qt::UserRole, i);
+		item->setCheckState (0, Qt::Checked);
+		_tree->addTopLevelItem (item);
+	}
+	_tree->header ()->setSectionResizeMode (QHeaderView::ResizeToContents);
+
+	_totals = new QLabel ();
+	layout->addWidget (_tree);
+	layout->addWidget (_totals);
+	layout->addWidget (buttons);
+
+	applyButton->setEnabled (!_suggestions.isEmpty ());
+	connect (applyButton, SIGNAL (clicked ()), this, SLOT (apply ()));
+	connect (buttons, SIGNAL (rejected ()), this, SLOT (reject ()));
+	connect (_tree, SIGNAL (itemChanged (QTreeWidgetItem *, int)), this, SLOT (updateTotals ()));
+	connect (_tree, SIGNAL (itemDoubleClicked (QTreeWidgetItem *, int)), this, SLOT (showLines (QTreeWidgetItem *, int)));
+	updateTotals ();
+}
+/*}}}*/
+/*{{{  int AVRPeepholeDialog::applied (void) const*/
+/*
+ *	returns how many suggestions were applied.
+ */
+int AVRPeepholeDialog::applied (void) const
+{
+	return _applied;
+}
+/*}}}*/
+
+/*{{{  void AVRPeepholeDialog::apply (void)*/
+/*
+ *	replaces the lines of each ticked suggestion, last first so earlier line numbers stay put, all
+ *	inside one undo action.
+ */
+void AVRPeepholeDialog::apply (void)
+{
+	_editor->beginUndoAction ();
+	for (int i=_tree->topLevelItemCount () - 1; i>=0; i--) {
+		QTreeWidgetItem *item = _tree->topLevelItem (i);
+		const AVRPeephole::Suggestion &s = _suggestions.at (item->data (0, Qt::UserRole).toInt ());
+		int last = s.lastLine;
+		int lastLength = _editor->text (last).length ();
+		QString text = s.replacement.join ("\n");
+
+		if (item->checkState (0) != Qt::Checked) {
+			continue;
+		}
+		/* replace up to the end of the last line (but not its newline) */
+		while ((lastLength > 0) && ((_editor->text (last).at (lastLength - 1) == '\n') || (_editor->text (last).at (lastLength - 1) == '\r'))) {
+			lastLength--;
+		}
+		if (s.replacement.isEmpty () && (last + 1 < _editor->lines ())) {
+			/* whole lines go: take the newline too */
+			_editor->setSelection (s.firstLine, 0, last + 1, 0);
+		} else {
+			_editor->setSelection (s.firstLine, 0, last, lastLength);
+		}
+		_editor->replaceSelectedText (text);
+		_applied++;
+	}
+	_editor->endUndoAction ();
+	accept ();
+}
+/*}}}*/
+/*{{{  void AVRPeepholeDialog::updateTotals (void)*/
+/*
+ *	shows what the ticked suggestions save between them.
+ */
+void AVRPeepholeDialog::updateTotals (void)
+{
+	int count = 0, words = 0, cycles = 0;
+
+	for (int i=0; i<_tree->topLevelItemCount (); i++) {
+		QTreeWidgetItem *item = _tree->topLevelItem (i);
+		const AVRPeephole::Suggestion &s = _suggestions.at (item->data (0, Qt::UserRole).toInt ());
+
+		if (item->checkState (0) == Qt::Checked) {
+			count++;
+			words += s.words;
+			cycles += s.cycles;
+		}
+	}
+	_totals->setText (tr ("%1 of %2 ticked: saves %3 word(s) of flash and %4 cycle(s) per pass").arg (count)
+			.arg (_suggestions.count ()).arg (words).arg (cycles));
+}
+/*}}}*/
+/*{{{  void AVRPeepholeDialog::showLines (QTreeWidgetItem *item, int column)*/
+/*
+ *	selects a suggestion's lines in the editor.
+ */
+void AVRPeepholeDialog::showLines (QTreeWidgetItem *item, int column)
+{
+	const AVRPeephole::Suggestion &s = _suggestions.at (item->data (0, Qt::UserRole).toInt ());
+
+	Q_UNUSED (column);
+	_editor->setSelection (s.firstLine, 0, s.lastLine, _editor->text (s.lastLine).length ());
+	_editor->ensureLineVisible (s.firstLine);
+}
+/*}}}*/
+
@@ -0,0 +1,60 @@
+/*
+ *	avrpeepholedialog.h -- lists peephole suggestions and applies the chosen ones.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRPEEPHOLEDIALOG_H
+#define AVRPEEPHOLEDIALOG_H
+
+#include <QDialog>
+#include <QList>
+
+#include "avrpeephole.h"
+
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QsciScintilla;
+
+/*
+ *	One row per suggestion (all ticked to start with) with its savings; double-clicking a row shows
+ *	the lines in the editor.  Applying replaces the ticked ones as a single undoable edit.
+ */
+class AVRPeepholeDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	AVRPeepholeDialog (QsciScintilla *editor, const QList<AVRPeephole::Suggestion> &suggestions, QWidget *parent = 0);
+
+	int applied (void) const;
+
+private slots:
+	void apply (void);
+	void updateTotals (void);
+	void showLines (QTreeWidgetItem *item, int column);
+
+private:
+	QsciScintilla *_editor;
+	QList<AVRPeephole::Suggestion> _suggestions;
+	QTreeWidget *_tree;
+	QLabel *_totals;
+	int _applied;
+};
+
+#endif	/* !AVRPEEPHOLEDIALOG_H */
+
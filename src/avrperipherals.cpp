@@ -0,0 +1,905 @@
+/*
+ *	avrperipherals.cpp -- timer, USART and external interrupt models for the simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "avrperipherals.h"
+
+/* data addresses, as the ATmega48/88/168/328 have them */
+#define IO_PIND		0x29
+#define IO_DDRD		0x2a
+#define IO_PORTD	0x2b
+#define IO_TIFR0	0x35
+#define IO_TIFR1	0x36
+#define IO_TIFR2	0x37
+#define IO_EIFR		0x3c
+#define IO_EIMSK	0x3d
+#define IO_TCCR0A	0x44
+#define IO_TCCR0B	0x45
+#define IO_TCNT0	0x46
+#define IO_OCR0A	0x47
+#define IO_OCR0B	0x48
+#define IO_EICRA	0x69
+#define IO_TIMSK0	0x6e
+#define IO_TIMSK1	0x6f
+#define IO_TIMSK2	0x70
+#define IO_TCCR1A	0x80
+#define IO_TCCR1B	0x81
+#define IO_TCNT1	0x84
+#define IO_ICR1		0x86
+#define IO_OCR1A	0x88
+#define IO_OCR1B	0x8a
+#define IO_TCCR2A	0xb0
+#define IO_TCCR2B	0xb1
+#define IO_TCNT2	0xb2
+#define IO_OCR2A	0xb3
+#define IO_OCR2B	0xb4
+#define IO_UCSR0A	0xc0
+#define IO_UCSR0B	0xc1
+#define IO_UCSR0C	0xc2
+#define IO_UBRR0L	0xc4
+#define IO_UBRR0H	0xc5
+#define IO_UDR0		0xc6
+
+/* TIFRn/TIMSKn bits */
+#define TF_OVF		0x01
+#define TF_COMPA	0x02
+#define TF_COMPB	0x04
+#define TF_CAPT		0x20
+
+/* UCSR0A/UCSR0B bits */
+#define UA_RXC		0x80
+#define UA_TXC		0x40
+#define UA_UDRE		0x20
+#define UA_DOR		0x08
+#define UA_U2X		0x02
+#define UA_MPCM		0x01
+#define UB_RXCIE	0x80
+#define UB_TXCIE	0x40
+#define UB_UDRIE	0x20
+#define UB_RXEN		0x10
+#define UB_TXEN		0x08
+
+/* vectors */
+#define VEC_INT0	1
+#define VEC_USART_RX	18
+#define VEC_USART_UDRE	19
+#define VEC_USART_TX	20
+
+static const int prescale01[8] = {0, 1, 8, 64, 256, 1024, 0, 0};	/* 6 and 7 are the T0/T1 pins */
+static const int prescale2[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+
+/*{{{  AVRPeripherals::AVRPeripherals ()*/
+/*
+ *	constructor: nothing is modelled until attached to a device that has these peripherals.
+ */
+AVRPeripherals::AVRPeripherals ()
+{
+	_enabled = false;
+	_data = 0;
+	_pending = 0;
+	_next = PERIPHERAL_NEVER;
+	for (int i=0; i<3; i++) {
+		Timer &t = _timers[i];
+
+		t.tccra = t.tccrb = t.tcnt = t.ocra = t.ocrb = t.icr = t.timsk = t.tifr = 0;
+		t.wide = false;
+		t.vecOvf = t.vecCompA = t.vecCompB = t.vecCapt = 0;
+		t.prescale = prescale01;
+		t.clock = 0;
+		t.kind = TK_NORMAL;
+		t.max = t.top = 0xff;
+		t.icrTop = false;
+		t.base = 0;
+		t.count = 0;
+		t.up = true;
+		t.temp = 0;
+		t.due = PERIPHERAL_NEVER;
+	}
+	_rxFifo[0] = _rxFifo[1] = 0;
+	_rxCount = 0;
+	_rxDue = PERIPHERAL_NEVER;
+	_txShift = _txBuffer = 0;
+	_txShifting = _txFull = false;
+	_txDue = PERIPHERAL_NEVER;
+	_pinD = 0xff;
+	_intLevel = 0xff;
+}
+/*}}}*/
+/*{{{  bool AVRPeripherals::supports (const AVRDeviceInfo &device)*/
+/*
+ *	returns true if the device has the peripherals modelled here, at these addresses.
+ */
+bool AVRPeripherals::supports (const AVRDeviceInfo &device)
+{
+	return (device.name == "ATMEGA328P") || (device.name == "ATMEGA168") || (device.name == "ATMEGA88");
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::attach (const AVRDeviceInfo &device, quint8 *data, quint64 *pending)*/
+/*
+ *	connects to a core's data space and interrupt requests; for other devices nothing is modelled
+ *	and the registers are plain memory.
+ */
+void AVRPeripherals::attach (const AVRDeviceInfo &device, quint8 *data, quint64 *pending)
+{
+	static const quint32 regs[3][8] = {
+		{IO_TCCR0A, IO_TCCR0B, IO_TCNT0, IO_OCR0A, IO_OCR0B, 0, IO_TIMSK0, IO_TIFR0},
+		{IO_TCCR1A, IO_TCCR1B, IO_TCNT1, IO_OCR1A, IO_OCR1B, IO_ICR1, IO_TIMSK1, IO_TIFR1},
+		{IO_TCCR2A, IO_TCCR2B, IO_TCNT2, IO_OCR2A, IO_OCR2B, 0, IO_TIMSK2, IO_TIFR2}};
+	static const int vectors[3][4] = {{16, 14, 15, 0}, {13, 11, 12, 10}, {9, 7, 8, 0}};
+
+	_data = data;
+	_pending = pending;
+	_enabled = supports (device);
+	for (int i=0; i<3; i++) {
+		Timer &t = _timers[i];
+
+		t.tccra = regs[i][0];
+		t.tccrb = regs[i][1];
+		t.tcnt = regs[i][2];
+		t.ocra = regs[i][3];
+		t.ocrb = regs[i][4];
+		t.icr = regs[i][5];
+		t.timsk = regs[i][6];
+		t.tifr = regs[i][7];
+		t.wide = (i == 1);
+		t.vecOvf = vectors[i][0];
+		t.vecCompA = vectors[i][1];
+		t.vecCompB = vectors[i][2];
+		t.vecCapt = vectors[i][3];
+		t.prescale = (i == 2) ? prescale2 : prescale01;
+	}
+}
+/*}}}*/
+/*{{{  bool AVRPeripherals::isEnabled (void) const*/
+/*
+ *	returns true if the peripherals are modelled for the attached device.
+ */
+bool AVRPeripherals::isEnabled (void) const
+{
+	return _enabled;
+}
+/*}}}*/
+/*{{{  QVector<int> AVRPeripherals::addresses (void) const*/
+/*
+ *	returns the data addresses whose reads and writes must come here.
+ */
+QVector<int> AVRPeripherals::addresses (void) const
+{
+	QVector<int> r;
+
+	if (!_enabled) {
+		return r;
+	}
+	for (int i=0; i<3; i++) {
+		const Timer &t = _timers[i];
+
+		r << t.tccra << t.tccrb << t.tcnt << t.ocra << t.ocrb << t.timsk << t.tifr;
+		if (t.wide) {
+			r << (t.tcnt + 1) << (t.ocra + 1) << (t.ocrb + 1) << t.icr << (t.icr + 1);
+		}
+	}
+	r << IO_UCSR0A << IO_UCSR0B << IO_UCSR0C << IO_UBRR0L << IO_UBRR0H << IO_UDR0;
+	r << IO_EICRA << IO_EIMSK << IO_EIFR << IO_PIND << IO_DDRD << IO_PORTD;
+	return r;
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::reset (void)*/
+/*
+ *	puts the peripherals in their reset state, the core having cleared the data space and its
+ *	interrupt requests.  Serial output not yet collected is kept.
+ */
+void AVRPeripherals::reset (void)
+{
+	_next = PERIPHERAL_NEVER;
+	if (!_enabled) {
+		return;
+	}
+	for (int i=0; i<3; i++) {
+		Timer &t = _timers[i];
+
+		t.base = 0;
+		t.count = 0;
+		t.up = true;
+		t.temp = 0;
+		timerConfigure (t, 0);
+		t.due = PERIPHERAL_NEVER;
+	}
+	_data[IO_UCSR0A] = UA_UDRE;
+	_data[IO_UCSR0C] = 0x06;
+	_rxCount = 0;
+	_rxQueue.clear ();
+	_rxDue = PERIPHERAL_NEVER;
+	_txShifting = _txFull = false;
+	_txDue = PERIPHERAL_NEVER;
+	_pinD = 0xff;
+	_intLevel = pinLevels ();
+}
+/*}}}*/
+/*{{{  quint8 AVRPeripherals::read (quint32 addr, quint64 now)*/
+/*
+ *	reads a register at cycle 'now' (anything due by then happening first).
+ */
+quint8 AVRPeripherals::read (quint32 addr, quint64 now)
+{
+	quint32 reg;
+	Timer *t = _enabled ? timerAt (addr, &reg) : 0;
+
+	if (!_enabled) {
+		return _data[addr];
+	}
+	advance (now);
+	if (t) {
+		if (addr != reg) {
+			/* high byte of a 16-bit register: TCNT1 and ICR1 as latched by reading the low byte */
+			return ((reg == t->tcnt) || (reg == t->icr)) ? t->temp : _data[addr];
+		} else if (reg == t->tcnt) {
+			quint32 count = t->clock ? timerCount (*t, now / t->clock, 0) : t->count;
+
+			t->temp = count >> 8;
+			return count & 0xff;
+		} else if (t->wide && (reg == t->icr)) {
+			t->temp = _data[t->icr + 1];
+		} else if (reg == t->tifr) {
+			timerSync (*t, now);
+			timerUpdate (*t);
+		}
+		return _data[addr];
+	}
+
+	switch (addr) {
+	case IO_UDR0:
+		{
+			quint8 v = _rxFifo[0];
+
+			if (_rxCount) {
+				_rxFifo[0] = _rxFifo[1];
+				_rxCount--;
+			}
+			if (!_rxCount) {
+				_data[IO_UCSR0A] &= ~UA_RXC;
+			}
+			_data[IO_UCSR0A] &= ~UA_DOR;
+			usartUpdate ();
+			return v;
+		}
+	case IO_PIND:
+		return pinLevels ();
+	}
+	return _data[addr];
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::write (quint32 addr, quint8 value, quint64 now)*/
+/*
+ *	writes a register at cycle 'now' (anything due by then happening first).
+ */
+void AVRPeripherals::write (quint32 addr, quint8 value, quint64 now)
+{
+	quint32 reg;
+	Timer *t = _enabled ? timerAt (addr, &reg) : 0;
+
+	if (!_enabled) {
+		_data[addr] = value;
+		return;
+	}
+	advance (now);
+	if (t) {
+		timerSync (*t, now);
+		if (addr != reg) {
+			/* high byte of a 16-bit register: held until the low byte is written */
+			t->temp = value;
+		} else if (reg == t->tcnt) {
+			t->count = t->wide ? ((t->temp << 8) | value) : value;
+			t->up = true;
+			if (t->clock) {
+				t->base = now / t->clock;
+			}
+		} else if ((reg == t->ocra) || (reg == t->ocrb) || (reg == t->icr)) {
+			_data[reg] = value;
+			if (t->wide) {
+				_data[reg + 1] = t->temp;
+			}
+			timerConfigure (*t, now);
+		} else if (reg == t->tifr) {
+			_data[reg] &= ~value;
+		} else if (reg == t->timsk) {
+			_data[reg] = value & (TF_OVF | TF_COMPA | TF_COMPB | (t->wide ? TF_CAPT : 0));
+		} else {
+			/* TCCRnA/TCCRnB: the force-compare strobes read as zero */
+			_data[reg] = ((reg == t->tccrb) && !t->wide) ? (value & 0x0f) : value;
+			timerConfigure (*t, now);
+		}
+		timerUpdate (*t);
+		scheduleNext ();
+		return;
+	}
+
+	switch (addr) {
+	case IO_UDR0:
+		if (!(_data[IO_UCSR0B] & UB_TXEN)) {
+			break;
+		}
+		if (!_txShifting) {
+			_txShifting = true;
+			_txShift = value;
+			_txDue = now + usartFrame ();
+		} else if (!_txFull) {
+			_txBuffer = value;
+			_txFull = true;
+			_data[IO_UCSR0A] &= ~UA_UDRE;
+		}
+		break;
+	case IO_UCSR0A:
+		_data[addr] = (_data[addr] & ~(UA_U2X | UA_MPCM)) | (value & (UA_U2X | UA_MPCM));
+		if (value & UA_TXC) {
+			_data[addr] &= ~UA_TXC;
+		}
+		break;
+	case IO_UCSR0B:
+		_data[addr] = value;
+		if ((value & UB_RXEN) && !_rxQueue.isEmpty () && (_rxDue == PERIPHERAL_NEVER)) {
+			_rxDue = now + usartFrame ();
+		}
+		break;
+	case IO_PIND:
+		/* writing ones toggles the port bits */
+		_data[IO_PORTD] ^= value;
+		externalCheck ();
+		break;
+	case IO_DDRD:
+	case IO_PORTD:
+		_data[addr] = value;
+		externalCheck ();
+		break;
+	case IO_EIFR:
+		_data[addr] &= ~value;
+		break;
+	case IO_EIMSK:
+		_data[addr] = value & 0x03;
+		break;
+	default:
+		_data[addr] = value;
+		break;
+	}
+	usartUpdate ();
+	externalUpdate ();
+	scheduleNext ();
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::acknowledge (int vector, quint64 now)*/
+/*
+ *	called when the core takes an interrupt (having cleared its request): clears the flags that
+ *	the hardware clears on the way in, and asks again for those still wanted.
+ */
+void AVRPeripherals::acknowledge (int vector, quint64 now)
+{
+	if (!_enabled) {
+		return;
+	}
+	advance (now);
+	for (int i=0; i<3; i++) {
+		Timer &t = _timers[i];
+		int flag = (vector == t.vecOvf) ? TF_OVF : (vector == t.vecCompA) ? TF_COMPA :
+				(vector == t.vecCompB) ? TF_COMPB : (t.vecCapt && (vector == t.vecCapt)) ? TF_CAPT : 0;
+
+		if (flag) {
+			timerSync (t, now);
+			_data[t.tifr] &= ~flag;
+			timerUpdate (t);
+		}
+	}
+	if (vector == VEC_USART_TX) {
+		_data[IO_UCSR0A] &= ~UA_TXC;
+	} else if ((vector == VEC_INT0) || (vector == VEC_INT0 + 1)) {
+		int n = vector - VEC_INT0;
+
+		if ((_data[IO_EICRA] >> (2 * n)) & 3) {
+			_data[IO_EIFR] &= ~(1 << n);
+		}
+	}
+	usartUpdate ();
+	externalUpdate ();
+	scheduleNext ();
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::advance (quint64 now)*/
+/*
+ *	handles everything due at or before cycle 'now'.
+ */
+void AVRPeripherals::advance (quint64 now)
+{
+	if (now < _next) {
+		return;
+	}
+	for (int i=0; i<3; i++) {
+		Timer &t = _timers[i];
+
+		if (t.due <= now) {
+			timerSync (t, now);
+			timerUpdate (t);
+		}
+	}
+	usartAdvance (now);
+	scheduleNext ();
+}
+/*}}}*/
+/*{{{  quint64 AVRPeripherals::nextEvent (void) const*/
+/*
+ *	returns the cycle of the next thing due, PERIPHERAL_NEVER if nothing is.
+ */
+quint64 AVRPeripherals::nextEvent (void) const
+{
+	return _next;
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::serialInput (const QByteArray &bytes, quint64 now)*/
+/*
+ *	sends bytes to the USART receiver from outside, one frame time apart; they wait while the
+ *	receiver is disabled.
+ */
+void AVRPeripherals::serialInput (const QByteArray &bytes, quint64 now)
+{
+	if (!_enabled || bytes.isEmpty ()) {
+		return;
+	}
+	advance (now);
+	_rxQueue.append (bytes);
+	if ((_data[IO_UCSR0B] & UB_RXEN) && (_rxDue == PERIPHERAL_NEVER)) {
+		_rxDue = now + usartFrame ();
+	}
+	scheduleNext ();
+}
+/*}}}*/
+/*{{{  QByteArray AVRPeripherals::takeSerialOutput (void)*/
+/*
+ *	returns (and forgets) the bytes the USART has sent since last called.
+ */
+QByteArray AVRPeripherals::takeSerialOutput (void)
+{
+	QByteArray r = _txOut;
+
+	_txOut.clear ();
+	return r;
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::setSerialOutput (const QByteArray &bytes)*/
+/*
+ *	replaces the bytes waiting to be collected.
+ */
+void AVRPeripherals::setSerialOutput (const QByteArray &bytes)
+{
+	_txOut = bytes;
+}
+/*}}}*/
+/*{{{  bool AVRPeripherals::setPin (char port, int bit, bool high)*/
+/*
+ *	drives an input pin from outside (pins not driven float high, as if pulled up).
+ *	returns true on success, false otherwise (not a modelled pin).
+ */
+bool AVRPeripherals::setPin (char port, int bit, bool high)
+{
+	if (!_enabled || (port != 'D') || (bit < 0) || (bit > 7)) {
+		return false;
+	}
+	if (high) {
+		_pinD |= (1 << bit);
+	} else {
+		_pinD &= ~(1 << bit);
+	}
+	externalCheck ();
+	externalUpdate ();
+	return true;
+}
+/*}}}*/
+
+/*{{{  void AVRPeripherals::timerConfigure (Timer &t, quint64 now)*/
+/*
+ *	works out a timer's clock, mode and TOP from its registers (the count having been brought
+ *	up to date), and starts counting ticks from 'now'.
+ */
+void AVRPeripherals::timerConfigure (Timer &t, quint64 now)
+{
+	quint8 a = _data[t.tccra];
+	quint8 b = _data[t.tccrb];
+	quint32 ocra = t.wide ? (_data[t.ocra] | (_data[t.ocra + 1] << 8)) : _data[t.ocra];
+	quint32 icr = t.wide ? (_data[t.icr] | (_data[t.icr + 1] << 8)) : 0;
+	int wgm;
+
+	t.clock = t.prescale[b & 0x07];
+	t.kind = TK_NORMAL;
+	t.icrTop = false;
+	if (!t.wide) {
+		t.max = t.top = 0xff;
+		wgm = (a & 0x03) | ((b >> 1) & 0x04);
+		switch (wgm) {
+		case 1:		t.kind = TK_DUAL;					break;
+		case 2:		t.kind = TK_CTC;	t.top = ocra;			break;
+		case 3:		t.kind = TK_FAST;					break;
+		case 5:		t.kind = TK_DUAL;	t.top = ocra;			break;
+		case 7:		t.kind = TK_FAST;	t.top = ocra;			break;
+		}
+	} else {
+		t.max = t.top = 0xffff;
+		wgm = (a & 0x03) | ((b >> 1) & 0x0c);
+		switch (wgm) {
+		case 1:		t.kind = TK_DUAL;	t.top = 0x00ff;			break;
+		case 2:		t.kind = TK_DUAL;	t.top = 0x01ff;			break;
+		case 3:		t.kind = TK_DUAL;	t.top = 0x03ff;			break;
+		case 4:		t.kind = TK_CTC;	t.top = ocra;			break;
+		case 5:		t.kind = TK_FAST;	t.top = 0x00ff;			break;
+		case 6:		t.kind = TK_FAST;	t.top = 0x01ff;			break;
+		case 7:		t.kind = TK_FAST;	t.top = 0x03ff;			break;
+		case 8:
+		case 10:	t.kind = TK_DUAL;	t.top = icr;	t.icrTop = true;	break;
+		case 9:
+		case 11:	t.kind = TK_DUAL;	t.top = ocra;			break;
+		case 12:	t.kind = TK_CTC;	t.top = icr;	t.icrTop = true;	break;
+		case 14:	t.kind = TK_FAST;	t.top = icr;	t.icrTop = true;	break;
+		case 15:	t.kind = TK_FAST;	t.top = ocra;			break;
+		}
+	}
+	if (t.clock) {
+		t.base = now / t.clock;
+	}
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::timerSync (Timer &t, quint64 now)*/
+/*
+ *	brings a timer up to cycle 'now': sets the flags for everything that happened since it was
+ *	last brought up to date, and counts from there.
+ */
+void AVRPeripherals::timerSync (Timer &t, quint64 now)
+{
+	static const int flags[4] = {TF_OVF, TF_COMPA, TF_COMPB, TF_CAPT};
+	quint64 tick;
+
+	if (!t.clock) {
+		return;
+	}
+	tick = now / t.clock;
+	if (tick <= t.base) {
+		return;
+	}
+	for (int i=0; i<4; i++) {
+		if (!(_data[t.tifr] & flags[i]) && (timerEvent (t, flags[i]) <= tick)) {
+			_data[t.tifr] |= flags[i];
+		}
+	}
+	t.count = timerCount (t, tick, &t.up);
+	t.base = tick;
+}
+/*}}}*/
+/*{{{  quint32 AVRPeripherals::timerCount (const Timer &t, quint64 tick, bool *up) const*/
+/*
+ *	returns a timer's count at a tick (not before its base), and the direction if 'up' is given.
+ *	Single-slope counters set above TOP run on to MAX and wrap before settling into their period.
+ */
+quint32 AVRPeripherals::timerCount (const Timer &t, quint64 tick, bool *up) const
+{
+	quint64 k = tick - t.base;
+
+	if (t.kind == TK_DUAL) {
+		quint64 period = 2 * (quint64)t.top;
+		quint32 count = qMin (t.count, t.top);
+		quint64 pos;
+
+		if (!k) {
+			if (up) {
+				*up = t.up;
+			}
+			return t.count;
+		} else if (!period) {
+			return 0;
+		}
+		pos = ((t.up ? count : period - count) + k) % period;
+		if (up) {
+			*up = (pos < t.top);
+		}
+		return (pos <= t.top) ? pos : (period - pos);
+	}
+	if (up) {
+		*up = true;
+	}
+	if (t.count > t.top) {
+		quint64 wrap = t.max - t.count + 1;
+
+		if (k < wrap) {
+			return t.count + k;
+		}
+		return (k - wrap) % ((quint64)t.top + 1);
+	}
+	return (t.count + k) % ((quint64)t.top + 1);
+}
+/*}}}*/
+/*{{{  quint64 AVRPeripherals::timerMatch (const Timer &t, quint32 value) const*/
+/*
+ *	returns the first tick after a timer's base at which it counts to 'value', PERIPHERAL_NEVER if
+ *	it never does.
+ */
+quint64 AVRPeripherals::timerMatch (const Timer &t, quint32 value) const
+{
+	if (t.kind == TK_DUAL) {
+		quint64 period = 2 * (quint64)t.top;
+		quint32 count = qMin (t.count, t.top);
+		quint64 pos, best = PERIPHERAL_NEVER;
+
+		if (!period || (value > t.top)) {
+			return PERIPHERAL_NEVER;
+		}
+		pos = t.up ? count : period - count;
+		for (int i=0; i<2; i++) {
+			quint64 target = i ? (period - value) % period : value;
+			quint64 d = (target + period - pos) % period;
+
+			best = qMin (best, t.base + (d ? d : period));
+		}
+		return best;
+	}
+	if (t.count > t.top) {
+		if (value > t.count) {
+			return t.base + (value - t.count);
+		} else if (value > t.top) {
+			return PERIPHERAL_NEVER;
+		}
+		return t.base + (t.max - t.count + 1) + value;
+	} else if (value > t.top) {
+		return PERIPHERAL_NEVER;
+	} else {
+		quint64 period = (quint64)t.top + 1;
+		quint64 d = (value + period - t.count) % period;
+
+		return t.base + (d ? d : period);
+	}
+}
+/*}}}*/
+/*{{{  quint64 AVRPeripherals::timerEvent (const Timer &t, int flag) const*/
+/*
+ *	returns the first tick after a timer's base that sets one of its flags, PERIPHERAL_NEVER if
+ *	none will (stopped timers included).
+ */
+quint64 AVRPeripherals::timerEvent (const Timer &t, int flag) const
+{
+	if (!t.clock) {
+		return PERIPHERAL_NEVER;
+	}
+	switch (flag) {
+	case TF_OVF:
+		switch (t.kind) {
+		case TK_FAST:
+			return timerMatch (t, t.top);
+		case TK_DUAL:
+			return timerMatch (t, 0);
+		default:
+			/* wrapping from MAX */
+			if (t.count > t.top) {
+				return t.base + (t.max - t.count + 1);
+			} else if (t.top == t.max) {
+				return timerMatch (t, 0);
+			}
+			return PERIPHERAL_NEVER;
+		}
+	case TF_COMPA:
+		return timerMatch (t, t.wide ? (_data[t.ocra] | (_data[t.ocra + 1] << 8)) : _data[t.ocra]);
+	case TF_COMPB:
+		return timerMatch (t, t.wide ? (_data[t.ocrb] | (_data[t.ocrb + 1] << 8)) : _data[t.ocrb]);
+	case TF_CAPT:
+		return t.icrTop ? timerMatch (t, t.top) : PERIPHERAL_NEVER;
+	}
+	return PERIPHERAL_NEVER;
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::timerUpdate (Timer &t)*/
+/*
+ *	sets a timer's interrupt requests from its flags and mask, and when it next needs attention:
+ *	the soonest of the enabled interrupts whose flags are still clear.
+ */
+void AVRPeripherals::timerUpdate (Timer &t)
+{
+	quint8 flags = _data[t.tifr];
+	quint8 mask = _data[t.timsk];
+
+	request (t.vecOvf, flags & mask & TF_OVF);
+	request (t.vecCompA, flags & mask & TF_COMPA);
+	request (t.vecCompB, flags & mask & TF_COMPB);
+	if (t.vecCapt) {
+		request (t.vecCapt, flags & mask & TF_CAPT);
+	}
+
+	t.due = PERIPHERAL_NEVER;
+	mask &= ~flags;
+	for (int f=TF_OVF; f<=TF_CAPT; f<<=1) {
+		if (mask & f) {
+			quint64 tick = timerEvent (t, f);
+
+			if (tick != PERIPHERAL_NEVER) {
+				t.due = qMin (t.due, tick * t.clock);
+			}
+		}
+	}
+}
+/*}}}*/
+/*{{{  AVRPeripherals::Timer *AVRPeripherals::timerAt (quint32 addr, quint32 *reg)*/
+/*
+ *	returns the timer a register belongs to (0 if none), and in 'reg' the register's first
+ *	address (the low byte of 16-bit ones).
+ */
+AVRPeripherals::Timer *AVRPeripherals::timerAt (quint32 addr, quint32 *reg)
+{
+	for (int i=0; i<3; i++) {
+		Timer &t = _timers[i];
+
+		if ((addr == t.tccra) || (addr == t.tccrb) || (addr == t.timsk) || (addr == t.tifr)) {
+			*reg = addr;
+			return &t;
+		}
+		if ((addr == t.tcnt) || (addr == t.ocra) || (addr == t.ocrb) || (t.icr && (addr == t.icr))) {
+			*reg = addr;
+			return &t;
+		}
+		if (t.wide && ((addr == t.tcnt + 1) || (addr == t.ocra + 1) || (addr == t.ocrb + 1) || (addr == t.icr + 1))) {
+			*reg = addr - 1;
+			return &t;
+		}
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  quint64 AVRPeripherals::usartFrame (void) const*/
+/*
+ *	returns the cycles one USART frame takes: start bit, data bits, parity and stop bits at the
+ *	baud rate set.
+ */
+quint64 AVRPeripherals::usartFrame (void) const
+{
+	quint64 ubrr = ((_data[IO_UBRR0H] & 0x0f) << 8) | _data[IO_UBRR0L];
+	int size = ((_data[IO_UCSR0B] & 0x04) | ((_data[IO_UCSR0C] >> 1) & 0x03));
+	int bits = 1 + ((size == 7) ? 9 : 5 + (size & 0x03));
+
+	bits += (_data[IO_UCSR0C] & 0x20) ? 1 : 0;
+	bits += (_data[IO_UCSR0C] & 0x08) ? 2 : 1;
+	return (ubrr + 1) * ((_data[IO_UCSR0A] & UA_U2X) ? 8 : 16) * bits;
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::usartAdvance (quint64 now)*/
+/*
+ *	finishes the frames sent and received by cycle 'now'.
+ */
+void AVRPeripherals::usartAdvance (quint64 now)
+{
+	while (_txDue <= now) {
+		_txOut.append ((char)_txShift);
+		if (_txFull) {
+			_txShift = _txBuffer;
+			_txFull = false;
+			_data[IO_UCSR0A] |= UA_UDRE;
+			_txDue += usartFrame ();
+		} else {
+			_txShifting = false;
+			_txDue = PERIPHERAL_NEVER;
+			_data[IO_UCSR0A] |= UA_TXC;
+		}
+	}
+	while (_rxDue <= now) {
+		quint8 v = _rxQueue.at (0);
+
+		_rxQueue.remove (0, 1);
+		if (_rxCount < 2) {
+			_rxFifo[_rxCount++] = v;
+			_data[IO_UCSR0A] |= UA_RXC;
+		} else {
+			_data[IO_UCSR0A] |= UA_DOR;
+		}
+		if (!_rxQueue.isEmpty () && (_data[IO_UCSR0B] & UB_RXEN)) {
+			_rxDue += usartFrame ();
+		} else {
+			_rxDue = PERIPHERAL_NEVER;
+		}
+	}
+	usartUpdate ();
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::usartUpdate (void)*/
+/*
+ *	sets the USART's interrupt requests from its flags and enables.
+ */
+void AVRPeripherals::usartUpdate (void)
+{
+	quint8 a = _data[IO_UCSR0A];
+	quint8 b = _data[IO_UCSR0B];
+
+	request (VEC_USART_RX, (a & UA_RXC) && (b & UB_RXCIE));
+	request (VEC_USART_UDRE, (a & UA_UDRE) && (b & UB_UDRIE));
+	request (VEC_USART_TX, (a & UA_TXC) && (b & UB_TXCIE));
+}
+/*}}}*/
+/*{{{  quint8 AVRPeripherals::pinLevels (void) const*/
+/*
+ *	returns the levels on port D: outputs as PORTD, inputs as driven from outside.
+ */
+quint8 AVRPeripherals::pinLevels (void) const
+{
+	quint8 ddr = _data[IO_DDRD];
+
+	return (_data[IO_PORTD] & ddr) | (_pinD & ~ddr);
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::externalCheck (void)*/
+/*
+ *	looks for the edges INT0 (PD2) and INT1 (PD3) are set to catch since last looked.
+ */
+void AVRPeripherals::externalCheck (void)
+{
+	quint8 levels = pinLevels ();
+
+	for (int n=0; n<2; n++) {
+		quint8 bit = 1 << (2 + n);
+		bool was = (_intLevel & bit), now = (levels & bit);
+
+		switch ((_data[IO_EICRA] >> (2 * n)) & 3) {
+		case 1:		if (was != now) _data[IO_EIFR] |= (1 << n);	break;
+		case 2:		if (was && !now) _data[IO_EIFR] |= (1 << n);	break;
+		case 3:		if (!was && now) _data[IO_EIFR] |= (1 << n);	break;
+		}
+	}
+	_intLevel = levels;
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::externalUpdate (void)*/
+/*
+ *	sets the INT0/INT1 requests: while the pin is low for level-sensed ones, from the flag for
+ *	edge-sensed ones.
+ */
+void AVRPeripherals::externalUpdate (void)
+{
+	for (int n=0; n<2; n++) {
+		bool want;
+
+		if (((_data[IO_EICRA] >> (2 * n)) & 3) == 0) {
+			want = !(_intLevel & (1 << (2 + n)));
+		} else {
+			want = (_data[IO_EIFR] & (1 << n));
+		}
+		request (VEC_INT0 + n, want && (_data[IO_EIMSK] & (1 << n)));
+	}
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::request (int vector, bool on)*/
+/*
+ *	raises or withdraws an interrupt request in the core.
+ */
+void AVRPeripherals::request (int vector, bool on)
+{
+	if (on) {
+		*_pending |= ((quint64)1 << vector);
+	} else {
+		*_pending &= ~((quint64)1 << vector);
+	}
+}
+/*}}}*/
+/*{{{  void AVRPeripherals::scheduleNext (void)*/
+/*
+ *	works out when anything is next due.
+ */
+void AVRPeripherals::scheduleNext (void)
+{
+	_next = qMin (_txDue, _rxDue);
+	for (int i=0; i<3; i++) {
+		_next = qMin (_next, _timers[i].due);
+	}
+}
+/*}}}*/
+
@@ -0,0 +1,131 @@
+/*
+ *	avrperipherals.h -- timer, USART and external interrupt models for the simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRPERIPHERALS_H
+#define AVRPERIPHERALS_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include "avrdevice.h"
+
+#define PERIPHERAL_NEVER	(~(quint64)0)
+
+/*
+ *	Timer0/1/2, USART0 and INT0/1 as the ATmega48/88/168/328 have them, driven by the simulator's
+ *	cycle count rather than ticked: a counter is worked out from when it was last set up whenever
+ *	it is read, and flags that nothing is waiting on are caught up the same way.  Each source has
+ *	one due cycle at most (a timer only while an enabled interrupt flag is clear, the USART only
+ *	while a frame is on the wire), and nextEvent() is the earliest, so the core runs at full speed
+ *	until then and sleeps straight through to it; idle peripherals cost nothing.
+ *
+ *	Not modelled: output compare pins, input capture from the ICP1 pin, external timer clocks,
+ *	asynchronous Timer2, double-buffered OCR in PWM modes, and USART framing/parity errors and the
+ *	ninth data bit.  Interrupt requests are kept in the core's pending-vector mask.
+ */
+class AVRPeripherals
+{
+public:
+	AVRPeripherals ();
+
+	static bool supports (const AVRDeviceInfo &device);
+	void attach (const AVRDeviceInfo &device, quint8 *data, quint64 *pending);
+	bool isEnabled (void) const;
+	QVector<int> addresses (void) const;
+	void reset (void);
+
+	quint8 read (quint32 addr, quint64 now);
+	void write (quint32 addr, quint8 value, quint64 now);
+	void acknowledge (int vector, quint64 now);
+	void advance (quint64 now);
+	quint64 nextEvent (void) const;
+
+	void serialInput (const QByteArray &bytes, quint64 now);
+	QByteArray takeSerialOutput (void);
+	void setSerialOutput (const QByteArray &bytes);
+	bool setPin (char port, int bit, bool high);
+
+private:
+	typedef enum TimerKind {
+		TK_NORMAL,		/* up to MAX and wrap */
+		TK_CTC,			/* up to TOP, cleared; overflow only if passing MAX */
+		TK_FAST,		/* up to TOP, cleared; overflow at TOP */
+		TK_DUAL			/* up to TOP and back down; overflow at BOTTOM */
+	} TimerKind;
+
+	typedef struct Timer {
+		/* registers (data addresses; the low byte for 16-bit ones, 0 if absent) and vectors */
+		quint32 tccra, tccrb, tcnt, ocra, ocrb, icr, timsk, tifr;
+		bool wide;
+		int vecOvf, vecCompA, vecCompB, vecCapt;
+		const int *prescale;	/* cycles a tick, by clock select */
+		/* from the control registers */
+		int clock;		/* 0 when stopped */
+		TimerKind kind;
+		quint32 max;
+		quint32 top;
+		bool icrTop;		/* ICR1 is TOP, so ICF1 is set there */
+		/* the counter was 'count' at tick 'base' (ticks are at multiples of 'clock' cycles) */
+		quint64 base;
+		quint32 count;
+		bool up;		/* dual-slope direction */
+		quint8 temp;		/* 16-bit access high byte */
+		quint64 due;
+	} Timer;
+
+	void timerConfigure (Timer &t, quint64 now);
+	void timerSync (Timer &t, quint64 now);
+	quint32 timerCount (const Timer &t, quint64 tick, bool *up) const;
+	quint64 timerMatch (const Timer &t, quint32 value) const;
+	quint64 timerEvent (const Timer &t, int flag) const;
+	void timerUpdate (Timer &t);
+	Timer *timerAt (quint32 addr, quint32 *reg);
+	quint64 usartFrame (void) const;
+	void usartAdvance (quint64 now);
+	void usartUpdate (void);
+	quint8 pinLevels (void) const;
+	void externalCheck (void);
+	void externalUpdate (void);
+	void request (int vector, bool on);
+	void scheduleNext (void);
+
+	bool _enabled;
+	quint8 *_data;			/* the core's data space */
+	quint64 *_pending;		/* the core's interrupt requests */
+	quint64 _next;
+
+	Timer _timers[3];
+
+	quint8 _rxFifo[2];
+	int _rxCount;
+	QByteArray _rxQueue;		/* sent from outside, not yet received */
+	quint64 _rxDue;
+	quint8 _txShift;
+	quint8 _txBuffer;
+	bool _txShifting;
+	bool _txFull;
+	quint64 _txDue;
+	QByteArray _txOut;		/* sent, not yet collected */
+
+	quint8 _pinD;			/* port D as driven from outside */
+	quint8 _intLevel;		/* port D as last seen by INT0/1 */
+};
+
+#endif	/* !AVRPERIPHERALS_H */
+
@@ -0,0 +1,113 @@
+/*
+ *	avrprofiler.cpp -- simulator execution profile mapped to source lines.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <math.h>
+#include <algorithm>
+
+#include <QHash>
+
+#include "avrprofiler.h"
+#include "avrlisting.h"
+
+/*{{{  AVRProfiler::AVRProfiler (const QVector<AVRSimulator::ProfileCount> &counts, const AVRListingIndex &index)*/
+/*
+ *	constructor: builds the per-line profile.
+ */
+AVRProfiler::AVRProfiler (const QVector<AVRSimulator::ProfileCount> &counts, const AVRListingIndex &index)
+{
+	QHash<int,int> byLine;		/* source line -> entry in _lines */
+
+	_total = 0;
+	_max = 0;
+	for (int w=0; w<counts.count (); w++) {
+		const AVRSimulator::ProfileCount &pc = counts.at (w);
+		int line, slot;
+
+		if (!pc.executions) {
+			continue;
+		}
+		line = index.isOpen () ? index.lineForAddress (w * 2) : -1;
+		if ((line >= 0) && byLine.contains (line)) {
+			slot = byLine.value (line);
+		} else {
+			Line l = {line, (quint32)(w * 2), 0, 0};
+
+			slot = _lines.count ();
+			_lines.append (l);
+			if (line >= 0) {
+				byLine.insert (line, slot);
+			}
+		}
+		_lines[slot].executions += pc.executions;
+		_lines[slot].cycles += pc.cycles;
+		_total += pc.cycles;
+	}
+
+	std::stable_sort (_lines.begin (), _lines.end (), [] (const Line &a, const Line &b) {
+		return a.cycles > b.cycles;
+	});
+	if (!_lines.isEmpty ()) {
+		_max = _lines.first ().cycles;
+	}
+}
+/*}}}*/
+/*{{{  const QVector<AVRProfiler::Line> &AVRProfiler::lines (void) const*/
+/*
+ *	returns the lines that ran, most cycles first.
+ */
+const QVector<AVRProfiler::Line> &AVRProfiler::lines (void) const
+{
+	return _lines;
+}
+/*}}}*/
+/*{{{  quint64 AVRProfiler::totalCycles (void) const*/
+/*
+ *	returns the cycles counted (instructions only, not interrupt entry).
+ */
+quint64 AVRProfiler::totalCycles (void) const
+{
+	return _total;
+}
+/*}}}*/
+/*{{{  quint64 AVRProfiler::maxCycles (void) const*/
+/*
+ *	returns the cycles of the hottest line.
+ */
+quint64 AVRProfiler::maxCycles (void) const
+{
+	return _max;
+}
+/*}}}*/
+/*{{{  int AVRProfiler::heat (quint64 cycles, int levels) const*/
+/*
+ *	places a cycle count on a log scale against the hottest line.
+ *	returns 1..levels (levels for the hottest), or 0 for none.
+ */
+int AVRProfiler::heat (quint64 cycles, int levels) const
+{
+	if (!cycles || !_max) {
+		return 0;
+	}
+	if (_max == 1) {
+		return levels;
+	}
+	return 1 + (int)((levels - 1) * (log ((double)cycles) / log ((double)_max)) + 0.5);
+}
+/*}}}*/
+
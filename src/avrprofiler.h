@@ -0,0 +1,58 @@
+/*
+ *	avrprofiler.h -- simulator execution profile mapped to source lines.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRPROFILER_H
+#define AVRPROFILER_H
+
+#include <QVector>
+
+#include "avrsimulator.h"
+
+class AVRListingIndex;
+
+/*
+ *	Folds the simulator's per-word counts onto the main-file lines that placed them (through the
+ *	listing index).  Words the listing does not cover (included files, no listing yet) are kept
+ *	by address, with line -1.
+ */
+class AVRProfiler
+{
+public:
+	typedef struct Line {
+		int line;		/* 0-based main-file line, -1 if unknown */
+		quint32 address;	/* byte address of the first word counted */
+		quint64 executions;
+		quint64 cycles;
+	} Line;
+
+	AVRProfiler (const QVector<AVRSimulator::ProfileCount> &counts, const AVRListingIndex &index);
+
+	const QVector<Line> &lines (void) const;
+	quint64 totalCycles (void) const;
+	quint64 maxCycles (void) const;
+	int heat (quint64 cycles, int levels) const;
+
+private:
+	QVector<Line> _lines;		/* most cycles first */
+	quint64 _total;
+	quint64 _max;
+};
+
+#endif	/* !AVRPROFILER_H */
+
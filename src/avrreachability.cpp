@@ -0,0 +1,310 @@
+/*
+ *	avrreachability.cpp -- unreachable code and unused data tables.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QRegExp>
+
+#include "avrreachability.h"
+#include "avrasmflow.h"
+#include "avrdevice.h"
+
+/*{{{  AVRReachability::AVRReachability (const AVRASMFlow &flow, const AVRDeviceInfo *device)*/
+/*
+ *	constructor: works out what is reachable in the graph (which must outlive this); 'device' may
+ *	be null if not known.
+ */
+AVRReachability::AVRReachability (const AVRASMFlow &flow, const AVRDeviceInfo *device) : _flow (flow)
+{
+	QList<int> roots;
+
+	_reachable.fill (false, _flow.nodes ().count ());
+	findRoots (device, &roots);
+	walk (roots);
+	findBlocks ();
+	findTables ();
+}
+/*}}}*/
+/*{{{  bool AVRReachability::isReachable (int node) const*/
+/*
+ *	returns true if a flow node can be reached, false otherwise.
+ */
+bool AVRReachability::isReachable (int node) const
+{
+	return _reachable.at (node);
+}
+/*}}}*/
+/*{{{  const QList<AVRReachability::Block> &AVRReachability::unreachable (void) const*/
+/*
+ *	returns the runs of unreachable instructions, in address order.
+ */
+const QList<AVRReachability::Block> &AVRReachability::unreachable (void) const
+{
+	return _unreachable;
+}
+/*}}}*/
+/*{{{  const QList<AVRReachability::Table> &AVRReachability::unusedTables (void) const*/
+/*
+ *	returns the data tables nothing refers to, in program order.
+ */
+const QList<AVRReachability::Table> &AVRReachability::unusedTables (void) const
+{
+	return _tables;
+}
+/*}}}*/
+/*{{{  const QList<AVRReachability::Note> &AVRReachability::notes (void) const*/
+/*
+ *	returns things that limit the analysis (unannotated indirect jumps, unknown @targets).
+ */
+const QList<AVRReachability::Note> &AVRReachability::notes (void) const
+{
+	return _notes;
+}
+/*}}}*/
+/*{{{  int AVRReachability::unreachableBytes (void) const*/
+/*
+ *	returns the flash taken by unreachable code.
+ */
+int AVRReachability::unreachableBytes (void) const
+{
+	int bytes = 0;
+
+	for (const Block &b : _unreachable) {
+		bytes += b.bytes;
+	}
+	return bytes;
+}
+/*}}}*/
+
+/*{{{  void AVRReachability::findRoots (const AVRDeviceInfo *device, QList<int> *roots)*/
+/*
+ *	collects the vector slots, reads the @targets of indirect jumps, and (if any lack them) adds
+ *	the code labels whose address is taken.
+ */
+void AVRReachability::findRoots (const AVRDeviceInfo *device, QList<int> *roots)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	const AVRASMProgram &program = _flow.program ();
+	const QVector<AVRASMProgram::Line> &lines = program.lines ();
+	QRegExp targetsRE (";+\\s*@targets\\s+(.*)$");
+	bool addressTaken = false;
+
+	/*{{{  vectors: every slot can be entered by the hardware*/
+	if (device) {
+		for (int v=0; v<device->vectorCount; v++) {
+			int n = _flow.nodeAt (v * device->vectorSize * 2);
+
+			if (n >= 0) {
+				*roots << n;
+			}
+		}
+	} else if (_flow.nodeAt (0) >= 0) {
+		*roots << _flow.nodeAt (0);
+	}
+	/*}}}*/
+	/*{{{  indirect jumps and calls*/
+	for (int n=0; n<nodes.count (); n++) {
+		const AVRASMFlow::Node &node = nodes.at (n);
+		QString text = program.sourceText (node.index);
+		QString comment = text.mid (AVRASMConstants::stripComment (text).length ());
+		Note note;
+
+		if ((node.kind != AVRASMFlow::INDIRECT_JUMP) && (node.kind != AVRASMFlow::INDIRECT_CALL)) {
+			continue;
+		}
+		note.index = node.index;
+		if (targetsRE.indexIn (comment) < 0) {
+			note.text = QString ("%1 has no @targets, assuming any label whose address is taken").arg (node.mnemonic);
+			_notes << note;
+			addressTaken = true;
+			continue;
+		}
+		for (const QString &label : targetsRE.cap (1).split (QRegExp ("[\\s,]+"), QString::SkipEmptyParts)) {
+			int t = _flow.nodeForLabel (label);
+
+			if (t < 0) {
+				note.text = QString ("@targets: \"%1\" is not a code label").arg (label);
+				_notes << note;
+				continue;
+			}
+			_targets[n] << t;
+		}
+	}
+	/*}}}*/
+	/*{{{  labels whose address is taken, if we have to*/
+	if (!addressTaken) {
+		return;
+	}
+	for (int i=0; i<lines.count (); i++) {
+		const AVRASMProgram::Line &l = lines.at (i);
+		int n = _flow.nodeForIndex (i);
+
+		if (!l.stmt || l.stmt->mnemonic.isEmpty ()) {
+			continue;
+		}
+		if ((n >= 0) && (nodes.at (n).kind != AVRASMFlow::PLAIN) && (nodes.at (n).kind != AVRASMFlow::SKIP)) {
+			/* jumps and calls name their targets directly */
+			continue;
+		}
+		for (const QString &name : names (l.stmt->args)) {
+			int t = _flow.nodeForLabel (name);
+
+			if (t >= 0) {
+				*roots << t;
+			}
+		}
+	}
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  void AVRReachability::walk (const QList<int> &roots)*/
+/*
+ *	marks everything reachable from the roots.
+ */
+void AVRReachability::walk (const QList<int> &roots)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	QList<int> work = roots;
+
+	while (!work.isEmpty ()) {
+		int n = work.takeLast ();
+
+		if (_reachable.at (n)) {
+			continue;
+		}
+		_reachable[n] = true;
+		if (nodes.at (n).next >= 0) {
+			work << nodes.at (n).next;
+		}
+		if (nodes.at (n).target >= 0) {
+			work << nodes.at (n).target;
+		}
+		work << _targets.value (n);
+	}
+}
+/*}}}*/
+/*{{{  void AVRReachability::findBlocks (void)*/
+/*
+ *	groups unreachable nodes into runs of adjacent instructions.
+ */
+void AVRReachability::findBlocks (void)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	QHash<qint32, QString> labels;
+	int prev = -1;
+
+	for (const AVRASMProgram::Symbol &sym : _flow.program ().symbols ()) {
+		if (sym.section == AVRASMProgram::TEXT) {
+			labels.insert (sym.address, sym.name);
+		}
+	}
+	for (int n=0; n<nodes.count (); n++) {
+		const AVRASMFlow::Node &node = nodes.at (n);
+
+		if (_reachable.at (n)) {
+			prev = -1;
+			continue;
+		}
+		if ((prev < 0) || ((nodes.at (prev).address + nodes.at (prev).size) != node.address)) {
+			Block b;
+
+			b.firstIndex = node.index;
+			b.label = labels.value (node.address);
+			b.bytes = 0;
+			_unreachable << b;
+		}
+		_unreachable.last ().lastIndex = node.index;
+		_unreachable.last ().bytes += node.size;
+		prev = n;
+	}
+}
+/*}}}*/
+/*{{{  void AVRReachability::findTables (void)*/
+/*
+ *	finds the labelled runs of data, and keeps those that nothing live refers to.
+ */
+void AVRReachability::findTables (void)
+{
+	const QVector<AVRASMProgram::Line> &lines = _flow.program ().lines ();
+	QSet<QString> used;
+	QList<Table> tables;
+	QString label;
+	int labelIndex = -1;
+	bool open = false;
+
+	for (int i=0; i<lines.count (); i++) {
+		const AVRASMProgram::Line &l = lines.at (i);
+		int n = _flow.nodeForIndex (i);
+
+		if (!l.stmt) {
+			continue;
+		}
+		/*{{{  references (only from code that can run)*/
+		if (!l.stmt->mnemonic.isEmpty () && ((n < 0) || _reachable.at (n))) {
+			used += names (l.stmt->args);
+		}
+		/*}}}*/
+		/*{{{  tables: data after a label, up to the next label or anything else*/
+		if (!l.stmt->label.isEmpty ()) {
+			label = l.stmt->label;
+			labelIndex = i;
+			open = false;
+		}
+		if ((l.kind == AVRASMProgram::DATA_BYTES) && (l.size > 0) && !label.isEmpty ()) {
+			if (!open) {
+				Table t;
+
+				t.name = label;
+				t.section = l.section;
+				t.index = labelIndex;
+				t.bytes = 0;
+				tables << t;
+				open = true;
+			}
+			tables.last ().bytes += l.size;
+		} else if (l.kind != AVRASMProgram::BLANK) {
+			label.clear ();
+			open = false;
+		}
+		/*}}}*/
+	}
+
+	for (const Table &t : tables) {
+		if (!used.contains (t.name)) {
+			_tables << t;
+		}
+	}
+}
+/*}}}*/
+/*{{{  QSet<QString> AVRReachability::names (const QString &text) const*/
+/*
+ *	returns the identifiers in an operand list or expression.
+ */
+QSet<QString> AVRReachability::names (const QString &text) const
+{
+	QRegExp nameRE ("[A-Za-z_][A-Za-z0-9_]*");
+	QSet<QString> set;
+	int pos = 0;
+
+	while ((pos = nameRE.indexIn (text, pos)) >= 0) {
+		set << nameRE.cap (0);
+		pos += nameRE.matchedLength ();
+	}
+	return set;
+}
+/*}}}*/
+
@@ -0,0 +1,88 @@
+/*
+ *	avrreachability.h -- unreachable code and unused data tables.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRREACHABILITY_H
+#define AVRREACHABILITY_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "avrasmprogram.h"
+
+class AVRASMFlow;
+struct AVRDeviceInfo;
+
+/*
+ *	Code is reachable if some path leads to it from the reset or an interrupt vector (or from
+ *	address 0 when the device is not known).  An ijmp/icall is followed to the labels listed in a
+ *	"; @targets a, b, ..." comment on its line; if any indirect jump has no such list, every code
+ *	label whose address is taken (in an instruction operand or a data table) is assumed reachable
+ *	too, so nothing live is reported dead.  A data table (labelled .const, .const16 or .space) is
+ *	unused if no reachable instruction and no data or directive mentions its label.
+ */
+class AVRReachability
+{
+public:
+	typedef struct Block {
+		int firstIndex;		/* program lines, inclusive */
+		int lastIndex;
+		QString label;		/* label at or just before the start, or empty */
+		int bytes;
+	} Block;
+
+	typedef struct Table {
+		QString name;
+		AVRASMProgram::Section section;
+		int index;		/* program line of the label */
+		int bytes;
+	} Table;
+
+	typedef struct Note {
+		int index;
+		QString text;
+	} Note;
+
+	AVRReachability (const AVRASMFlow &flow, const AVRDeviceInfo *device);
+
+	bool isReachable (int node) const;
+	const QList<Block> &unreachable (void) const;
+	const QList<Table> &unusedTables (void) const;
+	const QList<Note> &notes (void) const;
+	int unreachableBytes (void) const;
+
+private:
+	void findRoots (const AVRDeviceInfo *device, QList<int> *roots);
+	void walk (const QList<int> &roots);
+	void findBlocks (void);
+	void findTables (void);
+	QSet<QString> names (const QString &text) const;
+
+	const AVRASMFlow &_flow;
+	QVector<bool> _reachable;	/* per flow node */
+	QHash<int, QList<int> > _targets;	/* indirect jump node -> annotated targets */
+	QList<Block> _unreachable;
+	QList<Table> _tables;
+	QList<Note> _notes;
+};
+
+#endif	/* !AVRREACHABILITY_H */
+
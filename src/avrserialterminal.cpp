@@ -0,0 +1,305 @@
+/*
+ *	avrserialterminal.cpp -- terminal on the simulated USART.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QVBoxLayout>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include "avrserialterminal.h"
+
+/* lines kept on view */
+#define TERMINAL_LINES	5000
+
+/* output held for a pseudo-terminal no one is reading, before the oldest is dropped */
+#define PTY_HELD_MAX	65536
+
+/*{{{  AVRSerialTerminal::AVRSerialTerminal (QWidget *parent)*/
+/*
+ *	constructor: no pseudo-terminal until asked for.
+ */
+AVRSerialTerminal::AVRSerialTerminal (QWidget *parent) : QWidget (parent)
+{
+	QVBoxLayout *vbox = new QVBoxLayout (this);
+	QHBoxLayout *line = new QHBoxLayout ();
+	QHBoxLayout *pty = new QHBoxLayout ();
+	QPushButton *clearButton = new QPushButton (tr ("Clear"));
+	QFont fixed ("Courier 10 Pitch", 10);
+
+	_ptyMaster = -1;
+	_ptySlave = -1;
+	_ptyRead = 0;
+	_ptyWrite = 0;
+
+	_view = new QPlainTextEdit ();
+	_view->setReadOnly (true);
+	_view->setFont (fixed);
+	_view->setMaximumBlockCount (TERMINAL_LINES);
+
+	_input = new QLineEdit ();
+	_input->setFont (fixed);
+	_input->setToolTip (tr ("Sent to the simulated USART on Enter"));
+	_ending = new QComboBox ();
+	_ending->addItem (tr ("LF"), QByteArray ("\n"));
+	_ending->addItem (tr ("CR"), QByteArray ("\r"));
+	_ending->addItem (tr ("CR LF"), QByteArray ("\r\n"));
+	_ending->addItem (tr ("None"), QByteArray ());
+	_ending->setCurrentIndex (QSettings ("unikent", "avr-asm-ide").value ("simSerialEnding", 0).toInt ());
+	line->addWidget (_input);
+	line->addWidget (_ending);
+	line->addWidget (clearButton);
+
+	_ptyBox = new QCheckBox (tr ("Pseudo-terminal"));
+	_ptyBox->setToolTip (tr ("Also pass the USART to and from a pseudo-terminal, for host programs to open"));
+	_ptyLabel = new QLabel ();
+	_ptyLabel->setTextInteractionFlags (Qt::TextSelectableByMouse);
+	pty->addWidget (_ptyBox);
+	pty->addWidget (_ptyLabel, 1);
+#ifndef Q_OS_UNIX
+	_ptyBox->setEnabled (false);
+#endif
+
+	vbox->addWidget (_view);
+	vbox->addLayout (line);
+	vbox->addLayout (pty);
+
+	connect (_input, SIGNAL (returnPressed ()), this, SLOT (sendLine ()));
+	connect (clearButton, SIGNAL (clicked ()), this, SLOT (clear ()));
+	connect (_ptyBox, SIGNAL (toggled (bool)), this, SLOT (setPty (bool)));
+}
+/*}}}*/
+/*{{{  AVRSerialTerminal::~AVRSerialTerminal ()*/
+/*
+ *	destructor: closes any pseudo-terminal, and keeps the line ending for next time.
+ */
+AVRSerialTerminal::~AVRSerialTerminal ()
+{
+	closePty ();
+	QSettings ("unikent", "avr-asm-ide").setValue ("simSerialEnding", _ending->currentIndex ());
+}
+/*}}}*/
+/*{{{  bool AVRSerialTerminal::openPty (QString *error)*/
+/*
+ *	opens a pseudo-terminal (raw, so bytes pass unchanged) and starts bridging it to the USART.
+ *	returns true on success, false otherwise (with the reason in 'error').
+ */
+bool AVRSerialTerminal::openPty (QString *error)
+{
+#ifdef Q_OS_UNIX
+	struct termios tio;
+	const char *name;
+
+	if (_ptyMaster >= 0) {
+		return true;
+	}
+	_ptyMaster = posix_openpt (O_RDWR | O_NOCTTY);
+	if ((_ptyMaster < 0) || grantpt (_ptyMaster) || unlockpt (_ptyMaster) || !(name = ptsname (_ptyMaster)) ||
+			((_ptySlave = ::open (name, O_RDWR | O_NOCTTY)) < 0)) {
+		if (error) {
+			*error = QString ("cannot open a pseudo-terminal: %1").arg (strerror (errno));
+		}
+		closePty ();
+		return false;
+	}
+	_ptyName = QString (name);
+	if (!tcgetattr (_ptySlave, &tio)) {
+		cfmakeraw (&tio);
+		tcsetattr (_ptySlave, TCSANOW, &tio);
+	}
+	fcntl (_ptyMaster, F_SETFL, fcntl (_ptyMaster, F_GETFL) | O_NONBLOCK);
+
+	_ptyRead = new QSocketNotifier (_ptyMaster, QSocketNotifier::Read, this);
+	connect (_ptyRead, SIGNAL (activated (int)), this, SLOT (readPty ()));
+	_ptyWrite = new QSocketNotifier (_ptyMaster, QSocketNotifier::Write, this);
+	_ptyWrite->setEnabled (false);
+	connect (_ptyWrite, SIGNAL (activated (int)), this, SLOT (writePty ()));
+	_ptyLabel->setText (_ptyName);
+	return true;
+#else
+	if (error) {
+		*error = QString ("pseudo-terminals need a Unix host");
+	}
+	return false;
+#endif
+}
+/*}}}*/
+/*{{{  void AVRSerialTerminal::closePty (void)*/
+/*
+ *	closes the pseudo-terminal, if open.
+ */
+void AVRSerialTerminal::closePty (void)
+{
+	delete _ptyRead;
+	delete _ptyWrite;
+	_ptyRead = 0;
+	_ptyWrite = 0;
+#ifdef Q_OS_UNIX
+	if (_ptySlave >= 0) {
+		::close (_ptySlave);
+	}
+	if (_ptyMaster >= 0) {
+		::close (_ptyMaster);
+	}
+#endif
+	_ptySlave = -1;
+	_ptyMaster = -1;
+	_ptyName = QString ();
+	_ptyOut.clear ();
+	_ptyLabel->setText (QString ());
+}
+/*}}}*/
+/*{{{  QString AVRSerialTerminal::ptyName (void) const*/
+/*
+ *	returns the device host programs open to reach the USART (empty if none).
+ */
+QString AVRSerialTerminal::ptyName (void) const
+{
+	return _ptyName;
+}
+/*}}}*/
+/*{{{  void AVRSerialTerminal::received (const QByteArray &bytes)*/
+/*
+ *	shows output from the USART (carriage returns dropped), and passes it to the pseudo-terminal.
+ */
+void AVRSerialTerminal::received (const QByteArray &bytes)
+{
+	QString text = QString::fromLatin1 (bytes.constData (), bytes.count ());
+	QScrollBar *bar = _view->verticalScrollBar ();
+	bool atEnd = (bar->value () == bar->maximum ());
+
+	text.remove (QChar ('\r'));
+	_view->moveCursor (QTextCursor::End);
+	_view->insertPlainText (text);
+	if (atEnd) {
+		bar->setValue (bar->maximum ());
+	}
+	if (_ptyMaster >= 0) {
+		_ptyOut.append (bytes);
+		if (_ptyOut.count () > PTY_HELD_MAX) {
+			/* no one is reading: lost, as on a real line */
+			_ptyOut.remove (0, _ptyOut.count () - PTY_HELD_MAX);
+		}
+		writePty ();
+	}
+}
+/*}}}*/
+/*{{{  void AVRSerialTerminal::clear (void)*/
+/*
+ *	clears the view.
+ */
+void AVRSerialTerminal::clear (void)
+{
+	_view->clear ();
+}
+/*}}}*/
+
+/*{{{  void AVRSerialTerminal::sendLine (void)*/
+/*
+ *	sends the line typed, with the line ending chosen.
+ */
+void AVRSerialTerminal::sendLine (void)
+{
+	QByteArray bytes = _input->text ().toLatin1 ();
+
+	bytes.append (_ending->itemData (_ending->currentIndex ()).toByteArray ());
+	_input->clear ();
+	if (!bytes.isEmpty ()) {
+		emit send (bytes);
+	}
+}
+/*}}}*/
+/*{{{  void AVRSerialTerminal::setPty (bool enabled)*/
+/*
+ *	opens or closes the pseudo-terminal, as the check box asks.
+ */
+void AVRSerialTerminal::setPty (bool enabled)
+{
+	QString err;
+
+	if (!enabled) {
+		closePty ();
+		return;
+	}
+	if (!openPty (&err)) {
+		emit message (err);
+		_ptyBox->setChecked (false);
+		return;
+	}
+	emit message (QString ("serial terminal: simulated USART on %1").arg (_ptyName));
+}
+/*}}}*/
+/*{{{  void AVRSerialTerminal::readPty (void)*/
+/*
+ *	called when a host program has written to the pseudo-terminal: sends it all on in one go.
+ */
+void AVRSerialTerminal::readPty (void)
+{
+#ifdef Q_OS_UNIX
+	QByteArray bytes;
+	char buf[4096];
+	ssize_t n;
+
+	while ((n = ::read (_ptyMaster, buf, sizeof (buf))) > 0) {
+		bytes.append (buf, n);
+	}
+	if (!bytes.isEmpty ()) {
+		emit send (bytes);
+	}
+#endif
+}
+/*}}}*/
+/*{{{  void AVRSerialTerminal::writePty (void)*/
+/*
+ *	writes as much waiting output to the pseudo-terminal as it takes, and watches for room for
+ *	the rest.
+ */
+void AVRSerialTerminal::writePty (void)
+{
+#ifdef Q_OS_UNIX
+	while (!_ptyOut.isEmpty ()) {
+		ssize_t n = ::write (_ptyMaster, _ptyOut.constData (), _ptyOut.count ());
+
+		if (n <= 0) {
+			break;
+		}
+		_ptyOut.remove (0, n);
+	}
+	if (_ptyWrite) {
+		_ptyWrite->setEnabled (!_ptyOut.isEmpty ());
+	}
+#endif
+}
+/*}}}*/
+
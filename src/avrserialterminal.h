@@ -0,0 +1,81 @@
+/*
+ *	avrserialterminal.h -- terminal on the simulated USART.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRSERIALTERMINAL_H
+#define AVRSERIALTERMINAL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QWidget>
+
+class QCheckBox;
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QPlainTextEdit;
+class QSocketNotifier;
+
+/*
+ *	Shows what the simulated firmware sends on its USART as it arrives (in batches, as the
+ *	simulator panel samples it), and sends it a typed line with the chosen line ending.  On Unix
+ *	it can also bridge the USART to a pseudo-terminal, whose other side host scripts open as they
+ *	would a board's serial port.
+ */
+class AVRSerialTerminal : public QWidget
+{
+	Q_OBJECT
+
+public:
+	AVRSerialTerminal (QWidget *parent = 0);
+	~AVRSerialTerminal ();
+
+	bool openPty (QString *error = 0);
+	void closePty (void);
+	QString ptyName (void) const;
+
+public slots:
+	void received (const QByteArray &bytes);
+	void clear (void);
+
+signals:
+	void send (QByteArray);
+	void message (QString);
+
+private slots:
+	void sendLine (void);
+	void setPty (bool enabled);
+	void readPty (void);
+	void writePty (void);
+
+private:
+	QPlainTextEdit *_view;
+	QLineEdit *_input;
+	QComboBox *_ending;
+	QCheckBox *_ptyBox;
+	QLabel *_ptyLabel;
+	int _ptyMaster;			/* -1 when no pseudo-terminal */
+	int _ptySlave;			/* kept open, so host programs can come and go */
+	QString _ptyName;
+	QSocketNotifier *_ptyRead;
+	QSocketNotifier *_ptyWrite;	/* enabled while output is waiting */
+	QByteArray _ptyOut;		/* for the pseudo-terminal, not yet taken */
+};
+
+#endif	/* !AVRSERIALTERMINAL_H */
+
@@ -0,0 +1,2101 @@
+/*
+ *	avrsimulator.cpp -- cycle-accurate AVR core simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include <QElapsedTimer>
+
+#include "avrsimulator.h"
+#include "avrdecoder.h"
+#include "avrheximage.h"
+#include "avrtracerecorder.h"
+
+/* SPMCSR bits */
+#define SPM_SPMEN	0x01
+#define SPM_PGERS	0x02
+#define SPM_PGWRT	0x04
+#define SPM_RWWSRE	0x10
+
+/* data-space bytes per checkpoint page */
+#define HISTORY_PAGE	128
+
+/* how far before the current cycle stepBack() runs to at full speed, more than any instruction
+ * plus interrupt response takes */
+#define STEP_BACK_MARGIN	32
+
+/* bit of _pending (past any vector) that stops the core at the next instruction boundary */
+#define PENDING_HALT	((quint64)1 << 63)
+
+/* EECR bits */
+#define EE_EERE		0x01
+#define EE_EEPE		0x02
+#define EE_EEMPE	0x04
+#define EE_EEPM		0x30
+
+/*{{{  static inline quint8 logicFlags (quint8 sreg, quint8 res)*/
+/*
+ *	flags after and/or/eor/com and friends: V cleared, N and Z from the result, S = N.
+ */
+static inline quint8 logicFlags (quint8 sreg, quint8 res)
+{
+	sreg &= ~(AVRSimulator::SREG_V | AVRSimulator::SREG_N | AVRSimulator::SREG_Z | AVRSimulator::SREG_S);
+	if (res & 0x80) {
+		sreg |= AVRSimulator::SREG_N | AVRSimulator::SREG_S;
+	}
+	if (!res) {
+		sreg |= AVRSimulator::SREG_Z;
+	}
+	return sreg;
+}
+/*}}}*/
+/*{{{  static inline quint8 addFlags (quint8 sreg, quint8 d, quint8 r, int carry, quint8 *res)*/
+/*
+ *	d + r + carry, setting H, S, V, N, Z, C.
+ */
+static inline quint8 addFlags (quint8 sreg, quint8 d, quint8 r, int carry, quint8 *res)
+{
+	int sum = d + r + carry;
+	quint8 v = (quint8)sum;
+
+	sreg &= ~(AVRSimulator::SREG_H | AVRSimulator::SREG_S | AVRSimulator::SREG_V | AVRSimulator::SREG_N |
+			AVRSimulator::SREG_Z | AVRSimulator::SREG_C);
+	if (((d & 0x0f) + (r & 0x0f) + carry) & 0x10) {
+		sreg |= AVRSimulator::SREG_H;
+	}
+	if (sum & 0x100) {
+		sreg |= AVRSimulator::SREG_C;
+	}
+	if (~(d ^ r) & (d ^ v) & 0x80) {
+		sreg |= AVRSimulator::SREG_V;
+	}
+	if (v & 0x80) {
+		sreg |= AVRSimulator::SREG_N;
+	}
+	if (!v) {
+		sreg |= AVRSimulator::SREG_Z;
+	}
+	if (!(sreg & AVRSimulator::SREG_N) != !(sreg & AVRSimulator::SREG_V)) {
+		sreg |= AVRSimulator::SREG_S;
+	}
+	*res = v;
+	return sreg;
+}
+/*}}}*/
+/*{{{  static inline quint8 subFlags (quint8 sreg, quint8 d, quint8 r, int carry, bool keepZ, quint8 *res)*/
+/*
+ *	d - r - carry, setting H, S, V, N, Z, C.  With 'keepZ' (sbc, sbci, cpc) Z can only be cleared.
+ */
+static inline quint8 subFlags (quint8 sreg, quint8 d, quint8 r, int carry, bool keepZ, quint8 *res)
+{
+	int diff = d - r - carry;
+	quint8 v = (quint8)diff;
+	bool z = !v && (!keepZ || (sreg & AVRSimulator::SREG_Z));
+
+	sreg &= ~(AVRSimulator::SREG_H | AVRSimulator::SREG_S | AVRSimulator::SREG_V | AVRSimulator::SREG_N |
+			AVRSimulator::SREG_Z | AVRSimulator::SREG_C);
+	if ((d & 0x0f) < ((r & 0x0f) + carry)) {
+		sreg |= AVRSimulator::SREG_H;
+	}
+	if (diff < 0) {
+		sreg |= AVRSimulator::SREG_C;
+	}
+	if ((d ^ r) & (d ^ v) & 0x80) {
+		sreg |= AVRSimulator::SREG_V;
+	}
+	if (v & 0x80) {
+		sreg |= AVRSimulator::SREG_N;
+	}
+	if (z) {
+		sreg |= AVRSimulator::SREG_Z;
+	}
+	if (!(sreg & AVRSimulator::SREG_N) != !(sreg & AVRSimulator::SREG_V)) {
+		sreg |= AVRSimulator::SREG_S;
+	}
+	*res = v;
+	return sreg;
+}
+/*}}}*/
+/*{{{  static inline quint8 shiftFlags (quint8 sreg, quint8 res, bool carry)*/
+/*
+ *	flags after a right shift or rotate: C from the bit shifted out, V = N ^ C, S = N ^ V.
+ */
+static inline quint8 shiftFlags (quint8 sreg, quint8 res, bool carry)
+{
+	bool n = (res & 0x80);
+	bool v = n != carry;
+
+	sreg &= ~(AVRSimulator::SREG_S | AVRSimulator::SREG_V | AVRSimulator::SREG_N | AVRSimulator::SREG_Z | AVRSimulator::SREG_C);
+	if (carry) {
+		sreg |= AVRSimulator::SREG_C;
+	}
+	if (n) {
+		sreg |= AVRSimulator::SREG_N;
+	}
+	if (v) {
+		sreg |= AVRSimulator::SREG_V;
+	}
+	if (n != v) {
+		sreg |= AVRSimulator::SREG_S;
+	}
+	if (!res) {
+		sreg |= AVRSimulator::SREG_Z;
+	}
+	return sreg;
+}
+/*}}}*/
+/*{{{  static inline quint8 mulFlags (quint8 sreg, quint16 res, bool carry)*/
+/*
+ *	flags after a multiply: C from bit 15 of the product, Z if the result is zero.
+ */
+static inline quint8 mulFlags (quint8 sreg, quint16 res, bool carry)
+{
+	sreg &= ~(AVRSimulator::SREG_Z | AVRSimulator::SREG_C);
+	if (carry) {
+		sreg |= AVRSimulator::SREG_C;
+	}
+	if (!res) {
+		sreg |= AVRSimulator::SREG_Z;
+	}
+	return sreg;
+}
+/*}}}*/
+
+/*{{{  static inline quint8 wordFlags (quint8 sreg, quint16 res, bool overflow, bool carry)*/
+/*
+ *	flags after adiw/sbiw: V and C as worked out by the caller, N from bit 15, Z, S = N ^ V.
+ */
+static inline quint8 wordFlags (quint8 sreg, quint16 res, bool overflow, bool carry)
+{
+	sreg &= ~(AVRSimulator::SREG_S | AVRSimulator::SREG_V | AVRSimulator::SREG_N | AVRSimulator::SREG_Z | AVRSimulator::SREG_C);
+	if (overflow) {
+		sreg |= AVRSimulator::SREG_V;
+	}
+	if (carry) {
+		sreg |= AVRSimulator::SREG_C;
+	}
+	if (res & 0x8000) {
+		sreg |= AVRSimulator::SREG_N;
+	}
+	if (!res) {
+		sreg |= AVRSimulator::SREG_Z;
+	}
+	if (!(sreg & AVRSimulator::SREG_N) != !(sreg & AVRSimulator::SREG_V)) {
+		sreg |= AVRSimulator::SREG_S;
+	}
+	return sreg;
+}
+/*}}}*/
+
+/*{{{  AVRSimulator::AVRSimulator (const AVRDeviceInfo &device)*/
+/*
+ *	constructor: flash and EEPROM start erased, and the core is reset.
+ */
+AVRSimulator::AVRSimulator (const AVRDeviceInfo &device) : _device (device)
+{
+	QVector<int> special;
+
+	_pc22 = (device.flashSize > 131072);
+	_flash.fill (0xffff, device.flashSize / 2);
+	_eeprom.fill (0xff, device.eepromSize);
+	_data.fill (0, device.sramStart + device.sramSize);
+	_pageBuffer.fill (0xffff, device.flashPageSize / 2);
+	_code.resize (_flash.count () + 2);
+	for (int i=_flash.count (); i<_code.count (); i++) {
+		/* past the end: wraps round to the start */
+		_code[i].handler = 0;
+		_code[i].k = 0;
+		_code[i].op = AVRDecoder::OP_COUNT;
+		_code[i].d = _code[i].r = _code[i].b = 0;
+		_code[i].words = 1;
+	}
+	_dirtyFirst = _flash.count ();
+	_dirtyLast = _code.count () - 1;
+	predecode (0, _flash.count () - 1);
+	_breakpoints.fill (0, _code.count ());
+	_breakpointCount = 0;
+	_passBreakpoint = false;
+	_watch.fill (0, _data.count ());
+	_watchCount = 0;
+	_watchAddress = 0;
+	_watchKind = 0;
+	_replaying = false;
+	_profiling = false;
+	_trace = 0;
+	_historyInterval = 0;
+	_historyLimit = 0;
+	_historyBytes = 0;
+	_nextCheckpoint = 0;
+	_ioSpecial.fill (0, device.sramStart);
+	_io.attach (device, _data.data (), &_pending);
+	special = _io.addresses ();
+	special << IO_EECR << IO_SPMCSR;
+	for (int a : special) {
+		if (a < device.sramStart) {
+			_ioSpecial[a] = 1;
+		}
+	}
+	reset ();
+}
+/*}}}*/
+/*{{{  const AVRDeviceInfo &AVRSimulator::device (void) const*/
+/*
+ *	returns the device being simulated.
+ */
+const AVRDeviceInfo &AVRSimulator::device (void) const
+{
+	return _device;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::loadFlash (const AVRHexImage &image)*/
+/*
+ *	copies a flash image in (as much as fits).
+ */
+void AVRSimulator::loadFlash (const AVRHexImage &image)
+{
+	int words = qMin (image.size (), _device.flashSize) / 2;
+
+	_flash.fill (0xffff);
+	for (int i=0; i<words; i++) {
+		_flash[i] = image.wordAt (i);
+	}
+	predecode (0, _flash.count () - 1);
+	clearHistory ();
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  void AVRSimulator::loadEeprom (const AVRHexImage &image)*/
+/*
+ *	copies an EEPROM image in (as much as fits).
+ */
+void AVRSimulator::loadEeprom (const AVRHexImage &image)
+{
+	int bytes = qMin (image.size (), _device.eepromSize);
+
+	_eeprom.fill (0xff);
+	for (int i=0; i<bytes; i++) {
+		_eeprom[i] = image.byteAt (i);
+	}
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  void AVRSimulator::reset (void)*/
+/*
+ *	power-on reset: registers, I/O and SRAM cleared, SP at the top of SRAM, PC at 0.  Flash and
+ *	EEPROM keep their contents.
+ */
+void AVRSimulator::reset (void)
+{
+	quint16 ramEnd = _device.sramStart + _device.sramSize - 1;
+
+	_data.fill (0);
+	_data[IO_SPL] = ramEnd & 0xff;
+	_data[IO_SPH] = ramEnd >> 8;
+	_pageBuffer.fill (0xffff);
+	clearProfile ();
+	_pc = 0;
+	_cycles = 0;
+	_instructions = 0;
+	_sleeping = false;
+	_inhibit = false;
+	_pending = 0;
+	_io.reset ();
+	_nextEvent = _io.nextEvent ();
+	_stop = STOP_NONE;
+	clearHistory ();
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  AVRSimulator::StopReason AVRSimulator::run (quint64 cycles)*/
+/*
+ *	runs for (at least) the given number of cycles, or until something stops it, taking
+ *	checkpoints on the way if history is on.
+ *	returns why it stopped.
+ */
+AVRSimulator::StopReason AVRSimulator::run (quint64 cycles)
+{
+	quint64 end = _cycles + cycles;
+
+	_stop = STOP_NONE;
+	while ((_stop == STOP_NONE) && (_cycles < end)) {
+		if (_historyInterval && (_nextCheckpoint < end)) {
+			execute (_nextCheckpoint);
+			if (_cycles >= _nextCheckpoint) {
+				checkpoint ();
+			}
+		} else {
+			execute (end);
+		}
+	}
+	if (_stop == STOP_NONE) {
+		_stop = STOP_LIMIT;
+	}
+	return _stop;
+}
+/*}}}*/
+/*{{{  AVRSimulator::StopReason AVRSimulator::step (void)*/
+/*
+ *	runs one instruction (and takes an interrupt after it, if one is due), or takes an interrupt
+ *	already waiting.  A breakpoint on the instruction at the PC does not stop it.
+ *	returns STOP_LIMIT, or why it could not.
+ */
+AVRSimulator::StopReason AVRSimulator::step (void)
+{
+	_passBreakpoint = true;
+	return run (1);
+}
+/*}}}*/
+/*{{{  quint32 AVRSimulator::pc (void) const*/
+/*
+ *	returns the program counter (words).
+ */
+quint32 AVRSimulator::pc (void) const
+{
+	return _pc;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setPC (quint32 pc)*/
+/*
+ *	sets the program counter (words).
+ */
+void AVRSimulator::setPC (quint32 pc)
+{
+	_pc = pc % _flash.count ();
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  quint64 AVRSimulator::cycles (void) const*/
+/*
+ *	returns the cycles run since reset.
+ */
+quint64 AVRSimulator::cycles (void) const
+{
+	return _cycles;
+}
+/*}}}*/
+/*{{{  quint64 AVRSimulator::instructions (void) const*/
+/*
+ *	returns the instructions run since reset.
+ */
+quint64 AVRSimulator::instructions (void) const
+{
+	return _instructions;
+}
+/*}}}*/
+/*{{{  AVRSimulator::StopReason AVRSimulator::stopReason (void) const*/
+/*
+ *	returns why the last run or step stopped.
+ */
+AVRSimulator::StopReason AVRSimulator::stopReason (void) const
+{
+	return _stop;
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::isSleeping (void) const*/
+/*
+ *	returns true if the core is in a sleep mode.
+ */
+bool AVRSimulator::isSleeping (void) const
+{
+	return _sleeping;
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::reg (int r) const*/
+/*
+ *	returns a register.
+ */
+quint8 AVRSimulator::reg (int r) const
+{
+	return _data.at (r & 0x1f);
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setReg (int r, quint8 value)*/
+/*
+ *	sets a register.
+ */
+void AVRSimulator::setReg (int r, quint8 value)
+{
+	_data[r & 0x1f] = value;
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::sreg (void) const*/
+/*
+ *	returns the status register.
+ */
+quint8 AVRSimulator::sreg (void) const
+{
+	return _data.at (IO_SREG);
+}
+/*}}}*/
+/*{{{  quint16 AVRSimulator::sp (void) const*/
+/*
+ *	returns the stack pointer.
+ */
+quint16 AVRSimulator::sp (void) const
+{
+	return _data.at (IO_SPL) | (_data.at (IO_SPH) << 8);
+}
+/*}}}*/
+/*{{{  int AVRSimulator::dataSize (void) const*/
+/*
+ *	returns the size of the data space (registers, I/O and SRAM).
+ */
+int AVRSimulator::dataSize (void) const
+{
+	return _data.count ();
+}
+/*}}}*/
+/*{{{  const quint8 *AVRSimulator::dataSpace (void) const*/
+/*
+ *	returns the whole data space (dataSize() bytes), for copying out in one go.
+ */
+const quint8 *AVRSimulator::dataSpace (void) const
+{
+	return _data.constData ();
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::dataAt (int addr) const*/
+/*
+ *	returns a byte of the data space, without the side effects a read by the program would have.
+ */
+quint8 AVRSimulator::dataAt (int addr) const
+{
+	return ((addr >= 0) && (addr < _data.count ())) ? _data.at (addr) : 0;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setDataAt (int addr, quint8 value)*/
+/*
+ *	sets a byte of the data space, without side effects.
+ */
+void AVRSimulator::setDataAt (int addr, quint8 value)
+{
+	if ((addr >= 0) && (addr < _data.count ())) {
+		_data[addr] = value;
+		checkpoint ();
+	}
+}
+/*}}}*/
+/*{{{  quint16 AVRSimulator::flashWord (quint32 wordAddr) const*/
+/*
+ *	returns a word of flash.
+ */
+quint16 AVRSimulator::flashWord (quint32 wordAddr) const
+{
+	return _flash.at (wordAddr % _flash.count ());
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::eepromAt (int addr) const*/
+/*
+ *	returns a byte of EEPROM.
+ */
+quint8 AVRSimulator::eepromAt (int addr) const
+{
+	return ((addr >= 0) && (addr < _eeprom.count ())) ? _eeprom.at (addr) : 0xff;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setEepromAt (int addr, quint8 value)*/
+/*
+ *	sets a byte of EEPROM.
+ */
+void AVRSimulator::setEepromAt (int addr, quint8 value)
+{
+	if ((addr >= 0) && (addr < _eeprom.count ())) {
+		_eeprom[addr] = value;
+		checkpoint ();
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulator::writeFlash (quint32 addr, const QByteArray &bytes)*/
+/*
+ *	overwrites flash from a byte address (as a programmer would, so without erasing first), and
+ *	decodes the words changed again.  Bytes past the end of flash are dropped.
+ */
+void AVRSimulator::writeFlash (quint32 addr, const QByteArray &bytes)
+{
+	quint32 flashBytes = _flash.count () * 2;
+	quint32 end = qMin (flashBytes, addr + bytes.count ());
+
+	if ((addr >= flashBytes) || bytes.isEmpty ()) {
+		return;
+	}
+	for (quint32 a=addr; a<end; a++) {
+		quint16 &w = _flash[a >> 1];
+		quint8 b = bytes.at (a - addr);
+
+		w = (a & 1) ? ((w & 0x00ff) | (b << 8)) : ((w & 0xff00) | b);
+	}
+	predecode ((addr >> 1) ? (addr >> 1) - 1 : 0, (end - 1) >> 1);
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::setBreakpoint (quint32 wordAddr, bool on)*/
+/*
+ *	sets or clears a breakpoint: run() stops with STOP_BREAKPOINT on reaching the instruction at
+ *	a flash word address, before running it.
+ *	returns true on success, false if the address is outside flash.
+ */
+bool AVRSimulator::setBreakpoint (quint32 wordAddr, bool on)
+{
+	if (wordAddr >= (quint32)_flash.count ()) {
+		return false;
+	}
+	if (!_breakpoints.at (wordAddr) != !on) {
+		_breakpoints[wordAddr] = on;
+		_breakpointCount += on ? 1 : -1;
+		/* execute() links the instruction again, with or without the breakpoint */
+		_dirtyFirst = qMin (_dirtyFirst, wordAddr);
+		_dirtyLast = qMax (_dirtyLast, wordAddr);
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::clearBreakpoints (void)*/
+/*
+ *	removes all breakpoints.
+ */
+void AVRSimulator::clearBreakpoints (void)
+{
+	for (quint32 i=0; _breakpointCount && (i<(quint32)_flash.count ()); i++) {
+		if (_breakpoints.at (i)) {
+			setBreakpoint (i, false);
+		}
+	}
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::setWatchpoint (quint32 addr, int len, int kinds, bool on)*/
+/*
+ *	starts or stops watching 'len' bytes of the data space for the program's reads and/or writes
+ *	(WATCH_READ, WATCH_WRITE): run() stops with STOP_WATCHPOINT after the instruction that makes
+ *	one.  Registers are not watched (the core uses them directly), nor are the stack pushes an
+ *	interrupt makes.
+ *	returns true on success, false if the range is outside the data space.
+ */
+bool AVRSimulator::setWatchpoint (quint32 addr, int len, int kinds, bool on)
+{
+	if ((len <= 0) || (addr >= (quint32)_data.count ()) || ((quint32)len > _data.count () - addr)) {
+		return false;
+	}
+	for (quint32 a=addr; a<addr+len; a++) {
+		char was = _watch.at (a);
+
+		_watch[a] = on ? (was | kinds) : (was & ~kinds);
+		_watchCount += (_watch.at (a) ? 1 : 0) - (was ? 1 : 0);
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::clearWatchpoints (void)*/
+/*
+ *	removes all watchpoints.
+ */
+void AVRSimulator::clearWatchpoints (void)
+{
+	_watch.fill (0);
+	_watchCount = 0;
+}
+/*}}}*/
+/*{{{  quint32 AVRSimulator::watchAddress (void) const*/
+/*
+ *	returns the data address of the last watchpoint hit.
+ */
+quint32 AVRSimulator::watchAddress (void) const
+{
+	return _watchAddress;
+}
+/*}}}*/
+/*{{{  int AVRSimulator::watchKind (void) const*/
+/*
+ *	returns how the last watchpoint hit was made (WATCH_READ or WATCH_WRITE).
+ */
+int AVRSimulator::watchKind (void) const
+{
+	return _watchKind;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setProfiling (bool enabled)*/
+/*
+ *	turns counting of executions and cycles per instruction on or off (counts so far are kept
+ *	while on, dropped when turned off).
+ */
+void AVRSimulator::setProfiling (bool enabled)
+{
+	_profiling = enabled;
+	if (!enabled) {
+		_profile.clear ();
+	} else if (_profile.isEmpty ()) {
+		clearProfile ();
+	}
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::isProfiling (void) const*/
+/*
+ *	returns true if profiling.
+ */
+bool AVRSimulator::isProfiling (void) const
+{
+	return _profiling;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::clearProfile (void)*/
+/*
+ *	zeroes the profile counts.
+ */
+void AVRSimulator::clearProfile (void)
+{
+	if (_profiling) {
+		ProfileCount zero = {0, 0};
+
+		_profile.fill (zero, _flash.count ());
+	}
+}
+/*}}}*/
+/*{{{  const QVector<AVRSimulator::ProfileCount> &AVRSimulator::profile (void) const*/
+/*
+ *	returns the profile: executions and cycles (including taken branches and skips) per flash word
+ *	address, empty if not profiling.
+ */
+const QVector<AVRSimulator::ProfileCount> &AVRSimulator::profile (void) const
+{
+	return _profile;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setTrace (AVRTraceRecorder *trace)*/
+/*
+ *	records every instruction run, and every data-space write the program makes, into 'trace'
+ *	(0 to stop).  The recorder must have been opened at the current cycle and PC.
+ */
+void AVRSimulator::setTrace (AVRTraceRecorder *trace)
+{
+	_trace = trace;
+}
+/*}}}*/
+/*{{{  AVRTraceRecorder *AVRSimulator::trace (void) const*/
+/*
+ *	returns the trace recorder in use (0 if none).
+ */
+AVRTraceRecorder *AVRSimulator::trace (void) const
+{
+	return _trace;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::raiseInterrupt (int vector)*/
+/*
+ *	marks an interrupt as waiting (taken when the I flag allows); wakes the core from sleep.
+ */
+void AVRSimulator::raiseInterrupt (int vector)
+{
+	if ((vector > 0) && (vector < _device.vectorCount)) {
+		_pending |= ((quint64)1 << vector);
+		checkpoint ();
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulator::clearInterrupt (int vector)*/
+/*
+ *	withdraws a waiting interrupt (its flag was cleared).
+ */
+void AVRSimulator::clearInterrupt (int vector)
+{
+	if ((vector > 0) && (vector < _device.vectorCount)) {
+		_pending &= ~((quint64)1 << vector);
+		checkpoint ();
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulator::serialInput (const QByteArray &bytes)*/
+/*
+ *	sends bytes to the USART from outside; they arrive a frame time apart from now.
+ */
+void AVRSimulator::serialInput (const QByteArray &bytes)
+{
+	_io.serialInput (bytes, _cycles);
+	_nextEvent = _io.nextEvent ();
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  QByteArray AVRSimulator::takeSerialOutput (void)*/
+/*
+ *	returns the bytes the USART has sent since last asked.
+ */
+QByteArray AVRSimulator::takeSerialOutput (void)
+{
+	return _io.takeSerialOutput ();
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::setPin (char port, int bit, bool high)*/
+/*
+ *	drives an input pin from outside (external interrupts see the change straight away).
+ *	returns true on success, false otherwise (not a pin the simulator models).
+ */
+bool AVRSimulator::setPin (char port, int bit, bool high)
+{
+	if (!_io.setPin (port, bit, high)) {
+		return false;
+	}
+	checkpoint ();
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::setHistory (quint64 interval, int maxBytes)*/
+/*
+ *	turns history on, checkpointing every 'interval' cycles in at most 'maxBytes' (the oldest
+ *	checkpoints go first), or off if 'interval' is 0.  History starts again from here.
+ */
+void AVRSimulator::setHistory (quint64 interval, int maxBytes)
+{
+	_historyInterval = interval;
+	_historyLimit = maxBytes;
+	clearHistory ();
+	checkpoint ();
+}
+/*}}}*/
+/*{{{  quint64 AVRSimulator::historyStart (void) const*/
+/*
+ *	returns the earliest cycle rewind() can reach.
+ */
+quint64 AVRSimulator::historyStart (void) const
+{
+	return _history.isEmpty () ? _cycles : _history.first ().cycles;
+}
+/*}}}*/
+/*{{{  int AVRSimulator::historyBytes (void) const*/
+/*
+ *	returns the memory the checkpoints hold.
+ */
+int AVRSimulator::historyBytes (void) const
+{
+	return _historyBytes;
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::rewind (quint64 cycle)*/
+/*
+ *	goes back to the first instruction boundary at or after an earlier cycle, by running forwards
+ *	from the checkpoint before it (not profiled or traced).  History after that point is lost.
+ *	returns true on success, false if history does not go back that far.
+ */
+bool AVRSimulator::rewind (quint64 cycle)
+{
+	int i = checkpointBefore (cycle + 1);
+	bool profiling = _profiling;
+	AVRTraceRecorder *trace = _trace;
+	QByteArray sent;
+
+	if ((i < 0) || (cycle > _cycles)) {
+		return false;
+	}
+	restore (i);
+	sent = _io.takeSerialOutput ();
+	_profiling = false;
+	_trace = 0;
+	_replaying = true;
+	if (cycle > _cycles) {
+		run (cycle - _cycles);
+	}
+	/* the serial output run again was sent the first time round */
+	_io.setSerialOutput (sent);
+	_profiling = profiling;
+	_trace = trace;
+	_replaying = false;
+	_stop = STOP_LIMIT;
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRSimulator::stepBack (void)*/
+/*
+ *	undoes the last instruction (or interrupt response): runs forwards from the checkpoint before
+ *	it to find where it started, then rewinds to there.
+ *	returns true on success, false if history does not go back that far.
+ */
+bool AVRSimulator::stepBack (void)
+{
+	quint64 target = _cycles;
+	quint64 start;
+	int i = checkpointBefore (target);
+	bool profiling = _profiling;
+	AVRTraceRecorder *trace = _trace;
+	QByteArray sent;
+
+	if (i < 0) {
+		return false;
+	}
+	restore (i);
+	sent = _io.takeSerialOutput ();
+	_profiling = false;
+	_trace = 0;
+	_replaying = true;
+	if (target - _cycles > STEP_BACK_MARGIN) {
+		run (target - _cycles - STEP_BACK_MARGIN);
+	}
+	if (_cycles >= target) {
+		/* cannot happen if the margin is big enough, but start over carefully if it does */
+		restore (i);
+	}
+	start = _cycles;
+	while (_cycles < target) {
+		start = _cycles;
+		if (step () != STOP_LIMIT) {
+			break;
+		}
+	}
+	_io.setSerialOutput (sent);
+	_profiling = profiling;
+	_trace = trace;
+	_replaying = false;
+	return rewind (start);
+}
+/*}}}*/
+/*{{{  QString AVRSimulator::stopReasonName (StopReason reason)*/
+/*
+ *	returns a short description of why a run stopped.
+ */
+QString AVRSimulator::stopReasonName (StopReason reason)
+{
+	switch (reason) {
+	case STOP_NONE:
+		return QString ("running");
+	case STOP_LIMIT:
+		return QString ("cycle limit");
+	case STOP_BREAK:
+		return QString ("break instruction");
+	case STOP_SLEEP:
+		return QString ("asleep with nothing to wake it");
+	case STOP_INVALID:
+		return QString ("invalid instruction");
+	case STOP_BREAKPOINT:
+		return QString ("breakpoint");
+	case STOP_WATCHPOINT:
+		return QString ("watchpoint");
+	}
+	return QString ("?");
+}
+/*}}}*/
+/*{{{  QString AVRSimulator::benchmark (int msecs)*/
+/*
+ *	runs a fixed loop (ALU, load/store, branch, call/return) on an ATmega328P for about 'msecs'
+ *	milliseconds of real time.
+ *	returns a one-line report of the instruction and cycle rates.
+ */
+QString AVRSimulator::benchmark (int msecs)
+{
+	static const quint16 words[] = {
+		0xe000,		/* 	ldi	r16, 0x00 */
+		0xe011,		/* 	ldi	r17, 0x01 */
+		0xe0a0,		/* 	ldi	r26, lo(0x100) */
+		0xe0b1,		/* 	ldi	r27, hi(0x100) */
+		0x0f01,		/* loop:	add	r16, r17 */
+		0x2720,		/* 	eor	r18, r16 */
+		0x932d,		/* 	st	X+, r18 */
+		0x913e,		/* 	ld	r19, -X */
+		0x5003,		/* 	subi	r16, 3 */
+		0xd002,		/* 	rcall	sub */
+		0xf7c9,		/* 	brne	loop */
+		0xcff8,		/* 	rjmp	loop */
+		0x9536,		/* sub:	lsr	r19 */
+		0x9508		/* 	ret */
+	};
+	const AVRDeviceInfo *dev = findAVRDevice ("ATMEGA328P");
+	AVRHexImage image (dev->flashSize, dev->flashPageSize);
+	AVRSimulator sim (*dev);
+	QElapsedTimer timer;
+	double secs;
+
+	image.setBytes (0, (const quint8 *)words, sizeof (words));
+	sim.loadFlash (image);
+
+	timer.start ();
+	while (timer.elapsed () < msecs) {
+		sim.run (10000000);
+	}
+	secs = qMax ((qint64)1, timer.elapsed ()) / 1000.0;
+
+	return QString ("%1 instructions, %2 cycles in %3 s: %4 MIPS, %5x real time at 16 MHz").arg (sim.instructions ())
+			.arg (sim.cycles ()).arg (secs, 0, 'f', 2).arg (sim.instructions () / secs / 1e6, 0, 'f', 1)
+			.arg (sim.cycles () / secs / 16e6, 0, 'f', 1);
+}
+/*}}}*/
+
+/*{{{  void AVRSimulator::interrupt (void)*/
+/*
+ *	takes the lowest waiting interrupt if enabled (not straight after sei or reti): return address
+ *	pushed, I cleared, jump to the vector.  The flag is cleared as the vector is taken.
+ */
+void AVRSimulator::interrupt (void)
+{
+	int v;
+
+	if (!_pending || _inhibit || !(_data.at (IO_SREG) & SREG_I)) {
+		return;
+	}
+	for (v=1; !(_pending & ((quint64)1 << v)); v++);
+	_pending &= ~((quint64)1 << v);
+	_io.acknowledge (v, _cycles);
+	_nextEvent = _io.nextEvent ();
+
+	if (_sleeping) {
+		_sleeping = false;
+		_cycles += 4;
+	}
+	pushPC (_pc);
+	_data[IO_SREG] &= ~SREG_I;
+	_pc = (v * _device.vectorSize) % _flash.count ();
+	_cycles += _pc22 ? 5 : 4;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::watched (quint32 addr, int kind)*/
+/*
+ *	called for each slow-path read or write while watchpoints are set: on a hit, notes it and has
+ *	the core stop once the instruction is done.
+ */
+void AVRSimulator::watched (quint32 addr, int kind)
+{
+	if (!_replaying && (addr < (quint32)_watch.count ()) && (_watch.at (addr) & kind)) {
+		_watchAddress = addr;
+		_watchKind = kind;
+		_pending |= PENDING_HALT;
+	}
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::readData (quint32 addr)*/
+/*
+ *	a data-space read by the program.  Addresses past the end read as 0.
+ */
+inline quint8 AVRSimulator::readData (quint32 addr)
+{
+	if (_watchCount) {
+		watched (addr, WATCH_READ);
+	}
+	if (addr < (quint32)_ioSpecial.count ()) {
+		if (_ioSpecial.at (addr)) {
+			return readIO (addr);
+		}
+		return _data.at (addr);
+	}
+	return (addr < (quint32)_data.count ()) ? _data.at (addr) : 0;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::writeData (quint32 addr, quint8 value)*/
+/*
+ *	a data-space write by the program.  Writes past the end are lost.
+ */
+inline void AVRSimulator::writeData (quint32 addr, quint8 value)
+{
+	if (_watchCount) {
+		watched (addr, WATCH_WRITE);
+	}
+	if (_trace) {
+		_trace->write (addr, value);
+	}
+	if (addr < (quint32)_ioSpecial.count ()) {
+		if (_ioSpecial.at (addr)) {
+			writeIO (addr, value);
+			return;
+		}
+		_data[addr] = value;
+	} else if (addr < (quint32)_data.count ()) {
+		_data[addr] = value;
+	}
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::readIO (quint32 addr)*/
+/*
+ *	reads an I/O register that needs more than storage: the peripherals' are worked out as of
+ *	now.
+ */
+quint8 AVRSimulator::readIO (quint32 addr)
+{
+	switch (addr) {
+	case IO_EECR:
+	case IO_SPMCSR:
+		return _data.at (addr);
+	}
+	return _io.read (addr, _cycles);
+}
+/*}}}*/
+/*{{{  void AVRSimulator::writeIO (quint32 addr, quint8 value)*/
+/*
+ *	writes an I/O register that does something: the EEPROM control register (reads and writes
+ *	happen at once, the CPU halted for 4 and 2 cycles), SPMCSR (which just holds the command
+ *	for the next spm), and the peripherals' (which may change when they next need attention).
+ */
+void AVRSimulator::writeIO (quint32 addr, quint8 value)
+{
+	switch (addr) {
+	case IO_EECR:
+		{
+			int ee = (_data.at (IO_EEARL) | (_data.at (IO_EEARH) << 8)) % qMax (1, _eeprom.count ());
+
+			if ((value & EE_EERE) && !_eeprom.isEmpty ()) {
+				_data[IO_EEDR] = _eeprom.at (ee);
+				_cycles += 4;
+				value &= ~EE_EERE;
+			}
+			if ((value & EE_EEPE) && (_data.at (IO_EECR) & EE_EEMPE) && !_eeprom.isEmpty ()) {
+				switch (_data.at (IO_EECR) & EE_EEPM) {
+				case 0x00:		/* erase and write */
+					_eeprom[ee] = _data.at (IO_EEDR);
+					break;
+				case 0x10:		/* erase only */
+					_eeprom[ee] = 0xff;
+					break;
+				case 0x20:		/* write only */
+					_eeprom[ee] &= _data.at (IO_EEDR);
+					break;
+				}
+				_cycles += 2;
+			}
+			/* reads and writes finish immediately, a write using up EEMPE */
+			_data[IO_EECR] = value & ~(EE_EERE | EE_EEPE | ((value & EE_EEPE) ? EE_EEMPE : 0));
+		}
+		break;
+	case IO_SPMCSR:
+		_data[addr] = value;
+		break;
+	default:
+		_io.write (addr, value, _cycles);
+		_nextEvent = _io.nextEvent ();
+		break;
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulator::push (quint8 value)*/
+/*
+ *	pushes a byte: stored at SP, then SP decremented.
+ */
+inline void AVRSimulator::push (quint8 value)
+{
+	quint16 sp = this->sp ();
+
+	writeData (sp, value);
+	sp--;
+	_data[IO_SPL] = sp & 0xff;
+	_data[IO_SPH] = sp >> 8;
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::pop (void)*/
+/*
+ *	pops a byte: SP incremented, then read.
+ */
+inline quint8 AVRSimulator::pop (void)
+{
+	quint16 sp = this->sp () + 1;
+
+	_data[IO_SPL] = sp & 0xff;
+	_data[IO_SPH] = sp >> 8;
+	return readData (sp);
+}
+/*}}}*/
+/*{{{  void AVRSimulator::pushPC (quint32 pc)*/
+/*
+ *	pushes a return address, low byte first (so it reads big-endian from SP+1).
+ */
+inline void AVRSimulator::pushPC (quint32 pc)
+{
+	push (pc & 0xff);
+	push ((pc >> 8) & 0xff);
+	if (_pc22) {
+		push ((pc >> 16) & 0xff);
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulator::spm (void)*/
+/*
+ *	carries out the command in SPMCSR: fill the page buffer from r1:r0, erase a page, or write the
+ *	buffer to a page (Z gives the address).  The command is cleared afterwards.
+ */
+void AVRSimulator::spm (void)
+{
+	quint8 cmd = _data.at (IO_SPMCSR);
+	quint32 z = (_data.at (30) | (_data.at (31) << 8)) | ((quint32)_data.at (IO_RAMPZ) << 16);
+	int pageWords = _pageBuffer.count ();
+	quint32 page = ((z >> 1) / pageWords) * pageWords;
+
+	if (!(cmd & SPM_SPMEN)) {
+		return;
+	}
+	switch (cmd & (SPM_PGERS | SPM_PGWRT | SPM_RWWSRE | 0x08)) {
+	case 0:
+		_pageBuffer[(z >> 1) % pageWords] = _data.at (0) | (_data.at (1) << 8);
+		break;
+	case SPM_PGERS:
+		for (int i=0; (i<pageWords) && ((int)(page + i) < _flash.count ()); i++) {
+			_flash[page + i] = 0xffff;
+		}
+		predecode (page ? page - 1 : 0, qMin (page + pageWords, (quint32)_flash.count ()) - 1);
+		break;
+	case SPM_PGWRT:
+		for (int i=0; (i<pageWords) && ((int)(page + i) < _flash.count ()); i++) {
+			_flash[page + i] &= _pageBuffer.at (i);
+		}
+		predecode (page ? page - 1 : 0, qMin (page + pageWords, (quint32)_flash.count ()) - 1);
+		_pageBuffer.fill (0xffff);
+		break;
+	default:
+		/* RWW re-enable, lock bits: nothing to do */
+		break;
+	}
+	_data[IO_SPMCSR] = cmd & ~(SPM_SPMEN | SPM_PGERS | SPM_PGWRT | SPM_RWWSRE | 0x08);
+}
+/*}}}*/
+/*{{{  void AVRSimulator::checkpoint (void)*/
+/*
+ *	records the state now (if history is on), replacing any checkpoints at or after this cycle.
+ *	Pages, flash and EEPROM the same as in the checkpoint before are shared with it.
+ */
+void AVRSimulator::checkpoint (void)
+{
+	Checkpoint cp;
+	const Checkpoint *prev;
+	int pages = (_data.count () + HISTORY_PAGE - 1) / HISTORY_PAGE;
+
+	if (!_historyInterval) {
+		return;
+	}
+	while (!_history.isEmpty () && (_history.last ().cycles >= _cycles)) {
+		_historyBytes -= _history.last ().bytes;
+		_history.removeLast ();
+	}
+	prev = _history.isEmpty () ? 0 : &_history.last ();
+
+	cp.cycles = _cycles;
+	cp.instructions = _instructions;
+	cp.pc = _pc;
+	cp.sleeping = _sleeping;
+	cp.inhibit = _inhibit;
+	cp.pending = _pending;
+	cp.bytes = sizeof (Checkpoint);
+	cp.data.resize (pages);
+	for (int i=0; i<pages; i++) {
+		int at = i * HISTORY_PAGE;
+		int len = qMin (HISTORY_PAGE, _data.count () - at);
+
+		if (prev && !memcmp (prev->data.at (i).constData (), _data.constData () + at, len)) {
+			cp.data[i] = prev->data.at (i);
+		} else {
+			cp.data[i] = Page (len);
+			memcpy (cp.data[i].data (), _data.constData () + at, len);
+			cp.bytes += len;
+		}
+	}
+	cp.flash = _flash;
+	cp.pageBuffer = _pageBuffer;
+	cp.eeprom = _eeprom;
+	cp.io = _io;
+	cp.io.setSerialOutput (QByteArray ());
+	if (!prev || (prev->flash.constData () != _flash.constData ())) {
+		cp.bytes += _flash.count () * 2;
+	}
+	if (!prev || (prev->eeprom.constData () != _eeprom.constData ())) {
+		cp.bytes += _eeprom.count ();
+	}
+	if (!prev || (prev->pageBuffer.constData () != _pageBuffer.constData ())) {
+		cp.bytes += _pageBuffer.count () * 2;
+	}
+
+	_history.append (cp);
+	_historyBytes += cp.bytes;
+	while ((_historyBytes > _historyLimit) && (_history.count () > 1)) {
+		dropOldest ();
+	}
+	_nextCheckpoint = _cycles + _historyInterval;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::clearHistory (void)*/
+/*
+ *	forgets all checkpoints.
+ */
+void AVRSimulator::clearHistory (void)
+{
+	_history.clear ();
+	_historyBytes = 0;
+	_nextCheckpoint = _cycles + _historyInterval;
+}
+/*}}}*/
+/*{{{  int AVRSimulator::checkpointBefore (quint64 cycle) const*/
+/*
+ *	returns the index of the latest checkpoint before 'cycle', or -1 if there is none.
+ */
+int AVRSimulator::checkpointBefore (quint64 cycle) const
+{
+	int lo = 0, hi = _history.count ();
+
+	/* first checkpoint at or after 'cycle' */
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (_history.at (mid).cycles < cycle) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo - 1;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::restore (int index)*/
+/*
+ *	puts the state back as it was at a checkpoint, and drops the checkpoints after it.  Flash is
+ *	decoded again only if SPM changed it since, and serial output not yet collected is kept.
+ */
+void AVRSimulator::restore (int index)
+{
+	const Checkpoint &cp = _history.at (index);
+	QByteArray sent = _io.takeSerialOutput ();
+
+	for (int i=0; i<cp.data.count (); i++) {
+		memcpy (_data.data () + i * HISTORY_PAGE, cp.data.at (i).constData (), cp.data.at (i).count ());
+	}
+	if (_flash.constData () != cp.flash.constData ()) {
+		_flash = cp.flash;
+		predecode (0, _flash.count () - 1);
+	}
+	_pageBuffer = cp.pageBuffer;
+	_eeprom = cp.eeprom;
+	_pc = cp.pc;
+	_cycles = cp.cycles;
+	_instructions = cp.instructions;
+	_sleeping = cp.sleeping;
+	_inhibit = cp.inhibit;
+	_pending = cp.pending;
+	_io = cp.io;
+	_io.setSerialOutput (sent);
+	_nextEvent = _io.nextEvent ();
+	_stop = STOP_NONE;
+
+	while (_history.count () > index + 1) {
+		_historyBytes -= _history.last ().bytes;
+		_history.removeLast ();
+	}
+	_nextCheckpoint = _cycles + _historyInterval;
+}
+/*}}}*/
+/*{{{  void AVRSimulator::dropOldest (void)*/
+/*
+ *	forgets the oldest checkpoint; what it shared with the next one is now counted there.
+ */
+void AVRSimulator::dropOldest (void)
+{
+	const Checkpoint &old = _history.first ();
+
+	if (_history.count () > 1) {
+		Checkpoint &next = _history[1];
+		int shared = 0;
+
+		for (int i=0; i<old.data.count (); i++) {
+			if (old.data.at (i).constData () == next.data.at (i).constData ()) {
+				shared += old.data.at (i).count ();
+			}
+		}
+		if (old.flash.constData () == next.flash.constData ()) {
+			shared += old.flash.count () * 2;
+		}
+		if (old.eeprom.constData () == next.eeprom.constData ()) {
+			shared += old.eeprom.count ();
+		}
+		if (old.pageBuffer.constData () == next.pageBuffer.constData ()) {
+			shared += old.pageBuffer.count () * 2;
+		}
+		next.bytes += shared;
+		_historyBytes += shared;
+	}
+	_historyBytes -= old.bytes;
+	_history.removeFirst ();
+}
+/*}}}*/
+/*{{{  void AVRSimulator::predecode (quint32 first, quint32 last)*/
+/*
+ *	decodes flash words first..last into the instruction array the core runs from (after a load,
+ *	or an SPM erase or write; 'first' should include the word before a changed range, in case a
+ *	2-word instruction straddles it).  Relative targets are made absolute, and instructions this
+ *	device does not have become OP_UNKNOWN.  Handlers are attached by execute().
+ */
+void AVRSimulator::predecode (quint32 first, quint32 last)
+{
+	const AVRDecoder &dec = AVRDecoder::instance ();
+	quint32 flashWords = _flash.count ();
+
+	for (quint32 i=first; i<=last; i++) {
+		AVRInstruction in = dec.decode (_flash.at (i), _flash.at ((i + 1) % flashWords));
+		Decoded &c = _code[i];
+
+		switch (in.op) {
+		case AVRDecoder::OP_RJMP:
+		case AVRDecoder::OP_RCALL:
+		case AVRDecoder::OP_BRBS:
+		case AVRDecoder::OP_BRBC:
+			in.k = ((qint64)i + 1 + in.k + flashWords) % flashWords;
+			break;
+		case AVRDecoder::OP_JMP:
+		case AVRDecoder::OP_CALL:
+			in.k %= flashWords;
+			if (!_device.hasJmp) {
+				in.op = AVRDecoder::OP_UNKNOWN;
+			}
+			break;
+		case AVRDecoder::OP_MUL:
+		case AVRDecoder::OP_MULS:
+		case AVRDecoder::OP_MULSU:
+		case AVRDecoder::OP_FMUL:
+		case AVRDecoder::OP_FMULS:
+		case AVRDecoder::OP_FMULSU:
+			if (!_device.hasMul) {
+				in.op = AVRDecoder::OP_UNKNOWN;
+			}
+			break;
+		case AVRDecoder::OP_MOVW:
+			if (!_device.hasMovw) {
+				in.op = AVRDecoder::OP_UNKNOWN;
+			}
+			break;
+		case AVRDecoder::OP_EIJMP:
+		case AVRDecoder::OP_EICALL:
+			if (!_pc22) {
+				in.op = AVRDecoder::OP_UNKNOWN;
+			}
+			break;
+		case AVRDecoder::OP_ELPM:
+		case AVRDecoder::OP_ELPM_Z:
+		case AVRDecoder::OP_ELPM_ZINC:
+			if (_device.flashSize <= 65536) {
+				in.op = AVRDecoder::OP_UNKNOWN;
+			}
+			break;
+		}
+		c.handler = 0;
+		c.k = in.k;
+		c.op = in.op;
+		c.d = in.d;
+		c.r = in.r;
+		c.b = in.b;
+		c.words = in.words;
+	}
+	_dirtyFirst = qMin (_dirtyFirst, first);
+	_dirtyLast = qMax (_dirtyLast, last);
+}
+/*}}}*/
+/*{{{  quint8 AVRSimulator::flashByte (quint32 addr) const*/
+/*
+ *	returns a byte of flash (for lpm/elpm), wrapping at the end.
+ */
+inline quint8 AVRSimulator::flashByte (quint32 addr) const
+{
+	quint16 w = _flash.at ((addr >> 1) % _flash.count ());
+
+	return (addr & 1) ? (w >> 8) : (w & 0xff);
+}
+/*}}}*/
+
+/*{{{  dispatch macros*/
+/*
+ *	Each handler ends with NEXT(cycles), which counts the instruction (and profiles and traces
+ *	it, if on), checks for anything that needs attention (interrupts, sei/reti shadow, sleep,
+ *	peripherals) or the cycle limit, then dispatches the next instruction.  With GCC (and clang)
+ *	that is a computed goto through the handler address stored in the pre-decoded instruction
+ *	(direct threading); otherwise a switch on the opcode.
+ */
+#ifdef __GNUC__
+#define HANDLER(op)	L_##op:
+#define LINK(op)	labels[AVRDecoder::op] = &&L_##op
+#define DISPATCH()	do { c = &code[pc]; goto *c->handler; } while (0)
+#else
+#define HANDLER(op)	case AVRDecoder::op:
+#define DISPATCH()	goto dispatch
+#endif
+
+#define NEXT(n)		do { \
+				_cycles += (n); \
+				_instructions++; \
+				if (prof) { \
+					prof[c - code].executions++; \
+					prof[c - code].cycles += (n); \
+				} \
+				if (trace) { \
+					trace->instruction (c - code, _cycles); \
+				} \
+				if ((_pending | _inhibit | _sleeping) || (_cycles >= stop)) { \
+					goto attention; \
+				} \
+				DISPATCH (); \
+			} while (0)
+
+#define SREG		R[IO_SREG]
+#define LOAD(a)		((((quint32)(a) - ramStart) < ramSize) ? R[a] : readData (a))
+#define STORE(a,v)	do { quint32 a_ = (a); quint8 v_ = (v); \
+				if ((a_ - ramStart) < ramSize) { \
+					R[a_] = v_; \
+					if (trace) { \
+						trace->write (a_, v_); \
+					} \
+				} else { \
+					IOWRITE (a_, v_); \
+				} \
+			} while (0)
+#define IOWRITE(a,v)	do { writeData ((a), (v)); stop = qMin (limit, _nextEvent); } while (0)	/* may bring a peripheral event forward */
+#define PUSH(v)		do { quint16 sp_ = PTR (IO_SPL); STORE (sp_, (v)); SETPTR (IO_SPL, sp_ - 1); } while (0)
+#define POP(v)		do { quint16 sp_ = PTR (IO_SPL) + 1; SETPTR (IO_SPL, sp_); (v) = LOAD (sp_); } while (0)
+#define PUSHPC(a)	do { quint32 r_ = (a); PUSH (r_ & 0xff); PUSH ((r_ >> 8) & 0xff); if (_pc22) { PUSH ((r_ >> 16) & 0xff); } } while (0)
+#define POPPC(a)	do { quint8 b_; (a) = 0; if (_pc22) { POP (b_); (a) = (quint32)b_ << 16; } POP (b_); (a) |= (quint32)b_ << 8; POP (b_); (a) |= b_; } while (0)
+#define PTR(n)		((quint16)(R[n] | (R[(n) + 1] << 8)))
+#define SETPTR(n,v)	do { quint16 v_ = (v); R[n] = v_ & 0xff; R[(n) + 1] = v_ >> 8; } while (0)
+/*}}}*/
+/*{{{  void AVRSimulator::execute (quint64 limit)*/
+/*
+ *	runs instructions from the pre-decoded flash until the cycle count reaches 'limit' or something
+ *	stops the core (setting _stop).  Flash rewritten by SPM is re-linked before carrying on.
+ */
+void AVRSimulator::execute (quint64 limit)
+{
+	quint8 *R = _data.data ();
+	Decoded *code = _code.data ();
+	const Decoded *c;
+	quint32 pc = _pc;
+	quint32 flashWords = _flash.count ();
+	quint32 ramStart = _device.sramStart;		/* plain SRAM: no side effects */
+	quint32 ramSize = _watchCount ? 0 : _device.sramSize;	/* none while watching: all checked */
+	const Decoded *pass = _passBreakpoint ? &code[_pc] : 0;	/* run even with a breakpoint */
+	ProfileCount *prof = _profiling ? _profile.data () : 0;
+	AVRTraceRecorder *trace = _trace;
+	quint64 stop = qMin (limit, _nextEvent);	/* limit, or sooner for the peripherals */
+	quint8 res;
+	bool relinkThenNext = false;
+
+	_passBreakpoint = false;
+relink:
+	/*{{{  give newly decoded instructions their handlers*/
+#ifdef __GNUC__
+	if (_dirtyFirst <= _dirtyLast) {
+		const void **labels;
+
+		_handlers.resize (AVRDecoder::OP_COUNT + 1);
+		labels = _handlers.data ();
+		for (int i=0; i<=AVRDecoder::OP_COUNT; i++) {
+			labels[i] = &&L_OP_UNKNOWN;
+		}
+		LINK (OP_NOP); LINK (OP_MOVW); LINK (OP_MULS); LINK (OP_MULSU); LINK (OP_FMUL); LINK (OP_FMULS); LINK (OP_FMULSU);
+		LINK (OP_CPC); LINK (OP_SBC); LINK (OP_ADD); LINK (OP_CPSE); LINK (OP_CP); LINK (OP_SUB); LINK (OP_ADC);
+		LINK (OP_AND); LINK (OP_EOR); LINK (OP_OR); LINK (OP_MOV);
+		LINK (OP_CPI); LINK (OP_SBCI); LINK (OP_SUBI); LINK (OP_ORI); LINK (OP_ANDI);
+		LINK (OP_LDD_Z); LINK (OP_LDD_Y); LINK (OP_STD_Z); LINK (OP_STD_Y);
+		LINK (OP_LDS); LINK (OP_LD_ZINC); LINK (OP_LD_ZDEC); LINK (OP_LPM_Z); LINK (OP_LPM_ZINC); LINK (OP_ELPM_Z); LINK (OP_ELPM_ZINC);
+		LINK (OP_LD_YINC); LINK (OP_LD_YDEC); LINK (OP_LD_X); LINK (OP_LD_XINC); LINK (OP_LD_XDEC); LINK (OP_POP);
+		LINK (OP_STS); LINK (OP_ST_ZINC); LINK (OP_ST_ZDEC);
+		LINK (OP_ST_YINC); LINK (OP_ST_YDEC); LINK (OP_ST_X); LINK (OP_ST_XINC); LINK (OP_ST_XDEC); LINK (OP_PUSH);
+		LINK (OP_COM); LINK (OP_NEG); LINK (OP_SWAP); LINK (OP_INC); LINK (OP_ASR); LINK (OP_LSR); LINK (OP_ROR); LINK (OP_DEC);
+		LINK (OP_BSET); LINK (OP_BCLR); LINK (OP_IJMP); LINK (OP_EIJMP); LINK (OP_RET); LINK (OP_ICALL); LINK (OP_EICALL); LINK (OP_RETI);
+		LINK (OP_SLEEP); LINK (OP_BREAK); LINK (OP_WDR); LINK (OP_LPM); LINK (OP_ELPM); LINK (OP_SPM); LINK (OP_SPM_ZINC);
+		LINK (OP_JMP); LINK (OP_CALL); LINK (OP_ADIW); LINK (OP_SBIW); LINK (OP_CBI); LINK (OP_SBIC); LINK (OP_SBI); LINK (OP_SBIS); LINK (OP_MUL);
+		LINK (OP_IN); LINK (OP_OUT); LINK (OP_RJMP); LINK (OP_RCALL); LINK (OP_LDI); LINK (OP_BRBS); LINK (OP_BRBC);
+		LINK (OP_BLD); LINK (OP_BST); LINK (OP_SBRC); LINK (OP_SBRS);
+		LINK (OP_DES); LINK (OP_XCH); LINK (OP_LAS); LINK (OP_LAC); LINK (OP_LAT);
+		LINK (OP_COUNT);
+
+		for (quint32 i=_dirtyFirst; i<=_dirtyLast; i++) {
+			code[i].handler = _breakpoints.at (i) ? &&L_BREAKPOINT : labels[code[i].op];
+		}
+	}
+#endif
+	_dirtyFirst = _code.count ();
+	_dirtyLast = 0;
+	/*}}}*/
+	if (relinkThenNext) {
+		relinkThenNext = false;
+		NEXT (1);
+	}
+	/* interrupts (or the instruction after sei or reti held over from the last run) first */
+	goto attention;
+
+#ifndef __GNUC__
+dispatch:
+	c = &code[pc];
+	if (_breakpointCount && _breakpoints.at (pc) && (c != pass) && !_replaying) {
+		_stop = STOP_BREAKPOINT;
+		goto done;
+	}
+	pass = 0;
+	switch (c->op) {
+#endif
+	/*{{{  arithmetic and logic*/
+	HANDLER (OP_ADD)
+		SREG = addFlags (SREG, R[c->d], R[c->r], 0, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_ADC)
+		SREG = addFlags (SREG, R[c->d], R[c->r], SREG & SREG_C, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SUB)
+		SREG = subFlags (SREG, R[c->d], R[c->r], 0, false, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SBC)
+		SREG = subFlags (SREG, R[c->d], R[c->r], SREG & SREG_C, true, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SUBI)
+		SREG = subFlags (SREG, R[c->d], c->k, 0, false, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SBCI)
+		SREG = subFlags (SREG, R[c->d], c->k, SREG & SREG_C, true, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_CP)
+		SREG = subFlags (SREG, R[c->d], R[c->r], 0, false, &res);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_CPC)
+		SREG = subFlags (SREG, R[c->d], R[c->r], SREG & SREG_C, true, &res);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_CPI)
+		SREG = subFlags (SREG, R[c->d], c->k, 0, false, &res);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_AND)
+		R[c->d] &= R[c->r];
+		SREG = logicFlags (SREG, R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_ANDI)
+		R[c->d] &= c->k;
+		SREG = logicFlags (SREG, R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_OR)
+		R[c->d] |= R[c->r];
+		SREG = logicFlags (SREG, R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_ORI)
+		R[c->d] |= c->k;
+		SREG = logicFlags (SREG, R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_EOR)
+		R[c->d] ^= R[c->r];
+		SREG = logicFlags (SREG, R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_COM)
+		R[c->d] = ~R[c->d];
+		SREG = logicFlags (SREG, R[c->d]) | SREG_C;
+		pc++;
+		NEXT (1);
+	HANDLER (OP_NEG)
+		res = R[c->d];
+		SREG = subFlags (SREG, 0, res, 0, false, &R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_INC)
+		res = ++R[c->d];
+		SREG &= ~(SREG_S | SREG_V | SREG_N | SREG_Z);
+		SREG |= ((res == 0x80) ? (SREG_V | SREG_N) : 0) | (((res & 0x80) && (res != 0x80)) ? (SREG_N | SREG_S) : 0) | (res ? 0 : SREG_Z);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_DEC)
+		res = --R[c->d];
+		SREG &= ~(SREG_S | SREG_V | SREG_N | SREG_Z);
+		SREG |= ((res == 0x7f) ? (SREG_V | SREG_S) : 0) | ((res & 0x80) ? (SREG_N | SREG_S) : 0) | (res ? 0 : SREG_Z);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_ASR)
+		res = (R[c->d] >> 1) | (R[c->d] & 0x80);
+		SREG = shiftFlags (SREG, res, R[c->d] & 0x01);
+		R[c->d] = res;
+		pc++;
+		NEXT (1);
+	HANDLER (OP_LSR)
+		res = R[c->d] >> 1;
+		SREG = shiftFlags (SREG, res, R[c->d] & 0x01);
+		R[c->d] = res;
+		pc++;
+		NEXT (1);
+	HANDLER (OP_ROR)
+		res = (R[c->d] >> 1) | ((SREG & SREG_C) ? 0x80 : 0);
+		SREG = shiftFlags (SREG, res, R[c->d] & 0x01);
+		R[c->d] = res;
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SWAP)
+		R[c->d] = (R[c->d] << 4) | (R[c->d] >> 4);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_ADIW)
+		{
+			quint16 before = PTR (c->d);
+			quint16 after = before + c->k;
+
+			SETPTR (c->d, after);
+			SREG = wordFlags (SREG, after, !(before & 0x8000) && (after & 0x8000), (before & 0x8000) && !(after & 0x8000));
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_SBIW)
+		{
+			quint16 before = PTR (c->d);
+			quint16 after = before - c->k;
+
+			SETPTR (c->d, after);
+			SREG = wordFlags (SREG, after, (before & 0x8000) && !(after & 0x8000), !(before & 0x8000) && (after & 0x8000));
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_MUL)
+		{
+			quint16 p = R[c->d] * R[c->r];
+
+			R[0] = p & 0xff;
+			R[1] = p >> 8;
+			SREG = mulFlags (SREG, p, p & 0x8000);
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_MULS)
+		{
+			quint16 p = (quint16)((qint8)R[c->d] * (qint8)R[c->r]);
+
+			R[0] = p & 0xff;
+			R[1] = p >> 8;
+			SREG = mulFlags (SREG, p, p & 0x8000);
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_MULSU)
+		{
+			quint16 p = (quint16)((qint8)R[c->d] * R[c->r]);
+
+			R[0] = p & 0xff;
+			R[1] = p >> 8;
+			SREG = mulFlags (SREG, p, p & 0x8000);
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_FMUL)
+		{
+			quint16 p = R[c->d] * R[c->r];
+			bool carry = (p & 0x8000);
+
+			p <<= 1;
+			R[0] = p & 0xff;
+			R[1] = p >> 8;
+			SREG = mulFlags (SREG, p, carry);
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_FMULS)
+		{
+			quint16 p = (quint16)((qint8)R[c->d] * (qint8)R[c->r]);
+			bool carry = (p & 0x8000);
+
+			p <<= 1;
+			R[0] = p & 0xff;
+			R[1] = p >> 8;
+			SREG = mulFlags (SREG, p, carry);
+		}
+		pc++;
+		NEXT (2);
+	HANDLER (OP_FMULSU)
+		{
+			quint16 p = (quint16)((qint8)R[c->d] * R[c->r]);
+			bool carry = (p & 0x8000);
+
+			p <<= 1;
+			R[0] = p & 0xff;
+			R[1] = p >> 8;
+			SREG = mulFlags (SREG, p, carry);
+		}
+		pc++;
+		NEXT (2);
+	/*}}}*/
+	/*{{{  moves, loads and stores*/
+	HANDLER (OP_MOV)
+		R[c->d] = R[c->r];
+		pc++;
+		NEXT (1);
+	HANDLER (OP_MOVW)
+		R[c->d] = R[c->r];
+		R[c->d + 1] = R[c->r + 1];
+		pc++;
+		NEXT (1);
+	HANDLER (OP_LDI)
+		R[c->d] = c->k;
+		pc++;
+		NEXT (1);
+	HANDLER (OP_LDS)
+		R[c->d] = LOAD (c->k);
+		pc += 2;
+		NEXT (2);
+	HANDLER (OP_STS)
+		STORE (c->k, R[c->d]);
+		pc += 2;
+		NEXT (2);
+	HANDLER (OP_LD_X)
+		R[c->d] = LOAD (PTR (26));
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LD_XINC)
+		R[c->d] = LOAD (PTR (26));
+		SETPTR (26, PTR (26) + 1);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LD_XDEC)
+		SETPTR (26, PTR (26) - 1);
+		R[c->d] = LOAD (PTR (26));
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LD_YINC)
+		R[c->d] = LOAD (PTR (28));
+		SETPTR (28, PTR (28) + 1);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LD_YDEC)
+		SETPTR (28, PTR (28) - 1);
+		R[c->d] = LOAD (PTR (28));
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LD_ZINC)
+		R[c->d] = LOAD (PTR (30));
+		SETPTR (30, PTR (30) + 1);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LD_ZDEC)
+		SETPTR (30, PTR (30) - 1);
+		R[c->d] = LOAD (PTR (30));
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_X)
+		STORE (PTR (26), R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_XINC)
+		STORE (PTR (26), R[c->d]);
+		SETPTR (26, PTR (26) + 1);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_XDEC)
+		SETPTR (26, PTR (26) - 1);
+		STORE (PTR (26), R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_YINC)
+		STORE (PTR (28), R[c->d]);
+		SETPTR (28, PTR (28) + 1);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_YDEC)
+		SETPTR (28, PTR (28) - 1);
+		STORE (PTR (28), R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_ZINC)
+		STORE (PTR (30), R[c->d]);
+		SETPTR (30, PTR (30) + 1);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_ST_ZDEC)
+		SETPTR (30, PTR (30) - 1);
+		STORE (PTR (30), R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LDD_Y)
+		R[c->d] = LOAD (PTR (28) + c->k);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LDD_Z)
+		R[c->d] = LOAD (PTR (30) + c->k);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_STD_Y)
+		STORE (PTR (28) + c->k, R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_STD_Z)
+		STORE (PTR (30) + c->k, R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_PUSH)
+		PUSH (R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_POP)
+		POP (R[c->d]);
+		pc++;
+		NEXT (2);
+	HANDLER (OP_LPM)
+		R[0] = flashByte (PTR (30));
+		pc++;
+		NEXT (3);
+	HANDLER (OP_LPM_Z)
+		R[c->d] = flashByte (PTR (30));
+		pc++;
+		NEXT (3);
+	HANDLER (OP_LPM_ZINC)
+		R[c->d] = flashByte (PTR (30));
+		SETPTR (30, PTR (30) + 1);
+		pc++;
+		NEXT (3);
+	HANDLER (OP_ELPM)
+		R[0] = flashByte (PTR (30) | ((quint32)R[IO_RAMPZ] << 16));
+		pc++;
+		NEXT (3);
+	HANDLER (OP_ELPM_Z)
+		R[c->d] = flashByte (PTR (30) | ((quint32)R[IO_RAMPZ] << 16));
+		pc++;
+		NEXT (3);
+	HANDLER (OP_ELPM_ZINC)
+		{
+			quint32 z = PTR (30) | ((quint32)R[IO_RAMPZ] << 16);
+
+			R[c->d] = flashByte (z);
+			z++;
+			SETPTR (30, z);
+			R[IO_RAMPZ] = (z >> 16) & 0xff;
+		}
+		pc++;
+		NEXT (3);
+	HANDLER (OP_SPM)
+	HANDLER (OP_SPM_ZINC)
+		spm ();
+		if (c->op == AVRDecoder::OP_SPM_ZINC) {
+			SETPTR (30, PTR (30) + 2);
+		}
+		pc++;
+		/* flash (and so the decoded copy) may have changed under us */
+		code = _code.data ();
+		relinkThenNext = true;
+		goto relink;
+	HANDLER (OP_IN)
+		R[c->d] = readData (0x20 + c->k);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_OUT)
+		IOWRITE (0x20 + c->k, R[c->d]);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SBI)
+		IOWRITE (0x20 + c->k, readData (0x20 + c->k) | (1 << c->b));
+		pc++;
+		NEXT (2);
+	HANDLER (OP_CBI)
+		IOWRITE (0x20 + c->k, readData (0x20 + c->k) & ~(1 << c->b));
+		pc++;
+		NEXT (2);
+	/*}}}*/
+	/*{{{  bits and flags*/
+	HANDLER (OP_BSET)
+		if ((c->b == 7) && !(SREG & SREG_I)) {
+			/* sei: the next instruction runs before any interrupt */
+			_inhibit = true;
+		}
+		SREG |= (1 << c->b);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_BCLR)
+		SREG &= ~(1 << c->b);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_BST)
+		SREG = (R[c->d] & (1 << c->b)) ? (SREG | SREG_T) : (SREG & ~SREG_T);
+		pc++;
+		NEXT (1);
+	HANDLER (OP_BLD)
+		R[c->d] = (SREG & SREG_T) ? (R[c->d] | (1 << c->b)) : (R[c->d] & ~(1 << c->b));
+		pc++;
+		NEXT (1);
+	/*}}}*/
+	/*{{{  jumps, calls, branches and skips (targets made absolute when decoded)*/
+	HANDLER (OP_RJMP)
+		pc = c->k;
+		NEXT (2);
+	HANDLER (OP_JMP)
+		pc = c->k;
+		NEXT (3);
+	HANDLER (OP_IJMP)
+		pc = PTR (30) % flashWords;
+		NEXT (2);
+	HANDLER (OP_EIJMP)
+		pc = (PTR (30) | ((quint32)R[IO_EIND] << 16)) % flashWords;
+		NEXT (2);
+	HANDLER (OP_RCALL)
+		PUSHPC (pc + 1);
+		pc = c->k;
+		NEXT (_pc22 ? 4 : 3);
+	HANDLER (OP_CALL)
+		PUSHPC (pc + 2);
+		pc = c->k;
+		NEXT (_pc22 ? 5 : 4);
+	HANDLER (OP_ICALL)
+		PUSHPC (pc + 1);
+		pc = PTR (30) % flashWords;
+		NEXT (_pc22 ? 4 : 3);
+	HANDLER (OP_EICALL)
+		PUSHPC (pc + 1);
+		pc = (PTR (30) | ((quint32)R[IO_EIND] << 16)) % flashWords;
+		NEXT (4);
+	HANDLER (OP_RET)
+		POPPC (pc);
+		pc %= flashWords;
+		NEXT (_pc22 ? 5 : 4);
+	HANDLER (OP_RETI)
+		POPPC (pc);
+		pc %= flashWords;
+		SREG |= SREG_I;
+		_inhibit = true;
+		NEXT (_pc22 ? 5 : 4);
+	HANDLER (OP_BRBS)
+		if (SREG & (1 << c->b)) {
+			pc = c->k;
+			NEXT (2);
+		}
+		pc++;
+		NEXT (1);
+	HANDLER (OP_BRBC)
+		if (!(SREG & (1 << c->b))) {
+			pc = c->k;
+			NEXT (2);
+		}
+		pc++;
+		NEXT (1);
+	HANDLER (OP_CPSE)
+		pc++;
+		if (R[c->d] == R[c->r]) {
+			res = code[pc].words;
+			pc += res;
+			NEXT (1 + res);
+		}
+		NEXT (1);
+	HANDLER (OP_SBRC)
+		pc++;
+		if (!(R[c->d] & (1 << c->b))) {
+			res = code[pc].words;
+			pc += res;
+			NEXT (1 + res);
+		}
+		NEXT (1);
+	HANDLER (OP_SBRS)
+		pc++;
+		if (R[c->d] & (1 << c->b)) {
+			res = code[pc].words;
+			pc += res;
+			NEXT (1 + res);
+		}
+		NEXT (1);
+	HANDLER (OP_SBIC)
+		pc++;
+		if (!(readData (0x20 + c->k) & (1 << c->b))) {
+			res = code[pc].words;
+			pc += res;
+			NEXT (1 + res);
+		}
+		NEXT (1);
+	HANDLER (OP_SBIS)
+		pc++;
+		if (readData (0x20 + c->k) & (1 << c->b)) {
+			res = code[pc].words;
+			pc += res;
+			NEXT (1 + res);
+		}
+		NEXT (1);
+	HANDLER (OP_COUNT)
+		/* ran (or skipped) off the end of flash: wrap round */
+		pc -= flashWords;
+		DISPATCH ();
+	/*}}}*/
+	/*{{{  MCU control*/
+	HANDLER (OP_NOP)
+	HANDLER (OP_WDR)
+		pc++;
+		NEXT (1);
+	HANDLER (OP_SLEEP)
+		_sleeping = true;
+		pc++;
+		NEXT (1);
+	HANDLER (OP_BREAK)
+		pc++;
+		_cycles++;
+		_instructions++;
+		_stop = STOP_BREAK;
+		goto done;
+	HANDLER (OP_UNKNOWN)
+	HANDLER (OP_DES)
+	HANDLER (OP_XCH)
+	HANDLER (OP_LAS)
+	HANDLER (OP_LAC)
+	HANDLER (OP_LAT)
+		/* not an instruction, or not one this device has (decoded as OP_UNKNOWN) */
+		_stop = STOP_INVALID;
+		goto done;
+	/*}}}*/
+#ifndef __GNUC__
+	}
+#else
+L_BREAKPOINT:
+	/* linked in place of an instruction with a breakpoint on it */
+	if ((c != pass) && !_replaying) {
+		_stop = STOP_BREAKPOINT;
+		goto done;
+	}
+	pass = 0;
+	goto *_handlers.at (c->op);
+#endif
+
+attention:
+	if (_cycles >= _nextEvent) {
+		_io.advance (_cycles);
+		_nextEvent = _io.nextEvent ();
+	}
+	if (_pending & PENDING_HALT) {
+		/* a watchpoint hit by the instruction just run */
+		_pending &= ~PENDING_HALT;
+		_stop = STOP_WATCHPOINT;
+		goto done;
+	}
+	if (_inhibit) {
+		if (_cycles >= limit) {
+			/* leaves the next instruction to run first, whenever execution carries on */
+			goto done;
+		}
+		_inhibit = false;
+	} else if (_pending && (SREG & SREG_I)) {
+		_pc = pc;
+		interrupt ();
+		pc = _pc;
+	}
+	stop = qMin (limit, _nextEvent);
+	if (_sleeping) {
+		if (_nextEvent == PERIPHERAL_NEVER) {
+			_stop = STOP_SLEEP;
+			goto done;
+		} else if (_nextEvent >= limit) {
+			_cycles = qMax (_cycles, limit);
+			goto done;
+		}
+		/* nothing happens until the peripherals' next event */
+		_cycles = qMax (_cycles, _nextEvent);
+		goto attention;
+	}
+	if (_cycles >= limit) {
+		goto done;
+	}
+	DISPATCH ();
+
+done:
+	_pc = pc;
+}
+/*}}}*/
+
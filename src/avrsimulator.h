@@ -0,0 +1,242 @@
+/*
+ *	avrsimulator.h -- cycle-accurate AVR core simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRSIMULATOR_H
+#define AVRSIMULATOR_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "avrdevice.h"
+#include "avrperipherals.h"
+
+class AVRHexImage;
+class AVRTraceRecorder;
+
+/*
+ *	The AVR core as the datasheet describes it: 32 registers, I/O and SRAM in one data space
+ *	(registers at 0x00, I/O from 0x20, SRAM from the device's sramStart), flash as words, and the
+ *	EEPROM behind EECR/EEDR/EEAR.  Every instruction takes its datasheet cycle count (taken
+ *	branches, skips over one or two words, 16 or 22-bit return addresses), and interrupts are taken
+ *	between instructions, lowest vector first, with the usual 4-cycle response (plus 4 more out of
+ *	sleep) and one instruction always run after sei and reti.  EEPROM and flash (SPM) writes finish
+ *	at once rather than after their milliseconds of programming time.
+ *
+ *	Flash is decoded once into an instruction array (the pages SPM rewrites are decoded again) and
+ *	run with direct-threaded dispatch; benchmark() measures the rate on a fixed instruction mix.
+ *
+ *	With history turned on, the state is checkpointed every so many cycles (and after any change
+ *	made from outside, which the core could not reproduce), each checkpoint sharing the data-space
+ *	pages, flash and EEPROM that have not changed since the one before.  Since the core is
+ *	deterministic, any earlier cycle is reached by restoring the checkpoint before it and running
+ *	forwards again; the oldest checkpoints are dropped to keep within a memory budget.
+ *
+ *	On devices AVRPeripherals knows, the timers, USART and external interrupts run from the cycle
+ *	count: execution stops short only at the next peripheral event, and sleep skips to it.
+ *
+ *	A breakpoint replaces the handler of the instruction it is on, so code without one runs as
+ *	fast as ever; watchpoints send the program's loads and stores the slow way while any are set.
+ */
+class AVRSimulator
+{
+public:
+	typedef enum StopReason {
+		STOP_NONE = 0,		/* still running */
+		STOP_LIMIT,		/* ran the cycles asked for */
+		STOP_BREAK,		/* executed a break */
+		STOP_SLEEP,		/* asleep with nothing to wake it */
+		STOP_INVALID,		/* not an instruction this device has */
+		STOP_BREAKPOINT,	/* reached an instruction with a breakpoint on it */
+		STOP_WATCHPOINT		/* the program read or wrote a watched data address */
+	} StopReason;
+
+	/* per flash word, when profiling */
+	typedef struct ProfileCount {
+		quint64 executions;
+		quint64 cycles;
+	} ProfileCount;
+
+	/* SREG bits */
+	enum {
+		SREG_C = 0x01, SREG_Z = 0x02, SREG_N = 0x04, SREG_V = 0x08,
+		SREG_S = 0x10, SREG_H = 0x20, SREG_T = 0x40, SREG_I = 0x80
+	};
+
+	/* I/O registers, as data-space addresses */
+	enum {
+		IO_EECR = 0x3f, IO_EEDR = 0x40, IO_EEARL = 0x41, IO_EEARH = 0x42,
+		IO_SPMCSR = 0x57, IO_RAMPZ = 0x5b, IO_EIND = 0x5c,
+		IO_SPL = 0x5d, IO_SPH = 0x5e, IO_SREG = 0x5f
+	};
+
+	/* watchpoint kinds */
+	enum {
+		WATCH_READ = 0x01, WATCH_WRITE = 0x02
+	};
+
+	explicit AVRSimulator (const AVRDeviceInfo &device);
+
+	const AVRDeviceInfo &device (void) const;
+
+	void loadFlash (const AVRHexImage &image);
+	void loadEeprom (const AVRHexImage &image);
+	void reset (void);
+
+	StopReason run (quint64 cycles);
+	StopReason step (void);
+
+	quint32 pc (void) const;
+	void setPC (quint32 pc);
+	quint64 cycles (void) const;
+	quint64 instructions (void) const;
+	StopReason stopReason (void) const;
+	bool isSleeping (void) const;
+
+	quint8 reg (int r) const;
+	void setReg (int r, quint8 value);
+	quint8 sreg (void) const;
+	quint16 sp (void) const;
+	int dataSize (void) const;
+	const quint8 *dataSpace (void) const;
+	quint8 dataAt (int addr) const;
+	void setDataAt (int addr, quint8 value);
+	quint16 flashWord (quint32 wordAddr) const;
+	quint8 eepromAt (int addr) const;
+	void setEepromAt (int addr, quint8 value);
+	void writeFlash (quint32 addr, const QByteArray &bytes);
+
+	bool setBreakpoint (quint32 wordAddr, bool on);
+	void clearBreakpoints (void);
+	bool setWatchpoint (quint32 addr, int len, int kinds, bool on);
+	void clearWatchpoints (void);
+	quint32 watchAddress (void) const;
+	int watchKind (void) const;
+
+	void setProfiling (bool enabled);
+	bool isProfiling (void) const;
+	void clearProfile (void);
+	const QVector<ProfileCount> &profile (void) const;
+
+	void setTrace (AVRTraceRecorder *trace);
+	AVRTraceRecorder *trace (void) const;
+
+	void raiseInterrupt (int vector);
+	void clearInterrupt (int vector);
+	void serialInput (const QByteArray &bytes);
+	QByteArray takeSerialOutput (void);
+	bool setPin (char port, int bit, bool high);
+
+	void setHistory (quint64 interval, int maxBytes);
+	quint64 historyStart (void) const;
+	int historyBytes (void) const;
+	bool rewind (quint64 cycle);
+	bool stepBack (void);
+
+	static QString stopReasonName (StopReason reason);
+	static QString benchmark (int msecs);
+
+private:
+	/* an instruction decoded from flash, ready to run */
+	typedef struct Decoded {
+		const void *handler;	/* where execute() handles it (GCC), else 0 */
+		qint32 k;		/* as AVRInstruction, but jump and branch targets absolute */
+		quint8 op;		/* AVRDecoder::Opcode; OP_COUNT past the end of flash */
+		quint8 d, r, b;
+		quint8 words;
+	} Decoded;
+
+	/* a slice of the data space, shared between checkpoints while it does not change */
+	typedef QVector<quint8> Page;
+
+	typedef struct Checkpoint {
+		quint64 cycles;
+		quint64 instructions;
+		quint32 pc;
+		bool sleeping;
+		bool inhibit;
+		quint64 pending;
+		QVector<Page> data;
+		QVector<quint16> flash;		/* implicitly shared: copied only if SPM writes */
+		QVector<quint16> pageBuffer;
+		QVector<quint8> eeprom;
+		AVRPeripherals io;		/* without serial output not yet collected */
+		int bytes;			/* memory held that the checkpoint before does not */
+	} Checkpoint;
+
+	void predecode (quint32 first, quint32 last);
+	void execute (quint64 limit);
+	quint8 flashByte (quint32 addr) const;
+	void interrupt (void);
+	void watched (quint32 addr, int kind);
+	quint8 readData (quint32 addr);
+	void writeData (quint32 addr, quint8 value);
+	quint8 readIO (quint32 addr);
+	void writeIO (quint32 addr, quint8 value);
+	void push (quint8 value);
+	quint8 pop (void);
+	void pushPC (quint32 pc);
+	void spm (void);
+	void checkpoint (void);
+	void clearHistory (void);
+	int checkpointBefore (quint64 cycle) const;
+	void restore (int index);
+	void dropOldest (void);
+
+	AVRDeviceInfo _device;
+	bool _pc22;			/* 3-byte return addresses */
+	QVector<quint16> _flash;	/* words */
+	QVector<quint8> _data;		/* registers, I/O, SRAM */
+	QVector<quint8> _eeprom;
+	QVector<quint16> _pageBuffer;	/* SPM temporary page buffer */
+	QVector<char> _ioSpecial;	/* per data address below SRAM: has side effects */
+	AVRPeripherals _io;
+	quint64 _nextEvent;		/* cycle the peripherals next need attention */
+	QVector<Decoded> _code;		/* one per flash word, plus two that wrap round */
+	quint32 _dirtyFirst;		/* range of _code still needing handlers */
+	quint32 _dirtyLast;
+	QVector<const void *> _handlers;	/* per opcode, once execute() has linked anything (GCC) */
+	QVector<char> _breakpoints;	/* per entry in _code */
+	int _breakpointCount;
+	bool _passBreakpoint;		/* the next execute() runs the instruction at the PC regardless */
+	QVector<char> _watch;		/* per data address, WATCH_ kinds */
+	int _watchCount;		/* data addresses watched */
+	quint32 _watchAddress;		/* last watchpoint hit */
+	int _watchKind;
+	bool _replaying;		/* running again from a checkpoint: breakpoints and watchpoints ignored */
+	bool _profiling;
+	QVector<ProfileCount> _profile;	/* per flash word, while profiling */
+	AVRTraceRecorder *_trace;	/* not owned; 0 when not tracing */
+	QList<Checkpoint> _history;	/* oldest first */
+	quint64 _historyInterval;	/* cycles between checkpoints, 0 for no history */
+	int _historyLimit;		/* bytes */
+	int _historyBytes;
+	quint64 _nextCheckpoint;
+
+	quint32 _pc;			/* words */
+	quint64 _cycles;
+	quint64 _instructions;
+	bool _sleeping;
+	bool _inhibit;			/* run one more instruction before taking an interrupt */
+	quint64 _pending;		/* interrupt vectors waiting, bit per vector */
+	StopReason _stop;
+};
+
+#endif	/* !AVRSIMULATOR_H */
+
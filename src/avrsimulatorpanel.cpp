@@ -0,0 +1,382 @@
+/*
+ *	avrsimulatorpanel.cpp -- simulator controls and core state view.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSettings>
+#include <QVBoxLayout>
+
+#include "avrsimulatorpanel.h"
+#include "avrheximage.h"
+
+/* how often the GUI looks at the simulator's state */
+#define SAMPLE_MSECS	33
+
+/*{{{  AVRSimulatorPanel::AVRSimulatorPanel (QWidget *parent)*/
+/*
+ *	constructor: nothing loaded until load() is called.
+ */
+AVRSimulatorPanel::AVRSimulatorPanel (QWidget *parent) : QWidget (parent)
+{
+	QVBoxLayout *vbox = new QVBoxLayout (this);
+	QHBoxLayout *buttons = new QHBoxLayout ();
+	QFont fixed ("Courier 10 Pitch", 10);
+
+	_thread = 0;
+	_snap = 0;
+	_shownSerial = 0;
+	_stopSerial = 0;
+	_posted = 0;
+	_wantRunning = false;
+	_serialWait = false;
+	_wallStart = 0;
+	QSettings settings ("unikent", "avr-asm-ide");
+
+	_clock = settings.value ("simClock", 16000000).toLongLong ();
+	_historyCycles = settings.value ("simHistoryCycles", 1000000).toULongLong ();
+	_historyKB = settings.value ("simHistoryKB", 16384).toInt ();
+
+	_resetButton = new QPushButton (tr ("Reset"));
+	_stepButton = new QPushButton (tr ("Step"));
+	_backButton = new QPushButton (tr ("Back"));
+	_backButton->setToolTip (tr ("Undo the last instruction"));
+	_runButton = new QPushButton (tr ("Run"));
+	_pauseButton = new QPushButton (tr ("Pause"));
+	buttons->addWidget (_resetButton);
+	buttons->addWidget (_backButton);
+	buttons->addWidget (_stepButton);
+	buttons->addWidget (_runButton);
+	buttons->addWidget (_pauseButton);
+
+	_state = new QPlainTextEdit ();
+	_state->setReadOnly (true);
+	_state->setLineWrapMode (QPlainTextEdit::NoWrap);
+	_state->setFont (fixed);
+	_status = new QLabel ();
+
+	vbox->addLayout (buttons);
+	vbox->addWidget (_state);
+	vbox->addWidget (_status);
+
+	_timer.setInterval (SAMPLE_MSECS);
+	connect (&_timer, SIGNAL (timeout ()), this, SLOT (sample ()));
+	connect (_resetButton, SIGNAL (clicked ()), this, SLOT (reset ()));
+	connect (_stepButton, SIGNAL (clicked ()), this, SLOT (step ()));
+	connect (_backButton, SIGNAL (clicked ()), this, SLOT (stepBack ()));
+	connect (_runButton, SIGNAL (clicked ()), this, SLOT (run ()));
+	connect (_pauseButton, SIGNAL (clicked ()), this, SLOT (pause ()));
+	updateView ();
+}
+/*}}}*/
+/*{{{  AVRSimulatorPanel::~AVRSimulatorPanel ()*/
+/*
+ *	destructor: stops the simulator thread.
+ */
+AVRSimulatorPanel::~AVRSimulatorPanel ()
+{
+	_timer.stop ();
+	delete _thread;
+}
+/*}}}*/
+/*{{{  bool AVRSimulatorPanel::load (const AVRDeviceInfo &device, const AVRHexImage &flash, const AVRHexImage &eeprom)*/
+/*
+ *	starts a new simulation of the given device and images (stopping any running), held at reset.
+ *	returns true on success, false otherwise (nothing in flash).
+ */
+bool AVRSimulatorPanel::load (const AVRDeviceInfo &device, const AVRHexImage &flash, const AVRHexImage &eeprom)
+{
+	AVRSimulator *sim;
+
+	if (flash.isEmpty ()) {
+		return false;
+	}
+	_timer.stop ();
+	delete _thread;
+
+	sim = new AVRSimulator (device);
+	sim->loadFlash (flash);
+	if (!eeprom.isEmpty ()) {
+		sim->loadEeprom (eeprom);
+	}
+	sim->setHistory (_historyCycles, qMax (1, _historyKB) * 1024);
+	_thread = new AVRSimulatorThread (sim);
+	_snap = &_thread->snapshot ();
+	_shownSerial = _snap->serial;
+	_stopSerial = _snap->stopSerial;
+	_traceError = QString ();
+	_posted = 0;
+	_wantRunning = false;
+	_serialIn.clear ();
+	_thread->start ();
+	_timer.start ();
+	if (_serialWait && _thread->post (AVRSimulatorThread::CMD_SERIAL_WAIT, 1)) {
+		_posted++;
+	}
+
+	_status->setText (tr ("%1 loaded, %2 flash bytes").arg (device.name).arg (flash.extent ()));
+	updateView ();
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRSimulatorPanel::isRunning (void) const*/
+/*
+ *	returns true if the simulation is running free (or has been asked to).
+ */
+bool AVRSimulatorPanel::isRunning (void) const
+{
+	if (!_snap) {
+		return false;
+	}
+	return (_snap->commands == _posted) ? _snap->running : _wantRunning;
+}
+/*}}}*/
+/*{{{  const AVRSimulatorThread::Snapshot *AVRSimulatorPanel::snapshot (void) const*/
+/*
+ *	returns the state last sampled from the simulator (0 if nothing has been loaded).
+ */
+const AVRSimulatorThread::Snapshot *AVRSimulatorPanel::snapshot (void) const
+{
+	return _snap;
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::setProfiling (bool enabled)*/
+/*
+ *	turns execution profiling on or off in the simulator.
+ */
+void AVRSimulatorPanel::setProfiling (bool enabled)
+{
+	if (_thread && _thread->post (AVRSimulatorThread::CMD_PROFILE, enabled)) {
+		_posted++;
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::setTrace (const QString &fileName, int megabytes)*/
+/*
+ *	starts recording an execution trace into a file (keeping the last 'megabytes' of it), or stops
+ *	if 'fileName' is empty.
+ */
+void AVRSimulatorPanel::setTrace (const QString &fileName, int megabytes)
+{
+	if (_thread && _thread->post (AVRSimulatorThread::CMD_TRACE, megabytes, fileName)) {
+		_posted++;
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::reset (void)*/
+/*
+ *	resets the core (flash and EEPROM are kept).
+ */
+void AVRSimulatorPanel::reset (void)
+{
+	if (!_thread || !_thread->post (AVRSimulatorThread::CMD_RESET)) {
+		return;
+	}
+	_posted++;
+	_wantRunning = false;
+	_status->setText (tr ("Reset"));
+	updateView ();
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::step (void)*/
+/*
+ *	runs a single instruction.
+ */
+void AVRSimulatorPanel::step (void)
+{
+	if (!_thread || isRunning () || !_thread->post (AVRSimulatorThread::CMD_STEP)) {
+		return;
+	}
+	_posted++;
+	_status->setText (QString ());
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::stepBack (void)*/
+/*
+ *	undoes the last instruction, if history goes back that far.
+ */
+void AVRSimulatorPanel::stepBack (void)
+{
+	if (!_thread || isRunning () || !_thread->post (AVRSimulatorThread::CMD_STEP_BACK)) {
+		return;
+	}
+	_posted++;
+	_status->setText (QString ());
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::run (void)*/
+/*
+ *	lets the simulation run until paused or stopped.
+ */
+void AVRSimulatorPanel::run (void)
+{
+	if (!_thread || isRunning () || !_thread->post (AVRSimulatorThread::CMD_RUN)) {
+		return;
+	}
+	_posted++;
+	_wantRunning = true;
+	_wall.start ();
+	_wallStart = _snap->cycles;
+	_status->setText (QString ());
+	updateView ();
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::pause (void)*/
+/*
+ *	stops a free run.
+ */
+void AVRSimulatorPanel::pause (void)
+{
+	if (!isRunning () || !_thread->post (AVRSimulatorThread::CMD_PAUSE)) {
+		return;
+	}
+	_posted++;
+	_wantRunning = false;
+	_status->setText (tr ("Paused"));
+	updateView ();
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::serialInput (const QByteArray &bytes)*/
+/*
+ *	sends bytes to the simulated USART (they queue up until something is loaded).
+ */
+void AVRSimulatorPanel::serialInput (const QByteArray &bytes)
+{
+	_serialIn.append (bytes);
+	postSerial ();
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::setSerialWait (bool enabled)*/
+/*
+ *	with a terminal attached, a core asleep with nothing to wake it waits for serial input rather
+ *	than stopping.
+ */
+void AVRSimulatorPanel::setSerialWait (bool enabled)
+{
+	_serialWait = enabled;
+	if (_thread && _thread->post (AVRSimulatorThread::CMD_SERIAL_WAIT, enabled)) {
+		_posted++;
+	}
+}
+/*}}}*/
+
+/*{{{  void AVRSimulatorPanel::sample (void)*/
+/*
+ *	timer: passes on any serial output, then picks up the simulator's latest state, and shows it
+ *	if it has changed.  Reports a stop the core came to by itself (break, sleep, bad instruction).
+ */
+void AVRSimulatorPanel::sample (void)
+{
+	QByteArray out = _thread->takeSerialOutput ();
+
+	if (!out.isEmpty ()) {
+		emit serialOutput (out);
+	}
+	postSerial ();
+	_snap = &_thread->snapshot ();
+	if (_snap->serial == _shownSerial) {
+		return;
+	}
+	_shownSerial = _snap->serial;
+	if (_snap->stopSerial != _stopSerial) {
+		QString msg = tr ("Stopped at 0x%1 after %2 cycles: %3").arg (_snap->pc * 2, 4, 16, QChar ('0'))
+				.arg (_snap->cycles).arg (AVRSimulator::stopReasonName (_snap->stop));
+
+		_stopSerial = _snap->stopSerial;
+		_wantRunning = false;
+		_status->setText (msg);
+		emit stopped (msg);
+	}
+	if (_snap->traceError != _traceError) {
+		_traceError = _snap->traceError;
+		if (!_traceError.isEmpty ()) {
+			_status->setText (tr ("Trace: %1").arg (_traceError));
+		}
+	}
+	updateView ();
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::postSerial (void)*/
+/*
+ *	posts the serial input waiting, in one command.
+ */
+void AVRSimulatorPanel::postSerial (void)
+{
+	if (_thread && !_serialIn.isEmpty () && _thread->post (AVRSimulatorThread::CMD_SERIAL_IN, 0, QString::fromLatin1 (_serialIn.constData (), _serialIn.count ()))) {
+		_posted++;
+		_serialIn.clear ();
+	}
+}
+/*}}}*/
+/*{{{  void AVRSimulatorPanel::updateView (void)*/
+/*
+ *	shows the registers and the rest of the core state, and enables the buttons that make sense.
+ *	Says (halted) when the core is not running, so other views can catch up.
+ */
+void AVRSimulatorPanel::updateView (void)
+{
+	static const char sregNames[] = "CZNVSHTI";
+	bool running = isRunning ();
+	const AVRSimulatorThread::Snapshot *s = _snap;
+	QString text;
+
+	_resetButton->setEnabled (s != 0);
+	_stepButton->setEnabled (s && !running);
+	_backButton->setEnabled (s && !running && (s->cycles > s->historyStart));
+	_runButton->setEnabled (s && !running);
+	_pauseButton->setEnabled (running);
+	if (!s) {
+		_state->setPlainText (tr ("Build, then simulate, to load the flash image."));
+		return;
+	}
+
+	for (int r=0; r<32; r++) {
+		text += QString ("r%1=%2%3").arg (r, 2, 10, QChar ('0')).arg (s->data.at (r), 2, 16, QChar ('0'))
+				.arg (((r & 7) == 7) ? "\n" : "  ");
+	}
+	text += QString ("\nPC=0x%1  SP=0x%2  SREG=").arg (s->pc * 2, 4, 16, QChar ('0')).arg (s->sp, 4, 16, QChar ('0'));
+	for (int b=7; b>=0; b--) {
+		text += (s->sreg & (1 << b)) ? QLatin1Char (sregNames[b]) : QChar ('-');
+	}
+	text += QString ("\nX=0x%1  Y=0x%2  Z=0x%3\n").arg (s->data.at (26) | (s->data.at (27) << 8), 4, 16, QChar ('0'))
+			.arg (s->data.at (28) | (s->data.at (29) << 8), 4, 16, QChar ('0'))
+			.arg (s->data.at (30) | (s->data.at (31) << 8), 4, 16, QChar ('0'));
+	text += QString ("\ncycles: %1 (%2 ms at %3 MHz)\ninstructions: %4%5\n").arg (s->cycles)
+			.arg ((double)s->cycles * 1000.0 / (double)qMax (1LL, _clock), 0, 'f', 3)
+			.arg ((double)_clock / 1e6).arg (s->instructions)
+			.arg (s->sleeping ? QString ("  (sleeping)") : QString ());
+	if (!s->traceFile.isEmpty ()) {
+		text += QString ("trace: %1 (%2 KB written)\n").arg (s->traceFile).arg (s->traceBytes / 1024);
+	}
+	if (_historyCycles) {
+		text += QString ("history: back to cycle %1 (%2 KB)\n").arg (s->historyStart).arg ((s->historyBytes + 1023) / 1024);
+	}
+	if (running && (_wall.elapsed () > 0) && (s->cycles >= _wallStart)) {
+		double simMs = (double)(s->cycles - _wallStart) * 1000.0 / (double)qMax (1LL, _clock);
+
+		text += QString ("speed: %1x real time\n").arg (simMs / (double)_wall.elapsed (), 0, 'f', 1);
+	}
+	_state->setPlainText (text);
+	if (!running && (s->commands == _posted)) {
+		emit halted ();
+	}
+}
+/*}}}*/
+
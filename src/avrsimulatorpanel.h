@@ -0,0 +1,98 @@
+/*
+ *	avrsimulatorpanel.h -- simulator controls and core state view.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRSIMULATORPANEL_H
+#define AVRSIMULATORPANEL_H
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QWidget>
+
+#include "avrsimulatorthread.h"
+
+class QLabel;
+class QPlainTextEdit;
+class QPushButton;
+
+/*
+ *	Runs the simulator on its own thread (see AVRSimulatorThread): the buttons post commands to it,
+ *	and a timer samples its latest snapshot at display rate to show the registers, SREG, SP, PC and
+ *	cycle count, so neither side ever waits for the other.
+ */
+class AVRSimulatorPanel : public QWidget
+{
+	Q_OBJECT
+
+public:
+	AVRSimulatorPanel (QWidget *parent = 0);
+	~AVRSimulatorPanel ();
+
+	bool load (const AVRDeviceInfo &device, const AVRHexImage &flash, const AVRHexImage &eeprom);
+	bool isRunning (void) const;
+	const AVRSimulatorThread::Snapshot *snapshot (void) const;
+	void setProfiling (bool enabled);
+	void setTrace (const QString &fileName, int megabytes);
+
+public slots:
+	void reset (void);
+	void step (void);
+	void stepBack (void);
+	void run (void);
+	void pause (void);
+	void serialInput (const QByteArray &bytes);
+	void setSerialWait (bool enabled);
+
+signals:
+	void stopped (QString);
+	void halted (void);
+	void serialOutput (QByteArray);
+
+private slots:
+	void sample (void);
+
+private:
+	void updateView (void);
+	void postSerial (void);
+
+	AVRSimulatorThread *_thread;
+	const AVRSimulatorThread::Snapshot *_snap;	/* latest sampled, 0 if nothing loaded */
+	quint64 _shownSerial;		/* of the snapshot on view */
+	quint64 _stopSerial;		/* of the last stop reported */
+	QString _traceError;		/* last reported */
+	int _posted;			/* commands posted to the thread */
+	bool _wantRunning;		/* what was last asked for, until the thread catches up */
+	QByteArray _serialIn;		/* USART input not yet posted (the queue was full) */
+	bool _serialWait;
+	QTimer _timer;
+	QElapsedTimer _wall;		/* since run was pressed */
+	quint64 _wallStart;		/* cycle count when run was pressed */
+	qint64 _clock;			/* Hz, for simulated time */
+	quint64 _historyCycles;		/* between checkpoints, 0 for no stepping back */
+	int _historyKB;
+	QPushButton *_resetButton;
+	QPushButton *_stepButton;
+	QPushButton *_backButton;
+	QPushButton *_runButton;
+	QPushButton *_pauseButton;
+	QPlainTextEdit *_state;
+	QLabel *_status;
+};
+
+#endif	/* !AVRSIMULATORPANEL_H */
+
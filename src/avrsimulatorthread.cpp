@@ -0,0 +1,340 @@
+/*
+ *	avrsimulatorthread.cpp -- runs the simulator on its own thread.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "avrsimulatorthread.h"
+
+#define SNAPSHOT_FRESH	4
+
+/* cycles run between looks at the command queue, and the most time between snapshots */
+#define SLICE_CYCLES	100000
+#define PUBLISH_MSECS	15
+
+/* USART output held back before the core is made to wait for the GUI to take some */
+#define SERIAL_HELD_MAX	65536
+
+/*{{{  AVRSimulatorThread::AVRSimulatorThread (AVRSimulator *sim, QObject *parent)*/
+/*
+ *	constructor: takes ownership of the simulator, and publishes its initial state.  The thread
+ *	is started by the caller.
+ */
+AVRSimulatorThread::AVRSimulatorThread (AVRSimulator *sim, QObject *parent) : QThread (parent)
+{
+	_sim = sim;
+	_trace = 0;
+	_head.storeRelease (0);
+	_tail.storeRelease (0);
+	_idle.storeRelease (0);
+	_serialHead.storeRelease (0);
+	_serialTail.storeRelease (0);
+	_serialWait = false;
+	_waiting = false;
+	for (int i=0; i<3; i++) {
+		_snapshots[i].data.fill (0, sim->dataSize ());
+		_snapshots[i].serial = 0;
+		_snapshots[i].commands = 0;
+		_snapshots[i].running = false;
+		_snapshots[i].stopSerial = 0;
+		_snapshots[i].stop = AVRSimulator::STOP_NONE;
+		_snapshots[i].profiling = false;
+		_snapshots[i].traceBytes = 0;
+	}
+	_back = 0;
+	_middle.storeRelease (1);
+	_front = 2;
+	_serial = 0;
+	_stopSerial = 0;
+	_stop = AVRSimulator::STOP_NONE;
+	_running = false;
+	publish (true);
+	snapshot ();
+}
+/*}}}*/
+/*{{{  AVRSimulatorThread::~AVRSimulatorThread ()*/
+/*
+ *	destructor: stops the worker and drops the simulator, finishing any trace.
+ */
+AVRSimulatorThread::~AVRSimulatorThread ()
+{
+	if (isRunning ()) {
+		while (!post (CMD_QUIT)) {
+			QThread::yieldCurrentThread ();
+		}
+		wait ();
+	}
+	delete _sim;
+	delete _trace;
+}
+/*}}}*/
+/*{{{  const AVRDeviceInfo &AVRSimulatorThread::device (void) const*/
+/*
+ *	returns the device being simulated.
+ */
+const AVRDeviceInfo &AVRSimulatorThread::device (void) const
+{
+	return _sim->device ();
+}
+/*}}}*/
+/*{{{  bool AVRSimulatorThread::post (Command cmd, int arg, const QString &text)*/
+/*
+ *	queues a command for the worker (GUI thread only).
+ *	returns true on success, false if the queue is full.
+ */
+bool AVRSimulatorThread::post (Command cmd, int arg, const QString &text)
+{
+	int tail = _tail.loadAcquire ();
+
+	if (tail - _head.loadAcquire () >= SIMULATOR_QUEUE_SIZE) {
+		return false;
+	}
+	_queue[tail & (SIMULATOR_QUEUE_SIZE - 1)].cmd = cmd;
+	_queue[tail & (SIMULATOR_QUEUE_SIZE - 1)].arg = arg;
+	_queue[tail & (SIMULATOR_QUEUE_SIZE - 1)].text = text;
+	_tail.storeRelease (tail + 1);
+
+	if (_idle.fetchAndAddOrdered (0)) {
+		QMutexLocker locker (&_idleLock);
+
+		_wake.wakeAll ();
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  const AVRSimulatorThread::Snapshot &AVRSimulatorThread::snapshot (void)*/
+/*
+ *	returns the newest state the worker has published (GUI thread only).  The reference stays
+ *	good until the next call.
+ */
+const AVRSimulatorThread::Snapshot &AVRSimulatorThread::snapshot (void)
+{
+	if (_middle.loadAcquire () & SNAPSHOT_FRESH) {
+		_front = _middle.fetchAndStoreOrdered (_front) & ~SNAPSHOT_FRESH;
+	}
+	return _snapshots[_front];
+}
+/*}}}*/
+/*{{{  QByteArray AVRSimulatorThread::takeSerialOutput (void)*/
+/*
+ *	returns the USART output the worker has passed over since the last call (GUI thread only).
+ */
+QByteArray AVRSimulatorThread::takeSerialOutput (void)
+{
+	int head = _serialHead.loadAcquire ();
+	int tail = _serialTail.loadAcquire ();
+	QByteArray bytes;
+
+	bytes.reserve (tail - head);
+	for (int i=head; i!=tail; i++) {
+		bytes.append (_serialRing[i & (SIMULATOR_SERIAL_SIZE - 1)]);
+	}
+	_serialHead.storeRelease (tail);
+	return bytes;
+}
+/*}}}*/
+
+/*{{{  void AVRSimulatorThread::run (void)*/
+/*
+ *	worker: obeys commands, runs the core in slices while running, and publishes snapshots at
+ *	most PUBLISH_MSECS apart (and whenever it halts).  Running holds off while the GUI is behind
+ *	with the USART output, or (if asked) while the core sleeps waiting for input.
+ */
+void AVRSimulatorThread::run (void)
+{
+	QElapsedTimer sincePublish;
+
+	sincePublish.start ();
+	for (;;) {
+		Message msg;
+		bool changed = false;
+		bool backedUp;
+
+		while (take (&msg)) {
+			switch ((Command)msg.cmd) {
+			case CMD_RUN:
+				_running = true;
+				_waiting = false;
+				break;
+			case CMD_PAUSE:
+				_running = false;
+				_waiting = false;
+				break;
+			case CMD_STEP:
+				if (!_running) {
+					_stop = _sim->step ();
+					if (_stop != AVRSimulator::STOP_LIMIT) {
+						_stopSerial++;
+					}
+				}
+				break;
+			case CMD_STEP_BACK:
+				if (!_running) {
+					_sim->stepBack ();
+				}
+				break;
+			case CMD_RESET:
+				_running = false;
+				_waiting = false;
+				_sim->reset ();
+				break;
+			case CMD_PROFILE:
+				_sim->setProfiling (msg.arg);
+				break;
+			case CMD_TRACE:
+				_sim->setTrace (0);
+				delete _trace;
+				_trace = 0;
+				_traceError = QString ();
+				if (!msg.text.isEmpty ()) {
+					_trace = new AVRTraceRecorder ();
+					if (_trace->open (msg.text, (qint64)qMax (1, msg.arg) << 20, true, _sim->cycles (), _sim->pc (), &_traceError)) {
+						_sim->setTrace (_trace);
+					} else {
+						delete _trace;
+						_trace = 0;
+					}
+				}
+				break;
+			case CMD_SERIAL_IN:
+				_sim->serialInput (msg.text.toLatin1 ());
+				_waiting = false;
+				break;
+			case CMD_SERIAL_WAIT:
+				_serialWait = msg.arg;
+				_waiting = _waiting && _serialWait;
+				break;
+			case CMD_QUIT:
+				return;
+			}
+			changed = true;
+		}
+
+		backedUp = flushSerial ();
+		if (_running && !_waiting && !backedUp) {
+			AVRSimulator::StopReason reason = _sim->run (SLICE_CYCLES);
+
+			if ((reason == AVRSimulator::STOP_SLEEP) && _serialWait) {
+				/* carries on when input arrives */
+				_waiting = true;
+				changed = true;
+			} else if (reason != AVRSimulator::STOP_LIMIT) {
+				_running = false;
+				_stop = reason;
+				_stopSerial++;
+				changed = true;
+			}
+			backedUp = flushSerial ();
+		}
+		if (changed || (_running && (sincePublish.elapsed () >= PUBLISH_MSECS))) {
+			publish (!_running);
+			sincePublish.restart ();
+		}
+		if (!_running || _waiting || backedUp) {
+			/* nothing to do until the GUI says so (or, if backed up, takes some output) */
+			QMutexLocker locker (&_idleLock);
+
+			_idle.fetchAndStoreOrdered (1);
+			if (_tail.loadAcquire () == _head.loadAcquire ()) {
+				_wake.wait (&_idleLock, backedUp ? 5 : 100);
+			}
+			_idle.fetchAndStoreOrdered (0);
+		}
+	}
+}
+/*}}}*/
+/*{{{  bool AVRSimulatorThread::take (Message *msg)*/
+/*
+ *	takes the next command off the queue (worker only).
+ *	returns true on success, false if there are none.
+ */
+bool AVRSimulatorThread::take (Message *msg)
+{
+	int head = _head.loadAcquire ();
+
+	if (head == _tail.loadAcquire ()) {
+		return false;
+	}
+	*msg = _queue[head & (SIMULATOR_QUEUE_SIZE - 1)];
+	_queue[head & (SIMULATOR_QUEUE_SIZE - 1)].text = QString ();
+	_head.storeRelease (head + 1);
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRSimulatorThread::flushSerial (void)*/
+/*
+ *	moves the core's USART output into the ring, as much as fits (worker only).
+ *	returns true if more than SERIAL_HELD_MAX bytes are still waiting, false otherwise.
+ */
+bool AVRSimulatorThread::flushSerial (void)
+{
+	int tail = _serialTail.loadAcquire ();
+	int n;
+
+	_serialHeld.append (_sim->takeSerialOutput ());
+	n = qMin (_serialHeld.count (), SIMULATOR_SERIAL_SIZE - (tail - _serialHead.loadAcquire ()));
+	if (n > 0) {
+		for (int i=0; i<n; i++) {
+			_serialRing[(tail + i) & (SIMULATOR_SERIAL_SIZE - 1)] = _serialHeld.at (i);
+		}
+		_serialHeld.remove (0, n);
+		_serialTail.storeRelease (tail + n);
+	}
+	return (_serialHeld.count () > SERIAL_HELD_MAX);
+}
+/*}}}*/
+/*{{{  void AVRSimulatorThread::publish (bool halted)*/
+/*
+ *	fills the back buffer from the core and swaps it into the middle (worker only; the
+ *	constructor too, before the worker starts).  The profile goes along only when halted.
+ */
+void AVRSimulatorThread::publish (bool halted)
+{
+	Snapshot &s = _snapshots[_back];
+
+	s.serial = ++_serial;
+	s.commands = _head.loadAcquire ();
+	s.running = _running;
+	s.stopSerial = _stopSerial;
+	s.stop = _stop;
+	s.sleeping = _sim->isSleeping ();
+	s.pc = _sim->pc ();
+	s.sp = _sim->sp ();
+	s.sreg = _sim->sreg ();
+	s.cycles = _sim->cycles ();
+	s.instructions = _sim->instructions ();
+	s.historyStart = _sim->historyStart ();
+	s.historyBytes = _sim->historyBytes ();
+	memcpy (s.data.data (), _sim->dataSpace (), s.data.count ());
+	s.profiling = _sim->isProfiling ();
+	s.traceFile = _trace ? _trace->fileName () : QString ();
+	s.traceBytes = _trace ? _trace->bytesWritten () : 0;
+	s.traceError = _traceError;
+	if (halted && s.profiling) {
+		s.profile = _sim->profile ();
+	} else {
+		s.profile.clear ();
+	}
+
+	_back = _middle.fetchAndStoreOrdered (_back | SNAPSHOT_FRESH) & ~SNAPSHOT_FRESH;
+}
+/*}}}*/
+
@@ -0,0 +1,136 @@
+/*
+ *	avrsimulatorthread.h -- runs the simulator on its own thread.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRSIMULATORTHREAD_H
+#define AVRSIMULATORTHREAD_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "avrsimulator.h"
+#include "avrtracerecorder.h"
+
+#define SIMULATOR_QUEUE_SIZE 64		/* commands; a power of 2 */
+#define SIMULATOR_SERIAL_SIZE 16384	/* bytes of USART output; a power of 2 */
+
+/*
+ *	The GUI talks to the simulator only through two lock-free structures:
+ *	  - commands go through a single-producer, single-consumer ring (post() never waits: it is a
+ *	    few atomic operations, and fails if the ring is full);
+ *	  - the worker publishes snapshots of the core into a triple buffer, and snapshot() hands the
+ *	    GUI the newest complete one without ever blocking the worker.
+ *	USART output goes back through a byte ring the same way, collected after each slice; input
+ *	goes in as commands.  A mutex and wait condition are only used to wake the worker when it is
+ *	idle.
+ */
+class AVRSimulatorThread : public QThread
+{
+	Q_OBJECT
+
+public:
+	typedef enum Command {
+		CMD_RUN,
+		CMD_PAUSE,
+		CMD_STEP,
+		CMD_STEP_BACK,
+		CMD_RESET,
+		CMD_PROFILE,		/* arg: on/off */
+		CMD_TRACE,		/* text: file (empty to stop), arg: MB kept (the last written) */
+		CMD_SERIAL_IN,		/* text: bytes for the USART, as Latin-1 */
+		CMD_SERIAL_WAIT,	/* arg: on/off, asleep with nothing to wake it waits for input */
+		CMD_QUIT
+	} Command;
+
+	typedef struct Snapshot {
+		quint64 serial;			/* bumped on every publish */
+		int commands;			/* how many posted commands it reflects */
+		bool running;
+		quint64 stopSerial;		/* bumped whenever the core stops by itself */
+		AVRSimulator::StopReason stop;	/* why it last stopped */
+		bool sleeping;
+		quint32 pc;
+		quint16 sp;
+		quint8 sreg;
+		quint64 cycles;
+		quint64 instructions;
+		quint64 historyStart;		/* earliest cycle stepping back can reach */
+		int historyBytes;
+		QVector<quint8> data;		/* registers, I/O, SRAM */
+		bool profiling;
+		QVector<AVRSimulator::ProfileCount> profile;	/* only while halted */
+		QString traceFile;		/* empty when not tracing */
+		qint64 traceBytes;
+		QString traceError;		/* why the last CMD_TRACE failed */
+	} Snapshot;
+
+	explicit AVRSimulatorThread (AVRSimulator *sim, QObject *parent = 0);
+	~AVRSimulatorThread ();
+
+	const AVRDeviceInfo &device (void) const;
+	bool post (Command cmd, int arg = 0, const QString &text = QString ());
+	const Snapshot &snapshot (void);
+	QByteArray takeSerialOutput (void);
+
+protected:
+	void run (void);
+
+private:
+	typedef struct Message {
+		int cmd;
+		int arg;
+		QString text;
+	} Message;
+
+	bool take (Message *msg);
+	void publish (bool halted);
+	bool flushSerial (void);
+
+	AVRSimulator *_sim;		/* owned; touched only by the worker once started */
+	AVRTraceRecorder *_trace;	/* owned, likewise */
+	QString _traceError;
+
+	Message _queue[SIMULATOR_QUEUE_SIZE];
+	QAtomicInt _head;		/* next to take (worker) */
+	QAtomicInt _tail;		/* next to fill (GUI) */
+	QAtomicInt _idle;		/* worker is (about to be) waiting */
+	QMutex _idleLock;
+	QWaitCondition _wake;
+
+	char _serialRing[SIMULATOR_SERIAL_SIZE];
+	QAtomicInt _serialHead;		/* next to take (GUI) */
+	QAtomicInt _serialTail;		/* next to fill (worker) */
+	QByteArray _serialHeld;		/* worker's: output not yet fitting in the ring */
+	bool _serialWait;
+	bool _waiting;			/* running, but asleep until input comes */
+
+	Snapshot _snapshots[3];
+	QAtomicInt _middle;		/* index of the shared buffer, plus SNAPSHOT_FRESH if unread */
+	int _back;			/* worker's */
+	int _front;			/* GUI's */
+	quint64 _serial;
+	quint64 _stopSerial;
+	AVRSimulator::StopReason _stop;
+	bool _running;
+};
+
+#endif	/* !AVRSIMULATORTHREAD_H */
+
@@ -0,0 +1,436 @@
+/*
+ *	avrstackanalysis.cpp -- static worst-case stack depth.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "avrstackanalysis.h"
+#include "avrasmflow.h"
+#include "avrasmprogram.h"
+#include "avrisranalysis.h"
+
+/* macros invoking macros, before giving up */
+#define MAX_MACRO_DEPTH 16
+
+/*{{{  AVRStackAnalysis::AVRStackAnalysis (const AVRASMFlow &flow, const AVRDeviceInfo &device)*/
+/*
+ *	constructor: analyses the whole program in the graph (which must outlive this).
+ */
+AVRStackAnalysis::AVRStackAnalysis (const AVRASMFlow &flow, const AVRDeviceInfo &device) : _flow (flow), _device (device)
+{
+	_depth.fill (0, _flow.nodes ().count ());
+	_walked.fill (-1, _flow.nodes ().count ());
+	analyse ();
+}
+/*}}}*/
+/*{{{  const QList<AVRStackAnalysis::Function> &AVRStackAnalysis::functions (void) const*/
+/*
+ *	returns the functions found: reset code first, then handlers, then anything called.
+ */
+const QList<AVRStackAnalysis::Function> &AVRStackAnalysis::functions (void) const
+{
+	return _functions;
+}
+/*}}}*/
+/*{{{  const AVRStackAnalysis::Summary &AVRStackAnalysis::summary (void) const*/
+/*
+ *	returns the program's worst case.
+ */
+const AVRStackAnalysis::Summary &AVRStackAnalysis::summary (void) const
+{
+	return _summary;
+}
+/*}}}*/
+/*{{{  int AVRStackAnalysis::returnBytes (const AVRDeviceInfo &device)*/
+/*
+ *	returns the size of a return address on the stack: 2 bytes, or 3 with a 22-bit program counter.
+ */
+int AVRStackAnalysis::returnBytes (const AVRDeviceInfo &device)
+{
+	return (device.flashSize > 131072) ? 3 : 2;
+}
+/*}}}*/
+
+/*{{{  void AVRStackAnalysis::analyse (void)*/
+/*
+ *	finds and walks every function, works out the peaks, then puts the handlers on top of the
+ *	reset code.
+ */
+void AVRStackAnalysis::analyse (void)
+{
+	const AVRASMProgram &program = _flow.program ();
+	QVector<int> entries = _flow.vectorEntries (_device);
+	int ret = returnBytes (_device);
+	int nesting = 0, deepest = 0;
+
+	for (const AVRASMProgram::Symbol &sym : program.symbols ()) {
+		if (sym.section == AVRASMProgram::TEXT) {
+			_labels.insert (sym.address, sym.name);
+		}
+	}
+
+	_summary.bounded = true;
+	_summary.mainDepth = 0;
+	_summary.interruptDepth = 0;
+	_summary.depth = 0;
+	_summary.available = _device.sramSize - program.sectionSize (AVRASMProgram::DATA);
+	_summary.problemIndex = -1;
+
+	/* reset code: where vector 0 jumps to, or just address 0 without a vector table */
+	if (!entries.isEmpty () && (entries.at (0) >= 0)) {
+		addFunction (entries.at (0), 0);
+	} else if (_flow.nodeAt (0) >= 0) {
+		addFunction (_flow.nodeAt (0), 0);
+	}
+	for (int v=1; v<entries.count (); v++) {
+		if (entries.at (v) >= 0) {
+			addFunction (entries.at (v), v);
+		}
+	}
+	for (int f=0; f<_functions.count (); f++) {
+		/* called functions get added as we go */
+		walk (f);
+	}
+
+	_state.fill (UNSEEN, _functions.count ());
+	for (int f=0; f<_functions.count (); f++) {
+		peak (f);
+	}
+
+	/*{{{  combine*/
+	for (int f=0; f<_functions.count (); f++) {
+		const Function &fn = _functions.at (f);
+
+		if ((f > 0) && (fn.vector <= 0)) {
+			/* handlers come straight after the reset code */
+			break;
+		}
+		if (!fn.bounded) {
+			if (_summary.bounded) {
+				_summary.bounded = false;
+				_summary.problem = QString ("%1: %2").arg (fn.name).arg (fn.problem);
+				_summary.problemIndex = fn.problemIndex;
+			}
+			continue;
+		}
+		if (fn.vector == 0) {
+			_summary.mainDepth = fn.peak;
+		} else if (fn.enablesInterrupts) {
+			nesting += ret + fn.peak;
+		} else {
+			deepest = qMax (deepest, ret + fn.peak);
+		}
+	}
+	_summary.interruptDepth = nesting + deepest;
+	_summary.depth = _summary.mainDepth + _summary.interruptDepth;
+	/*}}}*/
+}
+/*}}}*/
+/*{{{  int AVRStackAnalysis::addFunction (int entry, int vector)*/
+/*
+ *	returns the function starting at a node, adding it (to be walked) if new.
+ */
+int AVRStackAnalysis::addFunction (int entry, int vector)
+{
+	if (_functionAt.contains (entry)) {
+		return _functionAt.value (entry);
+	}
+
+	const AVRASMFlow::Node &node = _flow.nodes ().at (entry);
+	Function fn;
+
+	fn.entry = entry;
+	fn.entryIndex = node.index;
+	fn.vector = vector;
+	fn.enablesInterrupts = false;
+	fn.localPeak = 0;
+	fn.bounded = true;
+	fn.peak = 0;
+	fn.problemIndex = -1;
+	if (_labels.contains (node.address)) {
+		fn.name = _labels.value (node.address);
+	} else if (vector >= 0) {
+		fn.name = AVRISRAnalysis::vectorName (_device, vector);
+	} else {
+		fn.name = QString ("0x%1").arg (node.address >> 1, 4, 16, QChar ('0'));
+	}
+
+	_functions << fn;
+	_functionAt.insert (entry, _functions.count () - 1);
+	return _functions.count () - 1;
+}
+/*}}}*/
+/*{{{  void AVRStackAnalysis::walk (int f)*/
+/*
+ *	follows a function's instructions (not into calls) from its entry, recording the stack depth
+ *	at each and checking it is the same whichever way an instruction is reached.
+ */
+void AVRStackAnalysis::walk (int f)
+{
+	const QVector<AVRASMFlow::Node> &nodes = _flow.nodes ();
+	int ret = returnBytes (_device);
+	QVector<int> work;
+	int entry = _functions.at (f).entry;
+
+	_depth[entry] = 0;
+	_walked[entry] = f;
+	work << entry;
+
+	while (!work.isEmpty ()) {
+		int n = work.takeLast ();
+		const AVRASMFlow::Node &node = nodes.at (n);
+		int depth = _depth.at (n);
+		bool setsSP = false;
+		int rise = 0;
+		QString why;
+		int after = depth + stackDelta (n, &setsSP, &rise, &why);
+		int succ[2] = {-1, -1};
+
+		if (!why.isEmpty ()) {
+			setProblem (_functions[f], n, why);
+		}
+
+		if (setsSP) {
+			if (_functions.at (f).vector != 0) {
+				setProblem (_functions[f], n, QString ("stack pointer written directly"));
+			}
+			/* reset code setting up the stack: depth counts from here */
+			after = 0;
+		}
+		if (after < 0) {
+			setProblem (_functions[f], n, QString ("pops more than was pushed"));
+			after = 0;
+		}
+		if (node.mnemonic == "sei") {
+			_functions[f].enablesInterrupts = true;
+		}
+		_functions[f].localPeak = qMax (_functions.at (f).localPeak, qMax (after, depth + rise));
+
+		switch (node.kind) {
+		case AVRASMFlow::RETURN:
+		case AVRASMFlow::RETI:
+			if (depth != 0) {
+				setProblem (_functions[f], n, QString ("returns with %1 byte(s) still pushed").arg (depth));
+			}
+			continue;
+		case AVRASMFlow::INDIRECT_JUMP:
+			setProblem (_functions[f], n, QString ("indirect %1 (target not known)").arg (node.mnemonic));
+			continue;
+		case AVRASMFlow::INDIRECT_CALL:
+			setProblem (_functions[f], n, QString ("indirect %1 (target not known)").arg (node.mnemonic));
+			succ[0] = node.next;
+			break;
+		case AVRASMFlow::CALL:
+			if (node.target >= 0) {
+				int callee = addFunction (node.target, -1);
+
+				_functions[f].calls << qMakePair (callee, after + ret);
+			} else {
+				setProblem (_functions[f], n, QString ("target of %1 not found").arg (node.mnemonic));
+			}
+			succ[0] = node.next;
+			break;
+		case AVRASMFlow::JUMP:
+			if (node.target < 0) {
+				setProblem (_functions[f], n, QString ("target of %1 not found").arg (node.mnemonic));
+			}
+			succ[1] = node.target;
+			break;
+		default:
+			succ[0] = node.next;
+			succ[1] = node.target;
+			break;
+		}
+
+		for (int i=0; i<2; i++) {
+			int s = succ[i];
+
+			if (s < 0) {
+				continue;
+			}
+			if (_walked.at (s) != f) {
+				_walked[s] = f;
+				_depth[s] = after;
+				work << s;
+			} else if (_depth.at (s) != after) {
+				setProblem (_functions[f], s, QString ("stack depth differs between paths (%1 and %2 bytes)")
+						.arg (_depth.at (s)).arg (after));
+			}
+		}
+	}
+}
+/*}}}*/
+/*{{{  void AVRStackAnalysis::peak (int f)*/
+/*
+ *	works out a function's peak including what it calls (callees first).
+ */
+void AVRStackAnalysis::peak (int f)
+{
+	Function &fn = _functions[f];
+
+	if (_state.at (f) == DONE) {
+		return;
+	}
+	_state[f] = ACTIVE;
+	fn.peak = fn.localPeak;
+
+	for (int i=0; i<fn.calls.count (); i++) {
+		int callee = fn.calls.at (i).first;
+
+		if (_state.at (callee) == ACTIVE) {
+			if (fn.bounded) {
+				fn.bounded = false;
+				fn.problem = QString ("recursion through %1").arg (_functions.at (callee).name);
+				fn.problemIndex = _functions.at (callee).entryIndex;
+			}
+			continue;
+		}
+		peak (callee);
+
+		const Function &cf = _functions.at (callee);
+
+		if (!cf.bounded) {
+			if (fn.bounded) {
+				fn.bounded = false;
+				fn.problem = QString ("calls %1: %2").arg (cf.name).arg (cf.problem);
+				fn.problemIndex = cf.problemIndex;
+			}
+			continue;
+		}
+		fn.peak = qMax (fn.peak, fn.calls.at (i).second + cf.peak);
+	}
+	_state[f] = DONE;
+}
+/*}}}*/
+/*{{{  void AVRStackAnalysis::setProblem (Function &fn, int node, const QString &problem)*/
+/*
+ *	marks a function unbounded (keeping the first reason found).
+ */
+void AVRStackAnalysis::setProblem (Function &fn, int node, const QString &problem)
+{
+	if (!fn.bounded) {
+		return;
+	}
+	fn.bounded = false;
+	fn.problem = problem;
+	fn.problemIndex = _flow.nodes ().at (node).index;
+}
+/*}}}*/
+/*{{{  int AVRStackAnalysis::stackDelta (int node, bool *setsSP, int *rise, QString *problem) const*/
+/*
+ *	returns the bytes an instruction or macro invocation pushes (negative for pops); sets 'setsSP'
+ *	if it writes the stack pointer (out/sts to SPL or SPH), 'rise' to the most it pushes along the
+ *	way (for a macro that pushes and pops again), and 'problem' if a macro cannot be sized.
+ */
+int AVRStackAnalysis::stackDelta (int node, bool *setsSP, int *rise, QString *problem) const
+{
+	const AVRASMFlow::Node &n = _flow.nodes ().at (node);
+	const AVRASMProgram::Line &l = _flow.program ().lines ().at (n.index);
+	int delta = 0;
+
+	if (l.kind == AVRASMProgram::MACRO_CALL) {
+		macroDelta (n.mnemonic, 0, &delta, rise, setsSP, problem);
+		return delta;
+	}
+	delta = statementDelta (*l.stmt, setsSP);
+	*rise = qMax (0, delta);
+	return delta;
+}
+/*}}}*/
+/*{{{  int AVRStackAnalysis::statementDelta (const AVRASMStatement &stmt, bool *setsSP) const*/
+/*
+ *	returns the bytes an instruction pushes (negative for pops); sets 'setsSP' if it writes the
+ *	stack pointer.
+ */
+int AVRStackAnalysis::statementDelta (const AVRASMStatement &stmt, bool *setsSP) const
+{
+	if (stmt.mnemonic == "push") {
+		return 1;
+	} else if (stmt.mnemonic == "pop") {
+		return -1;
+	} else if ((stmt.mnemonic == "out") || (stmt.mnemonic == "sts")) {
+		const QStringList &ops = stmt.operands;
+		qint64 addr;
+
+		if (ops.isEmpty ()) {
+			return 0;
+		}
+		QString dst = ops.first ().trimmed ().toUpper ();
+
+		if (dst.contains ("SPL") || dst.contains ("SPH")) {
+			*setsSP = true;
+		} else if (_flow.program ().constants ().evaluate (ops.first (), &addr)) {
+			/* I/O address for out, data-space address for sts */
+			*setsSP = (stmt.mnemonic == "out") ? ((addr == 0x3d) || (addr == 0x3e)) : ((addr == 0x5d) || (addr == 0x5e));
+		}
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  bool AVRStackAnalysis::macroDelta (const QString &name, int depth, int *delta, int *rise, bool *setsSP, QString *problem) const*/
+/*
+ *	adds up the pushes and pops in a macro body (nested invocations included), into 'delta', with
+ *	the most pushed at any point (from the depth on entry) in 'rise'.  Calls, jumps and returns in
+ *	a macro, or branches and skips where it also pushes or pops, leave it unsized.
+ *	returns true on success, false otherwise (with the reason in 'problem').
+ */
+bool AVRStackAnalysis::macroDelta (const QString &name, int depth, int *delta, int *rise, bool *setsSP, QString *problem) const
+{
+	QVector<const AVRASMStatement *> body;
+	bool conditional = false;
+	bool stack = false;
+
+	*delta = 0;
+	*rise = 0;
+	if ((depth > MAX_MACRO_DEPTH) || !_flow.program ().macroBody (name, &body)) {
+		*problem = QString ("macro %1 cannot be sized").arg (name);
+		return false;
+	}
+	for (const AVRASMStatement *stmt : body) {
+		QVector<const AVRASMStatement *> inner;
+		int d = 0, r = 0;
+
+		if (_flow.program ().macroBody (stmt->mnemonic, &inner)) {
+			if (!macroDelta (stmt->mnemonic, depth + 1, &d, &r, setsSP, problem)) {
+				return false;
+			}
+		} else {
+			switch (AVRASMFlow::nodeKind (stmt->mnemonic)) {
+			case AVRASMFlow::PLAIN:
+				break;
+			case AVRASMFlow::BRANCH:
+			case AVRASMFlow::SKIP:
+				conditional = true;
+				break;
+			default:
+				*problem = QString ("%1 inside macro %2").arg (stmt->mnemonic).arg (name);
+				return false;
+			}
+			d = statementDelta (*stmt, setsSP);
+			r = qMax (0, d);
+		}
+		stack = stack || (d != 0) || (r != 0);
+		*rise = qMax (*rise, *delta + r);
+		*delta += d;
+	}
+	if (conditional && stack) {
+		*problem = QString ("macro %1 pushes or pops conditionally").arg (name);
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+
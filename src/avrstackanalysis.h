@@ -0,0 +1,112 @@
+/*
+ *	avrstackanalysis.h -- static worst-case stack depth.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRSTACKANALYSIS_H
+#define AVRSTACKANALYSIS_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "avrdevice.h"
+
+class AVRASMFlow;
+struct AVRASMStatement;
+
+/*
+ *	A function is the reset code, an interrupt handler, or anything called with rcall/call.  Each
+ *	is walked once to get the stack depth (push/pop) at each of its instructions, which must agree
+ *	wherever paths meet and be back to zero at ret/reti; its peak then includes the return address
+ *	and peak of everything it calls.  The program's worst case is the reset code's peak plus the
+ *	handlers on top: every handler that re-enables interrupts (sei) can be interrupted in turn, so
+ *	those all stack up, with the deepest of the rest on top.  Macro invocations count the pushes
+ *	and pops in their bodies.  Recursion, icall/ijmp, writes to SPL/SPH (outside the reset code)
+ *	and macros with calls, jumps or conditional pushes in them leave the depth unknown.
+ *
+ *	The whole program is analysed again each time (from the background analysis's fresh layout),
+ *	rather than only the functions an edit touched: the walk is linear in the flow graph, so this
+ *	costs no more than the layout itself.
+ */
+class AVRStackAnalysis
+{
+public:
+	typedef struct Function {
+		QString name;		/* label at the entry, or vector name */
+		int entry;		/* flow node */
+		int entryIndex;		/* program line of the entry */
+		int vector;		/* -1 if not a handler */
+		bool enablesInterrupts;	/* contains a sei */
+		int localPeak;		/* bytes pushed, not counting calls */
+		bool bounded;
+		int peak;		/* bytes, including calls */
+		QString problem;	/* why not bounded */
+		int problemIndex;	/* program line responsible, -1 if none */
+		QList<QPair<int, int> > calls;	/* function, depth at the call (return address included) */
+	} Function;
+
+	typedef struct Summary {
+		bool bounded;
+		int mainDepth;		/* reset code, with calls */
+		int interruptDepth;	/* handlers on top, nesting included */
+		int depth;		/* mainDepth + interruptDepth */
+		int available;		/* SRAM not used by .data */
+		QString problem;
+		int problemIndex;
+	} Summary;
+
+	AVRStackAnalysis (const AVRASMFlow &flow, const AVRDeviceInfo &device);
+
+	const QList<Function> &functions (void) const;
+	const Summary &summary (void) const;
+
+	static int returnBytes (const AVRDeviceInfo &device);
+
+private:
+	typedef enum State {
+		UNSEEN = 0,
+		ACTIVE,
+		DONE
+	} State;
+
+	void analyse (void);
+	int addFunction (int entry, int vector);
+	void walk (int f);
+	void peak (int f);
+	void setProblem (Function &fn, int node, const QString &problem);
+	int stackDelta (int node, bool *setsSP, int *rise, QString *problem) const;
+	int statementDelta (const AVRASMStatement &stmt, bool *setsSP) const;
+	bool macroDelta (const QString &name, int depth, int *delta, int *rise, bool *setsSP, QString *problem) const;
+
+	const AVRASMFlow &_flow;
+	AVRDeviceInfo _device;
+	QList<Function> _functions;
+	QHash<int, int> _functionAt;	/* entry node -> function */
+	QHash<qint32, QString> _labels;	/* text-section address -> label */
+	QVector<char> _state;		/* per function, while working out peaks */
+	Summary _summary;
+
+	/* per flow node, for the function being walked */
+	QVector<int> _depth;
+	QVector<int> _walked;		/* function that last set _depth, -1 if none */
+};
+
+#endif	/* !AVRSTACKANALYSIS_H */
+
@@ -0,0 +1,351 @@
+/*
+ *	avrtracereader.cpp -- reads execution traces written by AVRTraceRecorder.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "avrtracereader.h"
+
+/*{{{  AVRTraceReader::AVRTraceReader ()*/
+/*
+ *	constructor: nothing to read until opened.
+ */
+AVRTraceReader::AVRTraceReader ()
+{
+	_map = 0;
+	memset (&_header, 0, sizeof (_header));
+	_logical = 0;
+	_at = _end = 0;
+	_index = 0;
+	_cycle = 0;
+	_pc = 0;
+	_writeAddr = 0;
+	clearFilters ();
+}
+/*}}}*/
+/*{{{  AVRTraceReader::~AVRTraceReader ()*/
+/*
+ *	destructor.
+ */
+AVRTraceReader::~AVRTraceReader ()
+{
+	close ();
+}
+/*}}}*/
+/*{{{  bool AVRTraceReader::open (const QString &fileName, QString *error)*/
+/*
+ *	maps a trace file and positions at its first record.
+ *	returns true on success, false otherwise (with the reason in 'error').
+ */
+bool AVRTraceReader::open (const QString &fileName, QString *error)
+{
+	close ();
+	_file.setFileName (fileName);
+	if (!_file.open (QIODevice::ReadOnly)) {
+		if (error) {
+			*error = QString ("cannot open %1: %2").arg (fileName).arg (_file.errorString ());
+		}
+		return false;
+	}
+	if (_file.size () >= TRACE_FILE_HEADER) {
+		_map = _file.map (0, _file.size ());
+	}
+	if (_map) {
+		memcpy (&_header, _map, sizeof (_header));
+	}
+	if (!_map || memcmp (_header.magic, TRACE_MAGIC, sizeof (_header.magic)) || (_header.blockSize != TRACE_BLOCK_SIZE) ||
+			(_header.used > _header.blockCount) || (_header.first >= qMax (1u, _header.blockCount)) ||
+			(_file.size () < TRACE_FILE_HEADER + (qint64)_header.blockCount * TRACE_BLOCK_SIZE)) {
+		if (error) {
+			*error = QString ("%1 is not a trace file").arg (fileName);
+		}
+		close ();
+		return false;
+	}
+	startBlock (0);
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRTraceReader::close (void)*/
+/*
+ *	unmaps and closes the file.
+ */
+void AVRTraceReader::close (void)
+{
+	if (_map) {
+		_file.unmap ((uchar *)_map);
+		_map = 0;
+	}
+	_file.close ();
+	memset (&_header, 0, sizeof (_header));
+	_at = _end = 0;
+}
+/*}}}*/
+/*{{{  bool AVRTraceReader::isRing (void) const*/
+/*
+ *	returns true if the trace was recorded as a ring (so may have lost its start).
+ */
+bool AVRTraceReader::isRing (void) const
+{
+	return _header.ring;
+}
+/*}}}*/
+/*{{{  bool AVRTraceReader::wasTruncated (void) const*/
+/*
+ *	returns true if the file filled up and recording stopped before the run did.
+ */
+bool AVRTraceReader::wasTruncated (void) const
+{
+	return _header.dropped;
+}
+/*}}}*/
+/*{{{  quint64 AVRTraceReader::firstCycle (void) const*/
+/*
+ *	returns the cycle count the oldest record follows on from.
+ */
+quint64 AVRTraceReader::firstCycle (void) const
+{
+	return _header.used ? block (0)->cycle : 0;
+}
+/*}}}*/
+/*{{{  void AVRTraceReader::setPCFilter (quint32 first, quint32 last)*/
+/*
+ *	only returns instructions at word addresses first..last.
+ */
+void AVRTraceReader::setPCFilter (quint32 first, quint32 last)
+{
+	_pcFilter = true;
+	_pcFirst = first;
+	_pcLast = last;
+}
+/*}}}*/
+/*{{{  void AVRTraceReader::setWriteFilter (quint32 first, quint32 last)*/
+/*
+ *	only returns instructions that wrote somewhere in data addresses first..last.
+ */
+void AVRTraceReader::setWriteFilter (quint32 first, quint32 last)
+{
+	_writeFilter = true;
+	_writeFirst = first;
+	_writeLast = last;
+}
+/*}}}*/
+/*{{{  void AVRTraceReader::clearFilters (void)*/
+/*
+ *	returns every record again.
+ */
+void AVRTraceReader::clearFilters (void)
+{
+	_pcFilter = false;
+	_pcFirst = _pcLast = 0;
+	_writeFilter = false;
+	_writeFirst = _writeLast = 0;
+}
+/*}}}*/
+/*{{{  bool AVRTraceReader::seek (quint64 cycle)*/
+/*
+ *	positions at the first instruction whose cycle count reaches 'cycle': a binary search for the
+ *	last block starting before it, then a walk through (at most) that block.
+ *	returns true on success, false if the trace ends before then.
+ */
+bool AVRTraceReader::seek (quint64 cycle)
+{
+	int lo = 0, hi = _header.used;
+
+	while (hi - lo > 1) {
+		int mid = (lo + hi) / 2;
+
+		if (block (mid)->cycle < cycle) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	startBlock (lo);
+	for (;;) {
+		const uchar *at = _at;
+		quint64 index = _index, last = _cycle;
+		quint32 pc = _pc, writeAddr = _writeAddr;
+		int logical = _logical;
+		Record rec;
+
+		if (!decode (&rec)) {
+			return false;
+		}
+		if (rec.cycle >= cycle) {
+			/* back to just before it */
+			if (_logical != logical) {
+				startBlock (logical);
+			}
+			_at = at;
+			_index = index;
+			_cycle = last;
+			_pc = pc;
+			_writeAddr = writeAddr;
+			return true;
+		}
+	}
+}
+/*}}}*/
+/*{{{  bool AVRTraceReader::next (Record *rec)*/
+/*
+ *	reads the next record that passes the filters.
+ *	returns true on success, false at the end of the trace.
+ */
+bool AVRTraceReader::next (Record *rec)
+{
+	while (decode (rec)) {
+		bool match = true;
+
+		if (_pcFilter && ((rec->pc < _pcFirst) || (rec->pc > _pcLast))) {
+			match = false;
+		}
+		if (match && _writeFilter) {
+			match = false;
+			for (int i=0; i<rec->writeCount; i++) {
+				if ((rec->writes[i].addr >= _writeFirst) && (rec->writes[i].addr <= _writeLast)) {
+					match = true;
+					break;
+				}
+			}
+		}
+		if (match) {
+			return true;
+		}
+	}
+	return false;
+}
+/*}}}*/
+
+/*{{{  const AVRTraceRecorder::BlockHeader *AVRTraceReader::block (int logical) const*/
+/*
+ *	returns the header of a block, counting from the oldest.
+ */
+const AVRTraceRecorder::BlockHeader *AVRTraceReader::block (int logical) const
+{
+	quint32 index = (_header.first + logical) % _header.blockCount;
+
+	return (const AVRTraceRecorder::BlockHeader *)(_map + TRACE_FILE_HEADER + (qint64)index * TRACE_BLOCK_SIZE);
+}
+/*}}}*/
+/*{{{  void AVRTraceReader::startBlock (int logical)*/
+/*
+ *	positions at the start of a block (or at the end, if there are no more).
+ */
+void AVRTraceReader::startBlock (int logical)
+{
+	_logical = logical;
+	if (logical >= (int)_header.used) {
+		_at = _end = 0;
+		return;
+	}
+
+	const AVRTraceRecorder::BlockHeader *bh = block (logical);
+
+	_at = (const uchar *)(bh + 1);
+	_end = _at + qMin (bh->used, (quint32)(TRACE_BLOCK_SIZE - sizeof (*bh)));
+	_index = bh->instructions;
+	_cycle = bh->cycle;
+	_pc = bh->pc;
+	_writeAddr = bh->writeAddr;
+}
+/*}}}*/
+/*{{{  bool AVRTraceReader::decode (Record *rec)*/
+/*
+ *	decodes the next instruction record and the writes before it, moving on through the blocks.
+ *	returns true on success, false at the end of the trace.
+ */
+bool AVRTraceReader::decode (Record *rec)
+{
+	rec->writeCount = 0;
+	for (;;) {
+		quint8 tag;
+
+		if (_at >= _end) {
+			if (_logical >= (int)_header.used - 1) {
+				return false;
+			}
+			startBlock (_logical + 1);
+			continue;
+		}
+		tag = *_at++;
+		if (tag & 0x80) {
+			/*{{{  data write*/
+			quint32 z = tag & 0x7f;
+			qint32 da;
+
+			if (z == 127) {
+				z = varint ();
+			}
+			da = (qint32)((z >> 1) ^ (0 - (z & 1)));
+			_writeAddr += da;
+			if (rec->writeCount < TRACE_MAX_WRITES) {
+				rec->writes[rec->writeCount].addr = _writeAddr;
+				rec->writes[rec->writeCount].value = (_at < _end) ? *_at : 0;
+				rec->writeCount++;
+			}
+			_at++;
+			/*}}}*/
+		} else {
+			/*{{{  instruction*/
+			quint64 dc;
+			qint32 dpc;
+
+			if (tag == 0x7f) {
+				quint32 z;
+
+				dc = varint ();
+				z = (quint32)varint ();
+				dpc = (qint32)((z >> 1) ^ (0 - (z & 1)));
+			} else {
+				dc = (tag >> 4) + 1;
+				dpc = (int)(tag & 0x0f) - 7;
+			}
+			_cycle += dc;
+			_pc += dpc;
+			rec->index = _index++;
+			rec->cycle = _cycle;
+			rec->pc = _pc;
+			return true;
+			/*}}}*/
+		}
+	}
+}
+/*}}}*/
+/*{{{  quint64 AVRTraceReader::varint (void)*/
+/*
+ *	reads a varint from the current block.
+ */
+quint64 AVRTraceReader::varint (void)
+{
+	quint64 v = 0;
+	int shift = 0;
+
+	while ((_at < _end) && (shift < 64)) {
+		quint8 b = *_at++;
+
+		v |= (quint64)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			break;
+		}
+		shift += 7;
+	}
+	return v;
+}
+/*}}}*/
+
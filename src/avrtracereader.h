@@ -0,0 +1,91 @@
+/*
+ *	avrtracereader.h -- reads execution traces written by AVRTraceRecorder.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRTRACEREADER_H
+#define AVRTRACEREADER_H
+
+#include <QFile>
+#include <QString>
+
+#include "avrtracerecorder.h"
+
+#define TRACE_MAX_WRITES	8	/* kept per instruction (an interrupt and a call make 6) */
+
+/*
+ *	Maps a trace file and walks its records in order.  seek() finds the block holding a cycle by
+ *	binary search on the block headers, then decodes forwards within that block; filters on the
+ *	instruction's word address and on the data addresses written skip the records that do not
+ *	match.
+ */
+class AVRTraceReader
+{
+public:
+	typedef struct Write {
+		quint32 addr;
+		quint8 value;
+	} Write;
+
+	typedef struct Record {
+		quint64 index;		/* instructions recorded before this one */
+		quint64 cycle;		/* count after it ran */
+		quint32 pc;		/* words */
+		int writeCount;
+		Write writes[TRACE_MAX_WRITES];
+	} Record;
+
+	AVRTraceReader ();
+	~AVRTraceReader ();
+
+	bool open (const QString &fileName, QString *error);
+	void close (void);
+	bool isRing (void) const;
+	bool wasTruncated (void) const;
+	quint64 firstCycle (void) const;
+
+	void setPCFilter (quint32 first, quint32 last);
+	void setWriteFilter (quint32 first, quint32 last);
+	void clearFilters (void);
+
+	bool seek (quint64 cycle);
+	bool next (Record *rec);
+
+private:
+	const AVRTraceRecorder::BlockHeader *block (int logical) const;
+	void startBlock (int logical);
+	bool decode (Record *rec);
+	quint64 varint (void);
+
+	QFile _file;
+	const uchar *_map;
+	AVRTraceRecorder::FileHeader _header;
+	int _logical;			/* block being read, 0 the oldest */
+	const uchar *_at;
+	const uchar *_end;
+	quint64 _index;
+	quint64 _cycle;
+	quint32 _pc;
+	quint32 _writeAddr;
+	bool _pcFilter;
+	quint32 _pcFirst, _pcLast;
+	bool _writeFilter;
+	quint32 _writeFirst, _writeLast;
+};
+
+#endif	/* !AVRTRACEREADER_H */
+
@@ -0,0 +1,210 @@
+/*
+ *	avrtracerecorder.cpp -- compact execution traces from the simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "avrtracerecorder.h"
+
+/*{{{  AVRTraceRecorder::AVRTraceRecorder ()*/
+/*
+ *	constructor: records nothing until opened.
+ */
+AVRTraceRecorder::AVRTraceRecorder ()
+{
+	_map = 0;
+	memset (&_header, 0, sizeof (_header));
+	_block = 0;
+	_sequence = 0;
+	_at = _start = _scratch;
+	_limit = _scratch + sizeof (_scratch) - TRACE_BLOCK_SLACK;
+	_instructions = 0;
+	_cycle = 0;
+	_pc = 0;
+	_writeAddr = 0;
+	_written = 0;
+}
+/*}}}*/
+/*{{{  AVRTraceRecorder::~AVRTraceRecorder ()*/
+/*
+ *	destructor: finishes the file.
+ */
+AVRTraceRecorder::~AVRTraceRecorder ()
+{
+	close ();
+}
+/*}}}*/
+/*{{{  bool AVRTraceRecorder::open (const QString &fileName, qint64 bytes, bool ring, quint64 cycle, quint32 pc, QString *error)*/
+/*
+ *	creates a trace file of (about) 'bytes', mapped into memory, for a core now at 'cycle' and
+ *	word address 'pc'.
+ *	returns true on success, false otherwise (with the reason in 'error').
+ */
+bool AVRTraceRecorder::open (const QString &fileName, qint64 bytes, bool ring, quint64 cycle, quint32 pc, QString *error)
+{
+	quint32 blocks = (quint32)qBound ((qint64)1, bytes / TRACE_BLOCK_SIZE, (qint64)0x7fffffff / TRACE_BLOCK_SIZE);
+	qint64 size = TRACE_FILE_HEADER + (qint64)blocks * TRACE_BLOCK_SIZE;
+
+	close ();
+	_file.setFileName (fileName);
+	if (!_file.open (QIODevice::ReadWrite | QIODevice::Truncate) || !_file.resize (size)) {
+		if (error) {
+			*error = QString ("cannot create %1: %2").arg (fileName).arg (_file.errorString ());
+		}
+		_file.close ();
+		return false;
+	}
+	_map = _file.map (0, size);
+	if (!_map) {
+		if (error) {
+			*error = QString ("cannot map %1: %2").arg (fileName).arg (_file.errorString ());
+		}
+		_file.close ();
+		return false;
+	}
+
+	memset (&_header, 0, sizeof (_header));
+	memcpy (_header.magic, TRACE_MAGIC, sizeof (_header.magic));
+	_header.blockSize = TRACE_BLOCK_SIZE;
+	_header.blockCount = blocks;
+	_header.ring = ring;
+	_sequence = 0;
+	_instructions = 0;
+	_cycle = cycle;
+	_pc = pc;
+	_writeAddr = 0;
+	_written = 0;
+	startBlock (0);
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRTraceRecorder::close (void)*/
+/*
+ *	finishes the block being written and the file header, and closes the file.
+ */
+void AVRTraceRecorder::close (void)
+{
+	if (!_map) {
+		return;
+	}
+	finishBlock ();
+	memcpy (_map, &_header, sizeof (_header));
+	_file.unmap (_map);
+	_file.close ();
+	_map = 0;
+	_at = _start = _scratch;
+	_limit = _scratch + sizeof (_scratch) - TRACE_BLOCK_SLACK;
+}
+/*}}}*/
+/*{{{  bool AVRTraceRecorder::isOpen (void) const*/
+/*
+ *	returns true if a trace file is open.
+ */
+bool AVRTraceRecorder::isOpen (void) const
+{
+	return (_map != 0);
+}
+/*}}}*/
+/*{{{  QString AVRTraceRecorder::fileName (void) const*/
+/*
+ *	returns the trace file name.
+ */
+QString AVRTraceRecorder::fileName (void) const
+{
+	return _file.fileName ();
+}
+/*}}}*/
+/*{{{  qint64 AVRTraceRecorder::bytesWritten (void) const*/
+/*
+ *	returns the bytes of records written so far (including any since overwritten in a ring).
+ */
+qint64 AVRTraceRecorder::bytesWritten (void) const
+{
+	return _written + (_header.dropped ? 0 : (_at - _start));
+}
+/*}}}*/
+
+/*{{{  void AVRTraceRecorder::nextBlock (void)*/
+/*
+ *	called when a block is full: moves on to the next, round to the oldest in a ring, or into the
+ *	scratch area (dropping records) once a plain file is full.
+ */
+void AVRTraceRecorder::nextBlock (void)
+{
+	if (!_map || _header.dropped) {
+		_at = _scratch;
+		return;
+	}
+	finishBlock ();
+	if (_header.used < _header.blockCount) {
+		startBlock (_header.used);
+	} else if (_header.ring) {
+		_header.first = (_header.first + 1) % _header.blockCount;
+		startBlock ((_block + 1) % _header.blockCount);
+	} else {
+		_header.dropped = 1;
+		memcpy (_map, &_header, sizeof (_header));
+		_at = _start = _scratch;
+		_limit = _scratch + sizeof (_scratch) - TRACE_BLOCK_SLACK;
+	}
+}
+/*}}}*/
+/*{{{  void AVRTraceRecorder::finishBlock (void)*/
+/*
+ *	fills in the length of the block being written.
+ */
+void AVRTraceRecorder::finishBlock (void)
+{
+	BlockHeader *bh;
+
+	if (!_map || _header.dropped) {
+		return;
+	}
+	bh = (BlockHeader *)(_map + TRACE_FILE_HEADER + (qint64)_block * TRACE_BLOCK_SIZE);
+	bh->used = _at - _start;
+	_written += _at - _start;
+}
+/*}}}*/
+/*{{{  void AVRTraceRecorder::startBlock (quint32 index)*/
+/*
+ *	starts writing records into a block, its header holding the values the first deltas are from.
+ */
+void AVRTraceRecorder::startBlock (quint32 index)
+{
+	uchar *base = _map + TRACE_FILE_HEADER + (qint64)index * TRACE_BLOCK_SIZE;
+	BlockHeader bh;
+
+	bh.sequence = _sequence++;
+	bh.cycle = _cycle;
+	bh.instructions = _instructions;
+	bh.pc = _pc;
+	bh.writeAddr = _writeAddr;
+	bh.used = 0;
+	bh.reserved = 0;
+	memcpy (base, &bh, sizeof (bh));
+
+	if (index >= _header.used) {
+		_header.used = index + 1;
+	}
+	memcpy (_map, &_header, sizeof (_header));
+	_block = index;
+	_start = _at = base + sizeof (BlockHeader);
+	_limit = base + TRACE_BLOCK_SIZE - TRACE_BLOCK_SLACK;
+}
+/*}}}*/
+
@@ -0,0 +1,160 @@
+/*
+ *	avrtracerecorder.h -- compact execution traces from the simulator.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRTRACERECORDER_H
+#define AVRTRACERECORDER_H
+
+#include <QFile>
+#include <QString>
+
+#define TRACE_MAGIC		"AVRTRC01"
+#define TRACE_FILE_HEADER	4096		/* bytes before the first block */
+#define TRACE_BLOCK_SIZE	65536
+#define TRACE_BLOCK_SLACK	128		/* room for one instruction's writes and record */
+
+/*
+ *	Writes the instructions the simulator runs (word address, and the cycle count after each) and
+ *	the data-space writes they make to a memory-mapped file, as deltas from the record before:
+ *	  0ccc pppp			instruction: cycles 1-7 (ccc+1), PC -7..+7 (pppp-7); ccc = 7 or
+ *					pppp = 15 means varints follow (cycles, then zigzag PC delta)
+ *	  1aaa aaaa vvvvvvvv		write of v: address aaaaaaa zigzag from the last write, or 127
+ *					and a zigzag varint follows before v
+ *	Writes belong to the instruction record that follows them.  The file is cut into fixed-size
+ *	blocks, which always end after an instruction record, each starting with the absolute values
+ *	the deltas start from, so a reader can start at any block; blocks are in cycle order, which
+ *	makes seeking a binary search.  In ring mode the oldest block is reused once the file is
+ *	full, otherwise recording stops there.  Headers are in host byte order.
+ */
+class AVRTraceRecorder
+{
+public:
+	typedef struct FileHeader {
+		char magic[8];
+		quint32 blockSize;
+		quint32 blockCount;
+		quint32 ring;
+		quint32 first;		/* oldest block */
+		quint32 used;		/* blocks holding records */
+		quint32 dropped;	/* not a ring, and filled up */
+	} FileHeader;
+
+	typedef struct BlockHeader {
+		quint64 sequence;	/* blocks written before this one */
+		quint64 cycle;		/* where the deltas start */
+		quint64 instructions;	/* instruction records before this block */
+		quint32 pc;
+		quint32 writeAddr;
+		quint32 used;		/* bytes of records after the header */
+		quint32 reserved;
+	} BlockHeader;
+
+	AVRTraceRecorder ();
+	~AVRTraceRecorder ();
+
+	bool open (const QString &fileName, qint64 bytes, bool ring, quint64 cycle, quint32 pc, QString *error);
+	void close (void);
+	bool isOpen (void) const;
+	QString fileName (void) const;
+	qint64 bytesWritten (void) const;
+
+	inline void instruction (quint32 pc, quint64 cycle);
+	inline void write (quint32 addr, quint8 value);
+
+private:
+	void nextBlock (void);
+	void finishBlock (void);
+	void startBlock (quint32 index);
+	inline void varint (quint64 v);
+
+	QFile _file;
+	uchar *_map;
+	FileHeader _header;
+	quint32 _block;			/* being written */
+	quint64 _sequence;
+	uchar *_at;			/* next record */
+	uchar *_limit;			/* block full once past here */
+	uchar *_start;			/* first record of the block */
+	uchar _scratch[TRACE_BLOCK_SIZE / 16];	/* where records go once a full file stops recording */
+	quint64 _instructions;
+	quint64 _cycle;
+	quint32 _pc;
+	quint32 _writeAddr;
+	qint64 _written;		/* bytes in blocks finished */
+};
+
+/*{{{  inline void AVRTraceRecorder::varint (quint64 v)*/
+/*
+ *	7 bits a byte, low first, top bit set on all but the last.
+ */
+inline void AVRTraceRecorder::varint (quint64 v)
+{
+	while (v >= 0x80) {
+		*_at++ = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	*_at++ = v;
+}
+/*}}}*/
+/*{{{  inline void AVRTraceRecorder::instruction (quint32 pc, quint64 cycle)*/
+/*
+ *	records an instruction run at word address 'pc', the count reaching 'cycle'.
+ */
+inline void AVRTraceRecorder::instruction (quint32 pc, quint64 cycle)
+{
+	quint64 dc = cycle - _cycle - 1;
+	qint32 dpc = (qint32)(pc - _pc);
+	quint32 p = (quint32)(dpc + 7);
+
+	if ((dc < 7) && (p < 15)) {
+		*_at++ = (dc << 4) | p;
+	} else {
+		*_at++ = 0x7f;
+		varint (cycle - _cycle);
+		varint (((quint32)dpc << 1) ^ (quint32)(dpc >> 31));
+	}
+	_cycle = cycle;
+	_pc = pc;
+	_instructions++;
+	if (_at > _limit) {
+		nextBlock ();
+	}
+}
+/*}}}*/
+/*{{{  inline void AVRTraceRecorder::write (quint32 addr, quint8 value)*/
+/*
+ *	records a data-space write (by the instruction recorded next).
+ */
+inline void AVRTraceRecorder::write (quint32 addr, quint8 value)
+{
+	qint32 da = (qint32)(addr - _writeAddr);
+	quint32 z = ((quint32)da << 1) ^ (quint32)(da >> 31);
+
+	if (z < 127) {
+		*_at++ = 0x80 | z;
+	} else {
+		*_at++ = 0xff;
+		varint (z);
+	}
+	*_at++ = value;
+	_writeAddr = addr;
+}
+/*}}}*/
+
+#endif	/* !AVRTRACERECORDER_H */
+
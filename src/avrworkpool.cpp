@@ -0,0 +1,234 @@
+/*
+ *	avrworkpool.cpp -- work-stealing thread pool.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <QMutexLocker>
+
+#include "avrworkpool.h"
+
+/*{{{  AVRWorkPoolWorker::AVRWorkPoolWorker (AVRWorkPool *pool, int id)*/
+/*
+ *	constructor.
+ */
+AVRWorkPoolWorker::AVRWorkPoolWorker (AVRWorkPool *pool, int id) : _pool (pool), _id (id)
+{
+}
+/*}}}*/
+/*{{{  void AVRWorkPoolWorker::push (const std::function<void (void)> &task)*/
+/*
+ *	adds a task to the back of this worker's deque.
+ */
+void AVRWorkPoolWorker::push (const std::function<void (void)> &task)
+{
+	QMutexLocker locker (&_lock);
+
+	_tasks.append (task);
+}
+/*}}}*/
+/*{{{  bool AVRWorkPoolWorker::popBack (std::function<void (void)> *task)*/
+/*
+ *	takes the most recently added task (owner only).
+ *	returns true if there was one, false otherwise.
+ */
+bool AVRWorkPoolWorker::popBack (std::function<void (void)> *task)
+{
+	QMutexLocker locker (&_lock);
+
+	if (_tasks.isEmpty ()) {
+		return false;
+	}
+	*task = _tasks.takeLast ();
+	return true;
+}
+/*}}}*/
+/*{{{  bool AVRWorkPoolWorker::stealFront (std::function<void (void)> *task)*/
+/*
+ *	takes the oldest task (other workers, when idle).
+ *	returns true if there was one, false otherwise.
+ */
+bool AVRWorkPoolWorker::stealFront (std::function<void (void)> *task)
+{
+	QMutexLocker locker (&_lock);
+
+	if (_tasks.isEmpty ()) {
+		return false;
+	}
+	*task = _tasks.dequeue ();
+	return true;
+}
+/*}}}*/
+/*{{{  void AVRWorkPoolWorker::run (void)*/
+/*
+ *	worker thread: run tasks until the pool is stopped.
+ */
+void AVRWorkPoolWorker::run (void)
+{
+	for (;;) {
+		std::function<void (void)> task;
+
+		if (_pool->findWork (_id, &task)) {
+			task ();
+			_pool->taskDone ();
+			continue;
+		}
+
+		QMutexLocker locker (&_pool->_idleLock);
+
+		while (!_pool->_stopping && (_pool->_queued.load () == 0)) {
+			_pool->_workAvailable.wait (&_pool->_idleLock);
+		}
+		if (_pool->_stopping && (_pool->_queued.load () == 0)) {
+			return;
+		}
+	}
+}
+/*}}}*/
+
+
+/*{{{  AVRWorkPool::AVRWorkPool (int threads)*/
+/*
+ *	constructor: starts 'threads' workers (one per core if 0).
+ */
+AVRWorkPool::AVRWorkPool (int threads)
+{
+	if (threads <= 0) {
+		threads = qMax (1, QThread::idealThreadCount ());
+	}
+	_stopping = false;
+	for (int i=0; i<threads; i++) {
+		_workers << new AVRWorkPoolWorker (this, i);
+	}
+	for (AVRWorkPoolWorker *w : _workers) {
+		w->start ();
+	}
+}
+/*}}}*/
+/*{{{  AVRWorkPool::~AVRWorkPool ()*/
+/*
+ *	destructor: finishes outstanding work, then stops the workers.
+ */
+AVRWorkPool::~AVRWorkPool ()
+{
+	waitForDone ();
+	{
+		QMutexLocker locker (&_idleLock);
+
+		_stopping = true;
+		_workAvailable.wakeAll ();
+	}
+	for (AVRWorkPoolWorker *w : _workers) {
+		w->wait ();
+		delete w;
+	}
+}
+/*}}}*/
+/*{{{  void AVRWorkPool::submit (const std::function<void (void)> &task)*/
+/*
+ *	queues a task: on the calling worker's own deque if called from a task, otherwise round-robin.
+ */
+void AVRWorkPool::submit (const std::function<void (void)> &task)
+{
+	AVRWorkPoolWorker *target = 0;
+
+	for (AVRWorkPoolWorker *w : _workers) {
+		if (QThread::currentThread () == w) {
+			target = w;
+			break;
+		}
+	}
+	if (!target) {
+		target = _workers.at ((unsigned int)_next.fetchAndAddRelaxed (1) % _workers.count ());
+	}
+
+	_pending.ref ();
+	_queued.ref ();
+	target->push (task);
+
+	QMutexLocker locker (&_idleLock);
+
+	_workAvailable.wakeOne ();
+}
+/*}}}*/
+/*{{{  void AVRWorkPool::waitForDone (void)*/
+/*
+ *	blocks until every submitted task (and anything they submitted) has finished.
+ */
+void AVRWorkPool::waitForDone (void)
+{
+	QMutexLocker locker (&_idleLock);
+
+	while (_pending.load () > 0) {
+		_allDone.wait (&_idleLock);
+	}
+}
+/*}}}*/
+/*{{{  int AVRWorkPool::threadCount (void) const*/
+/*
+ *	returns the number of worker threads.
+ */
+int AVRWorkPool::threadCount (void) const
+{
+	return _workers.count ();
+}
+/*}}}*/
+/*{{{  int AVRWorkPool::steals (void) const*/
+/*
+ *	returns how many tasks were taken from another worker's deque.
+ */
+int AVRWorkPool::steals (void) const
+{
+	return _steals.load ();
+}
+/*}}}*/
+/*{{{  bool AVRWorkPool::findWork (int id, std::function<void (void)> *task)*/
+/*
+ *	finds the next task for worker 'id': its own newest first, else the oldest of another's.
+ *	returns true if a task was found, false otherwise.
+ */
+bool AVRWorkPool::findWork (int id, std::function<void (void)> *task)
+{
+	int n = _workers.count ();
+
+	if (_workers.at (id)->popBack (task)) {
+		_queued.deref ();
+		return true;
+	}
+	for (int i=1; i<n; i++) {
+		if (_workers.at ((id + i) % n)->stealFront (task)) {
+			_queued.deref ();
+			_steals.ref ();
+			return true;
+		}
+	}
+	return false;
+}
+/*}}}*/
+/*{{{  void AVRWorkPool::taskDone (void)*/
+/*
+ *	called by a worker after running a task.
+ */
+void AVRWorkPool::taskDone (void)
+{
+	if (!_pending.deref ()) {
+		QMutexLocker locker (&_idleLock);
+
+		_allDone.wakeAll ();
+	}
+}
+/*}}}*/
+
@@ -0,0 +1,87 @@
+/*
+ *	avrworkpool.h -- work-stealing thread pool.
+ *	Copyright (C) 2013-2015 Fred Barnes, University of Kent <frmb@kent.ac.uk>
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef AVRWORKPOOL_H
+#define AVRWORKPOOL_H
+
+#include <functional>
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+class AVRWorkPool;
+
+/*
+ *	Each worker owns a deque: it takes its own work from the back (most recently added, still warm)
+ *	and, when that runs dry, steals from the front of someone else's.  Tasks submitted from inside
+ *	a task go onto the submitting worker's own deque.
+ */
+class AVRWorkPoolWorker : public QThread
+{
+public:
+	AVRWorkPoolWorker (AVRWorkPool *pool, int id);
+
+	void push (const std::function<void (void)> &task);
+	bool popBack (std::function<void (void)> *task);
+	bool stealFront (std::function<void (void)> *task);
+
+protected:
+	void run (void);
+
+private:
+	AVRWorkPool *_pool;
+	int _id;
+	QMutex _lock;
+	QQueue<std::function<void (void)> > _tasks;
+};
+
+class AVRWorkPool
+{
+public:
+	explicit AVRWorkPool (int threads = 0);
+	~AVRWorkPool ();
+
+	void submit (const std::function<void (void)> &task);
+	void waitForDone (void);
+	int threadCount (void) const;
+	int steals (void) const;
+
+private:
+	friend class AVRWorkPoolWorker;
+
+	bool findWork (int id, std::function<void (void)> *task);
+	void taskDone (void);
+
+	QList<AVRWorkPoolWorker *> _workers;
+	QAtomicInt _next;		/* round-robin for submits from outside the pool */
+	QAtomicInt _queued;		/* tasks sitting in some deque */
+	QAtomicInt _pending;		/* tasks submitted and not yet finished */
+	QAtomicInt _steals;
+	bool _stopping;
+	QMutex _idleLock;
+	QWaitCondition _workAvailable;
+	QWaitCondition _allDone;
+};
+
+#endif	/* !AVRWORKPOOL_H */
+
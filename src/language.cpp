@@ -91,27 +91,27 @@ const QMultiMap < QString, OpcodeInfo > OpcodesInfo = {
 	{"MOV", {"MOV", "Rd, Rr", "Copy Register", {"Rd ← Rr"}, "None", "1"}},
 	{"MOVW", {"MOVW", "Rd, Rr", "Copy Register Pair", {"Rd+1:Rd ← Rr+1:Rr"}, "None", "1"}},
 	{"LDI", {"LDI", "Rd, K", "Load Immediate", {"Rd ← K"}, "None", "1"}},
-	{"LDS", {"LDS", "Rd, k", "Load Direct from data space", {"Rd ← (k)"}, "None", "1"}},
-	{"LD", {"LD", "Rd, X", "Load Indirect", {"Rd ← (X)"}, "None", "1"}},
+	{"LDS", {"LDS", "Rd, k", "Load Direct from data space", {"Rd ← (k)"}, "None", "2"}},
+	{"LD", {"LD", "Rd, X", "Load Indirect", {"Rd ← (X)"}, "None", "2"}},
 	{"LD", {"LD", "Rd, X+", "Load Indirect and Post-Increment", {"Rd ← (X)", "X ← X + 1"}, "None", "2"}},
 	{"LD", {"LD", "Rd, -X", "Load Indirect and Pre-Decrement", {"X ← X - 1,  ←  X - 1", "Rd ← (X)  ←  (X)"}, "None", "2"}},
-	{"LD", {"LD", "Rd, Y", "Load Indirect", {"Rd ← (Y)  ←  (Y)"}, "None", "1"}},
+	{"LD", {"LD", "Rd, Y", "Load Indirect", {"Rd ← (Y)  ←  (Y)"}, "None", "2"}},
 	{"LD", {"LD", "Rd, Y+", "Load Indirect and Post-Increment", {"Rd ← (Y)", "Y ← Y + 1"}, "None", "2"}},
 	{"LD", {"LD", "Rd, -Y", "Load Indirect and Pre-Decrement", {"Y ← Y - 1", "Rd ← (Y)"}, "None", "2"}},
-	{"LD", {"LD", "Rd, Z", "Load Indirect ", {"Rd ← (Z)"}, "None", "1"}},
+	{"LD", {"LD", "Rd, Z", "Load Indirect ", {"Rd ← (Z)"}, "None", "2"}},
 	{"LD", {"LD", "Rd, Z+", "Load Indirect and Post-Increment", {"Rd ← (Z),", "Z ← Z+1"}, "None", "2"}},
 	{"LD", {"LD", "Rd, -Z", "Load Indirect and Pre-Decrement", {"Z ← Z - 1,", "Rd ← (Z)"}, "None", "2"}},
 	{"LDD", {"LDD", "Rd, Y+q ", "Load Indirect with Displacement", {"Rd ← (Y + q)"}, "None", "2"}},
 	{"LDD", {"LDD", "Rd, Z+q ", "Load Indirect with Displacement", {"Rd ← (Z + q)"}, "None", "2"}},
-	{"STS", {"STS", "k, Rr", "Store Direct to Data Space", {"(k) ← Rd"}, "None", "1"}},
-	{"ST", {"ST", "X, Rr", "Store Indirect", {"(X) ← Rr"}, "None", "1"}},
-	{"ST", {"ST", "X+, Rr", "Store Indirect and Post-Increment", {"(X) ← Rr,", "X ← X + 1"}, "None", "1"}},
+	{"STS", {"STS", "k, Rr", "Store Direct to Data Space", {"(k) ← Rd"}, "None", "2"}},
+	{"ST", {"ST", "X, Rr", "Store Indirect", {"(X) ← Rr"}, "None", "2"}},
+	{"ST", {"ST", "X+, Rr", "Store Indirect and Post-Increment", {"(X) ← Rr,", "X ← X + 1"}, "None", "2"}},
 	{"ST", {"ST", "-X, Rr", "Store Indirect and Pre-Decrement", {"X ← X - 1,", "(X) ← Rr"}, "None", "2"}},
-	{"ST", {"ST", "Y, Rr", "Store Indirect", {"(Y) ← Rr"}, "None", "1"}},
-	{"ST", {"ST", "Y+, Rr", "Store Indirect and Post-Increment", {"(Y) ← Rr,", "Y ← Y + 1"}, "None", "1"}},
+	{"ST", {"ST", "Y, Rr", "Store Indirect", {"(Y) ← Rr"}, "None", "2"}},
+	{"ST", {"ST", "Y+, Rr", "Store Indirect and Post-Increment", {"(Y) ← Rr,", "Y ← Y + 1"}, "None", "2"}},
 	{"ST", {"ST", "-Y, Rr", "Store Indirect and Pre-Decrement", {"Y ← Y - 1,", "(Y) ← Rr"}, "None", "2"}},
-	{"ST", {"ST", "Z, Rr", "Store Indirect", {"(Z) ← Rr"}, "None", "1"}},
-	{"ST", {"ST", "Z+, Rr", "Store Indirect and Post-Increment", {"(Z) ← Rr", "Z ← Z + 1"}, "None", "1"}},
+	{"ST", {"ST", "Z, Rr", "Store Indirect", {"(Z) ← Rr"}, "None", "2"}},
+	{"ST", {"ST", "Z+, Rr", "Store Indirect and Post-Increment", {"(Z) ← Rr", "Z ← Z + 1"}, "None", "2"}},
 	{"ST", {"ST", "-Z, Rr", "Store Indirect and Pre-Decrement", {"Z ← Z - 1"}, "None", "2"}},
 	{"STD", {"STD", "Y+q, Rr", "Store Indirect with Displacement", {"(Y + q) ← Rr"}, "None", "2"}},
 	{"STD", {"STD", "Z+q, Rr", "Store Indirect with Displacement", {"(Z + q) ← Rr"}, "None", "2"}},
@@ -139,8 +139,8 @@ const QMultiMap < QString, OpcodeInfo > OpcodesInfo = {
 	{"SWAP", {"SWAP", "Rd", "Swap Nibbles", {"Rd(3..0) ↔ Rd(7..4)"}, "None", "1"}},
 	{"BSET", {"BSET", "s", "Flag Set", {"SREG(s) ← 1"}, "SREG(s)", "1"}},
 	{"BCLR", {"BCLR", "s", "Flag Clear", {"SREG(s) ← 0"}, "SREG(s)", "1"}},
-	{"SBI", {"SBI", "A, b", "Set Bit in I/O Register", {"I/O(A, b) ← 1"}, "None", "1"}},
-	{"CBI", {"CBI", "A, b", "Clear Bit in I/O Register", {"I/O(A, b) ← 0"}, "None", "1"}},
+	{"SBI", {"SBI", "A, b", "Set Bit in I/O Register", {"I/O(A, b) ← 1"}, "None", "2"}},
+	{"CBI", {"CBI", "A, b", "Clear Bit in I/O Register", {"I/O(A, b) ← 0"}, "None", "2"}},
 	{"BST", {"BST", "Rr, b", "Bit Store from Register to T", {"T ← Rr(b)"}, "T", "1"}},
 	{"BLD", {"BLD", "Rd, b", "Bit load from T to Register", {"Rd(b) ← T"}, "None", "1"}},
 	{"SEC", {"SEC", "", "Set Carry", {"C ← 1"}, "C", "1"}},
@@ -161,7 +161,8 @@ const QMultiMap < QString, OpcodeInfo > OpcodesInfo = {
 	{"CLH", {"CLH", "", "Clear Half Carry Flag in SREG", {"H ← 0"}, "H", "1"}},
 	{"BREAK", {"BREAK", "", "Break", {"(See specific descr. for BREAK)"}, "None", "1"}},
 	{"NOP", {"NOP", "", "No Operation", {}, "None", "1"}},
-	{"SLEEP", {"SLEEP", "", "Sleep", {"(see specific descr. for Sleep)"}, "None", "1"}}
+	{"SLEEP", {"SLEEP", "", "Sleep", {"(see specific descr. for Sleep)"}, "None", "1"}},
+	{"WDR", {"WDR", "", "Watchdog Reset", {"(see specific descr. for WDR)"}, "None", "1"}}
 };
 
 const QMap < QString, DirectiveInfo > DirectivesInfo = {
@@ -183,4 +184,56 @@ const QMap < QString, DirectiveInfo > DirectivesInfo = {
 	{".text", {".text", "", "Indicates that what follows should go into the text (code) section.", ".text"}},
 };
 
+/*{{{  bool opcodeCycles (const QString &nClocks, int *minCycles, int *maxCycles)*/
+/*
+ *	turns an OpcodeInfo cycle string ("1", "1 / 2", "1 / 2 / 3") into minimum and maximum counts.
+ *	returns true on success, false if the string holds no numbers (e.g. "-").
+ */
+bool opcodeCycles (const QString &nClocks, int *minCycles, int *maxCycles)
+{
+	QStringList parts = nClocks.split ('/', QString::SkipEmptyParts);
+	bool any = false;
+
+	for (const QString &part : parts) {
+		bool ok;
+		int n = part.trimmed ().toInt (&ok);
+
+		if (!ok) {
+			continue;
+		}
+		if (!any || (n < *minCycles)) {
+			*minCycles = n;
+		}
+		if (!any || (n > *maxCycles)) {
+			*maxCycles = n;
+		}
+		any = true;
+	}
+	return any;
+}
+/*}}}*/
+/*{{{  const OpcodeInfo *findOpcodeInfo (const QString &mnemonic, const QString &parameters)*/
+/*
+ *	finds the OpcodesInfo entry for a mnemonic; where there are several (LD, ST, LPM, ..) the one
+ *	whose parameter pattern matches 'parameters' (ignoring spaces), or the first if none given.
+ *	returns NULL if not found.
+ */
+const OpcodeInfo *findOpcodeInfo (const QString &mnemonic, const QString &parameters)
+{
+	QString key = mnemonic.toUpper ();
+	QString want = QString (parameters).remove (' ');
+	bool anyVariant = parameters.isNull ();
+	const OpcodeInfo *first = 0;
+
+	for (auto it = OpcodesInfo.constFind (key); (it != OpcodesInfo.constEnd ()) && (it.key () == key); ++it) {
+		if (!first) {
+			first = &(*it);
+		}
+		if (!anyVariant && (QString (it->parameters).remove (' ') == want)) {
+			return &(*it);
+		}
+	}
+	return anyVariant ? first : 0;
+}
+/*}}}*/
 
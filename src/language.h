@@ -47,6 +47,9 @@ typedef struct DirectiveInfo
 extern const QMultiMap<QString, OpcodeInfo> OpcodesInfo;
 extern const QMap<QString, DirectiveInfo> DirectivesInfo;
 
+bool opcodeCycles (const QString &nClocks, int *minCycles, int *maxCycles);
+const OpcodeInfo *findOpcodeInfo (const QString &mnemonic, const QString &parameters = QString ());
+
 static const QSet<QString> AVRASMKeywords = {
 	"r0",
 	"r1",
@@ -20,10 +20,404 @@
 
 
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
 #include <QApplication>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
 
 #include "mainwindow.h"
+#include "arduinoconfiguration.h"
+#include "avrbatchbuild.h"
+#include "avrgdbserver.h"
+#include "avrheximage.h"
+#include "avrsimulator.h"
+#include "avrtracereader.h"
 
+/*{{{  static int batchMain (int argc, char *argv[])*/
+/*
+ *	batch (command-line) build:
+ *		avr-asm-ide --batch [-j N] [--device D[,D...]] [--report FILE] [--timeout MS] file.asm|@list ...
+ *	the compiler and its parameters come from the saved settings.
+ *	returns 0 if everything built, 1 if anything failed, 2 on usage errors.
+ */
+static int batchMain (int argc, char *argv[])
+{
+	QCoreApplication app (argc, argv);
+	QStringList args = app.arguments ();
+	QSettings settings ("unikent", "avr-asm-ide");
+	QStringList devices;
+	QString reportFile;
+	AVRBatchBuild batch;
+	int nfiles = 0;
+
+	batch.setNocc (settings.value ("noccPath", DEFAULT_noccPath).toString (),
+			settings.value ("noccSpecsPath", DEFAULT_noccSpecsPath).toString (),
+			settings.value ("noccParams", DEFAULT_noccParams).toString ());
+
+	/* options first, so that devices apply to every file */
+	for (int i=1; i<args.count (); i++) {
+		const QString &arg = args.at (i);
+
+		if (((arg == "-j") || (arg == "--device") || (arg == "--report") || (arg == "--timeout")) && (i + 1 >= args.count ())) {
+			std::cerr << "batch: " << arg.toStdString () << " needs an argument" << std::endl;
+			return 2;
+		}
+		if (arg == "-j") {
+			batch.setThreads (args.at (++i).toInt ());
+		} else if (arg == "--device") {
+			devices << args.at (++i).split (',', QString::SkipEmptyParts);
+		} else if (arg == "--report") {
+			reportFile = args.at (++i);
+		} else if (arg == "--timeout") {
+			batch.setTimeout (args.at (++i).toInt ());
+		}
+	}
+	if (devices.isEmpty ()) {
+		devices << settings.value ("opt_p", DEFAULT_opt_p).toString ();
+	}
+	if ((devices.count () > 1) && !settings.value ("noccParams", DEFAULT_noccParams).toString ().contains ("%device%")) {
+		std::cerr << "batch: several devices given, but the nocc parameters have no %device%: those builds will fail" << std::endl;
+	}
+	for (int i=1; i<args.count (); i++) {
+		const QString &arg = args.at (i);
+
+		if ((arg == "-j") || (arg == "--device") || (arg == "--report") || (arg == "--timeout")) {
+			i++;
+		} else if (arg.startsWith ('@')) {
+			batch.addListFile (arg.mid (1), devices);
+			nfiles++;
+		} else if (!arg.startsWith ("-")) {
+			batch.addFile (arg, devices);
+			nfiles++;
+		}
+	}
+	if (!nfiles) {
+		std::cerr << "usage: " << args.at (0).toStdString ()
+			<< " --batch [-j N] [--device D[,D...]] [--report FILE] [--timeout MS] file.asm|@list ..." << std::endl;
+		return 2;
+	}
+
+	batch.start ();
+	batch.wait ();
+
+	std::cout << batch.report ().toStdString ();
+	if (!reportFile.isEmpty ()) {
+		QString err;
+
+		if (!batch.saveReport (reportFile, &err)) {
+			std::cerr << err.toStdString () << std::endl;
+		}
+	}
+	return batch.failures () ? 1 : 0;
+}
+/*}}}*/
+/*{{{  static bool parseRange (const QString &text, quint32 *first, quint32 *last)*/
+/*
+ *	parses "FIRST-LAST" (or a single address), either in decimal or 0x-prefixed hex.
+ *	returns true on success, false otherwise.
+ */
+static bool parseRange (const QString &text, quint32 *first, quint32 *last)
+{
+	QStringList parts = text.split ('-');
+	bool ok1 = false, ok2 = false;
+
+	if ((parts.count () < 1) || (parts.count () > 2)) {
+		return false;
+	}
+	*first = parts.at (0).toUInt (&ok1, 0);
+	*last = parts.at (parts.count () - 1).toUInt (&ok2, 0);
+	return ok1 && ok2 && (*first <= *last);
+}
+/*}}}*/
+/*{{{  static int traceDumpMain (int argc, char *argv[])*/
+/*
+ *	prints an execution trace recorded by the simulator, one instruction a line:
+ *		avr-asm-ide --trace-dump FILE [--from CYCLE] [--count N] [--pc FIRST-LAST] [--writes FIRST-LAST]
+ *	--pc takes byte addresses in flash (as listings show them), --writes data-space addresses.
+ *	returns 0 on success, 1 if the trace cannot be read, 2 on usage errors.
+ */
+static int traceDumpMain (int argc, char *argv[])
+{
+	QCoreApplication app (argc, argv);
+	QStringList args = app.arguments ();
+	AVRTraceReader reader;
+	AVRTraceReader::Record rec;
+	QString file, err;
+	quint64 from = 0;
+	qint64 count = -1;
+
+	for (int i=1; i<args.count (); i++) {
+		const QString &arg = args.at (i);
+		quint32 first, last;
+
+		if (arg == "--trace-dump") {
+			if (i + 1 < args.count ()) {
+				file = args.at (++i);
+			}
+		} else if ((arg == "--from") && (i + 1 < args.count ())) {
+			from = args.at (++i).toULongLong (0, 0);
+		} else if ((arg == "--count") && (i + 1 < args.count ())) {
+			count = args.at (++i).toLongLong ();
+		} else if ((arg == "--pc") && (i + 1 < args.count ()) && parseRange (args.at (i + 1), &first, &last)) {
+			reader.setPCFilter (first / 2, last / 2);
+			i++;
+		} else if ((arg == "--writes") && (i + 1 < args.count ()) && parseRange (args.at (i + 1), &first, &last)) {
+			reader.setWriteFilter (first, last);
+			i++;
+		} else {
+			file.clear ();
+			break;
+		}
+	}
+	if (file.isEmpty ()) {
+		std::cerr << "usage: " << args.at (0).toStdString ()
+			<< " --trace-dump FILE [--from CYCLE] [--count N] [--pc FIRST-LAST] [--writes FIRST-LAST]" << std::endl;
+		return 2;
+	}
+	if (!reader.open (file, &err)) {
+		std::cerr << err.toStdString () << std::endl;
+		return 1;
+	}
+	if (reader.isRing () && (from < reader.firstCycle ())) {
+		std::cerr << "trace: starts after cycle " << reader.firstCycle () << std::endl;
+	}
+	if (!reader.seek (from)) {
+		return 0;
+	}
+	while (count && reader.next (&rec)) {
+		QString line = QString ("%1\t%2\t0x%3").arg (rec.index).arg (rec.cycle).arg (rec.pc * 2, 4, 16, QChar ('0'));
+
+		for (int i=0; i<rec.writeCount; i++) {
+			line += QString ("\t[0x%1]=0x%2").arg (rec.writes[i].addr, 4, 16, QChar ('0')).arg (rec.writes[i].value, 2, 16, QChar ('0'));
+		}
+		std::cout << line.toStdString () << std::endl;
+		if (count > 0) {
+			count--;
+		}
+	}
+	if (reader.wasTruncated ()) {
+		std::cerr << "trace: the file filled up, recording stopped early" << std::endl;
+	}
+	return 0;
+}
+/*}}}*/
+/*{{{  static AVRSimulator *loadSimulator (const char *mode, const QString &device, const QString &flashFile, const QString &eepromFile, int *status)*/
+/*
+ *	creates a simulator for a device with a flash image and (optionally) an EEPROM image loaded,
+ *	for the headless modes.  Problems are reported on stderr.
+ *	returns the simulator, or 0 with the exit status in 'status' (1 if an image cannot be read, 2
+ *	for an unknown device).
+ */
+static AVRSimulator *loadSimulator (const char *mode, const QString &device, const QString &flashFile, const QString &eepromFile, int *status)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (device);
+	AVRHexImage flash, eeprom;
+	AVRSimulator *sim;
+	QString err;
+
+	if (!dev) {
+		std::cerr << mode << ": unknown device \"" << device.toStdString () << "\"" << std::endl;
+		*status = 2;
+		return 0;
+	}
+	flash.reset (dev->flashSize, dev->flashPageSize);
+	eeprom.reset (dev->eepromSize, dev->eepromPageSize);
+	if (!flash.load (flashFile, &err) || (!eepromFile.isEmpty () && !eeprom.load (eepromFile, &err))) {
+		std::cerr << err.toStdString () << std::endl;
+		*status = 1;
+		return 0;
+	}
+	sim = new AVRSimulator (*dev);
+	sim->loadFlash (flash);
+	sim->loadEeprom (eeprom);
+	return sim;
+}
+/*}}}*/
+/*{{{  static int gdbServerMain (int argc, char *argv[])*/
+/*
+ *	simulates a build for avr-gdb to attach to ("target remote localhost:PORT"), until killed:
+ *		avr-asm-ide --gdb-server FILE.hex [--eeprom FILE.hex] [--device D] [--port N]
+ *	the device and port default to the saved settings.
+ *	returns 1 if an image cannot be read or the port is in use, 2 on usage errors.
+ */
+static int gdbServerMain (int argc, char *argv[])
+{
+	QCoreApplication app (argc, argv);
+	QStringList args = app.arguments ();
+	QSettings settings ("unikent", "avr-asm-ide");
+	QString flashFile, eepromFile, err;
+	QString device = settings.value ("opt_p", DEFAULT_opt_p).toString ();
+	int port = settings.value ("simGdbPort", 1234).toInt ();
+	int status;
+	AVRSimulator *sim;
+	AVRGdbServer *server;
+
+	for (int i=1; i<args.count (); i++) {
+		const QString &arg = args.at (i);
+
+		if (i + 1 >= args.count ()) {
+			flashFile.clear ();
+			break;
+		} else if (arg == "--gdb-server") {
+			flashFile = args.at (++i);
+		} else if (arg == "--eeprom") {
+			eepromFile = args.at (++i);
+		} else if (arg == "--device") {
+			device = args.at (++i);
+		} else if (arg == "--port") {
+			port = args.at (++i).toInt ();
+		} else {
+			flashFile.clear ();
+			break;
+		}
+	}
+	if (flashFile.isEmpty () || (port < 0) || (port > 65535)) {
+		std::cerr << "usage: " << args.at (0).toStdString ()
+			<< " --gdb-server FILE.hex [--eeprom FILE.hex] [--device D] [--port N]" << std::endl;
+		return 2;
+	}
+	sim = loadSimulator ("gdb-server", device, flashFile, eepromFile, &status);
+	if (!sim) {
+		return status;
+	}
+	server = new AVRGdbServer (sim, &app);
+	if (!server->listen (port, &err)) {
+		std::cerr << "gdb-server: " << err.toStdString () << std::endl;
+		return 1;
+	}
+	std::cout << "simulating " << sim->device ().name.toStdString () << " for gdb on localhost:" << server->port () << std::endl;
+	return app.exec ();
+}
+/*}}}*/
+/*{{{  static int simulateMain (int argc, char *argv[])*/
+/*
+ *	runs a build in the simulator without a window, for regression tests, and prints the end state
+ *	as JSON (stop reason, cycles, registers, USART output, and any data-space ranges asked for):
+ *		avr-asm-ide --simulate FILE.hex [--eeprom FILE.hex] [--device D] [--cycles N]
+ *			[--break ADDR]... [--exit-port ADDR] [--dump FIRST-LAST]...
+ *	--break takes byte addresses in flash (as listings show them); --exit-port and --dump take
+ *	data-space addresses.  A write to the exit port stops the run, the value written being the
+ *	program's verdict.
+ *	returns 0 if the program wrote 0 to the exit port (or, without one, stopped other than on an
+ *	invalid instruction), 1 if not or an image cannot be read, 2 on usage errors.
+ */
+static int simulateMain (int argc, char *argv[])
+{
+	QCoreApplication app (argc, argv);
+	QStringList args = app.arguments ();
+	QSettings settings ("unikent", "avr-asm-ide");
+	QString flashFile, eepromFile;
+	QString device = settings.value ("opt_p", DEFAULT_opt_p).toString ();
+	quint64 cycles = 100000000ULL;
+	QList<quint32> breaks, dumpFirst, dumpLast;
+	qint64 exitPort = -1;
+	int status;
+	AVRSimulator *sim;
+	AVRSimulator::StopReason reason;
+	QJsonObject top;
+	QJsonArray regs, dumps;
+	bool ok = true;
+	int exitValue = -1;
+
+	for (int i=1; i<args.count (); i++) {
+		const QString &arg = args.at (i);
+		quint32 first, last;
+
+		if (i + 1 >= args.count ()) {
+			ok = false;
+		} else if (arg == "--simulate") {
+			flashFile = args.at (++i);
+		} else if (arg == "--eeprom") {
+			eepromFile = args.at (++i);
+		} else if (arg == "--device") {
+			device = args.at (++i);
+		} else if (arg == "--cycles") {
+			cycles = args.at (++i).toULongLong (&ok, 0);
+		} else if (arg == "--break") {
+			breaks << args.at (++i).toUInt (&ok, 0);
+		} else if (arg == "--exit-port") {
+			exitPort = args.at (++i).toUInt (&ok, 0);
+		} else if ((arg == "--dump") && parseRange (args.at (i + 1), &first, &last)) {
+			dumpFirst << first;
+			dumpLast << last;
+			i++;
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			break;
+		}
+	}
+	if (!ok || flashFile.isEmpty ()) {
+		std::cerr << "usage: " << args.at (0).toStdString ()
+			<< " --simulate FILE.hex [--eeprom FILE.hex] [--device D] [--cycles N] [--break ADDR]... [--exit-port ADDR] [--dump FIRST-LAST]..."
+			<< std::endl;
+		return 2;
+	}
+	sim = loadSimulator ("simulate", device, flashFile, eepromFile, &status);
+	if (!sim) {
+		return status;
+	}
+	for (int i=0; i<breaks.count (); i++) {
+		if (!sim->setBreakpoint (breaks.at (i) / 2, true)) {
+			std::cerr << "simulate: breakpoint 0x" << QString::number (breaks.at (i), 16).toStdString () << " is not in flash" << std::endl;
+			delete sim;
+			return 2;
+		}
+	}
+	if ((exitPort >= 0) && !sim->setWatchpoint (exitPort, 1, AVRSimulator::WATCH_WRITE, true)) {
+		std::cerr << "simulate: exit port 0x" << QString::number (exitPort, 16).toStdString () << " is not in the data space" << std::endl;
+		delete sim;
+		return 2;
+	}
+
+	reason = sim->run (cycles);
+	if (reason == AVRSimulator::STOP_WATCHPOINT) {
+		exitValue = sim->dataAt (exitPort);
+	}
+
+	top["device"] = sim->device ().name;
+	top["stop"] = (reason == AVRSimulator::STOP_WATCHPOINT) ? QString ("exit port") : AVRSimulator::stopReasonName (reason);
+	if (exitValue >= 0) {
+		top["exit"] = exitValue;
+	}
+	top["cycles"] = (double)sim->cycles ();
+	top["instructions"] = (double)sim->instructions ();
+	top["pc"] = (int)sim->pc () * 2;
+	top["sp"] = sim->sp ();
+	top["sreg"] = sim->sreg ();
+	for (int r=0; r<32; r++) {
+		regs.append (sim->reg (r));
+	}
+	top["registers"] = regs;
+	top["serial"] = QString::fromLatin1 (sim->takeSerialOutput ());
+	for (int i=0; i<dumpFirst.count (); i++) {
+		QJsonObject d;
+		QByteArray bytes;
+
+		for (quint32 a=dumpFirst.at (i); (a <= dumpLast.at (i)) && (a < (quint32)sim->dataSize ()); a++) {
+			bytes.append ((char)sim->dataAt (a));
+		}
+		d["address"] = (double)dumpFirst.at (i);
+		d["bytes"] = QString::fromLatin1 (bytes.toHex ());
+		dumps.append (d);
+	}
+	if (!dumps.isEmpty ()) {
+		top["memory"] = dumps;
+	}
+	std::cout << QJsonDocument (top).toJson ().constData ();
+	delete sim;
+
+	if (exitPort >= 0) {
+		return (exitValue == 0) ? 0 : 1;
+	}
+	return (reason == AVRSimulator::STOP_INVALID) ? 1 : 0;
+}
+/*}}}*/
 /*{{{  int main (int argc, char *argv[])*/
 /*
  *	start here!
@@ -33,6 +427,26 @@ int main (int argc, char *argv[])
 	int currentExitCode = 0;
 	Q_INIT_RESOURCE(application);
 
+	for (int i=1; i<argc; i++) {
+		if (!strcmp (argv[i], "--batch")) {
+			return batchMain (argc, argv);
+		}
+		if (!strcmp (argv[i], "--trace-dump")) {
+			return traceDumpMain (argc, argv);
+		}
+		if (!strcmp (argv[i], "--gdb-server")) {
+			return gdbServerMain (argc, argv);
+		}
+		if (!strcmp (argv[i], "--simulate")) {
+			return simulateMain (argc, argv);
+		}
+		if (!strcmp (argv[i], "--sim-benchmark")) {
+			/* avr-asm-ide --sim-benchmark [MS]: simulator throughput */
+			std::cout << AVRSimulator::benchmark ((i + 1 < argc) ? atoi (argv[i + 1]) : 3000).toStdString () << std::endl;
+			return 0;
+		}
+	}
+
 	while (true) {
 		QApplication *app = new QApplication (argc, argv);
 		MainWindow *mainWin = new MainWindow ();
@@ -52,12 +52,18 @@
 #include <QCloseEvent>
 #include <QDate>
 #include <QDebug>
+#include <QColor>
+#include <QDialog>
+#include <QDialogButtonBox>
 #include <QDir>
+#include <QDockWidget>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileDialog>
+#include <QFormLayout>
 #include <QGridLayout>
 #include <QIcon>
+#include <QInputDialog>
 #include <QIODevice>
 #include <QLabel>
 #include <QMenu>
@@ -69,10 +75,13 @@
 #include <QProgressBar>
 #include <QProcess>
 #include <QPushButton>
+#include <QScrollBar>
 #include <QSet>
 #include <QSettings>
 #include <QSignalMapper>
 #include <QSize>
+#include <QSpinBox>
+#include <QSplitter>
 #include <QStatusBar>
 #include <QTextCharFormat>
 #include <QTextStream>
@@ -84,6 +93,32 @@
 #include "mainwindow.h"
 #include "parameters.h"
 #include "avrasmlexer.h"
+#include "avrdevice.h"
+#include "avrdecoder.h"
+#include "avrasmprogram.h"
+#include "avrbackgroundanalysis.h"
+#include "avrbatchbuild.h"
+#include "avrcyclemargin.h"
+#include "avrpeephole.h"
+#include "avrpeepholedialog.h"
+#include "avrdelaydialog.h"
+#include "avrliveness.h"
+#include "avrinstructionmix.h"
+#include "avrasmflow.h"
+#include "avrsimulatorpanel.h"
+#include "avrgdbserver.h"
+#include "avrserialterminal.h"
+#include "avrhotspotpanel.h"
+#include "avrprofiler.h"
+
+/* editor marker for failed cycle assertions (shown in margin 4) */
+#define ASSERTION_MARKER 1
+/* editor indicator greying out unreachable code */
+#define UNREACHABLE_INDICATOR 8
+/* editor markers for the profile heat map (shown in margin 0), coolest first */
+#define HEAT_MARKER_FIRST 2
+#define HEAT_LEVELS 6
+#define HEAT_MASK (((1 << HEAT_LEVELS) - 1) << HEAT_MARKER_FIRST)
 
 
 MainWindow *globMainWindow = 0;
@@ -101,6 +136,9 @@ MainWindow::MainWindow ()
 	QString lfname = "";
 
 	_isFillingLog = false;
+	_batchBuild = 0;
+	_gdbServer = 0;
+	_buildOk = false;
 	this->setWindowIcon (icon);
 	createOptionDialog ();
 	readSettings ();
@@ -116,6 +154,12 @@ MainWindow::MainWindow ()
 	setCurrentFile ("");
 	createProcesses ();
 
+	_analysis = new AVRBackgroundAnalysis (this);
+	connect (_analysis, SIGNAL (analysed ()), this, SLOT (analysisFinished ()));
+	_analysisTimer.setSingleShot (true);
+	_analysisTimer.setInterval (750);
+	connect (&_analysisTimer, SIGNAL (timeout ()), this, SLOT (requestAnalysis ()));
+
 	args = qApp->arguments ();
 	for (i=1; i<args.count(); i++) {
 		QString str = args.at (i);
@@ -170,10 +214,23 @@ void MainWindow::initTextEdit (void)
 
 	_console->setPalette (p);
 
+	_listing = new QPlainTextEdit ();
+	_listing->setReadOnly (true);
+	_listing->setLineWrapMode (QPlainTextEdit::NoWrap);
+	_listing->setFont (newFont);
+	_listing->setPlaceholderText (tr ("Build to see the disassembled flash image."));
+
 	setCentralWidget (new QWidget);
 	_textEdit = new QsciScintilla;
 	_textEdit->setEolMode (QsciScintilla::EolUnix);
-	layout->addWidget (_textEdit, 3);
+
+	QSplitter *splitter = new QSplitter (Qt::Horizontal);
+
+	splitter->addWidget (_textEdit);
+	splitter->addWidget (_listing);
+	splitter->setStretchFactor (0, 3);
+	splitter->setStretchFactor (1, 2);
+	layout->addWidget (splitter, 3);
 	layout->addWidget (_console, 1);
 
 	centralWidget ()->setLayout (layout);
@@ -188,7 +245,56 @@ void MainWindow::initTextEdit (void)
 	_textEdit->setLexer (_lexer);
 	_textEdit->setMarginLineNumbers (1, true);
 	_textEdit->setMarginWidth (1, "-----");
-
+	_cycleMargin = new AVRCycleMargin (_textEdit, 2);
+	_textEdit->setMarginType (4, QsciScintilla::SymbolMargin);
+	_textEdit->setMarginWidth (4, 12);
+	_textEdit->setMarginMarkerMask (4, 1 << ASSERTION_MARKER);
+	_textEdit->setMarginType (0, QsciScintilla::SymbolMargin);
+	_textEdit->setMarginWidth (0, 0);
+	_textEdit->setMarginMarkerMask (0, HEAT_MASK);
+	_textEdit->setMarginMarkerMask (1, _textEdit->marginMarkerMask (1) & ~HEAT_MASK);
+	{
+		static const char *heatColours[HEAT_LEVELS] = {"#fff3b0", "#ffd966", "#ffb347", "#ff8c42", "#f25c3b", "#c81d25"};
+
+		for (int i=0; i<HEAT_LEVELS; i++) {
+			_textEdit->markerDefine (QsciScintilla::FullRectangle, HEAT_MARKER_FIRST + i);
+			_textEdit->setMarkerBackgroundColor (QColor (heatColours[i]), HEAT_MARKER_FIRST + i);
+		}
+	}
+	_textEdit->markerDefine (QsciScintilla::Circle, ASSERTION_MARKER);
+	_textEdit->setMarkerBackgroundColor (QColor (Qt::red), ASSERTION_MARKER);
+	_textEdit->setMarkerForegroundColor (QColor (Qt::darkRed), ASSERTION_MARKER);
+	_textEdit->indicatorDefine (QsciScintilla::TextColorIndicator, UNREACHABLE_INDICATOR);
+	_textEdit->setIndicatorForegroundColor (QColor (Qt::gray), UNREACHABLE_INDICATOR);
+
+	_simulator = new AVRSimulatorPanel ();
+	_simulatorDock = new QDockWidget (tr ("Simulator"), this);
+	_simulatorDock->setObjectName ("simulatorDock");
+	_simulatorDock->setWidget (_simulator);
+	addDockWidget (Qt::RightDockWidgetArea, _simulatorDock);
+	_simulatorDock->hide ();
+	connect (_simulator, SIGNAL (stopped (QString)), this, SLOT (simulatorStopped (QString)));
+	connect (_simulator, SIGNAL (halted ()), this, SLOT (updateProfile ()));
+
+	_hotSpots = new AVRHotSpotPanel ();
+	_hotSpotDock = new QDockWidget (tr ("Hot spots"), this);
+	_hotSpotDock->setObjectName ("hotSpotDock");
+	_hotSpotDock->setWidget (_hotSpots);
+	addDockWidget (Qt::BottomDockWidgetArea, _hotSpotDock);
+	_hotSpotDock->hide ();
+	connect (_hotSpots, SIGNAL (lineActivated (int)), this, SLOT (showLine (int)));
+
+	_terminal = new AVRSerialTerminal ();
+	_terminalDock = new QDockWidget (tr ("Serial terminal"), this);
+	_terminalDock->setObjectName ("terminalDock");
+	_terminalDock->setWidget (_terminal);
+	addDockWidget (Qt::BottomDockWidgetArea, _terminalDock);
+	_terminalDock->hide ();
+	connect (_simulator, SIGNAL (serialOutput (QByteArray)), _terminal, SLOT (received (QByteArray)));
+	connect (_terminal, SIGNAL (send (QByteArray)), _simulator, SLOT (serialInput (QByteArray)));
+	connect (_terminal, SIGNAL (message (QString)), this, SLOT (simulatorMessage (QString)));
+	/* firmware waiting on input sleeps rather than spins, while there is somewhere to type it */
+	connect (_terminalDock->toggleViewAction (), SIGNAL (toggled (bool)), _simulator, SLOT (setSerialWait (bool)));
 }
 
 /*}}}*/
@@ -265,6 +371,7 @@ bool MainWindow::build (void)
 
 	QStringList *parameters = _params->arduinoConfig()->noccProcessedParams (_curFile);
 
+	_buildOk = false;
 	if (saveBuild ()) {
 		statusBar ()->showMessage (tr ("Building..."));
 
@@ -299,14 +406,37 @@ bool MainWindow::build (void)
 /*}}}*/
 /*{{{  void MainWindow::buildFinished (int exitCode)*/
 /*
- *	called when the build (compile) is finished
+ *	called when the build (compile) is finished: the source is laid out once, for the listing
+ *	files and the memory usage checks.
  */
 void MainWindow::buildFinished (int exitCode)
 {
 	if (exitCode == 0) {
+		AVRASMProgram program;
+		QString err;
+		bool laidOut;
+
 		logInfo (_noccLog);
 		logInfo (_noccError);
-		logInfo ("Build complete with success !");
+		laidOut = program.load (_curFile, AVRASMProgram::includePaths (_params->arduinoConfig ()->noccParams ()), &err);
+		if (!laidOut) {
+			logWarning (err);
+		}
+		if (!loadBuildImages ()) {
+			logError ("Build output could not be read.");
+			statusBar ()->showMessage (tr ("Build output could not be read"));
+		} else {
+			if (laidOut) {
+				writeListingFiles (program);
+			}
+			if (!laidOut || checkMemoryUsage (program)) {
+				logInfo ("Build complete with success !");
+				_buildOk = true;
+			} else {
+				logError ("Build failed: over memory budget.");
+				statusBar ()->showMessage (tr ("Build over memory budget"));
+			}
+		}
 	} else {
 		logInfo (_noccLog);
 		logError (_noccError);
@@ -318,6 +448,711 @@ void MainWindow::buildFinished (int exitCode)
 }
 /*}}}*/
 
+/*{{{  void MainWindow::batchBuild (void)*/
+/*
+ *	asks for a set of files and builds them all (for the configured target) in the background.
+ */
+void MainWindow::batchBuild (void)
+{
+	QStringList files;
+
+	if (_batchBuild) {
+		statusBar ()->showMessage (tr ("A batch build is already running"), 2000);
+		return;
+	}
+	files = QFileDialog::getOpenFileNames (this, tr ("Batch build"), QString (), tr ("Assembler files (*.asm);;All files (*)"));
+	if (files.isEmpty ()) {
+		return;
+	}
+
+	_batchBuild = new AVRBatchBuild (this);
+	_batchBuild->setNocc (_params->arduinoConfig ()->noccPath (), _params->arduinoConfig ()->noccSpecsPath (),
+			_params->arduinoConfig ()->noccParams ());
+	for (const QString &file : files) {
+		_batchBuild->addFile (file, QStringList () << _params->arduinoConfig ()->targetDevice ());
+	}
+	connect (_batchBuild, SIGNAL (jobFinished (QString, QString, bool)), this, SLOT (batchJobFinished (QString, QString, bool)));
+	connect (_batchBuild, SIGNAL (finished ()), this, SLOT (batchBuildFinished ()));
+	_batchDone = 0;
+	_batchTotal = files.count ();
+	statusBar ()->showMessage (tr ("Batch build: %1 file(s)...").arg (_batchTotal));
+	_batchBuild->start ();
+}
+/*}}}*/
+/*{{{  void MainWindow::batchJobFinished (QString file, QString device, bool ok)*/
+/*
+ *	called (from the batch thread, queued) as each file in a batch build finishes.
+ */
+void MainWindow::batchJobFinished (QString file, QString device, bool ok)
+{
+	_batchDone++;
+	statusBar ()->showMessage (tr ("Batch build: %1 of %2 done").arg (_batchDone).arg (_batchTotal));
+	if (!ok) {
+		logWarning (QString ("batch: %1 (%2) failed").arg (strippedName (file)).arg (device));
+	}
+}
+/*}}}*/
+/*{{{  void MainWindow::batchBuildFinished (void)*/
+/*
+ *	called when a batch build is complete: puts the report in the console.
+ */
+void MainWindow::batchBuildFinished (void)
+{
+	QString report = _batchBuild->report ();
+
+	if (_batchBuild->failures ()) {
+		logError (report);
+	} else {
+		logInfo (report);
+	}
+	statusBar ()->showMessage (tr ("Batch build complete"), 2000);
+	_batchBuild->deleteLater ();
+	_batchBuild = 0;
+}
+/*}}}*/
+/*{{{  void MainWindow::setIsrBudget (void)*/
+/*
+ *	asks for the interrupt handler cycle budget, then re-checks the current file against it.
+ */
+void MainWindow::setIsrBudget (void)
+{
+	QSettings settings ("unikent", "avr-asm-ide");
+	bool ok;
+	int budget = QInputDialog::getInt (this, tr ("Interrupt cycle budget"), tr ("Worst-case cycles per interrupt handler:"),
+			settings.value ("isrBudget", 200).toInt (), 1, 1000000, 10, &ok);
+
+	if (!ok) {
+		return;
+	}
+	settings.setValue ("isrBudget", budget);
+	requestAnalysis ();
+}
+/*}}}*/
+/*{{{  void MainWindow::setMemoryBudgets (void)*/
+/*
+ *	asks for the flash, SRAM and EEPROM budgets (percentages of the device's sizes).
+ */
+void MainWindow::setMemoryBudgets (void)
+{
+	static const char *keys[3] = {"flashBudget", "sramBudget", "eepromBudget"};
+	QSettings settings ("unikent", "avr-asm-ide");
+	QDialog dialog (this);
+	QFormLayout *form = new QFormLayout (&dialog);
+	QDialogButtonBox *buttons = new QDialogButtonBox (QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+	QSpinBox *spins[3];
+
+	dialog.setWindowTitle (tr ("Memory budgets"));
+	for (int i=0; i<3; i++) {
+		spins[i] = new QSpinBox ();
+		spins[i]->setRange (1, 100);
+		spins[i]->setSuffix ("%");
+		spins[i]->setValue (settings.value (keys[i], 100).toInt ());
+	}
+	form->addRow (tr ("Flash:"), spins[0]);
+	form->addRow (tr ("SRAM:"), spins[1]);
+	form->addRow (tr ("EEPROM:"), spins[2]);
+	form->addRow (buttons);
+	connect (buttons, SIGNAL (accepted ()), &dialog, SLOT (accept ()));
+	connect (buttons, SIGNAL (rejected ()), &dialog, SLOT (reject ()));
+
+	if (dialog.exec () != QDialog::Accepted) {
+		return;
+	}
+	for (int i=0; i<3; i++) {
+		settings.setValue (keys[i], spins[i]->value ());
+	}
+}
+/*}}}*/
+/*{{{  void MainWindow::peepholeAdvisor (void)*/
+/*
+ *	looks for peephole improvements in the editor's text and offers them.
+ */
+void MainWindow::peepholeAdvisor (void)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+	AVRASMProgram program;
+
+	program.parse (_textEdit->text (), _curFile.isEmpty () ? QString ("untitled.asm") : _curFile,
+			AVRASMProgram::includePaths (_params->arduinoConfig ()->noccParams ()));
+
+	qint32 vectorBytes = 0;
+
+	/* an unknown device could have the largest of the vector tables */
+	for (const AVRDeviceInfo &d : AVRDevices) {
+		if (!dev || (&d == dev)) {
+			vectorBytes = qMax (vectorBytes, (qint32)(d.vectorCount * d.vectorSize * 2));
+		}
+	}
+
+	AVRPeephole peephole (program, dev && (dev->flashSize > 131072), dev && dev->hasMovw, vectorBytes);
+
+	if (peephole.suggestions ().isEmpty ()) {
+		statusBar ()->showMessage (tr ("No peephole suggestions"), 2000);
+		return;
+	}
+
+	AVRPeepholeDialog dialog (_textEdit, peephole.suggestions (), this);
+
+	dialog.exec ();
+	if (dialog.applied ()) {
+		statusBar ()->showMessage (tr ("Applied %1 peephole suggestion(s)").arg (dialog.applied ()), 2000);
+	}
+}
+/*}}}*/
+/*{{{  void MainWindow::insertDelay (void)*/
+/*
+ *	generates a cycle-exact delay loop and inserts it above the cursor's line.
+ */
+void MainWindow::insertDelay (void)
+{
+	AVRASMProgram program;
+	QString label;
+	int line, index;
+
+	program.parse (_textEdit->text (), _curFile.isEmpty () ? QString ("untitled.asm") : _curFile,
+			AVRASMProgram::includePaths (_params->arduinoConfig ()->noccParams ()));
+	for (int i=1; label.isEmpty (); i++) {
+		if (!program.symbols ().contains (QString ("delay%1").arg (i))) {
+			label = QString ("delay%1").arg (i);
+		}
+	}
+
+	AVRDelayDialog dialog (label, this);
+
+	if (dialog.exec () != QDialog::Accepted) {
+		return;
+	}
+	_textEdit->getCursorPosition (&line, &index);
+	_textEdit->beginUndoAction ();
+	_textEdit->insertAt (dialog.code ().join ("\n") + "\n", line, 0);
+	_textEdit->endUndoAction ();
+	statusBar ()->showMessage (tr ("Inserted delay loop"), 2000);
+}
+/*}}}*/
+/*{{{  void MainWindow::instructionStatistics (void)*/
+/*
+ *	logs the instruction mix of the editor's text, then offers to export it (CSV or JSON).
+ */
+void MainWindow::instructionStatistics (void)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+	AVRASMProgram program;
+	QString fileName, err;
+
+	program.parse (_textEdit->text (), _curFile.isEmpty () ? QString ("untitled.asm") : _curFile,
+			AVRASMProgram::includePaths (_params->arduinoConfig ()->noccParams ()));
+
+	AVRASMFlow flow (program, dev && (dev->flashSize > 131072));
+	AVRInstructionMix mix (flow, dev);
+
+	logInfo (mix.report (10).trimmed ());
+	fileName = QFileDialog::getSaveFileName (this, tr ("Export instruction statistics"),
+			_curFile.isEmpty () ? QString ("untitled.mix.csv") : outputFileName (".mix.csv"), tr ("CSV (*.csv);;JSON (*.json)"));
+	if (fileName.isEmpty ()) {
+		return;
+	}
+	if (!mix.saveReport (fileName, &err)) {
+		logError (err);
+		return;
+	}
+	statusBar ()->showMessage (tr ("Instruction statistics saved to %1").arg (strippedName (fileName)), 2000);
+}
+/*}}}*/
+/*{{{  void MainWindow::simulate (void)*/
+/*
+ *	loads the last build's flash and EEPROM images (from the build output if not already read)
+ *	into the simulator for the target device (an ATmega328P if that is not known), and shows it.
+ */
+void MainWindow::simulate (void)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+
+	if (!dev) {
+		dev = findAVRDevice ("ATMEGA328P");
+	}
+	if (_flashImage.isEmpty () && !_curFile.isEmpty () && QFileInfo (outputFileName (".flash.hex")).exists ()) {
+		loadBuildImages ();
+	}
+	if (!_simulator->load (*dev, _flashImage, _eepromImage)) {
+		logWarning (QString ("nothing to simulate: build first"));
+		return;
+	}
+	setProfiling (_profileAct->isChecked ());
+	if (_traceAct->isChecked ()) {
+		setTracing (true);
+	}
+	_simulatorDock->show ();
+	_simulatorDock->raise ();
+	statusBar ()->showMessage (tr ("Simulating %1").arg (dev->name), 2000);
+}
+/*}}}*/
+/*{{{  void MainWindow::simulatorStopped (QString msg)*/
+/*
+ *	called when the simulator stops by itself (break, sleep, invalid instruction).
+ */
+void MainWindow::simulatorStopped (QString msg)
+{
+	logInfo (msg);
+}
+/*}}}*/
+/*{{{  void MainWindow::setProfiling (bool enabled)*/
+/*
+ *	turns simulator profiling on or off, with the heat-map margin and hot-spots table.
+ */
+void MainWindow::setProfiling (bool enabled)
+{
+	_simulator->setProfiling (enabled);
+	_hotSpotDock->setVisible (enabled);
+	updateProfile ();
+}
+/*}}}*/
+/*{{{  void MainWindow::setTracing (bool enabled)*/
+/*
+ *	starts or stops recording an execution trace of the simulator, next to the build outputs (the
+ *	last "simTraceMB" megabytes of it are kept).
+ */
+void MainWindow::setTracing (bool enabled)
+{
+	QString file;
+
+	if (enabled) {
+		file = _curFile.isEmpty () ? QDir::temp ().filePath ("untitled.trace") : outputFileName (".trace");
+		statusBar ()->showMessage (tr ("Tracing to %1").arg (file), 2000);
+	}
+	_simulator->setTrace (file, QSettings ("unikent", "avr-asm-ide").value ("simTraceMB", 256).toInt ());
+}
+/*}}}*/
+/*{{{  void MainWindow::setGdbServer (bool enabled)*/
+/*
+ *	starts or stops serving the last build to avr-gdb, on localhost port "simGdbPort" (1234 by
+ *	default).  The server has a simulator of its own, apart from the one in the simulator pane.
+ */
+void MainWindow::setGdbServer (bool enabled)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+	AVRSimulator *sim;
+	QString err;
+
+	delete _gdbServer;
+	_gdbServer = 0;
+	if (!enabled) {
+		return;
+	}
+	if (!dev) {
+		dev = findAVRDevice ("ATMEGA328P");
+	}
+	if (_flashImage.isEmpty () && !_curFile.isEmpty () && QFileInfo (outputFileName (".flash.hex")).exists ()) {
+		loadBuildImages ();
+	}
+	if (_flashImage.isEmpty ()) {
+		logWarning (QString ("nothing to debug: build first"));
+		_gdbAct->setChecked (false);
+		return;
+	}
+	sim = new AVRSimulator (*dev);
+	sim->loadFlash (_flashImage);
+	sim->loadEeprom (_eepromImage);
+	_gdbServer = new AVRGdbServer (sim, this);
+	connect (_gdbServer, SIGNAL (message (QString)), this, SLOT (simulatorMessage (QString)));
+	if (!_gdbServer->listen (QSettings ("unikent", "avr-asm-ide").value ("simGdbPort", 1234).toInt (), &err)) {
+		logError (err);
+		delete _gdbServer;
+		_gdbServer = 0;
+		_gdbAct->setChecked (false);
+		return;
+	}
+	logInfo (QString ("GDB server for %1 on localhost:%2").arg (dev->name).arg (_gdbServer->port ()));
+}
+/*}}}*/
+/*{{{  void MainWindow::simulatorMessage (QString msg)*/
+/*
+ *	called when gdb attaches or detaches, or the GDB server or serial terminal has something to report.
+ */
+void MainWindow::simulatorMessage (QString msg)
+{
+	logInfo (msg);
+}
+/*}}}*/
+/*{{{  void MainWindow::updateProfile (void)*/
+/*
+ *	redraws the heat map and hot-spots table from the simulator's profile (called whenever the
+ *	simulator halts, when its last snapshot carries the profile).  Counts are mapped to lines
+ *	through the listing index, so need a build of the current text.
+ */
+void MainWindow::updateProfile (void)
+{
+	const AVRSimulatorThread::Snapshot *snap = _simulator->snapshot ();
+
+	for (int i=0; i<HEAT_LEVELS; i++) {
+		_textEdit->markerDeleteAll (HEAT_MARKER_FIRST + i);
+	}
+	if (!snap || !snap->profiling || !_profileAct->isChecked ()) {
+		_textEdit->setMarginWidth (0, 0);
+		_hotSpots->clear ();
+		return;
+	}
+
+	AVRProfiler profile (snap->profile, _listingIndex);
+
+	_textEdit->setMarginWidth (0, 8);
+	for (const AVRProfiler::Line &l : profile.lines ()) {
+		int level = profile.heat (l.cycles, HEAT_LEVELS);
+
+		if ((l.line >= 0) && level) {
+			_textEdit->markerAdd (l.line, HEAT_MARKER_FIRST + level - 1);
+		}
+	}
+	_hotSpots->setProfile (profile, _textEdit->text ().split ('\n'));
+}
+/*}}}*/
+/*{{{  void MainWindow::showLine (int line)*/
+/*
+ *	moves the editor to a (0-based) line.
+ */
+void MainWindow::showLine (int line)
+{
+	_textEdit->setCursorPosition (line, 0);
+	_textEdit->ensureLineVisible (line);
+	_textEdit->setFocus ();
+}
+/*}}}*/
+/*{{{  void MainWindow::requestAnalysis (void)*/
+/*
+ *	starts the background analysis of the current file (as it is in the editor), and tells the
+ *	lexer where the file's includes are for its constant tool-tips.
+ */
+void MainWindow::requestAnalysis (void)
+{
+	QStringList includePaths = AVRASMProgram::includePaths (_params->arduinoConfig ()->noccParams ());
+
+	if (_curFile.isEmpty ()) {
+		return;
+	}
+	_lexer->setSourceFile (_curFile, includePaths);
+	_analysis->request (_textEdit->text (), _curFile, includePaths,
+			_params->arduinoConfig ()->targetDevice (),
+			QSettings ("unikent", "avr-asm-ide").value ("isrBudget", 200).toInt ());
+}
+/*}}}*/
+/*{{{  void MainWindow::analysisFinished (void)*/
+/*
+ *	called (queued, from the analysis thread) with new results: reports interrupt handlers that
+ *	are unbounded or over budget, a stack that may not fit, failed cycle assertions (which are
+ *	also marked in the editor), and unreachable code (greyed out) and unused data, and passes
+ *	the free registers to the editor's tool-tips.  As this runs after every pause in editing,
+ *	messages are only logged when they differ from last time.
+ */
+void MainWindow::analysisFinished (void)
+{
+	AVRBackgroundAnalysis::Result r = _analysis->result ();
+	QStringList warnings, errors;
+	QString worst;
+	qint64 worstCycles = -1;
+	int over = 0;
+	int failed = 0;
+
+	if (r.fileName != _curFile) {
+		return;
+	}
+	/*{{{  cycle assertions*/
+	_textEdit->markerDeleteAll (ASSERTION_MARKER);
+	for (const AVRCycleAssertions::Assertion &a : r.assertions) {
+		if (a.ok) {
+			continue;
+		}
+		errors << QString ("%1: cycle assertion failed: %2").arg (AVRBackgroundAnalysis::location (*r.program, a.problemIndex)).arg (a.problem);
+		for (int idx : {a.index, a.problemIndex}) {
+			const AVRASMProgram::Line &l = r.program->lines ().at (idx);
+
+			if (l.file == 0) {
+				_textEdit->markerAdd (l.line, ASSERTION_MARKER);
+			}
+		}
+		failed++;
+	}
+	/*}}}*/
+	/*{{{  free registers, for the editor's tool-tips*/
+	if (r.program) {
+		const QVector<AVRASMProgram::Line> &lines = r.program->lines ();
+		QHash<int, quint32> liveByLine;
+		quint32 live = 0;
+		bool known = false;
+
+		/* on a label, comment or directive line, the next instruction's */
+		for (int idx = lines.count () - 1; idx >= 0; idx--) {
+			const AVRASMProgram::Line &l = lines.at (idx);
+
+			if (r.liveIn.contains (idx)) {
+				live = r.liveIn.value (idx);
+				known = true;
+			} else if ((l.kind != AVRASMProgram::BLANK) && (l.kind != AVRASMProgram::DIRECTIVE)) {
+				known = false;
+			}
+			if (known && (l.file == 0)) {
+				liveByLine.insert (l.line, live);
+			}
+		}
+		_lexer->setLiveRegisters (liveByLine);
+	}
+	/*}}}*/
+	/*{{{  unreachable code (greyed out) and unused tables*/
+	int deadBytes = 0;
+
+	_textEdit->clearIndicatorRange (0, 0, _textEdit->lines (), 0, UNREACHABLE_INDICATOR);
+	for (const AVRReachability::Block &b : r.unreachable) {
+		const AVRASMProgram::Line &first = r.program->lines ().at (b.firstIndex);
+		const AVRASMProgram::Line &last = r.program->lines ().at (b.lastIndex);
+
+		warnings << QString ("%1: unreachable code%2 (%3 bytes)").arg (AVRBackgroundAnalysis::location (*r.program, b.firstIndex))
+				.arg (b.label.isEmpty () ? QString ("") : QString (" at %1").arg (b.label)).arg (b.bytes);
+		if ((first.file == 0) && (last.file == 0) && (first.line <= last.line)) {
+			_textEdit->fillIndicatorRange (first.line, 0, last.line, _textEdit->lineLength (last.line), UNREACHABLE_INDICATOR);
+		}
+		deadBytes += b.bytes;
+	}
+	for (const AVRReachability::Table &t : r.unusedTables) {
+		warnings << QString ("%1: %2 is never used (%3 bytes of %4)").arg (AVRBackgroundAnalysis::location (*r.program, t.index))
+				.arg (t.name).arg (t.bytes).arg (AVRASMProgram::sectionName (t.section));
+		deadBytes += (t.section == AVRASMProgram::TEXT) ? t.bytes : 0;
+	}
+	for (const AVRReachability::Note &n : r.reachabilityNotes) {
+		warnings << QString ("%1: %2").arg (AVRBackgroundAnalysis::location (*r.program, n.index)).arg (n.text);
+	}
+	if (deadBytes > 0) {
+		warnings << QString ("%1: %2 bytes of flash could be reclaimed").arg (strippedName (r.fileName)).arg (deadBytes);
+	}
+	/*}}}*/
+	for (const AVRISRAnalysis::Handler &h : r.handlers) {
+		if (!h.bounded) {
+			warnings << QString ("%1: %2 handler has no worst case: %3").arg (AVRBackgroundAnalysis::location (*r.program, h.problemIndex))
+					.arg (h.name).arg (h.problem);
+			over++;
+			continue;
+		}
+		if (h.cycles > r.isrBudget) {
+			warnings << QString ("%1: %2 handler takes up to %3 cycles (budget %4)%5").arg (AVRBackgroundAnalysis::location (*r.program, h.entryIndex))
+					.arg (h.name).arg (h.cycles).arg (r.isrBudget)
+					.arg ((h.latency < 0) ? QString ("") : QString (", may wait %1 cycles to start").arg (h.latency));
+			over++;
+		}
+		if (h.cycles > worstCycles) {
+			worstCycles = h.cycles;
+			worst = h.name;
+		}
+	}
+	/*{{{  stack depth*/
+	const AVRStackAnalysis::Summary &st = r.stack;
+
+	if (r.deviceKnown && !st.bounded) {
+		warnings << QString ("%1: worst-case stack depth unknown: %2").arg (AVRBackgroundAnalysis::location (*r.program, st.problemIndex))
+				.arg (st.problem);
+	} else if (r.deviceKnown && (st.depth > st.available)) {
+		errors << QString ("%1: stack may reach %2 bytes (%3 main + %4 interrupts), only %5 bytes of SRAM free after .data")
+				.arg (strippedName (r.fileName)).arg (st.depth).arg (st.mainDepth).arg (st.interruptDepth).arg (st.available);
+	}
+	/*}}}*/
+
+	if ((warnings + errors) != _analysisReport) {
+		for (const QString &w : warnings) {
+			logWarning (w);
+		}
+		for (const QString &e : errors) {
+			logError (e);
+		}
+		_analysisReport = warnings + errors;
+	}
+
+	if (!r.deviceKnown) {
+		statusBar ()->showMessage (tr ("%1 cycle assertion(s), %2 failed (%3 ms)").arg (r.assertions.count ()).arg (failed).arg (r.msecs), 5000);
+		return;
+	}
+	statusBar ()->showMessage (tr ("%1 interrupt handler(s), %2 over budget%3; stack %4 of %5 bytes; %6 of %7 cycle assertion(s) failed (%8 ms)")
+			.arg (r.handlers.count ()).arg (over)
+			.arg (worst.isEmpty () ? QString ("") : tr (", longest %1 at %2 cycles").arg (worst).arg (worstCycles))
+			.arg (st.bounded ? QString::number (st.depth) : QString ("?")).arg (st.available)
+			.arg (failed).arg (r.assertions.count ()).arg (r.msecs), 5000);
+}
+/*}}}*/
+/*{{{  QString MainWindow::outputFileName (const QString &suffix)*/
+/*
+ *	returns the (relative) name of a build output for the current file, e.g. ".flash.hex".
+ */
+QString MainWindow::outputFileName (const QString &suffix)
+{
+	QDir dir;
+	QString name = dir.relativeFilePath (_curFile);
+
+	name.replace (QString (".asm"), suffix);
+	return name;
+}
+/*}}}*/
+/*{{{  void MainWindow::loadBuildImages (void)*/
+/*
+ *	reads the flash and EEPROM images produced by a build, reporting their size and how many
+ *	pages changed since the previous build.  If they cannot be read, the previous build's images
+ *	are dropped rather than left to stand in for this one.
+ *	returns true on success, false otherwise.
+ */
+bool MainWindow::loadBuildImages (void)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+	AVRHexImage flash, eeprom;
+	QString err;
+	int changed;
+
+	if (!dev) {
+		logWarning (QString ("unknown target device \"%1\", not reading build output").arg (_params->arduinoConfig ()->targetDevice ()));
+		return false;
+	}
+
+	flash.reset (dev->flashSize, dev->flashPageSize);
+	if (!flash.load (outputFileName (".flash.hex"), &err)) {
+		logWarning (err);
+		_flashImage.reset (dev->flashSize, dev->flashPageSize);
+		_eepromImage.reset (dev->eepromSize, dev->eepromPageSize);
+		return false;
+	}
+	changed = _flashImage.isEmpty () ? -1 : flash.diff (_flashImage);
+	logInfo (QString ("flash: %1 of %2 bytes in %3 page(s)%4").arg (flash.extent ()).arg (dev->flashSize).arg (flash.usedPages ())
+			.arg ((changed < 0) ? QString ("") : QString (", %1 page(s) changed since last build").arg (changed)));
+	_flashImage = flash;
+
+	eeprom.reset (dev->eepromSize, dev->eepromPageSize);
+	if (QFileInfo (outputFileName (".eeprom.hex")).exists ()) {
+		if (!eeprom.load (outputFileName (".eeprom.hex"), &err)) {
+			logWarning (err);
+		} else if (!eeprom.isEmpty ()) {
+			logInfo (QString ("eeprom: %1 of %2 bytes").arg (eeprom.extent ()).arg (dev->eepromSize));
+		}
+	}
+	_eepromImage = eeprom;
+
+	updateListing ();
+	return true;
+}
+/*}}}*/
+/*{{{  bool MainWindow::checkMemoryUsage (const AVRASMProgram &program)*/
+/*
+ *	reports what the last build (laid out in 'program') uses of each memory (and the biggest
+ *	consumers), updates the gauges, and checks the configured budgets.
+ *	returns true if within budget (or the usage cannot be worked out), false otherwise.
+ */
+bool MainWindow::checkMemoryUsage (const AVRASMProgram &program)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+	QSettings settings ("unikent", "avr-asm-ide");
+	QStringList problems;
+
+	if (!dev) {
+		return true;
+	}
+
+	AVRMemoryUsage usage (program, *dev, &_flashImage, &_eepromImage);
+
+	usage.setBudget (AVRASMProgram::TEXT, settings.value ("flashBudget", 100).toInt ());
+	usage.setBudget (AVRASMProgram::DATA, settings.value ("sramBudget", 100).toInt ());
+	usage.setBudget (AVRASMProgram::EEPROM, settings.value ("eepromBudget", 100).toInt ());
+
+	logInfo (usage.report (5).trimmed ());
+	updateGauges (usage);
+	if (usage.overBudget (&problems)) {
+		for (const QString &p : problems) {
+			logError (p);
+		}
+		return false;
+	}
+	return true;
+}
+/*}}}*/
+/*{{{  void MainWindow::updateGauges (const AVRMemoryUsage &usage)*/
+/*
+ *	sets the status-bar gauges from a usage report (red where over budget).
+ */
+void MainWindow::updateGauges (const AVRMemoryUsage &usage)
+{
+	for (int i=0; i<3; i++) {
+		const AVRMemoryUsage::Region &r = usage.region ((AVRASMProgram::Section)i);
+
+		_gauges[i]->setValue (r.size ? qMin (100, (int)((100LL * r.used) / r.size)) : 0);
+		_gauges[i]->setToolTip (tr ("%1: %2 of %3 bytes used, %4 free (budget %5)").arg (r.name).arg (r.used).arg (r.size)
+				.arg (qMax (0, r.size - r.used)).arg (r.budget));
+		_gauges[i]->setStyleSheet ((r.used > r.budget) ? QString ("QProgressBar::chunk { background-color: #c03030; }") : QString ());
+	}
+}
+/*}}}*/
+/*{{{  void MainWindow::writeListingFiles (const AVRASMProgram &program)*/
+/*
+ *	generates the listing, symbol map and listing index for the last build (laid out in
+ *	'program'), then maps the index for the address margin.
+ */
+void MainWindow::writeListingFiles (const AVRASMProgram &program)
+{
+	QString err;
+
+	for (const QString &msg : program.errors ()) {
+		logWarning (msg);
+	}
+	_listingIndex.close ();
+	if (!AVRListing::write (program, _flashImage, outputFileName (""), &err)) {
+		logWarning (err);
+		return;
+	}
+	openListingIndex ();
+}
+/*}}}*/
+/*{{{  void MainWindow::openListingIndex (void)*/
+/*
+ *	maps the listing index for the current file, if there is one no older than the source.
+ */
+void MainWindow::openListingIndex (void)
+{
+	QFileInfo src (_curFile);
+	QFileInfo idx (outputFileName (".lstx"));
+
+	_listingIndex.close ();
+	if (!_curFile.isEmpty () && idx.exists () && (idx.lastModified () >= src.lastModified ())) {
+		_listingIndex.open (idx.filePath ());
+	}
+	updateAddressMargin ();
+}
+/*}}}*/
+/*{{{  void MainWindow::updateAddressMargin (void)*/
+/*
+ *	shows each line's address (from the mapped listing index) in the editor's cycle margin, which
+ *	is also told the target's program-counter width.
+ */
+void MainWindow::updateAddressMargin (void)
+{
+	const AVRDeviceInfo *dev = findAVRDevice (_params->arduinoConfig ()->targetDevice ());
+	int n = qMin (_listingIndex.lineCount (), _textEdit->lines ());
+	QVector<qint32> addresses;
+
+	_cycleMargin->setPC22 (dev && (dev->flashSize > 131072));
+	if (_listingIndex.isOpen ()) {
+		addresses.fill (-1, _textEdit->lines ());
+		for (int i=0; i<n; i++) {
+			addresses[i] = _listingIndex.line (i)->address;
+		}
+	}
+	_cycleMargin->setAddresses (addresses);
+}
+/*}}}*/
+/*{{{  void MainWindow::updateListing (void)*/
+/*
+ *	disassembles the current flash image into the listing pane.
+ */
+void MainWindow::updateListing (void)
+{
+	const AVRDecoder &decoder = AVRDecoder::instance ();
+	QVector<AVRDisassembledInstruction> insns;
+	int vpos = _listing->verticalScrollBar ()->value ();
+
+	decoder.disassemble (_flashImage, &insns);
+	_listing->setPlainText (decoder.listing (insns));
+	_listing->verticalScrollBar ()->setValue (vpos);
+}
+/*}}}*/
+
 /*{{{  bool MainWindow::sendToBoard (void)*/
 /*
  *	called to send the compiled program to the board (flash and EEPROM hex files).
@@ -330,16 +1165,8 @@ bool MainWindow::sendToBoard (void)
 		return false;
 	}
 
-	QDir *dir = new QDir ();
-	QString relativeCurfile = dir->relativeFilePath (_curFile);
-	QString binFile = relativeCurfile;
-
-	binFile.replace (QString (".asm"), QString (".flash.hex"));
-
-	QString eepromFile = relativeCurfile;
-
-	eepromFile.replace (QString (".asm"), QString (".eeprom.hex"));
-
+	QString binFile = outputFileName (".flash.hex");
+	QString eepromFile = outputFileName (".eeprom.hex");
 	QStringList *parameters = _params->arduinoConfig ()->avrdudeProcessedParams (binFile, eepromFile);
 
 	if (saveBuild ()) {
@@ -393,7 +1220,7 @@ void MainWindow::sendToBoardFinished (int exitCode, QProcess::ExitStatus exitSta
  */
 void MainWindow::buildAndRun (void)
 {
-	if (build ()) {
+	if (build () && _buildOk) {
 		sendToBoard ();
 	}
 }
@@ -447,6 +1274,7 @@ void MainWindow::newFile (void)
 	if (maybeSave ()) {
 		_textEdit->clear ();
 		setCurrentFile ("");
+		openListingIndex ();
 	}
 }
 /*}}}*/
@@ -523,11 +1351,13 @@ void MainWindow::about (void)
 
 /*{{{  void MainWindow::documentWasModified (void)*/
 /*
- *	sets the modified-state based on the text-editor's modification state.
+ *	sets the modified-state based on the text-editor's modification state, and re-analyses
+ *	the text once editing pauses.
  */
 void MainWindow::documentWasModified (void)
 {
 	setWindowModified (_textEdit->isModified ());
+	_analysisTimer.start ();
 }
 /*}}}*/
 
@@ -547,6 +1377,42 @@ void MainWindow::createActions (void)
 	_buildAndSendAct->setStatusTip (tr ("Build the current script and upload it to the board"));
 	connect (_buildAndSendAct, SIGNAL (triggered ()), this, SLOT (buildAndRun ()));
 
+	_batchBuildAct = new QAction (tr ("B&atch build..."), this);
+	_batchBuildAct->setStatusTip (tr ("Build several files at once, in parallel"));
+	connect (_batchBuildAct, SIGNAL (triggered ()), this, SLOT (batchBuild ()));
+
+	_isrBudgetAct = new QAction (tr ("&Interrupt cycle budget..."), this);
+	_isrBudgetAct->setStatusTip (tr ("Set the most cycles an interrupt handler may take before it is flagged"));
+	connect (_isrBudgetAct, SIGNAL (triggered ()), this, SLOT (setIsrBudget ()));
+
+	_memoryBudgetAct = new QAction (tr ("&Memory budgets..."), this);
+	_memoryBudgetAct->setStatusTip (tr ("Set how much of flash, SRAM and EEPROM a build may use before it fails"));
+	connect (_memoryBudgetAct, SIGNAL (triggered ()), this, SLOT (setMemoryBudgets ()));
+
+	_mixAct = new QAction (tr ("Instruction &statistics..."), this);
+	_mixAct->setStatusTip (tr ("Count instructions by class and opcode, per file and function, and export them"));
+	connect (_mixAct, SIGNAL (triggered ()), this, SLOT (instructionStatistics ()));
+
+	_simulateAct = new QAction (tr ("Si&mulate"), this);
+	_simulateAct->setShortcut (tr ("F5"));
+	_simulateAct->setStatusTip (tr ("Load the last build into the simulator, held at reset"));
+	connect (_simulateAct, SIGNAL (triggered ()), this, SLOT (simulate ()));
+
+	_profileAct = new QAction (tr ("Execution &profile"), this);
+	_profileAct->setCheckable (true);
+	_profileAct->setStatusTip (tr ("Count cycles per line while simulating: heat map in the margin and a hot-spots table"));
+	connect (_profileAct, SIGNAL (toggled (bool)), this, SLOT (setProfiling (bool)));
+
+	_traceAct = new QAction (tr ("Record &trace"), this);
+	_traceAct->setCheckable (true);
+	_traceAct->setStatusTip (tr ("Record every instruction and memory write while simulating (read with --trace-dump)"));
+	connect (_traceAct, SIGNAL (toggled (bool)), this, SLOT (setTracing (bool)));
+
+	_gdbAct = new QAction (tr ("&GDB server"), this);
+	_gdbAct->setCheckable (true);
+	_gdbAct->setStatusTip (tr ("Simulate the last build for avr-gdb to attach to (target remote localhost:PORT)"));
+	connect (_gdbAct, SIGNAL (toggled (bool)), this, SLOT (setGdbServer (bool)));
+
 	_cleanAct = new QAction (QIcon (":/images/clean32.png"), tr ("&Clear console"), this);
 	_cleanAct->setStatusTip (tr ("Clear the content of the console"));
 	connect (_cleanAct, SIGNAL (triggered ()), this, SLOT (resetConsole ()));
@@ -599,6 +1465,14 @@ void MainWindow::createActions (void)
 	_pasteAct->setStatusTip (tr ("Paste the clipboard's contents into the current " "selection"));
 	connect (_pasteAct, SIGNAL (triggered ()), _textEdit, SLOT (paste ()));
 
+	_peepholeAct = new QAction (tr ("&Peephole suggestions..."), this);
+	_peepholeAct->setStatusTip (tr ("Look for shorter or faster instruction sequences and apply them"));
+	connect (_peepholeAct, SIGNAL (triggered ()), this, SLOT (peepholeAdvisor ()));
+
+	_delayAct = new QAction (tr ("Insert &delay loop..."), this);
+	_delayAct->setStatusTip (tr ("Insert a loop that takes an exact number of cycles"));
+	connect (_delayAct, SIGNAL (triggered ()), this, SLOT (insertDelay ()));
+
 	_aboutAct = new QAction (tr ("&About"), this);
 	_aboutAct->setStatusTip (tr ("Show the application's About box"));
 	connect (_aboutAct, SIGNAL (triggered ()), this, SLOT (about ()));
@@ -607,6 +1481,20 @@ void MainWindow::createActions (void)
 	_aboutQtAct->setStatusTip (tr ("Show the Qt library's About box"));
 	connect (_aboutQtAct, SIGNAL (triggered ()), qApp, SLOT (aboutQt ()));
 
+	_listingAct = new QAction (tr ("&Disassembly"), this);
+	_listingAct->setShortcut (QKeySequence ("Ctrl+Shift+D"));
+	_listingAct->setStatusTip (tr ("Show or hide the disassembly of the last build"));
+	_listingAct->setCheckable (true);
+	connect (_listingAct, SIGNAL (toggled (bool)), _listing, SLOT (setVisible (bool)));
+	_listingAct->setChecked (QSettings ("unikent", "avr-asm-ide").value ("showListing", true).toBool ());
+	_listing->setVisible (_listingAct->isChecked ());
+
+	_cyclesAct = new QAction (tr ("&Cycle counts"), this);
+	_cyclesAct->setStatusTip (tr ("Show each instruction's cycle count and basic-block totals in the margin"));
+	_cyclesAct->setCheckable (true);
+	connect (_cyclesAct, SIGNAL (toggled (bool)), _cycleMargin, SLOT (setEnabled (bool)));
+	_cyclesAct->setChecked (QSettings ("unikent", "avr-asm-ide").value ("showCycles", false).toBool ());
+
 	_cutAct->setEnabled (false);
 	_copyAct->setEnabled (false);
 	connect (_textEdit, SIGNAL (copyAvailable (bool)), _cutAct, SLOT (setEnabled (bool)));
@@ -635,12 +1523,31 @@ void MainWindow::createMenus (void)
 	_editMenu->addAction (_copyAct);
 	_editMenu->addAction (_pasteAct);
 	_editMenu->addSeparator ();
+	_editMenu->addAction (_peepholeAct);
+	_editMenu->addAction (_delayAct);
+	_editMenu->addSeparator ();
 	_editMenu->addAction (_optionAct);
 
 	_buildMenu = menuBar ()->addMenu (tr ("&Build"));
 	_buildMenu->addAction (_buildAct);
 	_buildMenu->addAction (_sendToBoardAct);
 	_buildMenu->addAction (_buildAndSendAct);
+	_buildMenu->addSeparator ();
+	_buildMenu->addAction (_batchBuildAct);
+	_buildMenu->addAction (_isrBudgetAct);
+	_buildMenu->addAction (_memoryBudgetAct);
+	_buildMenu->addAction (_mixAct);
+	_buildMenu->addSeparator ();
+	_buildMenu->addAction (_simulateAct);
+	_buildMenu->addAction (_traceAct);
+	_buildMenu->addAction (_gdbAct);
+
+	_viewMenu = menuBar ()->addMenu (tr ("&View"));
+	_viewMenu->addAction (_listingAct);
+	_viewMenu->addAction (_cyclesAct);
+	_viewMenu->addAction (_simulatorDock->toggleViewAction ());
+	_viewMenu->addAction (_terminalDock->toggleViewAction ());
+	_viewMenu->addAction (_profileAct);
 
 	//    menuBar()->addSeparator();
 
@@ -678,7 +1585,18 @@ void MainWindow::createToolBars (void)
  */
 void MainWindow::createStatusBar (void)
 {
+	static const char *names[3] = {"flash", "sram", "eeprom"};
+
 	statusBar ()->showMessage (tr ("Ready"));
+	for (int i=0; i<3; i++) {
+		_gauges[i] = new QProgressBar ();
+		_gauges[i]->setRange (0, 100);
+		_gauges[i]->setValue (0);
+		_gauges[i]->setFormat (QString ("%1 %p%").arg (names[i]));
+		_gauges[i]->setMaximumWidth (110);
+		_gauges[i]->setToolTip (tr ("Not built yet"));
+		statusBar ()->addPermanentWidget (_gauges[i]);
+	}
 }
 /*}}}*/
 /*{{{  void MainWindow::readSettings (void)*/
@@ -705,6 +1623,8 @@ void MainWindow::writeSettings (void)
 	QSettings settings ("unikent", "avr-asm-ide");
 
 	settings.setValue ("pos", pos ());
+	settings.setValue ("showListing", _listingAct->isChecked ());
+	settings.setValue ("showCycles", _cyclesAct->isChecked ());
 	settings.setValue ("size", size ());
 }
 /*}}}*/
@@ -775,6 +1695,8 @@ void MainWindow::loadFile (const QString &fileName)
 	QApplication::restoreOverrideCursor ();
 
 	setCurrentFile (fileName);
+	openListingIndex ();
+	requestAnalysis ();
 	statusBar ()->showMessage (tr ("File loaded"), 2000);
 }
 /*}}}*/
@@ -800,6 +1722,7 @@ bool MainWindow::saveFile (const QString &fileName)
 
 	setCurrentFile (fileName);
 	statusBar ()->showMessage (tr ("File saved"), 2000);
+	requestAnalysis ();
 	return true;
 }
 /*}}}*/
@@ -812,6 +1735,10 @@ void MainWindow::setCurrentFile (const QString &fileName)
 {
 	QDir *dir = new QDir ();
 
+	if (dir->relativeFilePath (fileName) != _curFile) {
+		/* hints were for the previous file */
+		_lexer->setLiveRegisters (QHash<int, quint32> ());
+	}
 	_curFile = dir->relativeFilePath (fileName);
 	_textEdit->setModified (false);
 	setWindowModified (false);
@@ -48,8 +48,12 @@
 #include <QPlainTextEdit>
 #include <QProgressBar>
 #include <QProcess>
+#include <QTimer>
 
 #include "avrasmlexer.h"
+#include "avrheximage.h"
+#include "avrlisting.h"
+#include "avrmemoryusage.h"
 #include "parameters.h"
 
 #define EXIT_CODE_REBOOT 12345
@@ -57,6 +61,14 @@
 #define APP_NAME "AVR-ASM-IDE"
 
 class QAction;
+class QDockWidget;
+class AVRBackgroundAnalysis;
+class AVRBatchBuild;
+class AVRCycleMargin;
+class AVRGdbServer;
+class AVRHotSpotPanel;
+class AVRSerialTerminal;
+class AVRSimulatorPanel;
 class QMenu;
 class QsciScintilla;
 
@@ -92,6 +104,24 @@ private slots:
 	void updateNoccPath (void);
 	void openExample (int);
 	void consoleCursorPosChange (void);
+	void batchBuild (void);
+	void batchJobFinished (QString, QString, bool);
+	void batchBuildFinished (void);
+	void setIsrBudget (void);
+	void setMemoryBudgets (void);
+	void peepholeAdvisor (void);
+	void insertDelay (void);
+	void instructionStatistics (void);
+	void simulate (void);
+	void simulatorStopped (QString);
+	void setProfiling (bool);
+	void setTracing (bool);
+	void setGdbServer (bool);
+	void simulatorMessage (QString);
+	void updateProfile (void);
+	void showLine (int);
+	void requestAnalysis (void);
+	void analysisFinished (void);
 
 private:
 	void logWarning (QString);
@@ -108,6 +138,14 @@ private:
 	void readSettings (void);
 	void writeSettings (void);
 	bool saveBuild (void);
+	QString outputFileName (const QString &);
+	bool loadBuildImages (void);
+	void updateListing (void);
+	void writeListingFiles (const AVRASMProgram &program);
+	bool checkMemoryUsage (const AVRASMProgram &program);
+	void updateGauges (const AVRMemoryUsage &usage);
+	void openListingIndex (void);
+	void updateAddressMargin (void);
 	void loadFile (const QString &);
 	bool saveFile (const QString &);
 	void setCurrentFile (const QString &);
@@ -117,10 +155,12 @@ private:
 
 	QsciScintilla *_textEdit;
 	AVRASMLexer *_lexer;
+	AVRCycleMargin *_cycleMargin;
 
 	QMenu *_fileMenu;
 	QMenu *_editMenu;
 	QMenu *_buildMenu;
+	QMenu *_viewMenu;
 	QMenu *_helpMenu;
 	QMenu *_exampleMenu;
 	QToolBar *_buildToolBar;
@@ -141,16 +181,47 @@ private:
 	QAction *_aboutAct;
 	QAction *_aboutQtAct;
 	QAction *_cleanAct;
+	QAction *_batchBuildAct;
+	QAction *_isrBudgetAct;
+	QAction *_memoryBudgetAct;
+	QAction *_peepholeAct;
+	QAction *_delayAct;
+	QAction *_mixAct;
+	QAction *_simulateAct;
+	QAction *_profileAct;
+	QAction *_traceAct;
+	QAction *_gdbAct;
+	QAction *_listingAct;
+	QAction *_cyclesAct;
 	Parameters *_params;
 	QProcess _buildProcess;
 	QProcess _sendProcess;
 	QPlainTextEdit *_console;
+	QPlainTextEdit *_listing;	/* disassembly of _flashImage */
 	QString _curFile;
 	QString _noccLog;
 	QString _noccError;
 	QString _avrdudeLog;
 	QString _avrdudeError;
 	QStringList _exampleList;
+	AVRHexImage _flashImage;	/* from the last successful build */
+	AVRHexImage _eepromImage;
+	AVRBatchBuild *_batchBuild;	/* while one is running */
+	int _batchDone;
+	int _batchTotal;
+	AVRListingIndex _listingIndex;	/* mapped .lstx for the current file */
+	AVRBackgroundAnalysis *_analysis;
+	QTimer _analysisTimer;		/* re-analyses once editing pauses */
+	QStringList _analysisReport;	/* messages logged for the last analysis */
+	AVRSimulatorPanel *_simulator;
+	QDockWidget *_simulatorDock;
+	AVRHotSpotPanel *_hotSpots;
+	QDockWidget *_hotSpotDock;
+	AVRSerialTerminal *_terminal;
+	QDockWidget *_terminalDock;
+	AVRGdbServer *_gdbServer;	/* while serving gdb */
+	QProgressBar *_gauges[3];	/* flash, SRAM, EEPROM usage in the status bar */
+	bool _buildOk;			/* last build succeeded and is within budget */
 
 	bool _isFillingLog;		/* true if currently adding to the log/console */
 };